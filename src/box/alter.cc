@@ -334,6 +334,15 @@ key_opts_create(struct key_opts *opts, const char *map)
 				     ER_WRONG_INDEX_OPTIONS, INDEX_OPTS);
 	if (opts->distancebuf[0] != '\0')
 		opts->distance = key_opts_decode_distance(opts->distancebuf);
+	if (opts->compactionbuf[0] != '\0') {
+		opts->compaction = STR2ENUM(vinyl_compaction,
+					    opts->compactionbuf);
+		if (opts->compaction == vinyl_compaction_MAX) {
+			tnt_raise(ClientError, ER_WRONG_INDEX_OPTIONS,
+				  INDEX_OPTS, "compaction must be either "
+				  "'tiered' or 'leveled'");
+		}
+	}
 	return map;
 }
 
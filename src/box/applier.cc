@@ -50,6 +50,8 @@
 
 /* TODO: add configuration options */
 static const int RECONNECT_DELAY = 1;
+/** Max number of rows applied concurrently during SUBSCRIBE */
+static const int APPLIER_INFLIGHT_MAX = 128;
 
 STRS(applier_state, applier_STATE);
 
@@ -278,6 +280,62 @@ finish:
 	applier_set_state(applier, APPLIER_CONNECTED);
 }
 
+/**
+ * Apply a single row received in SUBSCRIBE in a separate fiber.
+ * The fiber only waits for WAL, so that a next row can be applied
+ * while this one is being written. Errors are passed to the reader
+ * via applier->diag.
+ */
+static int
+applier_apply_f(va_list ap)
+{
+	struct applier *applier = va_arg(ap, struct applier *);
+	struct xrow_header row = *va_arg(ap, struct xrow_header *);
+	try {
+		/*
+		 * The reader reuses its input buffer as soon
+		 * as this fiber yields, copy the body first.
+		 */
+		for (int i = 0; i < row.bodycnt; i++) {
+			void *body = region_alloc_xc(&fiber()->gc,
+						     row.body[i].iov_len);
+			memcpy(body, row.body[i].iov_base,
+			       row.body[i].iov_len);
+			row.body[i].iov_base = body;
+		}
+		xstream_write(applier->subscribe_stream, &row);
+	} catch (Exception *e) {
+		if (diag_is_empty(&applier->diag))
+			diag_move(&fiber()->diag, &applier->diag);
+	}
+	if (--applier->inflight == 0 ||
+	    applier->inflight == APPLIER_INFLIGHT_MAX - 1)
+		ipc_cond_broadcast(&applier->inflight_cond);
+	return 0;
+}
+
+/**
+ * Wait until there are no more than @a max rows being applied.
+ */
+static void
+applier_wait_inflight(struct applier *applier, int max)
+{
+	while (applier->inflight > max)
+		ipc_cond_wait(&applier->inflight_cond);
+}
+
+/**
+ * Raise the error of a failed apply fiber, if any.
+ */
+static void
+applier_check_inflight(struct applier *applier)
+{
+	if (diag_is_empty(&applier->diag))
+		return;
+	diag_move(&applier->diag, &fiber()->diag);
+	diag_raise();
+}
+
 /**
  * Execute and process SUBSCRIBE request (follow updates from a master).
  */
@@ -286,6 +344,11 @@ applier_subscribe(struct applier *applier)
 {
 	assert(applier->subscribe_stream != NULL);
 
+	/* Finish rows left from the previous connection */
+	applier_wait_inflight(applier, 0);
+	fiber_testcancel();
+	applier_check_inflight(applier);
+
 	/* Send SUBSCRIBE request */
 	struct ev_io *coio = &applier->io;
 	struct iobuf *iobuf = applier->iobuf;
@@ -345,15 +408,52 @@ applier_subscribe(struct applier *applier)
 
 	/*
 	 * Process a stream of rows from the binary log.
+	 *
+	 * Each row is applied in its own fiber. A row is
+	 * executed and submitted to WAL before the next one
+	 * is started, so rows are committed in the order they
+	 * arrive and the vclock is followed in order, while
+	 * WAL writes of the rows received in one read overlap
+	 * and are grouped into batches by the WAL writer.
 	 */
 	while (true) {
+		if (ibuf_used(&iobuf->in) == 0) {
+			/*
+			 * All rows received so far are started.
+			 * Wait for their WAL writes before blocking
+			 * on the socket, so that a failed write
+			 * stops the applier now and not when the
+			 * master sends the next row, which may
+			 * never happen.
+			 */
+			applier_wait_inflight(applier, 0);
+			fiber_testcancel();
+			applier_check_inflight(applier);
+		}
 		coio_read_xrow(coio, &iobuf->in, &row);
 		applier->lag = ev_now(loop()) - row.tm;
 		applier->last_row_time = ev_now(loop());
 
 		if (iproto_type_is_error(row.type))
 			xrow_decode_error(&row);  /* error */
-		xstream_write(applier->subscribe_stream, &row);
+
+		applier_wait_inflight(applier, APPLIER_INFLIGHT_MAX - 1);
+		fiber_testcancel();
+		applier_check_inflight(applier);
+		struct fiber *f = fiber_new_xc("applier/apply",
+					       applier_apply_f);
+		applier->inflight++;
+		fiber_start(f, applier, &row);
+		if (vclock_get(&r->vclock, row.server_id) < row.lsn) {
+			/*
+			 * The row yielded before reaching WAL,
+			 * e.g. on a disk read. Wait for it so
+			 * that the next row doesn't overtake it.
+			 */
+			applier_wait_inflight(applier, 0);
+			fiber_testcancel();
+		}
+		applier_check_inflight(applier);
 
 		iobuf_reset(iobuf);
 		fiber_gc();
@@ -467,6 +567,8 @@ applier_stop(struct applier *applier)
 		return;
 	fiber_cancel(f);
 	fiber_join(f);
+	applier_wait_inflight(applier, 0);
+	diag_clear(&applier->diag);
 	applier_set_state(applier, APPLIER_OFF);
 	applier->reader = NULL;
 }
@@ -500,6 +602,8 @@ applier_new(const char *uri, struct xstream *initial_join_stream,
 	applier->last_row_time = ev_now(loop());
 	rlist_create(&applier->on_state);
 	ipc_channel_create(&applier->pause, 0);
+	ipc_cond_create(&applier->inflight_cond);
+	diag_create(&applier->diag);
 
 	return applier;
 }
@@ -510,7 +614,10 @@ applier_delete(struct applier *applier)
 	assert(applier->reader == NULL);
 	iobuf_delete(applier->iobuf);
 	assert(applier->io.fd == -1);
+	assert(applier->inflight == 0);
 	ipc_channel_destroy(&applier->pause);
+	ipc_cond_destroy(&applier->inflight_cond);
+	diag_destroy(&applier->diag);
 	trigger_destroy(&applier->on_state);
 	free(applier);
 }
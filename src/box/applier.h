@@ -41,6 +41,7 @@
 #include "third_party/tarantool_ev.h"
 #include "vclock.h"
 #include "ipc.h"
+#include "diag.h"
 
 struct xstream;
 
@@ -109,6 +110,12 @@ struct applier {
 	struct xstream *final_join_stream;
 	/** xstream to process rows during SUBSCRIBE */
 	struct xstream *subscribe_stream;
+	/** Number of fibers applying SUBSCRIBE rows */
+	int inflight;
+	/** Signaled when an apply fiber finishes */
+	struct ipc_cond inflight_cond;
+	/** The first error of an apply fiber, raised by the reader */
+	struct diag diag;
 };
 
 /**
@@ -344,6 +344,57 @@ box_check_rows_per_wal(int64_t rows_per_wal)
 	return rows_per_wal;
 }
 
+static double
+box_check_wal_sync_delay(double delay)
+{
+	if (delay < 0) {
+		tnt_raise(ClientError, ER_CFG, "wal_sync_delay",
+			  "the value must not be negative");
+	}
+	return delay;
+}
+
+static int64_t
+box_check_wal_sync_max_bytes(int64_t max_bytes)
+{
+	if (max_bytes <= 0) {
+		tnt_raise(ClientError, ER_CFG, "wal_sync_max_bytes",
+			  "the value must be greater than zero");
+	}
+	return max_bytes;
+}
+
+static int64_t
+box_check_wal_ring_size(int64_t size)
+{
+	if (size < 0) {
+		tnt_raise(ClientError, ER_CFG, "wal_ring_size",
+			  "the value must not be negative");
+	}
+	return size;
+}
+
+static int
+box_check_snap_threads(int threads)
+{
+	if (threads <= 0) {
+		tnt_raise(ClientError, ER_CFG, "snap_threads",
+			  "the value must be greater than zero");
+	}
+	return threads;
+}
+
+static int
+box_check_iproto_threads(int threads)
+{
+	enum { IPROTO_THREADS_MAX = 64 };
+	if (threads <= 0 || threads > IPROTO_THREADS_MAX) {
+		tnt_raise(ClientError, ER_CFG, "iproto_threads",
+			  "the value must be between 1 and 64");
+	}
+	return threads;
+}
+
 void
 box_check_config()
 {
@@ -351,8 +402,13 @@ box_check_config()
 	box_check_uri(cfg_gets("listen"), "listen");
 	box_check_replication_source();
 	box_check_readahead(cfg_geti("readahead"));
+	box_check_iproto_threads(cfg_geti("iproto_threads"));
 	box_check_rows_per_wal(cfg_geti64("rows_per_wal"));
 	box_check_wal_mode(cfg_gets("wal_mode"));
+	box_check_wal_sync_delay(cfg_getd("wal_sync_delay"));
+	box_check_wal_sync_max_bytes(cfg_geti64("wal_sync_max_bytes"));
+	box_check_wal_ring_size(cfg_geti64("wal_ring_size"));
+	box_check_snap_threads(cfg_geti("snap_threads"));
 	box_check_slab_alloc_minimal(cfg_geti64("slab_alloc_minimal"));
 }
 
@@ -470,6 +526,15 @@ box_set_snap_io_rate_limit(void)
 		memtx->setSnapIoRateLimit(cfg_getd("snap_io_rate_limit"));
 }
 
+void
+box_set_snap_threads(void)
+{
+	int threads = box_check_snap_threads(cfg_geti("snap_threads"));
+	MemtxEngine *memtx = (MemtxEngine *) engine_find("memtx");
+	if (memtx)
+		memtx->setSnapThreads(threads);
+}
+
 void
 box_set_too_long_threshold(void)
 {
@@ -646,6 +711,35 @@ box_select(struct port *port, uint32_t space_id, uint32_t index_id,
 	}
 }
 
+int
+box_get_multi(struct port *port, uint32_t space_id, uint32_t index_id,
+	      const char *keys, const char *keys_end)
+{
+	mp_tuple_assert(keys, keys_end);
+	try {
+		struct space *space = space_cache_find(space_id);
+		access_check_space(space, PRIV_R);
+		Index *index = index_find_unique(space, index_id);
+		const char *pos = keys;
+		uint32_t key_count = mp_decode_array(&pos);
+		rmean_collect(rmean_box, IPROTO_SELECT, key_count);
+		if (key_count == 0)
+			return 0;
+		struct tuple **result = (struct tuple **)
+			region_alloc_xc(&fiber()->gc,
+					key_count * sizeof(*result));
+		struct txn *txn = txn_begin_ro_stmt(space);
+		index_find_multi(index, keys, result);
+		for (uint32_t i = 0; i < key_count; i++)
+			port_add_tuple(port, result[i]);
+		txn_commit_ro_stmt(txn);
+		return 0;
+	} catch (Exception *e) {
+		txn_rollback_stmt();
+		return -1;
+	}
+}
+
 int
 box_insert(uint32_t space_id, const char *tuple, const char *tuple_end,
 	   box_tuple_t **result)
@@ -1287,6 +1381,8 @@ engine_init()
 	MemtxEngine *memtx = new MemtxEngine(cfg_gets("snap_dir"),
 					     cfg_geti("panic_on_snap_error"),
 					     cfg_geti("panic_on_wal_error"));
+	/* Used by snapshot recovery, before dynamic options are set. */
+	memtx->setSnapThreads(cfg_geti("snap_threads"));
 	engine_register(memtx);
 
 	SysviewEngine *sysview = new SysviewEngine();
@@ -1432,7 +1528,7 @@ box_init(void)
 
 	cluster_init();
 	port_init();
-	iproto_init();
+	iproto_init(cfg_geti("iproto_threads"));
 
 	title("loading");
 
@@ -1537,9 +1633,17 @@ box_init(void)
 	/* Start WAL writer */
 	int64_t rows_per_wal = box_check_rows_per_wal(cfg_geti64("rows_per_wal"));
 	enum wal_mode wal_mode = box_check_wal_mode(cfg_gets("wal_mode"));
+	double wal_sync_delay =
+		box_check_wal_sync_delay(cfg_getd("wal_sync_delay"));
+	int64_t wal_sync_max_bytes =
+		box_check_wal_sync_max_bytes(cfg_geti64("wal_sync_max_bytes"));
+	int64_t wal_ring_size =
+		box_check_wal_ring_size(cfg_geti64("wal_ring_size"));
 	if (wal_mode != WAL_NONE) {
 		wal_writer_start(wal_mode, cfg_gets("wal_dir"), &SERVER_UUID,
-				 &recovery->vclock, rows_per_wal);
+				 &recovery->vclock, rows_per_wal,
+				 wal_sync_delay, wal_sync_max_bytes,
+				 wal_ring_size);
 	}
 
 	rmean_cleanup(rmean_box);
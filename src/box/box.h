@@ -113,6 +113,7 @@ void box_set_replication_source(void);
 void box_set_log_level(void);
 void box_set_io_collect_interval(void);
 void box_set_snap_io_rate_limit(void);
+void box_set_snap_threads(void);
 void box_set_too_long_threshold(void);
 void box_set_readahead(void);
 void box_set_panic_on_wal_error(void);
@@ -133,6 +134,15 @@ box_select(struct port *port, uint32_t space_id, uint32_t index_id,
 	   int iterator, uint32_t offset, uint32_t limit,
 	   const char *key, const char *key_end);
 
+/**
+ * Find tuples by an array of full keys of a unique index.
+ * The port gets one entry per key, in the order of keys,
+ * NULL for a key which is not found.
+ */
+int
+box_get_multi(struct port *port, uint32_t space_id, uint32_t index_id,
+	      const char *keys, const char *keys_end);
+
 /** \cond public */
 
 /*
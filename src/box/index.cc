@@ -37,6 +37,7 @@
 #include "iproto_constants.h"
 #include "txn.h"
 #include "rmean.h"
+#include "fiber.h"
 
 const char *iterator_type_strs[] = {
 	/* [ITER_EQ]  = */ "EQ",
@@ -233,6 +234,45 @@ Index::findByKey(const char *key, uint32_t part_count) const
 	return NULL;
 }
 
+void
+Index::findByKeys(const char **keys, uint32_t key_count,
+		  struct tuple **result) const
+{
+	for (uint32_t i = 0; i < key_count; i++)
+		result[i] = findByKey(keys[i], key_def->part_count);
+}
+
+uint32_t
+index_find_multi(Index *index, const char *keys, struct tuple **result)
+{
+	assert(index->key_def->opts.is_unique);
+	RegionGuard region_guard(&fiber()->gc);
+	uint32_t key_count = mp_decode_array(&keys);
+	if (key_count == 0)
+		return 0;
+	const char **key_data = (const char **)
+		region_alloc_xc(&fiber()->gc, key_count * sizeof(*key_data));
+	/*
+	 * Validate all keys before looking up any of them,
+	 * so that the index can process the whole batch at
+	 * once.
+	 */
+	for (uint32_t i = 0; i < key_count; i++) {
+		if (mp_typeof(*keys) != MP_ARRAY) {
+			tnt_raise(ClientError, ER_ILLEGAL_PARAMS,
+				  "multi-get key must be an array");
+		}
+		const char *key = keys;
+		mp_next(&keys);
+		uint32_t part_count = mp_decode_array(&key);
+		if (primary_key_validate(index->key_def, key, part_count))
+			diag_raise();
+		key_data[i] = key;
+	}
+	index->findByKeys(key_data, key_count, result);
+	return key_count;
+}
+
 struct tuple *
 Index::findByTuple(struct tuple *tuple) const
 {
@@ -377,6 +417,39 @@ box_index_get(uint32_t space_id, uint32_t index_id, const char *key,
 	}
 }
 
+int
+box_index_get_multi(uint32_t space_id, uint32_t index_id, const char *keys,
+		    const char *keys_end, box_tuple_t **result)
+{
+	assert(keys != NULL && keys_end != NULL && result != NULL);
+	mp_tuple_assert(keys, keys_end);
+	try {
+		struct space *space;
+		Index *index = check_index(space_id, index_id, &space);
+		if (!index->key_def->opts.is_unique)
+			tnt_raise(ClientError, ER_MORE_THAN_ONE_TUPLE);
+		/* Start transaction in the engine. */
+		struct txn *txn = txn_begin_ro_stmt(space);
+		uint32_t key_count = index_find_multi(index, keys, result);
+		/* Count statistics */
+		rmean_collect(rmean_box, IPROTO_SELECT, key_count);
+		for (uint32_t i = 0; i < key_count; i++) {
+			if (result[i] == NULL || tuple_ref(result[i]) == 0)
+				continue;
+			while (i-- > 0) {
+				if (result[i] != NULL)
+					tuple_unref(result[i]);
+			}
+			diag_raise();
+		}
+		txn_commit_ro_stmt(txn);
+		return 0;
+	}  catch (Exception *) {
+		txn_rollback_stmt();
+		return -1;
+	}
+}
+
 int
 box_index_min(uint32_t space_id, uint32_t index_id, const char *key,
 	      const char *key_end, box_tuple_t **result)
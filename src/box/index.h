@@ -180,6 +180,30 @@ int
 box_index_get(uint32_t space_id, uint32_t index_id, const char *key,
 	      const char *key_end, box_tuple_t **result);
 
+/**
+ * Get tuples from index by a batch of keys.
+ *
+ * Works like box_index_get() called for every key, but lets the
+ * index overlap the lookups, e.g. a HASH index prefetches the
+ * buckets of all keys before probing any of them.
+ *
+ * \param space_id space identifier
+ * \param index_id index identifier
+ * \param keys encoded array of keys in MsgPack Array format
+ *        ([[part1, part2, ...], [part1, part2, ...], ...]).
+ * \param keys_end the end of encoded \a keys
+ * \param[out] result a tuple or NULL for every key, in the order
+ *        of the keys. Must have room for all keys. Found tuples
+ *        are referenced, release them with box_tuple_unref().
+ * \retval -1 on error (check box_error_last())
+ * \retval 0 on success
+ * \pre keys != NULL
+ * \sa \code box.space[space_id].index[index_id]:get_multi(keys) \endcode
+ */
+int
+box_index_get_multi(uint32_t space_id, uint32_t index_id, const char *keys,
+		    const char *keys_end, box_tuple_t **result);
+
 /**
  * Return a first (minimal) tuple matched the provided key.
  *
@@ -330,6 +354,15 @@ public:
 	virtual size_t count(enum iterator_type type, const char *key,
 			     uint32_t part_count) const;
 	virtual struct tuple *findByKey(const char *key, uint32_t part_count) const;
+	/**
+	 * Find tuples by a batch of full keys. Each element of
+	 * @a keys points to the parts of a key, past the array
+	 * header. @a result gets a tuple or NULL for every key.
+	 * The default implementation calls findByKey() in a loop,
+	 * an index may override it to order or overlap lookups.
+	 */
+	virtual void findByKeys(const char **keys, uint32_t key_count,
+				struct tuple **result) const;
 	virtual struct tuple *findByTuple(struct tuple *tuple) const;
 	virtual struct tuple *replace(struct tuple *old_tuple,
 				      struct tuple *new_tuple,
@@ -406,6 +439,15 @@ replace_check_dup(struct tuple *old_tuple, struct tuple *dup_tuple,
 	return 0;
 }
 
+/**
+ * Find tuples in a unique index by an encoded array of full
+ * keys. All keys are validated before the whole batch is passed
+ * to Index::findByKeys(). @a result must have room for every key.
+ * Return the number of keys. Throws on error.
+ */
+uint32_t
+index_find_multi(Index *index, const char *keys, struct tuple **result);
+
 /** Get index ordinal number in space. */
 static inline uint32_t
 index_id(const Index *index)
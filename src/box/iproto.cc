@@ -33,6 +33,7 @@
 #include <stdint.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include <msgpuck.h>
 #include "third_party/base64.h"
@@ -59,9 +60,77 @@
 #include "iproto_constants.h"
 #include "rmean.h"
 
-/* The number of iproto messages in flight */
+/* The number of iproto messages in flight, in all net threads */
 enum { IPROTO_MSG_MAX = 768 };
 
+enum {
+	/**
+	 * Tuples of this size or bigger are sent to the client
+	 * straight from the tuple memory rather than copied to
+	 * the output buffer, see iproto_port_dump().
+	 */
+	IPROTO_ZC_TUPLE_SIZE_MIN = 1024,
+	/** The max number of iovecs in one writev() of iproto_flush(). */
+	IPROTO_FLUSH_IOV_MAX = 256
+};
+
+/* {{{ iproto_zc_batch - zero-copy output */
+
+/** A tuple sent by reference, see struct iproto_zc_batch. */
+struct iproto_zc_chunk {
+	/**
+	 * The output buffer position the tuple belongs to:
+	 * it is sent right before the byte at this position.
+	 */
+	size_t used;
+	/** A referenced tuple. */
+	struct tuple *tuple;
+};
+
+/**
+ * Big tuples of a single reply which are not copied to the
+ * output buffer. The batch is created in tx, queued for
+ * output together with the reply in net_send_msg(), and
+ * sent back to tx to release the tuples as soon as they are
+ * written to the socket.
+ */
+struct iproto_zc_batch: public cmsg
+{
+	/** Link in iproto_zc_queue::batches. */
+	struct rlist link;
+	/** The number of chunks. */
+	uint32_t count;
+	/** The chunk being written, in the net thread. */
+	uint32_t pos;
+	/** How many bytes of the chunk at pos are written. */
+	size_t offset;
+	struct iproto_zc_chunk chunks[0];
+};
+
+/** Release the tuples of a batch and free it. Runs in tx. */
+static void
+tx_zc_batch_free(struct cmsg *m)
+{
+	struct iproto_zc_batch *batch = (struct iproto_zc_batch *) m;
+	for (uint32_t i = 0; i < batch->count; i++)
+		tuple_unref(batch->chunks[i].tuple);
+	free(batch);
+}
+
+/**
+ * Zero-copy output of one of the two connection iobufs.
+ * Only accessed in the net thread, except for connection
+ * destruction in tx.
+ */
+struct iproto_zc_queue {
+	/** The iobuf the output goes with. */
+	struct iobuf *iobuf;
+	/** Batches to write, in the order of their positions. */
+	struct rlist batches;
+};
+
+/* }}} */
+
 /* {{{ iproto_msg - declaration */
 
 /**
@@ -93,6 +162,8 @@ struct iproto_msg: public cmsg
 	size_t len;
 	/** End of write position in the output buffer */
 	struct obuf_svp write_end;
+	/** Tuples of the reply sent by reference, if any. */
+	struct iproto_zc_batch *zc;
 	/**
 	 * Used in "connect" msgs, true if connect trigger failed
 	 * and the connection must be closed.
@@ -100,63 +171,81 @@ struct iproto_msg: public cmsg
 	bool close_connection;
 };
 
-static struct mempool iproto_msg_pool;
+/* }}} */
 
-static struct iproto_msg *
-iproto_msg_new(struct iproto_connection *con)
-{
-	struct iproto_msg *msg =
-		(struct iproto_msg *) mempool_alloc_xc(&iproto_msg_pool);
-	msg->connection = con;
-	return msg;
-}
+/* {{{ iproto_thread - a network io thread */
 
 /**
- * Resume stopped connections, if any.
+ * Client connections are served by one or more network io
+ * threads (box.cfg.iproto_threads). The first thread owns
+ * the listening socket and spreads accepted connections
+ * among all threads round-robin. A connection stays in its
+ * thread till it's closed. Each thread has its own pair of
+ * pipes to the tx thread, its own message and connection
+ * pools, and its own statistics.
  */
-static void
-iproto_resume();
-
-
-static inline void
-iproto_msg_delete(struct cmsg *msg)
-{
-	mempool_free(&iproto_msg_pool, msg);
-	iproto_resume();
-}
-
-struct IprotoMsgGuard {
-	struct iproto_msg *msg;
-	IprotoMsgGuard(struct iproto_msg *msg_arg):msg(msg_arg) {}
-	~IprotoMsgGuard()
-	{ if (msg) iproto_msg_delete(msg); }
-	struct iproto_msg *release()
-	{ struct iproto_msg *tmp = msg; msg = NULL; return tmp; }
+struct iproto_thread {
+	/** The thread. */
+	struct cord cord;
+	/** Index of the thread in iproto_threads. */
+	int id;
+	/**
+	 * A queue for all requests in all connections of the
+	 * thread. All requests from all connections are processed
+	 * concurrently.
+	 * Is also used as a queue for just established connections
+	 * and to execute disconnect triggers. A few notes about
+	 * these triggers:
+	 * - they need to be run in a fiber
+	 * - unlike an ordinary request failure, on_connect trigger
+	 *   failure must lead to connection close.
+	 * - on_connect trigger must be processed before any other
+	 *   request on this connection.
+	 */
+	struct cpipe tx_pipe;
+	/** Pipe from the tx thread to this thread. */
+	struct cpipe net_pipe;
+	struct cbus net_tx_bus;
+	/** Max number of messages in flight in this thread. */
+	size_t msg_max;
+	struct mempool iproto_msg_pool;
+	struct mempool iproto_connection_pool;
+	/** Connections stopped due to too many messages in flight. */
+	struct rlist stopped_connections;
+	/** Network statistics of this thread. */
+	struct rmean *rmean_net;
+	/** The binary listener, only used by the first thread. */
+	struct evio_service binary;
+	/**
+	 * Message routes. They end up in net_pipe of this
+	 * thread, hence are per thread.
+	 */
+	struct cmsg_hop disconnect_route[2];
+	struct cmsg_hop misc_route[2];
+	struct cmsg_hop select_route[2];
+	struct cmsg_hop get_multi_route[2];
+	struct cmsg_hop zc_release_route[1];
+	struct cmsg_hop process1_route[2];
+	struct cmsg_hop sync_route[2];
+	struct cmsg_hop connect_route[2];
+	struct cmsg_hop accept_route[2];
+	const struct cmsg_hop *dml_route[IPROTO_TYPE_STAT_MAX];
 };
 
+static struct iproto_thread *iproto_threads;
+static int iproto_thread_count;
+
 /* }}} */
 
 /* {{{ iproto connection and requests */
 
-/**
- * A single global queue for all requests in all connections. All
- * requests from all connections are processed concurrently.
- * Is also used as a queue for just established connections and to
- * execute disconnect triggers. A few notes about these triggers:
- * - they need to be run in a fiber
- * - unlike an ordinary request failure, on_connect trigger
- *   failure must lead to connection close.
- * - on_connect trigger must be processed before any other
- *   request on this connection.
- */
-static struct cpipe tx_pipe;
-static struct cpipe net_pipe;
-static struct cbus net_tx_bus;
 /* A pointer to the transaction processor cord. */
 struct cord *tx_cord;
 
-struct rmean *rmean_net;
-struct rmean *rmean_net_tx_bus;
+/** Network statistics, one object per net thread. */
+struct rmean **rmean_net;
+struct rmean **rmean_net_tx_bus;
+int rmean_net_count;
 
 enum rmean_net_name {
 	IPROTO_SENT,
@@ -177,6 +266,8 @@ struct iproto_connection
 	 * and iobuf[0] are moved around again.
 	 */
 	struct iobuf *iobuf[2];
+	/** Tuples sent by reference, one queue per iobuf. */
+	struct iproto_zc_queue zc[2];
 	/*
 	 * Size of readahead which is not parsed yet, i.e.
 	 * size of a piece of request which is not fully read.
@@ -194,13 +285,71 @@ struct iproto_connection
 	/** Logical session. */
 	struct session *session;
 	ev_loop *loop;
+	/** The net thread serving the connection. */
+	struct iproto_thread *thread;
 	/* Pre-allocated disconnect msg. */
 	struct iproto_msg *disconnect;
 	struct rlist in_stop_list;
 };
 
-static struct mempool iproto_connection_pool;
-static RLIST_HEAD(stopped_connections);
+static struct iproto_msg *
+iproto_msg_new(struct iproto_connection *con)
+{
+	struct iproto_msg *msg = (struct iproto_msg *)
+		mempool_alloc_xc(&con->thread->iproto_msg_pool);
+	msg->connection = con;
+	msg->zc = NULL;
+	return msg;
+}
+
+/** Find the zero-copy output queue of an iobuf. */
+static inline struct iproto_zc_queue *
+iproto_connection_zc(struct iproto_connection *con, struct iobuf *iobuf)
+{
+	assert(con->zc[0].iobuf == iobuf || con->zc[1].iobuf == iobuf);
+	return con->zc[0].iobuf == iobuf ? &con->zc[0] : &con->zc[1];
+}
+
+/** Check if an iobuf has output which is not written yet. */
+static inline bool
+iproto_iobuf_has_output(struct iproto_connection *con, struct iobuf *iobuf)
+{
+	return obuf_used(&iobuf->out) > 0 ||
+	       ! rlist_empty(&iproto_connection_zc(con, iobuf)->batches);
+}
+
+/** Same as iobuf_is_idle(), but aware of zero-copy output. */
+static inline bool
+iproto_iobuf_is_idle(struct iproto_connection *con, struct iobuf *iobuf)
+{
+	return ibuf_used(&iobuf->in) == 0 &&
+	       ! iproto_iobuf_has_output(con, iobuf);
+}
+
+/**
+ * Resume stopped connections, if any.
+ */
+static void
+iproto_resume(struct iproto_thread *thread);
+
+
+static inline void
+iproto_msg_delete(struct cmsg *m)
+{
+	struct iproto_msg *msg = (struct iproto_msg *) m;
+	struct iproto_thread *thread = msg->connection->thread;
+	mempool_free(&thread->iproto_msg_pool, msg);
+	iproto_resume(thread);
+}
+
+struct IprotoMsgGuard {
+	struct iproto_msg *msg;
+	IprotoMsgGuard(struct iproto_msg *msg_arg):msg(msg_arg) {}
+	~IprotoMsgGuard()
+	{ if (msg) iproto_msg_delete(msg); }
+	struct iproto_msg *release()
+	{ struct iproto_msg *tmp = msg; msg = NULL; return tmp; }
+};
 
 /**
  * Returns true if we have enough spare messages
@@ -208,11 +357,12 @@ static RLIST_HEAD(stopped_connections);
  * discounted: they are mostly reserved and idle.
  */
 static inline bool
-iproto_stop_input()
+iproto_stop_input(struct iproto_thread *thread)
 {
-	size_t connection_count = mempool_count(&iproto_connection_pool);
-	size_t request_count = mempool_count(&iproto_msg_pool);
-	return request_count > connection_count + IPROTO_MSG_MAX;
+	size_t connection_count =
+		mempool_count(&thread->iproto_connection_pool);
+	size_t request_count = mempool_count(&thread->iproto_msg_pool);
+	return request_count > connection_count + thread->msg_max;
 }
 
 /**
@@ -222,20 +372,20 @@ iproto_stop_input()
  * object in the message pool.
  */
 static void
-iproto_resume()
+iproto_resume(struct iproto_thread *thread)
 {
 	/*
 	 * Most of the time we have nothing to do here: throttling
 	 * is not active.
 	 */
-	if (rlist_empty(&stopped_connections))
+	if (rlist_empty(&thread->stopped_connections))
 		return;
-	if (iproto_stop_input())
+	if (iproto_stop_input(thread))
 		return;
 
 	struct iproto_connection *con;
-	con = rlist_first_entry(&stopped_connections, struct iproto_connection,
-				in_stop_list);
+	con = rlist_first_entry(&thread->stopped_connections,
+				struct iproto_connection, in_stop_list);
 	ev_feed_event(con->loop, &con->input, EV_READ);
 }
 
@@ -266,7 +416,7 @@ iproto_connection_stop(struct iproto_connection *con)
 {
 	assert(rlist_empty(&con->in_stop_list));
 	ev_io_stop(con->loop, &con->input);
-	rlist_add_tail(&stopped_connections, &con->in_stop_list);
+	rlist_add_tail(&con->thread->stopped_connections, &con->in_stop_list);
 }
 
 static void
@@ -292,7 +442,7 @@ iproto_connection_delete(struct iproto_connection *con)
 	iobuf_delete_mt(con->iobuf[1]);
 	if (con->disconnect)
 		iproto_msg_delete(con->disconnect);
-	mempool_free(&iproto_connection_pool, con);
+	mempool_free(&con->thread->iproto_connection_pool, con);
 }
 
 static void
@@ -331,6 +481,17 @@ tx_process_disconnect(struct cmsg *m)
 	 */
 	obuf_destroy(&con->iobuf[0]->out);
 	obuf_destroy(&con->iobuf[1]->out);
+	/*
+	 * The connection is closed, drop the tuples which
+	 * haven't been written. The net thread doesn't
+	 * touch the queues any more.
+	 */
+	for (int i = 0; i < 2; i++) {
+		struct iproto_zc_batch *batch, *tmp;
+		rlist_foreach_entry_safe(batch, &con->zc[i].batches, link, tmp)
+			tx_zc_batch_free(batch);
+		rlist_create(&con->zc[i].batches);
+	}
 }
 
 /**
@@ -341,68 +502,34 @@ static void
 net_finish_disconnect(struct cmsg *m)
 {
 	struct iproto_msg *msg = (struct iproto_msg *) m;
-	/* Runs the trigger, which may yield. */
-	iproto_connection_delete(msg->connection);
+	struct iproto_connection *con = msg->connection;
 	iproto_msg_delete(msg);
+	/* Runs the trigger, which may yield. */
+	iproto_connection_delete(con);
 }
 
-static const struct cmsg_hop disconnect_route[] = {
-	{ tx_process_disconnect, &net_pipe },
-	{ net_finish_disconnect, NULL },
-};
-
-static const struct cmsg_hop misc_route[] = {
-	{ tx_process_misc, &net_pipe },
-	{ net_send_msg, NULL },
-};
-
-static const struct cmsg_hop select_route[] = {
-	{ tx_process_select, &net_pipe },
-	{ net_send_msg, NULL },
-};
-
-static const struct cmsg_hop process1_route[] = {
-	{ tx_process1, &net_pipe },
-	{ net_send_msg, NULL },
-};
-
-static const struct cmsg_hop *dml_route[IPROTO_TYPE_STAT_MAX] = {
-	NULL,                                   /* IPROTO_OK */
-	select_route,                           /* IPROTO_SELECT */
-	process1_route,                         /* IPROTO_INSERT */
-	process1_route,                         /* IPROTO_REPLACE */
-	process1_route,                         /* IPROTO_UPDATE */
-	process1_route,                         /* IPROTO_DELETE */
-	misc_route,                             /* IPROTO_CALL_16 */
-	misc_route,                             /* IPROTO_AUTH */
-	misc_route,                             /* IPROTO_EVAL */
-	process1_route,                         /* IPROTO_UPSERT */
-	misc_route                              /* IPROTO_CALL */
-};
-
-static const struct cmsg_hop sync_route[] = {
-	{ tx_process_join_subscribe, &net_pipe },
-	{ net_end_join_subscribe, NULL },
-};
-
 static struct iproto_connection *
-iproto_connection_new(const char *name, int fd)
+iproto_connection_new(struct iproto_thread *thread, int fd)
 {
-	(void) name;
 	struct iproto_connection *con = (struct iproto_connection *)
-		mempool_alloc_xc(&iproto_connection_pool);
+		mempool_alloc_xc(&thread->iproto_connection_pool);
 	con->input.data = con->output.data = con;
 	con->loop = loop();
+	con->thread = thread;
 	ev_io_init(&con->input, iproto_connection_on_input, fd, EV_READ);
 	ev_io_init(&con->output, iproto_connection_on_output, fd, EV_WRITE);
 	con->iobuf[0] = iobuf_new_mt(&tx_cord->slabc);
 	con->iobuf[1] = iobuf_new_mt(&tx_cord->slabc);
+	for (int i = 0; i < 2; i++) {
+		con->zc[i].iobuf = con->iobuf[i];
+		rlist_create(&con->zc[i].batches);
+	}
 	con->parse_size = 0;
 	con->session = NULL;
 	rlist_create(&con->in_stop_list);
 	/* It may be very awkward to allocate at close. */
 	con->disconnect = iproto_msg_new(con);
-	cmsg_init(con->disconnect, disconnect_route);
+	cmsg_init(con->disconnect, thread->disconnect_route);
 	return con;
 }
 
@@ -447,7 +574,7 @@ iproto_connection_close(struct iproto_connection *con)
 		assert(con->disconnect != NULL);
 		struct iproto_msg *msg = con->disconnect;
 		con->disconnect = NULL;
-		cpipe_push(&tx_pipe, msg);
+		cpipe_push(&con->thread->tx_pipe, msg);
 	}
 	rlist_del(&con->in_stop_list);
 }
@@ -510,7 +637,7 @@ iproto_connection_input_iobuf(struct iproto_connection *con)
 		return oldbuf;
 	}
 
-	if (! iobuf_is_idle(con->iobuf[1])) {
+	if (! iproto_iobuf_is_idle(con, con->iobuf[1])) {
 		/*
 		 * Wait until the second buffer is flushed
 		 * and becomes available for reuse.
@@ -533,7 +660,7 @@ iproto_connection_input_iobuf(struct iproto_connection *con)
 		 * We made ibuf idle. If obuf was already idle it makes the whole
 		 * iobuf idle, time to trim buffers.
 		 */
-		if (iobuf_is_idle(oldbuf))
+		if (iproto_iobuf_is_idle(con, oldbuf))
 			iobuf_reset_mt(oldbuf);
 	}
 	/*
@@ -565,6 +692,7 @@ iproto_decode_msg(struct iproto_msg *msg, const char **pos, const char *reqend,
 	case IPROTO_AUTH:
 	case IPROTO_EVAL:
 	case IPROTO_UPSERT:
+	case IPROTO_GET_MULTI:
 		/*
 		 * This is a common request which can be parsed with
 		 * request_decode(). Parse it before putting it into
@@ -579,15 +707,16 @@ iproto_decode_msg(struct iproto_msg *msg, const char **pos, const char *reqend,
 		request_decode_xc(&msg->request,
 				 (const char *) msg->header.body[0].iov_base,
 				 msg->header.body[0].iov_len);
-		assert(msg->header.type < sizeof(dml_route)/sizeof(*dml_route));
-		cmsg_init(msg, dml_route[msg->header.type]);
+		assert(msg->header.type < IPROTO_TYPE_STAT_MAX);
+		cmsg_init(msg,
+			  msg->connection->thread->dml_route[msg->header.type]);
 		break;
 	case IPROTO_PING:
-		cmsg_init(msg, misc_route);
+		cmsg_init(msg, msg->connection->thread->misc_route);
 		break;
 	case IPROTO_JOIN:
 	case IPROTO_SUBSCRIBE:
-		cmsg_init(msg, sync_route);
+		cmsg_init(msg, msg->connection->thread->sync_route);
 		*stop_input = true;
 		break;
 	default:
@@ -625,7 +754,8 @@ iproto_enqueue_batch(struct iproto_connection *con, struct ibuf *in)
 
 		try {
 			iproto_decode_msg(msg, &pos, reqend, &stop_input);
-			cpipe_push_input(&tx_pipe, guard.release());
+			cpipe_push_input(&con->thread->tx_pipe,
+					 guard.release());
 			n_requests++;
 		} catch (Exception *e) {
 			/*
@@ -683,7 +813,7 @@ iproto_enqueue_batch(struct iproto_connection *con, struct ibuf *in)
 		 */
 		ev_feed_event(con->loop, &con->input, EV_READ);
 	}
-	cpipe_flush_input(&tx_pipe);
+	cpipe_flush_input(&con->thread->tx_pipe);
 }
 
 static void
@@ -702,7 +832,7 @@ iproto_connection_on_input(ev_loop *loop, struct ev_io *watcher,
 		 * resume one more connection which might have
 		 * input.
 		 */
-		iproto_resume();
+		iproto_resume(con->thread);
 	}
 	/*
 	 * Throttle if there are too many pending requests,
@@ -711,7 +841,7 @@ iproto_connection_on_input(ev_loop *loop, struct ev_io *watcher,
 	 * another fiber waiting for write to complete).
 	 * Ignore iproto_connection->disconnect messages.
 	 */
-	if (iproto_stop_input()) {
+	if (iproto_stop_input(con->thread)) {
 		iproto_connection_stop(con);
 		return;
 	}
@@ -736,7 +866,7 @@ iproto_connection_on_input(ev_loop *loop, struct ev_io *watcher,
 			return;
 		}
 		/* Count statistics */
-		rmean_collect(rmean_net, IPROTO_RECEIVED, nrd);
+		rmean_collect(con->thread->rmean_net, IPROTO_RECEIVED, nrd);
 
 		/* Update the read position and connection state. */
 		in->wpos += nrd;
@@ -755,7 +885,7 @@ iproto_connection_on_input(ev_loop *loop, struct ev_io *watcher,
 static inline struct iobuf *
 iproto_connection_output_iobuf(struct iproto_connection *con)
 {
-	if (obuf_used(&con->iobuf[1]->out) > 0)
+	if (iproto_iobuf_has_output(con, con->iobuf[1]))
 		return con->iobuf[1];
 	/*
 	 * Don't try to write from a newer buffer if an older one
@@ -764,16 +894,144 @@ iproto_connection_output_iobuf(struct iproto_connection *con)
 	 * pieces of replies from both buffers.
 	 */
 	if (ibuf_used(&con->iobuf[1]->in) == 0 &&
-	    obuf_used(&con->iobuf[0]->out) > 0)
+	    iproto_iobuf_has_output(con, con->iobuf[0]))
 		return con->iobuf[0];
 	return NULL;
 }
 
+/**
+ * Flush an iobuf which has tuples sent by reference: interleave
+ * the output buffer contents with the tuple data at the chunk
+ * positions. Batches which are written completely are sent
+ * back to tx to release the tuples.
+ */
+static int
+iproto_flush_zc(struct iobuf *iobuf, struct iproto_connection *con)
+{
+	int fd = con->output.fd;
+	struct obuf_svp *begin = &iobuf->out.wpos;
+	struct obuf_svp *end = &iobuf->out.wend;
+	struct iproto_zc_queue *zc = iproto_connection_zc(con, iobuf);
+	struct iovec *src = iobuf->out.iov;
+	struct iovec iov[IPROTO_FLUSH_IOV_MAX];
+	/* The batch of each iovec, NULL for the output buffer. */
+	struct iproto_zc_batch *iov_batch[IPROTO_FLUSH_IOV_MAX];
+	while (true) {
+		int iovcnt = 0;
+		size_t total = 0;
+		int pos = begin->pos;
+		size_t offset = begin->iov_len;
+		size_t used = begin->used;
+		struct iproto_zc_batch *batch = rlist_empty(&zc->batches) ?
+			NULL : rlist_first_entry(&zc->batches,
+						 struct iproto_zc_batch, link);
+		uint32_t chunk = batch != NULL ? batch->pos : 0;
+		size_t chunk_offset = batch != NULL ? batch->offset : 0;
+		while (iovcnt < IPROTO_FLUSH_IOV_MAX) {
+			if (batch != NULL && batch->chunks[chunk].used == used) {
+				struct tuple *tuple = batch->chunks[chunk].tuple;
+				iov[iovcnt].iov_base = (char *) tuple_data(tuple) +
+						       chunk_offset;
+				iov[iovcnt].iov_len = tuple->bsize - chunk_offset;
+				iov_batch[iovcnt] = batch;
+				total += iov[iovcnt++].iov_len;
+				chunk_offset = 0;
+				if (++chunk < batch->count)
+					continue;
+				batch = batch->link.next == &zc->batches ?
+					NULL : container_of(batch->link.next,
+							    struct iproto_zc_batch,
+							    link);
+				chunk = 0;
+				continue;
+			}
+			if (used == end->used)
+				break;
+			/*
+			 * iov_len of the last pos may be concurrently
+			 * modified in tx thread, use the savepoint.
+			 */
+			size_t len = pos == end->pos ? end->iov_len :
+				     src[pos].iov_len;
+			size_t n = len - offset;
+			if (batch != NULL)
+				n = MIN(n, batch->chunks[chunk].used - used);
+			if (n > 0) {
+				iov[iovcnt].iov_base = (char *) src[pos].iov_base +
+						       offset;
+				iov[iovcnt].iov_len = n;
+				iov_batch[iovcnt] = NULL;
+				total += iov[iovcnt++].iov_len;
+				used += n;
+				offset += n;
+			}
+			if (offset == len && pos < end->pos) {
+				pos++;
+				offset = 0;
+			}
+		}
+		assert(iovcnt > 0);
+
+		ssize_t nwr = sio_writev(fd, iov, iovcnt);
+
+		/* Count statistics */
+		rmean_collect(con->thread->rmean_net, IPROTO_SENT, nwr);
+		if (nwr <= 0)
+			return -1;
+		/* Advance the write positions by what was written. */
+		size_t left = nwr;
+		for (int i = 0; i < iovcnt && left > 0; i++) {
+			size_t n = MIN(left, iov[i].iov_len);
+			left -= n;
+			batch = iov_batch[i];
+			if (batch == NULL) {
+				/*
+				 * The savepoint may point at the end of
+				 * a filled iovec, skip it like the walk
+				 * above does.
+				 */
+				while (begin->pos < end->pos &&
+				       begin->iov_len == src[begin->pos].iov_len) {
+					begin->pos++;
+					begin->iov_len = 0;
+				}
+				begin->used += n;
+				begin->iov_len += n;
+				continue;
+			}
+			batch->offset += n;
+			if (batch->offset < batch->chunks[batch->pos].tuple->bsize)
+				continue;
+			batch->offset = 0;
+			if (++batch->pos < batch->count)
+				continue;
+			rlist_del_entry(batch, link);
+			cmsg_init(batch, con->thread->zc_release_route);
+			cpipe_push(&con->thread->tx_pipe, batch);
+		}
+		if (begin->used == end->used && rlist_empty(&zc->batches)) {
+			if (ibuf_used(&iobuf->in) == 0) {
+				/* Quickly recycle the buffer if it's idle. */
+				assert(end->used == obuf_size(&iobuf->out));
+				iobuf_reset_mt(iobuf);
+			} else {
+				*begin = *end;
+			}
+			return 0;
+		}
+		if ((size_t) nwr < total)
+			return -1;
+		/* The iovec limit was hit, write the rest. */
+	}
+}
+
 /** writev() to the socket and handle the result. */
 
 static int
 iproto_flush(struct iobuf *iobuf, struct iproto_connection *con)
 {
+	if (! rlist_empty(&iproto_connection_zc(con, iobuf)->batches))
+		return iproto_flush_zc(iobuf, con);
 	int fd = con->output.fd;
 	struct obuf_svp *begin = &iobuf->out.wpos;
 	struct obuf_svp *end = &iobuf->out.wend;
@@ -793,7 +1051,7 @@ iproto_flush(struct iobuf *iobuf, struct iproto_connection *con)
 	ssize_t nwr = sio_writev(fd, iov, iovcnt);
 
 	/* Count statistics */
-	rmean_collect(rmean_net, IPROTO_SENT, nwr);
+	rmean_collect(con->thread->rmean_net, IPROTO_SENT, nwr);
 	if (nwr > 0) {
 		if (begin->used + nwr == end->used) {
 			if (ibuf_used(&iobuf->in) == 0) {
@@ -890,12 +1148,106 @@ error:
 	msg->write_end = obuf_create_svp(out);
 }
 
+/**
+ * Dump the port to the reply like port_dump(), but don't copy
+ * tuples of IPROTO_ZC_TUPLE_SIZE_MIN bytes or bigger: the reply
+ * takes over their references and they are written to the
+ * socket straight from the tuple memory by iproto_flush_zc().
+ * @param[out] zc_size the total size of the tuples not copied.
+ * @retval  0 success
+ * @retval -1 out of memory, the port is destroyed anyway
+ */
+static int
+iproto_port_dump(struct port *port, struct obuf *out,
+		 struct iproto_zc_batch **zc, size_t *zc_size)
+{
+	uint32_t count = 0;
+	for (struct port_entry *e = port->first; e != NULL; e = e->next) {
+		if (e->tuple != NULL &&
+		    e->tuple->bsize >= IPROTO_ZC_TUPLE_SIZE_MIN)
+			count++;
+	}
+	struct iproto_zc_batch *batch = NULL;
+	if (count > 0) {
+		batch = (struct iproto_zc_batch *)
+			malloc(sizeof(*batch) + count * sizeof(batch->chunks[0]));
+	}
+	if (batch == NULL) {
+		/* Nothing to share or no memory, copy everything. */
+		*zc_size = 0;
+		return port_dump(port, out);
+	}
+	batch->count = 0;
+	batch->pos = 0;
+	batch->offset = 0;
+	size_t size = 0;
+	for (struct port_entry *e = port->first; e != NULL; e = e->next) {
+		struct tuple *tuple = e->tuple;
+		if (tuple == NULL) {
+			char *data = (char *) obuf_alloc(out, mp_sizeof_nil());
+			if (data == NULL) {
+				diag_set(OutOfMemory, mp_sizeof_nil(),
+					 "obuf_alloc", "nil");
+				goto error;
+			}
+			mp_encode_nil(data);
+		} else if (tuple->bsize < IPROTO_ZC_TUPLE_SIZE_MIN) {
+			if (tuple_to_obuf(tuple, out) != 0)
+				goto error;
+		} else {
+			struct iproto_zc_chunk *chunk =
+				&batch->chunks[batch->count++];
+			chunk->used = obuf_size(out);
+			chunk->tuple = tuple;
+			size += tuple->bsize;
+			/* The reference belongs to the batch now. */
+			e->tuple = NULL;
+		}
+	}
+	assert(batch->count == count);
+	port_destroy(port);
+	*zc = batch;
+	*zc_size = size;
+	return 0;
+error:
+	port_destroy(port);
+	tx_zc_batch_free(batch);
+	return -1;
+}
+
+/**
+ * Reply to a select-like request with the tuples of the port.
+ * The port is destroyed.
+ */
+static void
+tx_reply_port(struct iproto_msg *msg, struct port *port)
+{
+	struct obuf *out = &msg->iobuf->out;
+	struct obuf_svp svp;
+	size_t zc_size;
+	if (iproto_prepare_select(out, &svp) != 0) {
+		port_destroy(port);
+		goto error;
+	}
+	if (iproto_port_dump(port, out, &msg->zc, &zc_size) != 0) {
+		obuf_rollback_to_svp(out, &svp);
+		goto error;
+	}
+	iproto_reply_select_ext(out, &svp, msg->header.sync, port->size,
+				zc_size);
+	msg->write_end = obuf_create_svp(out);
+	return;
+error:
+	iproto_reply_error(out, diag_last_error(&fiber()->diag),
+			   msg->header.sync);
+	msg->write_end = obuf_create_svp(out);
+}
+
 static void
 tx_process_select(struct cmsg *m)
 {
 	struct iproto_msg *msg = (struct iproto_msg *) m;
 	struct obuf *out = &msg->iobuf->out;
-	struct obuf_svp svp;
 	struct port port;
 	int rc;
 	struct request *req = &msg->request;
@@ -910,13 +1262,44 @@ tx_process_select(struct cmsg *m)
 			req->space_id, req->index_id,
 			req->iterator, req->offset, req->limit,
 			req->key, req->key_end);
-	if (rc < 0 || iproto_prepare_select(out, &svp) != 0) {
+	if (rc < 0) {
 		port_destroy(&port);
 		goto error;
 	}
-	port_dump(&port, out);
-	iproto_reply_select(out, &svp, msg->header.sync, port.size);
+	tx_reply_port(msg, &port);
+	return;
+error:
+	iproto_reply_error(out, diag_last_error(&fiber()->diag),
+			   msg->header.sync);
 	msg->write_end = obuf_create_svp(out);
+}
+
+/**
+ * Look up all keys of a multi-get request in one go and reply
+ * with an array of tuples, nil standing for a missing key.
+ */
+static void
+tx_process_get_multi(struct cmsg *m)
+{
+	struct iproto_msg *msg = (struct iproto_msg *) m;
+	struct obuf *out = &msg->iobuf->out;
+	struct port port;
+	int rc;
+	struct request *req = &msg->request;
+
+	tx_fiber_init(msg->connection->session, msg->header.sync);
+
+	if (tx_check_schema(msg->header.schema_id))
+		goto error;
+
+	port_create(&port);
+	rc = box_get_multi((struct port *) &port, req->space_id,
+			   req->index_id, req->key, req->key_end);
+	if (rc < 0) {
+		port_destroy(&port);
+		goto error;
+	}
+	tx_reply_port(msg, &port);
 	return;
 error:
 	iproto_reply_error(out, diag_last_error(&fiber()->diag),
@@ -1014,6 +1397,10 @@ net_send_msg(struct cmsg *m)
 	/* Discard request (see iproto_enqueue_batch()) */
 	iobuf->in.rpos += msg->len;
 	iobuf->out.wend = msg->write_end;
+	if (msg->zc != NULL) {
+		rlist_add_tail_entry(&iproto_connection_zc(con, iobuf)->batches,
+				     msg->zc, link);
+	}
 
 	if (evio_has_fd(&con->output)) {
 		if (! ev_is_active(&con->output))
@@ -1086,7 +1473,8 @@ net_send_greeting(struct cmsg *m)
 						 obuf_iovcnt(out));
 
 			/* Count statistics */
-			rmean_collect(rmean_net, IPROTO_SENT, nwr);
+			rmean_collect(con->thread->rmean_net, IPROTO_SENT,
+				      nwr);
 		} catch (Exception *e) {
 			e->log();
 		}
@@ -1107,106 +1495,220 @@ net_send_greeting(struct cmsg *m)
 	iproto_msg_delete(msg);
 }
 
-static const struct cmsg_hop connect_route[] = {
-	{ tx_process_connect, &net_pipe },
-	{ net_send_greeting, NULL },
-};
-
 /** }}} */
 
 /**
- * Create a connection and start input.
+ * Create a connection in the current net thread and start input.
  */
 static void
-iproto_on_accept(struct evio_service * /* service */, int fd,
-		 struct sockaddr *addr, socklen_t addrlen)
+iproto_connection_start(struct iproto_thread *thread, int fd)
 {
-	char name[SERVICE_NAME_MAXLEN];
-	snprintf(name, sizeof(name), "%s/%s", "iobuf",
-		sio_strfaddr(addr, addrlen));
-
-	struct iproto_connection *con;
-
-	con = iproto_connection_new(name, fd);
+	struct iproto_connection *con = iproto_connection_new(thread, fd);
 	/*
 	 * Ignore msg allocation failure - the queue size is
 	 * fixed so there is a limited number of msgs in
 	 * use, all stored in just a few blocks of the memory pool.
 	 */
 	struct iproto_msg *msg = iproto_msg_new(con);
-	cmsg_init(msg, connect_route);
+	cmsg_init(msg, thread->connect_route);
 	msg->iobuf = con->iobuf[0];
 	msg->close_connection = false;
-	cpipe_push(&tx_pipe, msg);
+	cpipe_push(&thread->tx_pipe, msg);
 }
 
-static struct evio_service binary; /* iproto binary listener */
+/**
+ * A socket accepted in the first net thread and passed to
+ * another one. Goes through the tx thread, since there is
+ * no direct pipe between net threads.
+ */
+struct iproto_accept_msg: public cmsg
+{
+	struct iproto_thread *thread;
+	int fd;
+};
+
+static void
+tx_forward_accept(struct cmsg *m)
+{
+	/* Nothing to do, just pass the socket along. */
+	(void) m;
+}
+
+static void
+net_accept(struct cmsg *m)
+{
+	struct iproto_accept_msg *msg = (struct iproto_accept_msg *) m;
+	try {
+		iproto_connection_start(msg->thread, msg->fd);
+	} catch (Exception *e) {
+		e->log();
+		close(msg->fd);
+	}
+	free(msg);
+}
+
+/**
+ * Pass an accepted socket to the next net thread in turn.
+ */
+static void
+iproto_on_accept(struct evio_service *service, int fd,
+		 struct sockaddr * /* addr */, socklen_t /* addrlen */)
+{
+	struct iproto_thread *thread =
+		(struct iproto_thread *) service->on_accept_param;
+	/* Only the first thread accepts. */
+	static unsigned accept_count = 0;
+	struct iproto_thread *target =
+		&iproto_threads[accept_count++ % iproto_thread_count];
+	if (target == thread) {
+		iproto_connection_start(thread, fd);
+		return;
+	}
+	struct iproto_accept_msg *msg = (struct iproto_accept_msg *)
+		malloc(sizeof(*msg));
+	if (msg == NULL) {
+		tnt_raise(OutOfMemory, sizeof(*msg), "malloc",
+			  "struct iproto_accept_msg");
+	}
+	cmsg_init(msg, target->accept_route);
+	msg->thread = target;
+	msg->fd = fd;
+	cpipe_push(&thread->tx_pipe, msg);
+}
+
+/** Bind the message routes to the pipes of a thread. */
+static void
+iproto_thread_init_routes(struct iproto_thread *thread)
+{
+	struct cpipe *net_pipe = &thread->net_pipe;
+	thread->disconnect_route[0] = { tx_process_disconnect, net_pipe };
+	thread->disconnect_route[1] = { net_finish_disconnect, NULL };
+	thread->misc_route[0] = { tx_process_misc, net_pipe };
+	thread->misc_route[1] = { net_send_msg, NULL };
+	thread->select_route[0] = { tx_process_select, net_pipe };
+	thread->select_route[1] = { net_send_msg, NULL };
+	thread->get_multi_route[0] = { tx_process_get_multi, net_pipe };
+	thread->get_multi_route[1] = { net_send_msg, NULL };
+	thread->zc_release_route[0] = { tx_zc_batch_free, NULL };
+	thread->process1_route[0] = { tx_process1, net_pipe };
+	thread->process1_route[1] = { net_send_msg, NULL };
+	thread->sync_route[0] = { tx_process_join_subscribe, net_pipe };
+	thread->sync_route[1] = { net_end_join_subscribe, NULL };
+	thread->connect_route[0] = { tx_process_connect, net_pipe };
+	thread->connect_route[1] = { net_send_greeting, NULL };
+	thread->accept_route[0] = { tx_forward_accept, net_pipe };
+	thread->accept_route[1] = { net_accept, NULL };
+
+	const struct cmsg_hop **dml_route = thread->dml_route;
+	dml_route[IPROTO_OK] = NULL;
+	dml_route[IPROTO_SELECT] = thread->select_route;
+	dml_route[IPROTO_INSERT] = thread->process1_route;
+	dml_route[IPROTO_REPLACE] = thread->process1_route;
+	dml_route[IPROTO_UPDATE] = thread->process1_route;
+	dml_route[IPROTO_DELETE] = thread->process1_route;
+	dml_route[IPROTO_CALL_16] = thread->misc_route;
+	dml_route[IPROTO_AUTH] = thread->misc_route;
+	dml_route[IPROTO_EVAL] = thread->misc_route;
+	dml_route[IPROTO_UPSERT] = thread->process1_route;
+	dml_route[IPROTO_CALL] = thread->misc_route;
+	dml_route[IPROTO_GET_MULTI] = thread->get_multi_route;
+}
 
 /**
  * The network io thread main function:
  * begin serving the message bus.
  */
 static int
-net_cord_f(va_list /* ap */)
+net_cord_f(va_list ap)
 {
+	struct iproto_thread *thread = va_arg(ap, struct iproto_thread *);
 	/* Got to be called in every thread using iobuf */
 	iobuf_init();
-	mempool_create(&iproto_msg_pool, &cord()->slabc,
+	mempool_create(&thread->iproto_msg_pool, &cord()->slabc,
 		       sizeof(struct iproto_msg));
-	mempool_create(&iproto_connection_pool, &cord()->slabc,
+	mempool_create(&thread->iproto_connection_pool, &cord()->slabc,
 		       sizeof(struct iproto_connection));
 
-	evio_service_init(loop(), &binary, "binary",
-			  iproto_on_accept, NULL);
-
-
-	/* Init statistics counter */
-	rmean_net = rmean_new(rmean_net_strings, IPROTO_LAST);
-
-	if (rmean_net == NULL) {
-		tnt_raise(OutOfMemory, sizeof(struct rmean),
-			  "rmean", "struct rmean");
-	}
+	evio_service_init(loop(), &thread->binary, "binary",
+			  iproto_on_accept, thread);
 
-	cbus_join(&net_tx_bus, &net_pipe);
+	cbus_join(&thread->net_tx_bus, &thread->net_pipe);
 	/*
 	 * Nothing to do in the fiber so far, the service
 	 * will take care of creating events for incoming
 	 * connections.
 	 */
 	fiber_yield();
-	if (evio_service_is_active(&binary))
-		evio_service_stop(&binary);
-
-	rmean_delete(rmean_net);
+	if (evio_service_is_active(&thread->binary))
+		evio_service_stop(&thread->binary);
 	return 0;
 }
 
-/** Initialize the iproto subsystem and start network io thread */
+/** Initialize the iproto subsystem and start network io threads */
 void
-iproto_init()
+iproto_init(int thread_count)
 {
+	assert(thread_count > 0);
 	tx_cord = cord();
 
-	cbus_create(&net_tx_bus);
-	rmean_net_tx_bus = net_tx_bus.stats;
-	cpipe_create(&tx_pipe);
-	cpipe_set_max_input(&tx_pipe, IPROTO_MSG_MAX/2);
-	cpipe_create(&net_pipe);
-	cpipe_set_max_input(&net_pipe, IPROTO_MSG_MAX/2);
-
-	static struct cord net_cord;
-	if (cord_costart(&net_cord, "iproto", net_cord_f, NULL))
-		panic("failed to initialize iproto thread");
+	iproto_threads = (struct iproto_thread *)
+		calloc(thread_count, sizeof(*iproto_threads));
+	rmean_net = (struct rmean **) calloc(thread_count, sizeof(*rmean_net));
+	rmean_net_tx_bus = (struct rmean **)
+		calloc(thread_count, sizeof(*rmean_net_tx_bus));
+	if (iproto_threads == NULL || rmean_net == NULL ||
+	    rmean_net_tx_bus == NULL)
+		panic("failed to allocate iproto threads");
+	iproto_thread_count = thread_count;
+	rmean_net_count = thread_count;
 
-	cbus_join(&net_tx_bus, &tx_pipe);
+	/*
+	 * Split the message limit among threads to keep the
+	 * total number of messages in the tx thread the same.
+	 */
+	size_t msg_max = MAX(IPROTO_MSG_MAX / thread_count, 2);
+	for (int i = 0; i < thread_count; i++) {
+		struct iproto_thread *thread = &iproto_threads[i];
+		thread->id = i;
+		thread->msg_max = msg_max;
+		rlist_create(&thread->stopped_connections);
+		iproto_thread_init_routes(thread);
+
+		cbus_create(&thread->net_tx_bus);
+		rmean_net_tx_bus[i] = thread->net_tx_bus.stats;
+		/*
+		 * Create the statistics counter in tx, like
+		 * the bus stats, so that rmean_net[] is filled
+		 * before box.stat.net() can read it and before
+		 * the thread starts collecting.
+		 */
+		thread->rmean_net = rmean_new(rmean_net_strings, IPROTO_LAST);
+		if (thread->rmean_net == NULL)
+			panic("failed to allocate iproto statistics");
+		rmean_net[i] = thread->rmean_net;
+		cpipe_create(&thread->tx_pipe);
+		cpipe_set_max_input(&thread->tx_pipe, msg_max / 2);
+		cpipe_create(&thread->net_pipe);
+		cpipe_set_max_input(&thread->net_pipe, msg_max / 2);
+
+		char name[FIBER_NAME_MAX];
+		if (i == 0)
+			snprintf(name, sizeof(name), "iproto");
+		else
+			snprintf(name, sizeof(name), "iproto.%d", i);
+		if (cord_costart(&thread->cord, name, net_cord_f, thread))
+			panic("failed to initialize iproto thread");
+
+		cbus_join(&thread->net_tx_bus, &thread->tx_pipe);
+	}
 }
 
 /**
  * Since there is no way to "synchronously" change the
  * state of the io thread, to change the listen port
  * we need to bounce a couple of messages to and
- * from this thread.
+ * from this thread. The listener lives in the first
+ * net thread.
  */
 struct iproto_bind_msg: public cbus_call_msg
 {
@@ -1217,11 +1719,12 @@ static int
 iproto_do_bind(struct cbus_call_msg *m)
 {
 	const char *uri  = ((struct iproto_bind_msg *) m)->uri;
+	struct evio_service *binary = &iproto_threads[0].binary;
 	try {
-		if (evio_service_is_active(&binary))
-			evio_service_stop(&binary);
+		if (evio_service_is_active(binary))
+			evio_service_stop(binary);
 		if (uri != NULL)
-			evio_service_bind(&binary, uri);
+			evio_service_bind(binary, uri);
 	} catch (Exception *e) {
 		return -1;
 	}
@@ -1232,9 +1735,10 @@ static int
 iproto_do_listen(struct cbus_call_msg *m)
 {
 	(void) m;
+	struct evio_service *binary = &iproto_threads[0].binary;
 	try {
-		if (evio_service_is_active(&binary))
-			evio_service_listen(&binary);
+		if (evio_service_is_active(binary))
+			evio_service_listen(binary);
 	} catch (Exception *e) {
 		return -1;
 	}
@@ -1246,7 +1750,8 @@ iproto_bind(const char *uri)
 {
 	static struct iproto_bind_msg m;
 	m.uri = uri;
-	if (cbus_call(&net_tx_bus, &m, iproto_do_bind, NULL, TIMEOUT_INFINITY))
+	if (cbus_call(&iproto_threads[0].net_tx_bus, &m, iproto_do_bind,
+		      NULL, TIMEOUT_INFINITY))
 		diag_raise();
 }
 
@@ -1255,7 +1760,8 @@ iproto_listen()
 {
 	/* Declare static to avoid stack corruption on fiber cancel. */
 	static struct cbus_call_msg m;
-	if (cbus_call(&net_tx_bus, &m, iproto_do_listen, NULL, TIMEOUT_INFINITY))
+	if (cbus_call(&iproto_threads[0].net_tx_bus, &m, iproto_do_listen,
+		      NULL, TIMEOUT_INFINITY))
 		diag_raise();
 }
 
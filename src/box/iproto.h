@@ -30,8 +30,11 @@
  * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
  * SUCH DAMAGE.
  */
+/**
+ * Start @a thread_count network io threads.
+ */
 void
-iproto_init();
+iproto_init(int thread_count);
 
 void
 iproto_bind(const char *uri);
@@ -101,11 +101,12 @@ const char *iproto_type_strs[] =
 	"AUTH",
 	"EVAL",
 	"UPSERT",
-	"CALL"
+	"CALL",
+	NULL, /* GET_MULTI, accounted as SELECT */
 };
 
 #define bit(c) (1ULL<<IPROTO_##c)
-const uint64_t iproto_body_key_map[IPROTO_CALL + 1] = {
+const uint64_t iproto_body_key_map[IPROTO_TYPE_STAT_MAX] = {
 	0,                                                     /* unused */
 	bit(SPACE_ID) | bit(LIMIT) | bit(KEY),                 /* SELECT */
 	bit(SPACE_ID) | bit(TUPLE),                            /* INSERT */
@@ -117,6 +118,7 @@ const uint64_t iproto_body_key_map[IPROTO_CALL + 1] = {
 	bit(EXPR)     | bit(TUPLE),                            /* EVAL */
 	bit(SPACE_ID) | bit(OPS) | bit(TUPLE),                 /* UPSERT */
 	bit(FUNCTION_NAME) | bit(TUPLE),                       /* CALL */
+	bit(SPACE_ID) | bit(KEY),                              /* GET_MULTI */
 };
 #undef bit
 
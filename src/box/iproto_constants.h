@@ -131,7 +131,9 @@ enum iproto_type {
 	IPROTO_EVAL = 8,
 	IPROTO_UPSERT = 9,
 	IPROTO_CALL = 10,
-	IPROTO_TYPE_STAT_MAX = IPROTO_CALL + 1,
+	/** Find tuples by an array of keys, see box_get_multi(). */
+	IPROTO_GET_MULTI = 11,
+	IPROTO_TYPE_STAT_MAX = IPROTO_GET_MULTI + 1,
 	/* admin command codes */
 	IPROTO_PING = 64,
 	IPROTO_JOIN = 65,
@@ -163,7 +165,8 @@ iproto_type_name(uint32_t type)
 static inline bool
 iproto_type_is_select(uint32_t type)
 {
-	return type <= IPROTO_SELECT || type == IPROTO_CALL || type == IPROTO_EVAL;
+	return type <= IPROTO_SELECT || type == IPROTO_CALL ||
+	       type == IPROTO_EVAL || type == IPROTO_GET_MULTI;
 }
 
 /** A common request with a mandatory and simple body (key, tuple, ops)  */
@@ -49,6 +49,15 @@ iproto_prepare_select(struct obuf *buf, struct obuf_svp *svp);
 void
 iproto_reply_select(struct obuf *buf, struct obuf_svp *svp, uint64_t sync,
 		    uint32_t count);
+
+/**
+ * Same as iproto_reply_select(), but @a ext_size bytes of the
+ * reply body are not in the buffer and are sent separately,
+ * e.g. straight from tuple memory.
+ */
+void
+iproto_reply_select_ext(struct obuf *buf, struct obuf_svp *svp,
+			uint64_t sync, uint32_t count, size_t ext_size);
 #if defined(__cplusplus)
 } /*  extern "C" */
 
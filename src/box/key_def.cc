@@ -86,6 +86,8 @@ const char *index_type_strs[] = { "HASH", "TREE", "BITSET", "RTREE" };
 
 const char *rtree_index_distance_type_strs[] = { "EUCLID", "MANHATTAN" };
 
+const char *vinyl_compaction_strs[] = { "tiered", "leveled" };
+
 const char *func_language_strs[] = {"LUA", "C"};
 
 const uint32_t key_mp_type[] = {
@@ -106,10 +108,15 @@ const struct key_opts key_opts_default = {
 	/* .dimension           = */ 2,
 	/* .distancebuf         = */ { '\0' },
 	/* .distance            = */ RTREE_INDEX_DISTANCE_TYPE_EUCLID,
+	/* .hint                = */ false,
 	/* .path                = */ { 0 },
 	/* .range_size          = */ 0,
 	/* .page_size           = */ 0,
 	/* .compact_wm          = */ 2,
+	/* .compactionbuf       = */ { '\0' },
+	/* .compaction          = */ VINYL_COMPACTION_TIERED,
+	/* .run_size_ratio      = */ 4,
+	/* .level_count         = */ 6,
 	/* .lsn                 = */ 0,
 };
 
@@ -117,10 +124,14 @@ const struct opt_def key_opts_reg[] = {
 	OPT_DEF("unique", MP_BOOL, struct key_opts, is_unique),
 	OPT_DEF("dimension", MP_UINT, struct key_opts, dimension),
 	OPT_DEF("distance", MP_STR, struct key_opts, distancebuf),
+	OPT_DEF("hint", MP_BOOL, struct key_opts, hint),
 	OPT_DEF("path", MP_STR, struct key_opts, path),
 	OPT_DEF("range_size", MP_UINT, struct key_opts, range_size),
 	OPT_DEF("page_size", MP_UINT, struct key_opts, page_size),
 	OPT_DEF("compact_wm", MP_UINT, struct key_opts, compact_wm),
+	OPT_DEF("compaction", MP_STR, struct key_opts, compactionbuf),
+	OPT_DEF("run_size_ratio", MP_UINT, struct key_opts, run_size_ratio),
+	OPT_DEF("level_count", MP_UINT, struct key_opts, level_count),
 	OPT_DEF("lsn", MP_UINT, struct key_opts, lsn),
 	{ NULL, MP_NIL, 0, 0 }
 };
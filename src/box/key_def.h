@@ -152,6 +152,23 @@ enum rtree_index_distance_type {
 };
 extern const char *rtree_index_distance_type_strs[];
 
+/** Vinyl compaction policy. */
+enum vinyl_compaction {
+	/*
+	 * Size-tiered: a level is merged into the next one when
+	 * it accumulates compact_wm runs.
+	 */
+	VINYL_COMPACTION_TIERED,
+	/*
+	 * Leveled: each level is kept as a single run, which is
+	 * merged into the next level as soon as it outgrows its
+	 * size budget.
+	 */
+	VINYL_COMPACTION_LEVELED,
+	vinyl_compaction_MAX
+};
+extern const char *vinyl_compaction_strs[];
+
 /** Descriptor of a single part in a multipart key. */
 struct key_part {
 	uint32_t fieldno;
@@ -174,6 +191,13 @@ struct key_opts {
 	 */
 	char distancebuf[16];
 	enum rtree_index_distance_type distance;
+	/**
+	 * memtx TREE index: store a hint of the first key part
+	 * next to each tuple pointer, so that most comparisons
+	 * are done without touching the tuple. Off by default,
+	 * since it doubles the size of a tree element.
+	 */
+	bool hint;
 	/**
 	 * Vinyl index options.
 	 */
@@ -181,10 +205,24 @@ struct key_opts {
 	uint64_t range_size;
 	uint32_t page_size;
 	/**
-	 * Begin compaction when there are more than compact_wm
-	 * runs in a range.
+	 * Tiered compaction: merge a level of a range into the
+	 * next one when it has compact_wm runs.
 	 */
 	uint32_t compact_wm;
+	/**
+	 * Compaction policy, see enum vinyl_compaction.
+	 */
+	char compactionbuf[16];
+	enum vinyl_compaction compaction;
+	/**
+	 * Size ratio between two adjacent levels of a range.
+	 */
+	uint32_t run_size_ratio;
+	/**
+	 * Max number of levels in a range. All runs that don't
+	 * fit in the last level are accounted to it.
+	 */
+	uint32_t level_count;
 	/**
 	 * LSN from the time of index creation.
 	 */
@@ -203,6 +241,8 @@ key_opts_cmp(const struct key_opts *o1, const struct key_opts *o2)
 		return o1->dimension < o2->dimension ? -1 : 1;
 	if (o1->distance != o2->distance)
 		return o1->distance < o2->distance ? -1 : 1;
+	if (o1->hint != o2->hint)
+		return o1->hint < o2->hint ? -1 : 1;
 	return 0;
 }
 
@@ -34,6 +34,7 @@
 #include "box/index.h"
 #include "box/lua/tuple.h"
 #include "box/lua/misc.h" /* lbox_encode_tuple_on_gc() */
+#include "fiber.h" /* fiber->gc() */
 
 /** {{{ box.index Lua library: access to spaces and indexes
  */
@@ -168,6 +169,41 @@ lbox_index_get(lua_State *L)
 	return luaT_pushtupleornil(L, tuple);
 }
 
+static int
+lbox_index_get_multi(lua_State *L)
+{
+	if (lua_gettop(L) != 3 || !lua_isnumber(L, 1) ||
+	    !lua_isnumber(L, 2) || !lua_istable(L, 3))
+		return luaL_error(L, "Usage index.get_multi(space_id, "
+				  "index_id, keys)");
+
+	uint32_t space_id = lua_tointeger(L, 1);
+	uint32_t index_id = lua_tointeger(L, 2);
+	uint32_t key_count = lua_objlen(L, 3);
+	size_t keys_len;
+	const char *keys = lbox_encode_tuple_on_gc(L, 3, &keys_len);
+	size_t size = (key_count + 1) * sizeof(box_tuple_t *);
+	box_tuple_t **result = (box_tuple_t **)
+		region_alloc(&fiber()->gc, size);
+	if (result == NULL) {
+		diag_set(OutOfMemory, size, "region_alloc", "result");
+		return luaT_error(L);
+	}
+	if (box_index_get_multi(space_id, index_id, keys, keys + keys_len,
+				result) != 0)
+		return luaT_error(L);
+	/* A missing key leaves a hole in the result, like in net.box */
+	lua_createtable(L, key_count, 0);
+	for (uint32_t i = 0; i < key_count; i++) {
+		if (result[i] == NULL)
+			continue;
+		luaT_pushtuple(L, result[i]);
+		box_tuple_unref(result[i]);
+		lua_rawseti(L, -2, i + 1);
+	}
+	return 1;
+}
+
 static int
 lbox_index_min(lua_State *L)
 {
@@ -326,6 +362,7 @@ box_lua_index_init(struct lua_State *L)
 		{"delete",  lbox_index_delete},
 		{"random", lbox_index_random},
 		{"get",  lbox_index_get},
+		{"get_multi", lbox_index_get_multi},
 		{"min", lbox_index_min},
 		{"max", lbox_index_max},
 		{"count", lbox_index_count},
@@ -41,6 +41,7 @@
 #include <lualib.h>
 
 #include "box/applier.h"
+#include "box/relay.h"
 #include "box/recovery.h"
 #include "box/wal.h"
 #include "box/cluster.h"
@@ -66,16 +67,39 @@ lbox_pushvclock(struct lua_State *L, struct vclock *vclock)
 }
 
 static void
-lbox_pushreplica(lua_State *L, struct server *server)
+lbox_pushrelay(lua_State *L, struct relay *relay)
 {
-	struct applier *applier = server->applier;
+	/* Updated by the relay thread, a torn read is fine here. */
+	int64_t rows = relay->rows;
+	int64_t bytes = relay->bytes;
+	int64_t flushes = relay->flushes;
 
-	lua_createtable(L, 0, 4);
+	lua_createtable(L, 0, 5);
 
-	lua_pushstring(L, "uuid");
-	lua_pushstring(L, tt_uuid_str(&server->uuid));
+	lua_pushstring(L, "rows");
+	luaL_pushuint64(L, rows);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "bytes");
+	luaL_pushuint64(L, bytes);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "flushes");
+	luaL_pushuint64(L, flushes);
 	lua_settable(L, -3);
 
+	lua_pushstring(L, "rows_per_flush");
+	lua_pushnumber(L, flushes > 0 ? (double) rows / flushes : 0);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "bytes_per_flush");
+	lua_pushnumber(L, flushes > 0 ? (double) bytes / flushes : 0);
+	lua_settable(L, -3);
+}
+
+static void
+lbox_pushapplier(lua_State *L, struct applier *applier)
+{
 	/* Get applier state in lower case */
 	static char status[16];
 	char *d = status;
@@ -109,6 +133,25 @@ lbox_pushreplica(lua_State *L, struct server *server)
 	}
 }
 
+static void
+lbox_pushreplica(lua_State *L, struct server *server)
+{
+	lua_createtable(L, 0, 5);
+
+	lua_pushstring(L, "uuid");
+	lua_pushstring(L, tt_uuid_str(&server->uuid));
+	lua_settable(L, -3);
+
+	if (server->applier != NULL)
+		lbox_pushapplier(L, server->applier);
+
+	if (server->relay != NULL) {
+		lua_pushstring(L, "relay");
+		lbox_pushrelay(L, server->relay);
+		lua_settable(L, -3);
+	}
+}
+
 static int
 lbox_info_replication(struct lua_State *L)
 {
@@ -122,7 +165,8 @@ lbox_info_replication(struct lua_State *L)
 
 	server_foreach(server) {
 		/* Applier hasn't received server_id yet */
-		if (server->id == SERVER_ID_NIL || server->applier == NULL)
+		if (server->id == SERVER_ID_NIL ||
+		    (server->applier == NULL && server->relay == NULL))
 			continue;
 
 		lbox_pushreplica(L, server);
@@ -227,6 +271,9 @@ lbox_vinyl_info_handler(struct vy_info_node *node, void *ctx)
 	case VY_INFO_U64:
 		luaL_pushuint64(L, node->value.u64);
 		break;
+	case VY_INFO_DOUBLE:
+		lua_pushnumber(L, node->value.d);
+		break;
 	case VY_INFO_STRING:
 		lua_pushstring(L, node->value.str);
 		break;
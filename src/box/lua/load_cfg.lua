@@ -7,10 +7,17 @@ local private = require('box.internal')
 -- see default_cfg below
 local default_vinyl_cfg = {
     memory_limit      = 1.0, -- 1G
+    page_cache        = 0.125, -- 128M
     threads           = 1,
+    compact_bandwidth = 0, -- bytes per second, 0 - unlimited
     compact_wm        = 2, -- try to maintain less than 2 runs in a range
+    compaction        = 'tiered', -- or 'leveled'
+    compress_threads  = 2, -- compaction page compressors, 0 - inline
+    run_size_ratio    = 4, -- each level is 4 times bigger than the previous
+    level_count       = 6,
     range_size        = 1024 * 1024 * 1024,
     page_size        = 8 * 1024,
+    read_ahead        = 4, -- pages to read ahead on scans, 0 - disabled
 }
 
 -- all available options
@@ -30,10 +37,15 @@ local default_cfg = {
     log_level           = 5,
     io_collect_interval = nil,
     readahead           = 16320,
+    iproto_threads      = 1,
     snap_io_rate_limit  = nil, -- no limit
+    snap_threads        = 1,
     too_long_threshold  = 0.5,
     wal_mode            = "write",
     rows_per_wal        = 500000,
+    wal_sync_delay      = 0,
+    wal_sync_max_bytes  = 1024 * 1024,
+    wal_ring_size       = 16 * 1024 * 1024,
     wal_dir_rescan_delay= 2,
     panic_on_snap_error = true,
     panic_on_wal_error  = true,
@@ -54,14 +66,21 @@ local default_cfg = {
 -- see template_cfg below
 local vinyl_template_cfg = {
     memory_limit      = 'number',
+    page_cache        = 'number',
     threads           = 'number',
+    compact_bandwidth = 'number',
     compact_wm        = 'number',
+    compaction        = 'string',
+    compress_threads  = 'number',
+    run_size_ratio    = 'number',
+    level_count       = 'number',
     run_prio          = 'number',
     run_age           = 'number',
     run_age_period    = 'number',
     run_age_wm        = 'number',
     range_size        = 'number',
     page_size        = 'number',
+    read_ahead        = 'number',
 }
 
 -- types of available options
@@ -82,10 +101,15 @@ local template_cfg = {
     log_level           = 'number',
     io_collect_interval = 'number',
     readahead           = 'number',
+    iproto_threads      = 'number',
     snap_io_rate_limit  = 'number',
+    snap_threads        = 'number',
     too_long_threshold  = 'number',
     wal_mode            = 'string',
     rows_per_wal        = 'number',
+    wal_sync_delay      = 'number',
+    wal_sync_max_bytes  = 'number',
+    wal_ring_size       = 'number',
     wal_dir_rescan_delay= 'number',
     panic_on_snap_error = 'boolean',
     panic_on_wal_error  = 'boolean',
@@ -123,6 +147,7 @@ local dynamic_cfg = {
     readahead               = private.cfg_set_readahead,
     too_long_threshold      = private.cfg_set_too_long_threshold,
     snap_io_rate_limit      = private.cfg_set_snap_io_rate_limit,
+    snap_threads            = private.cfg_set_snap_threads,
     panic_on_wal_error      = function() end,
     read_only               = private.cfg_set_read_only,
     -- snapshot_daemon
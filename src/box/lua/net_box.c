@@ -268,6 +268,43 @@ netbox_encode_select(lua_State *L)
 	return 0;
 }
 
+static int
+netbox_encode_get_multi(lua_State *L)
+{
+	if (lua_gettop(L) < 6 || !lua_istable(L, 6))
+		return luaL_error(L, "Usage netbox.encode_get_multi(ibuf, "
+				  "sync, schema_id, space_id, index_id, keys)");
+	lua_settop(L, 6);
+
+	struct mpstream stream;
+	size_t svp = netbox_prepare_request(L, &stream, IPROTO_GET_MULTI);
+
+	luamp_encode_map(cfg, &stream, 3);
+
+	/* encode space_id */
+	uint32_t space_id = lua_tointeger(L, 4);
+	luamp_encode_uint(cfg, &stream, IPROTO_SPACE_ID);
+	luamp_encode_uint(cfg, &stream, space_id);
+
+	/* encode index_id */
+	uint32_t index_id = lua_tointeger(L, 5);
+	luamp_encode_uint(cfg, &stream, IPROTO_INDEX_ID);
+	luamp_encode_uint(cfg, &stream, index_id);
+
+	/* encode keys, each one converted like a single key */
+	luamp_encode_uint(cfg, &stream, IPROTO_KEY);
+	uint32_t key_count = lua_objlen(L, 6);
+	luamp_encode_array(cfg, &stream, key_count);
+	for (uint32_t i = 1; i <= key_count; i++) {
+		lua_rawgeti(L, 6, i);
+		luamp_convert_key(L, cfg, &stream, 7);
+		lua_pop(L, 1);
+	}
+
+	netbox_encode_request(&stream, svp);
+	return 0;
+}
+
 static inline int
 netbox_encode_insert_or_replace(lua_State *L, uint32_t reqtype)
 {
@@ -566,6 +603,7 @@ luaopen_net_box(struct lua_State *L)
 		{ "encode_call",    netbox_encode_call },
 		{ "encode_eval",    netbox_encode_eval },
 		{ "encode_select",  netbox_encode_select },
+		{ "encode_get_multi", netbox_encode_get_multi },
 		{ "encode_insert",  netbox_encode_insert },
 		{ "encode_replace", netbox_encode_replace },
 		{ "encode_delete",  netbox_encode_delete },
@@ -74,6 +74,13 @@ local method_codec           = {
                       check_iterator_type(opts, key_is_nil),
                       offset, limit, key)
     end,
+    get_multi = function(buf, id, schema_id, spaceno, indexno, keys)
+        if type(keys) ~= 'table' then
+            box.error(box.error.ILLEGAL_PARAMS,
+                      'get_multi() expects a table of keys')
+        end
+        internal.encode_get_multi(buf, id, schema_id, spaceno, indexno, keys)
+    end,
     -- inject raw data into connection, used by console and tests
     inject = function(buf, id, schema_id, bytes)
         local ptr = buf:reserve(#bytes)
@@ -665,7 +672,8 @@ function remote_methods:_request(method, ...)
             if postproc and rawget(box, 'tuple') then
                 local tnew = box.tuple.new
                 for i, v in pairs(res) do
-                    res[i] = tnew(v)
+                    -- get_multi() gets msgpack.NULL for missing keys
+                    res[i] = v ~= nil and tnew(v) or nil
                 end
             end
             return res
@@ -886,6 +894,12 @@ space_metatable = function(remote)
         if res[1] ~= nil then return res[1] end
     end
 
+    -- Returns a table with a tuple or nil for every key
+    function methods:get_multi(keys)
+        space_check(self, 'get_multi')
+        return remote:_request('get_multi', self.id, 0, keys)
+    end
+
     return { __index = methods, __metatable = false }
 end
 
@@ -912,6 +926,11 @@ index_metatable = function(remote)
         if res[1] ~= nil then return res[1] end
     end
 
+    function methods:get_multi(keys)
+        index_check(self, 'get_multi')
+        return remote:_request('get_multi', self.space.id, self.id, keys)
+    end
+
     function methods:min(key)
         index_check(self, 'min')
         local res = remote:_request('select', self.space.id, self.id, key,
@@ -44,6 +44,10 @@ ffi.cdef[[
     box_index_get(uint32_t space_id, uint32_t index_id, const char *key,
                   const char *key_end, box_tuple_t **result);
     int
+    box_index_get_multi(uint32_t space_id, uint32_t index_id,
+                        const char *keys, const char *keys_end,
+                        box_tuple_t **result);
+    int
     box_index_min(uint32_t space_id, uint32_t index_id, const char *key,
                   const char *key_end, box_tuple_t **result);
     int
@@ -383,10 +387,14 @@ box.schema.index.create = function(space_id, name, options)
         if_not_exists = 'boolean',
         dimension = 'number',
         distance = 'string',
+        hint = 'boolean',
         path = 'string',
         page_size = 'number',
         range_size = 'number',
         compact_wm = 'number',
+        compaction = 'string',
+        run_size_ratio = 'number',
+        level_count = 'number',
     }
     check_param_table(options, options_template)
     local options_defaults = {
@@ -409,6 +417,9 @@ box.schema.index.create = function(space_id, name, options)
             page_size = box.cfg.vinyl.page_size,
             range_size = box.cfg.vinyl.range_size,
             compact_wm = box.cfg.vinyl.compact_wm,
+            compaction = box.cfg.vinyl.compaction,
+            run_size_ratio = box.cfg.vinyl.run_size_ratio,
+            level_count = box.cfg.vinyl.level_count,
         }
     else
         options_defaults = {}
@@ -451,10 +462,14 @@ box.schema.index.create = function(space_id, name, options)
             dimension = options.dimension,
             unique = options.unique,
             distance = options.distance,
+            hint = options.hint,
             path = options.path,
             page_size = options.page_size,
             range_size = options.range_size,
             compact_wm = options.compact_wm,
+            compaction = options.compaction,
+            run_size_ratio = options.run_size_ratio,
+            level_count = options.level_count,
             lsn = box.info.cluster.signature,
     }
     local field_type_aliases = {
@@ -514,6 +529,7 @@ box.schema.index.alter = function(space_id, index_id, options)
         unique = 'boolean',
         dimension = 'number',
         distance = 'string',
+        hint = 'boolean',
     }
     check_param_table(options, options_template)
 
@@ -583,6 +599,9 @@ box.schema.index.alter = function(space_id, index_id, options)
     if options.distance ~= nil then
         key_opts.distance = options.distance
     end
+    if options.hint ~= nil then
+        key_opts.hint = options.hint
+    end
     if options.parts ~= nil then
         check_index_parts(options.parts)
         options.parts = update_index_parts(options.parts)
@@ -833,6 +852,41 @@ function box.schema.space.bless(space)
         return internal.get(index.space_id, index.id, key)
     end
 
+    local function keify_multi(keys)
+        if type(keys) ~= 'table' then
+            box.error(box.error.ILLEGAL_PARAMS,
+                      'get_multi() expects a table of keys')
+        end
+        local result = {}
+        for i = 1, #keys do
+            result[i] = keify(keys[i])
+        end
+        return result
+    end
+    index_mt.get_multi_ffi = function(index, keys)
+        keys = keify_multi(keys)
+        local count = #keys
+        local key, key_end = tuple_encode(keys)
+        local ptuples = ffi.new('box_tuple_t *[?]', count + 1)
+        if builtin.box_index_get_multi(index.space_id, index.id,
+                                       key, key_end, ptuples) ~= 0 then
+            return box.error() -- error
+        end
+        -- a missing key leaves a hole in the result, like in net.box
+        local result = {}
+        for i = 0, count - 1 do
+            if ptuples[i] ~= nil then
+                result[i + 1] = tuple_bless(ptuples[i])
+                builtin.box_tuple_unref(ptuples[i])
+            end
+        end
+        return result
+    end
+    index_mt.get_multi_luac = function(index, keys)
+        keys = keify_multi(keys)
+        return internal.get_multi(index.space_id, index.id, keys)
+    end
+
     local function check_select_opts(opts, key_is_nil)
         local offset = 0
         local limit = 4294967295
@@ -906,7 +960,8 @@ function box.schema.space.bless(space)
 
     -- true if reading operations may yield
     local read_yields = space.engine == 'vinyl'
-    local read_ops = {'select', 'get', 'min', 'max', 'count', 'random', 'pairs'}
+    local read_ops = {'select', 'get', 'get_multi', 'min', 'max', 'count',
+                      'random', 'pairs'}
     for _, op in ipairs(read_ops) do
         if read_yields then
             -- use Lua/C implmenetation
@@ -938,6 +993,10 @@ function box.schema.space.bless(space)
         check_index(space, 0)
         return space.index[0]:get(key)
     end
+    space_mt.get_multi = function(space, keys)
+        check_index(space, 0)
+        return space.index[0]:get_multi(keys)
+    end
     space_mt.select = function(space, key, opts)
         check_index(space, 0)
         return space.index[0]:select(key, opts)
@@ -42,10 +42,12 @@
 
 extern struct rmean *rmean_box;
 extern struct rmean *rmean_error;
-/** network statistics (iproto & cbus) */
-extern struct rmean *rmean_net;
-extern struct rmean *rmean_net_tx_bus;
+/** network statistics (iproto & cbus), one per net thread */
+extern struct rmean **rmean_net;
+extern struct rmean **rmean_net_tx_bus;
+extern int rmean_net_count;
 extern struct rmean *rmean_tx_wal_bus;
+extern struct rmean *rmean_wal;
 
 static void
 fill_stat_item(struct lua_State *L, int rps, int64_t total)
@@ -91,6 +93,29 @@ seek_stat_item(const char *name, int rps, int64_t total, void *cb_ctx)
 	return 1;
 }
 
+/**
+ * Like rmean_foreach(), but sums up the same counters of
+ * several rmean objects, e.g. of all net threads.
+ */
+static int
+rmean_foreach_sum(struct rmean **rmean, int count, rmean_cb cb,
+		  void *cb_ctx)
+{
+	for (size_t i = 0; i < rmean[0]->stats_n; i++) {
+		if (rmean[0]->stats[i].name == NULL)
+			continue;
+		int64_t rps = 0, total = 0;
+		for (int j = 0; j < count; j++) {
+			rps += rmean_mean(rmean[j], i);
+			total += rmean_total(rmean[j], i);
+		}
+		int res = cb(rmean[0]->stats[i].name, rps, total, cb_ctx);
+		if (res != 0)
+			return res;
+	}
+	return 0;
+}
+
 static int
 lbox_stat_index(struct lua_State *L)
 {
@@ -114,18 +139,21 @@ static int
 lbox_stat_net_index(struct lua_State *L)
 {
 	luaL_checkstring(L, -1);
-	int res = rmean_foreach(rmean_net, seek_stat_item, L);
+	int res = rmean_foreach_sum(rmean_net, rmean_net_count,
+				    seek_stat_item, L);
 	if (res)
 		return res;
-	return rmean_foreach(rmean_net_tx_bus, seek_stat_item, L);
+	return rmean_foreach_sum(rmean_net_tx_bus, rmean_net_count,
+				 seek_stat_item, L);
 }
 
 static int
 lbox_stat_net_call(struct lua_State *L)
 {
 	lua_newtable(L);
-	rmean_foreach(rmean_net, set_stat_item, L);
-	rmean_foreach(rmean_net_tx_bus, set_stat_item, L);
+	rmean_foreach_sum(rmean_net, rmean_net_count, set_stat_item, L);
+	rmean_foreach_sum(rmean_net_tx_bus, rmean_net_count,
+			  set_stat_item, L);
 	return 1;
 }
 
@@ -135,7 +163,10 @@ lbox_stat_wal_index(struct lua_State *L)
 	luaL_checkstring(L, -1);
 	if (rmean_tx_wal_bus == NULL)
 		return 0;
-	return rmean_foreach(rmean_tx_wal_bus, seek_stat_item, L);
+	int res = rmean_foreach(rmean_tx_wal_bus, seek_stat_item, L);
+	if (res)
+		return res;
+	return rmean_foreach(rmean_wal, seek_stat_item, L);
 }
 
 static int
@@ -144,6 +175,8 @@ lbox_stat_wal_call(struct lua_State *L)
 	lua_newtable(L);
 	if (rmean_tx_wal_bus)
 		rmean_foreach(rmean_tx_wal_bus, set_stat_item, L);
+	if (rmean_wal)
+		rmean_foreach(rmean_wal, set_stat_item, L);
 	return 1;
 }
 
@@ -450,6 +450,17 @@ MemtxBitset::count(enum iterator_type type, const char *key,
 			return bitset_index_size(&m_index) - bitset_index_count(&m_index, bit);
 	}
 
-	/* Call generic method */
-	return MemtxIndex::count(type, key, part_count);
+	if (type != ITER_EQ && type != ITER_BITS_ANY_SET &&
+	    type != ITER_BITS_ALL_SET && type != ITER_BITS_ALL_NOT_SET) {
+		/* Call generic method */
+		return MemtxIndex::count(type, key, part_count);
+	}
+
+	/*
+	 * Each tuple is a single bit in the result set, so count
+	 * the bits page by page instead of fetching the tuples.
+	 */
+	struct iterator *it = position();
+	initIterator(it, type, key, part_count);
+	return bitset_iterator_count(&bitset_index_iterator(it)->bitset_it);
 }
@@ -33,6 +33,8 @@
 
 #include "coeio_file.h"
 #include "scoped_guard.h"
+#include "tt_pthread.h"
+#include "salad/stailq.h"
 
 #include "tuple.h"
 #include "txn.h"
@@ -43,6 +45,8 @@
 #include "bootstrap.h"
 #include "cluster.h"
 #include "schema.h"
+#include "vclock.h"
+#include "wal.h"
 
 /** For all memory used by all indexes.
  * If you decide to use memtx_index_arena or
@@ -148,7 +152,16 @@ memtx_replace_all_keys(struct txn_stmt *stmt, struct space *space,
 		assert(old_tuple || new_tuple);
 		/* Update secondary keys. */
 		for (i++; i < space->index_count; i++) {
-			Index *index = space->index[i];
+			MemtxIndex *index = (MemtxIndex *) space->index[i];
+			/*
+			 * The key of an index untouched by UPDATE
+			 * is the same in both tuples: try to swap
+			 * them without rebalancing the index.
+			 */
+			if (old_tuple != NULL && new_tuple != NULL &&
+			    (stmt->column_mask & index->column_mask) == 0 &&
+			    index->replaceInPlace(old_tuple, new_tuple))
+				continue;
 			index->replace(old_tuple, new_tuple, DUP_INSERT);
 		}
 	} catch (Exception *e) {
@@ -208,12 +221,171 @@ memtx_build_secondary_keys(struct space *space, void *param)
 	handler->replace = memtx_replace_all_keys;
 }
 
+/* {{{ Parallel secondary key build */
+
+/*
+ * Most of the time of building secondary keys is spent sorting
+ * tuples of TREE indexes. Sorting only reads tuples, so sorts
+ * of up to snap_threads indexes run in separate threads, while
+ * the tx thread goes on filling the next indexes. Everything
+ * that allocates index memory - building HASH, RTREE and BITSET
+ * indexes and bulk-loading sorted tuples into trees - stays in
+ * the tx thread.
+ */
+
+struct memtx_build_space {
+	struct rlist link;
+	struct space *space;
+};
+
+struct memtx_build_sort {
+	struct cord cord;
+	MemtxTree *index;
+	/** Set if the sort is done in a separate thread. */
+	bool is_started;
+};
+
+struct memtx_build {
+	MemtxEngine *engine;
+	/** Spaces to build secondary keys for. */
+	struct rlist spaces;
+	/** Sorts in progress. */
+	struct memtx_build_sort *sorts;
+	int sort_count;
+	int sort_count_max;
+};
+
+static void
+memtx_build_add_space(struct space *space, void *param)
+{
+	struct memtx_build *build = (struct memtx_build *) param;
+	struct MemtxSpace *handler = (struct MemtxSpace *) space->handler;
+	if (handler->engine != build->engine ||
+	    space_index(space, 0) == NULL ||
+	    handler->replace == memtx_replace_all_keys)
+		return;
+	struct memtx_build_space *entry =
+		region_alloc_object_xc(&fiber()->gc, struct memtx_build_space);
+	entry->space = space;
+	rlist_add_tail_entry(&build->spaces, entry, link);
+}
+
+static void *
+memtx_build_sort_f(void *arg)
+{
+	struct memtx_build_sort *sort = (struct memtx_build_sort *) arg;
+	sort->index->sortBuild();
+	return NULL;
+}
+
+/**
+ * Wait for all sorts in progress and bulk-load the sorted
+ * tuples into the trees.
+ */
+static void
+memtx_build_flush(struct memtx_build *build)
+{
+	for (int i = 0; i < build->sort_count; i++) {
+		struct memtx_build_sort *sort = &build->sorts[i];
+		if (sort->is_started) {
+			cord_join(&sort->cord);
+			sort->is_started = false;
+		}
+		sort->index->endBuild();
+	}
+	build->sort_count = 0;
+}
+
+/**
+ * Start sorting tuples of a filled TREE index in a separate
+ * thread. Falls back to sorting in place if the thread can't
+ * be started.
+ */
+static void
+memtx_build_sort(struct memtx_build *build, MemtxTree *index)
+{
+	if (build->sort_count == build->sort_count_max)
+		memtx_build_flush(build);
+	struct memtx_build_sort *sort = &build->sorts[build->sort_count++];
+	sort->index = index;
+	sort->is_started = cord_start(&sort->cord, "build.sort",
+				      memtx_build_sort_f, sort) == 0;
+	if (!sort->is_started) {
+		error_log(diag_last_error(diag_get()));
+		index->sortBuild();
+	}
+}
+
+/**
+ * Build secondary keys of all memtx spaces at the end of
+ * recovery, sorting TREE indexes in up to @a thread_count
+ * threads.
+ */
+static void
+memtx_build_all_secondary_keys(MemtxEngine *engine, int thread_count)
+{
+	if (thread_count <= 1) {
+		space_foreach(memtx_build_secondary_keys, engine);
+		return;
+	}
+	struct memtx_build build;
+	build.engine = engine;
+	rlist_create(&build.spaces);
+	space_foreach(memtx_build_add_space, &build);
+
+	build.sort_count = 0;
+	build.sort_count_max = thread_count;
+	build.sorts = (struct memtx_build_sort *)
+		calloc(thread_count, sizeof(*build.sorts));
+	if (build.sorts == NULL) {
+		tnt_raise(OutOfMemory, thread_count * sizeof(*build.sorts),
+			  "calloc", "struct memtx_build_sort");
+	}
+	auto guard = make_scoped_guard([&]{
+		/* Don't leave sorting threads behind on error. */
+		for (int i = 0; i < build.sort_count; i++) {
+			if (build.sorts[i].is_started)
+				cord_join(&build.sorts[i].cord);
+		}
+		free(build.sorts);
+	});
+
+	struct memtx_build_space *entry;
+	rlist_foreach_entry(entry, &build.spaces, link) {
+		struct space *space = entry->space;
+		MemtxIndex *pk = (MemtxIndex *) space->index[0];
+		if (space->index_count > 1 && pk->size() > 0) {
+			say_info("Building secondary indexes in space '%s'...",
+				 space_name(space));
+		}
+		for (uint32_t j = 1; j < space->index_count; j++) {
+			MemtxIndex *index = (MemtxIndex *) space->index[j];
+			if (index->key_def->type != TREE) {
+				index_build(index, pk);
+				continue;
+			}
+			index_build_fill(index, pk);
+			memtx_build_sort(&build, (MemtxTree *) index);
+		}
+	}
+	memtx_build_flush(&build);
+
+	rlist_foreach_entry(entry, &build.spaces, link) {
+		struct MemtxSpace *handler =
+			(struct MemtxSpace *) entry->space->handler;
+		handler->replace = memtx_replace_all_keys;
+	}
+}
+
+/* }}} */
+
 MemtxEngine::MemtxEngine(const char *snap_dirname, bool panic_on_snap_error,
 			 bool panic_on_wal_error)
 	:Engine("memtx", &memtx_tuple_format_vtab),
 	m_checkpoint(0),
 	m_state(MEMTX_INITIALIZED),
 	m_snap_io_rate_limit(0),
+	m_snap_threads(1),
 	m_panic_on_wal_error(panic_on_wal_error)
 {
 	flags = ENGINE_CAN_BE_TEMPORARY;
@@ -247,6 +419,308 @@ MemtxEngine::lastCheckpoint(struct vclock *vclock)
 	return vclock->signature;
 }
 
+/* {{{ Snapshot reader */
+
+/*
+ * Snapshot recovery is pipelined: a reader thread reads the
+ * snapshot file, decompresses and decodes rows, and passes them
+ * to the tx thread in batches, while the tx thread applies the
+ * previous batches to spaces.
+ */
+
+enum {
+	/** Max number of rows in a batch of decoded rows. */
+	SNAPSHOT_BATCH_ROWS_MAX = 1024,
+	/** Max number of decoded batches not applied yet. */
+	SNAPSHOT_BATCHES_MAX = 16,
+};
+
+struct snapshot_batch {
+	/** Link in snapshot_reader::queue. */
+	struct stailq_entry in_queue;
+	/** Number of rows in the batch. */
+	uint32_t row_count;
+	struct xrow_header rows[SNAPSHOT_BATCH_ROWS_MAX];
+	/** Row bodies, malloc()ed. */
+	char *data;
+	size_t size;
+	size_t capacity;
+};
+
+struct snapshot_reader {
+	struct cord cord;
+	/** Name of the snapshot file. */
+	const char *filename;
+	bool panic_if_error;
+	pthread_mutex_t mutex;
+	/** Signaled when a batch is taken by tx or on stop. */
+	pthread_cond_t reader_cond;
+	/** Signaled when a batch is decoded or on completion. */
+	pthread_cond_t tx_cond;
+	/** Decoded batches, in the order of the file. */
+	struct stailq queue;
+	int queue_len;
+	/** Set by the reader when the file is open. */
+	bool is_open;
+	/** Set by the reader when it has read the whole file. */
+	bool is_done;
+	/** Set by tx to stop the reader. */
+	bool is_stopped;
+	/** Set if the snapshot ends with an EOF marker. */
+	bool has_eof;
+	/** Server UUID, from the snapshot meta. */
+	struct tt_uuid server_uuid;
+	/** Read error, if any. */
+	struct diag diag;
+};
+
+static struct snapshot_batch *
+snapshot_batch_new()
+{
+	struct snapshot_batch *batch = (struct snapshot_batch *)
+		malloc(sizeof(*batch));
+	if (batch == NULL) {
+		diag_set(OutOfMemory, sizeof(*batch), "malloc",
+			 "struct snapshot_batch");
+		return NULL;
+	}
+	batch->row_count = 0;
+	batch->data = NULL;
+	batch->size = 0;
+	batch->capacity = 0;
+	return batch;
+}
+
+static void
+snapshot_batch_delete(struct snapshot_batch *batch)
+{
+	free(batch->data);
+	free(batch);
+}
+
+/**
+ * Copy a decoded row to the batch. The row body points to the
+ * cursor buffer, which is reused for the next transaction, so
+ * the body is copied too.
+ */
+static int
+snapshot_batch_add_row(struct snapshot_batch *batch,
+		       struct xrow_header *row)
+{
+	assert(batch->row_count < SNAPSHOT_BATCH_ROWS_MAX);
+	size_t len = 0;
+	for (int i = 0; i < row->bodycnt; i++)
+		len += row->body[i].iov_len;
+	if (batch->size + len > batch->capacity) {
+		size_t capacity = MAX(batch->capacity * 2, 64 * 1024);
+		while (capacity < batch->size + len)
+			capacity *= 2;
+		char *data = (char *) realloc(batch->data, capacity);
+		if (data == NULL) {
+			diag_set(OutOfMemory, capacity, "realloc",
+				 "snapshot batch");
+			return -1;
+		}
+		batch->data = data;
+		batch->capacity = capacity;
+	}
+	for (int i = 0; i < row->bodycnt; i++) {
+		memcpy(batch->data + batch->size, row->body[i].iov_base,
+		       row->body[i].iov_len);
+		batch->size += row->body[i].iov_len;
+	}
+	batch->rows[batch->row_count++] = *row;
+	return 0;
+}
+
+/**
+ * Point the row bodies to the batch data. Done once the batch
+ * is complete, since the data may move while the batch grows.
+ */
+static void
+snapshot_batch_finish(struct snapshot_batch *batch)
+{
+	char *pos = batch->data;
+	for (uint32_t i = 0; i < batch->row_count; i++) {
+		struct xrow_header *row = &batch->rows[i];
+		for (int j = 0; j < row->bodycnt; j++) {
+			row->body[j].iov_base = pos;
+			pos += row->body[j].iov_len;
+		}
+	}
+	assert(pos == batch->data + batch->size);
+}
+
+/**
+ * Pass a decoded batch to tx. Waits while there are too many
+ * batches not applied yet.
+ *
+ * @retval 0 success
+ * @retval -1 the reader is stopped, the batch is deleted
+ */
+static int
+snapshot_reader_push(struct snapshot_reader *reader,
+		     struct snapshot_batch *batch)
+{
+	snapshot_batch_finish(batch);
+	tt_pthread_mutex_lock(&reader->mutex);
+	while (reader->queue_len >= SNAPSHOT_BATCHES_MAX &&
+	       !reader->is_stopped)
+		tt_pthread_cond_wait(&reader->reader_cond, &reader->mutex);
+	if (reader->is_stopped) {
+		tt_pthread_mutex_unlock(&reader->mutex);
+		snapshot_batch_delete(batch);
+		return -1;
+	}
+	stailq_add_tail_entry(&reader->queue, batch, in_queue);
+	reader->queue_len++;
+	tt_pthread_cond_signal(&reader->tx_cond);
+	tt_pthread_mutex_unlock(&reader->mutex);
+	return 0;
+}
+
+static int
+snapshot_reader_f(va_list ap)
+{
+	struct snapshot_reader *reader =
+		va_arg(ap, struct snapshot_reader *);
+	struct xlog_cursor cursor;
+	if (xlog_cursor_open(&cursor, reader->filename) != 0) {
+		diag_move(diag_get(), &reader->diag);
+		tt_pthread_mutex_lock(&reader->mutex);
+		reader->is_done = true;
+		tt_pthread_cond_signal(&reader->tx_cond);
+		tt_pthread_mutex_unlock(&reader->mutex);
+		return 0;
+	}
+	tt_pthread_mutex_lock(&reader->mutex);
+	reader->server_uuid = cursor.meta.server_uuid;
+	reader->is_open = true;
+	tt_pthread_cond_signal(&reader->tx_cond);
+	tt_pthread_mutex_unlock(&reader->mutex);
+
+	struct snapshot_batch *batch = NULL;
+	struct xrow_header row;
+	int rc;
+	while ((rc = xlog_cursor_next(&cursor, &row,
+				      reader->panic_if_error)) == 0) {
+		if (batch == NULL && (batch = snapshot_batch_new()) == NULL) {
+			rc = -1;
+			break;
+		}
+		if (snapshot_batch_add_row(batch, &row) != 0) {
+			rc = -1;
+			break;
+		}
+		if (batch->row_count < SNAPSHOT_BATCH_ROWS_MAX)
+			continue;
+		struct snapshot_batch *full = batch;
+		batch = NULL;
+		if (snapshot_reader_push(reader, full) != 0)
+			break;
+	}
+	/* Rows read before an error are still applied. */
+	if (batch != NULL)
+		snapshot_reader_push(reader, batch);
+	if (rc < 0)
+		diag_move(diag_get(), &reader->diag);
+	bool has_eof = cursor.state == XLOG_CURSOR_EOF;
+	xlog_cursor_close(&cursor, false);
+
+	tt_pthread_mutex_lock(&reader->mutex);
+	reader->has_eof = has_eof;
+	reader->is_done = true;
+	tt_pthread_cond_signal(&reader->tx_cond);
+	tt_pthread_mutex_unlock(&reader->mutex);
+	return 0;
+}
+
+static void
+snapshot_reader_stop(struct snapshot_reader *reader)
+{
+	tt_pthread_mutex_lock(&reader->mutex);
+	reader->is_stopped = true;
+	tt_pthread_cond_signal(&reader->reader_cond);
+	tt_pthread_mutex_unlock(&reader->mutex);
+	cord_join(&reader->cord);
+
+	struct snapshot_batch *batch, *tmp;
+	stailq_foreach_entry_safe(batch, tmp, &reader->queue, in_queue)
+		snapshot_batch_delete(batch);
+	diag_destroy(&reader->diag);
+	tt_pthread_cond_destroy(&reader->tx_cond);
+	tt_pthread_cond_destroy(&reader->reader_cond);
+	tt_pthread_mutex_destroy(&reader->mutex);
+}
+
+/**
+ * Start the reader thread and wait until it opens the file.
+ */
+static void
+snapshot_reader_start(struct snapshot_reader *reader, const char *filename,
+		      bool panic_if_error)
+{
+	reader->filename = filename;
+	reader->panic_if_error = panic_if_error;
+	tt_pthread_mutex_init(&reader->mutex, NULL);
+	tt_pthread_cond_init(&reader->reader_cond, NULL);
+	tt_pthread_cond_init(&reader->tx_cond, NULL);
+	stailq_create(&reader->queue);
+	reader->queue_len = 0;
+	reader->is_open = false;
+	reader->is_done = false;
+	reader->is_stopped = false;
+	reader->has_eof = false;
+	diag_create(&reader->diag);
+	if (cord_costart(&reader->cord, "snapshot.reader",
+			 snapshot_reader_f, reader) != 0) {
+		diag_destroy(&reader->diag);
+		tt_pthread_cond_destroy(&reader->tx_cond);
+		tt_pthread_cond_destroy(&reader->reader_cond);
+		tt_pthread_mutex_destroy(&reader->mutex);
+		diag_raise();
+	}
+	tt_pthread_mutex_lock(&reader->mutex);
+	while (!reader->is_open && !reader->is_done)
+		tt_pthread_cond_wait(&reader->tx_cond, &reader->mutex);
+	tt_pthread_mutex_unlock(&reader->mutex);
+	if (!reader->is_open) {
+		struct diag diag;
+		diag_create(&diag);
+		diag_move(&reader->diag, &diag);
+		snapshot_reader_stop(reader);
+		diag_move(&diag, diag_get());
+		diag_destroy(&diag);
+		diag_raise();
+	}
+}
+
+/**
+ * Take the next decoded batch. Recovery is the only thing
+ * going on in tx at this point, so it's OK to block the
+ * thread while waiting for the reader.
+ *
+ * @retval NULL the whole file is read
+ */
+static struct snapshot_batch *
+snapshot_reader_next(struct snapshot_reader *reader)
+{
+	tt_pthread_mutex_lock(&reader->mutex);
+	while (reader->queue_len == 0 && !reader->is_done)
+		tt_pthread_cond_wait(&reader->tx_cond, &reader->mutex);
+	struct snapshot_batch *batch = NULL;
+	if (reader->queue_len > 0) {
+		batch = stailq_shift_entry(&reader->queue,
+					   struct snapshot_batch, in_queue);
+		reader->queue_len--;
+		tt_pthread_cond_signal(&reader->reader_cond);
+	}
+	tt_pthread_mutex_unlock(&reader->mutex);
+	return batch;
+}
+
+/* }}} */
+
 void
 MemtxEngine::recoverSnapshot()
 {
@@ -261,29 +735,37 @@ MemtxEngine::recoverSnapshot()
 						    NONE);
 
 	say_info("recovering from `%s'", filename);
-	struct xlog_cursor cursor;
-	xlog_cursor_open_xc(&cursor, filename);
-	SERVER_UUID = cursor.meta.server_uuid;
+	struct snapshot_reader reader;
+	snapshot_reader_start(&reader, filename, m_snap_dir.panic_if_error);
+	SERVER_UUID = reader.server_uuid;
 	auto reader_guard = make_scoped_guard([&]{
-		xlog_cursor_close(&cursor, false);
+		snapshot_reader_stop(&reader);
 	});
 
-	struct xrow_header row;
 	uint64_t row_count = 0;
-	while (xlog_cursor_next_xc(&cursor, &row,
-				   m_snap_dir.panic_if_error) == 0) {
-		try {
-			recoverSnapshotRow(&row);
-		} catch (ClientError *e) {
-			if (m_snap_dir.panic_if_error)
-				throw;
-			say_error("can't apply row: ");
-			e->log();
+	struct snapshot_batch *batch;
+	while ((batch = snapshot_reader_next(&reader)) != NULL) {
+		auto batch_guard = make_scoped_guard([=]{
+			snapshot_batch_delete(batch);
+		});
+		for (uint32_t i = 0; i < batch->row_count; i++) {
+			try {
+				recoverSnapshotRow(&batch->rows[i]);
+			} catch (ClientError *e) {
+				if (m_snap_dir.panic_if_error)
+					throw;
+				say_error("can't apply row: ");
+				e->log();
+			}
+			++row_count;
+			if (row_count % 100000 == 0)
+				say_info("%.1fM rows processed",
+					 row_count / 1000000.);
 		}
-		++row_count;
-		if (row_count % 100000 == 0)
-			say_info("%.1fM rows processed",
-				 row_count / 1000000.);
+	}
+	if (!diag_is_empty(&reader.diag)) {
+		diag_move(&reader.diag, diag_get());
+		diag_raise();
 	}
 
 	/**
@@ -291,7 +773,7 @@ MemtxEngine::recoverSnapshot()
 	 * marker - such snapshots are very likely corrupted and
 	 * should not be trusted.
 	 */
-	if (cursor.state != XLOG_CURSOR_EOF)
+	if (!reader.has_eof)
 		panic("snapshot `%s' has no EOF marker", filename);
 
 }
@@ -366,7 +848,7 @@ MemtxEngine::beginFinalRecovery()
 		 * unique keys.
 		 */
 		m_state = MEMTX_OK;
-		space_foreach(memtx_build_secondary_keys, this);
+		memtx_build_all_secondary_keys(this, m_snap_threads);
 	}
 }
 
@@ -382,7 +864,7 @@ MemtxEngine::endRecovery()
 	if (m_state != MEMTX_OK) {
 		assert(m_state == MEMTX_FINAL_RECOVERY);
 		m_state = MEMTX_OK;
-		space_foreach(memtx_build_secondary_keys, this);
+		memtx_build_all_secondary_keys(this, m_snap_threads);
 	}
 }
 
@@ -436,6 +918,252 @@ MemtxEngine::initSystemSpace(struct space *space)
 	memtx_add_primary_key(space, MEMTX_OK);
 }
 
+/* {{{ Online secondary key build */
+
+/*
+ * Building a TREE index on a big space takes long, mostly
+ * sorting tuples. To keep serving requests meanwhile, the
+ * tuples are taken from a read view of the primary key, with
+ * yields, and sorted in a separate thread, while the fiber
+ * executing the DDL waits. Changes made to the space in the
+ * meantime are logged by an on_replace trigger and applied to
+ * the new index after it is loaded. As before, the new index
+ * becomes visible when the DDL is committed.
+ */
+
+enum {
+	/** Spaces smaller than this are built in place. */
+	MEMTX_BUILD_ONLINE_MIN = 10000,
+	/** Yield after taking this many tuples from the read view. */
+	MEMTX_BUILD_ONLINE_YIELD = 1000,
+};
+
+/** A change made to the space while the index is built. */
+struct memtx_build_change {
+	struct tuple *old_tuple;
+	struct tuple *new_tuple;
+};
+
+struct memtx_build_online {
+	/** The altered space. */
+	struct space *space;
+	/** The index being built. */
+	MemtxTree *index;
+	/** Changes to apply to the index once it's loaded. */
+	struct memtx_build_change *changes;
+	uint32_t change_count;
+	uint32_t change_count_max;
+	/** Logs changes of the space. */
+	struct trigger on_replace;
+	/** A duplicate found by the sorting thread, if any. */
+	struct tuple *dup;
+};
+
+/**
+ * Log a change of the space. Both tuples are referenced
+ * until the change is applied to the index.
+ */
+static void
+memtx_build_online_log(struct memtx_build_online *build,
+		       struct tuple *old_tuple, struct tuple *new_tuple)
+{
+	if (build->change_count == build->change_count_max) {
+		uint32_t count = MAX(build->change_count_max * 2, 64);
+		struct memtx_build_change *changes =
+			(struct memtx_build_change *)
+			realloc(build->changes, count * sizeof(*changes));
+		if (changes == NULL) {
+			tnt_raise(OutOfMemory, count * sizeof(*changes),
+				  "realloc", "struct memtx_build_change");
+		}
+		build->changes = changes;
+		build->change_count_max = count;
+	}
+	if (old_tuple != NULL)
+		tuple_ref_xc(old_tuple);
+	if (new_tuple != NULL && tuple_ref(new_tuple) != 0) {
+		if (old_tuple != NULL)
+			tuple_unref(old_tuple);
+		diag_raise();
+	}
+	struct memtx_build_change *change =
+		&build->changes[build->change_count++];
+	change->old_tuple = old_tuple;
+	change->new_tuple = new_tuple;
+}
+
+/**
+ * A trigger invoked on rollback of a transaction which changed
+ * the space while the index was built: log the reverse change.
+ * If the build is over, the DDL is rolled back too, since it was
+ * written to WAL after this transaction.
+ */
+static void
+memtx_build_online_on_rollback(struct trigger * /* trigger */, void *event)
+{
+	struct txn *txn = (struct txn *) event;
+	struct txn_stmt *stmt;
+	/*
+	 * Undo the statements in reverse order, as the engine
+	 * does, and restore the order for the engine afterwards.
+	 */
+	stailq_reverse(&txn->stmts);
+	stailq_foreach_entry(stmt, &txn->stmts, next) {
+		MemtxSpace *handler = (MemtxSpace *) stmt->space->handler;
+		if (handler->build == NULL)
+			continue;
+		try {
+			memtx_build_online_log(handler->build,
+					       stmt->new_tuple,
+					       stmt->old_tuple);
+		} catch (Exception *e) {
+			/* Rollback triggers must not fail. */
+			error_log(e);
+			panic("failed to roll back an index build");
+		}
+	}
+	stailq_reverse(&txn->stmts);
+}
+
+static void
+memtx_build_online_on_replace(struct trigger *trigger, void *event)
+{
+	struct txn *txn = (struct txn *) event;
+	struct txn_stmt *stmt = txn_current_stmt(txn);
+	struct memtx_build_online *build =
+		(struct memtx_build_online *) trigger->data;
+	struct trigger *on_rollback = (struct trigger *)
+		region_calloc_object_xc(&fiber()->gc, struct trigger);
+	on_rollback->run = memtx_build_online_on_rollback;
+	txn_init_triggers(txn);
+	trigger_add_unique(&txn->on_rollback, on_rollback);
+	memtx_build_online_log(build, stmt->old_tuple, stmt->new_tuple);
+}
+
+static int
+memtx_build_online_sort_f(va_list ap)
+{
+	struct memtx_build_online *build =
+		va_arg(ap, struct memtx_build_online *);
+	build->index->sortBuild();
+	build->dup = build->index->findBuildDup();
+	return 0;
+}
+
+/**
+ * Build a TREE index of an altered space without blocking
+ * other requests for the whole build.
+ */
+static void
+memtx_build_online(struct space *old_space, struct space *new_space,
+		   MemtxTree *new_index)
+{
+	MemtxSpace *handler = (MemtxSpace *) old_space->handler;
+	MemtxIndex *pk = (MemtxIndex *) index_find_xc(old_space, 0);
+	struct memtx_build_online build;
+	memset(&build, 0, sizeof(build));
+	build.space = old_space;
+	build.index = new_index;
+	trigger_create(&build.on_replace, memtx_build_online_on_replace,
+		       &build, NULL);
+
+	struct iterator *it = pk->allocIterator();
+	IteratorGuard it_guard(it);
+	/*
+	 * Transactions waiting for WAL have already changed the
+	 * primary key, but have no rollback trigger to log their
+	 * undo. Let them complete before taking the read view:
+	 * the read view is taken without yielding after the
+	 * checkpoint, so any change it doesn't see is logged.
+	 */
+	if (wal != NULL) {
+		struct vclock vclock;
+		wal_checkpoint(wal, &vclock, false);
+	}
+	pk->initIterator(it, ITER_ALL, NULL, 0);
+	pk->createReadViewForIterator(it);
+	auto guard = make_scoped_guard([&]{
+		pk->destroyReadViewForIterator(it);
+		trigger_clear(&build.on_replace);
+		handler->build = NULL;
+		for (uint32_t i = 0; i < build.change_count; i++) {
+			struct memtx_build_change *change = &build.changes[i];
+			if (change->old_tuple != NULL)
+				tuple_unref(change->old_tuple);
+			if (change->new_tuple != NULL)
+				tuple_unref(change->new_tuple);
+		}
+		free(build.changes);
+	});
+	/*
+	 * From now on, tuples deleted from the space stay
+	 * referenced by the log, so it's safe to read them from
+	 * the read view while yielding.
+	 */
+	handler->build = &build;
+	trigger_add(&old_space->on_replace, &build.on_replace);
+
+	say_info("Adding %" PRIu32 " keys to %s index '%s' in background ...",
+		 (uint32_t) pk->size(), index_type_strs[TREE],
+		 index_name(new_index));
+	new_index->beginBuild();
+	new_index->reserve(pk->size());
+	struct tuple_format *format = new_space->format;
+	struct tuple *tuple;
+	uint32_t loops = 0;
+	while ((tuple = it->next(it)) != NULL) {
+		if (tuple_validate(format, tuple))
+			diag_raise();
+		new_index->buildNext(tuple);
+		if (++loops % MEMTX_BUILD_ONLINE_YIELD == 0)
+			fiber_sleep(0);
+	}
+
+	/*
+	 * The sort thread compares tuples, looking up their
+	 * formats in tuple_formats, while tx may register new
+	 * formats on DDL. The formats themselves are referenced
+	 * by the tuples being sorted.
+	 */
+	struct cord cord;
+	tuple_formats_pin();
+	if (cord_costart(&cord, "build.sort", memtx_build_online_sort_f,
+			 &build) == 0) {
+		int rc = cord_cojoin(&cord);
+		tuple_formats_unpin();
+		if (rc != 0)
+			diag_raise();
+	} else {
+		tuple_formats_unpin();
+		error_log(diag_last_error(diag_get()));
+		new_index->sortBuild();
+		build.dup = new_index->findBuildDup();
+	}
+	if (build.dup != NULL) {
+		tnt_raise(ClientError, ER_TUPLE_FOUND, index_name(new_index),
+			  space_name(old_space));
+	}
+	new_index->endBuild();
+
+	/*
+	 * Catch up with the changes made while the index was
+	 * being built. No yields from here on till the DDL is
+	 * submitted to WAL.
+	 */
+	for (uint32_t i = 0; i < build.change_count; i++) {
+		struct memtx_build_change *change = &build.changes[i];
+		if (change->new_tuple != NULL &&
+		    tuple_validate(format, change->new_tuple))
+			diag_raise();
+		new_index->replace(change->old_tuple, change->new_tuple,
+				   DUP_INSERT);
+	}
+	say_info("Index '%s' is built, %" PRIu32 " changes applied",
+		 index_name(new_index), build.change_count);
+}
+
+/* }}} */
+
 void
 MemtxEngine::buildSecondaryKey(struct space *old_space,
 			       struct space *new_space, Index *new_index)
@@ -453,6 +1181,19 @@ MemtxEngine::buildSecondaryKey(struct space *old_space,
 	}
 	Index *pk = index_find_xc(old_space, 0);
 
+	/*
+	 * A yield would abort a multi-statement transaction,
+	 * so build in background only in autocommit mode.
+	 */
+	struct txn *txn = in_txn();
+	if (new_key_def->type == TREE && new_key_def->iid != 0 &&
+	    pk->size() >= MEMTX_BUILD_ONLINE_MIN &&
+	    (txn == NULL || txn->is_autocommit)) {
+		memtx_build_online(old_space, new_space,
+				   (MemtxTree *) new_index);
+		return;
+	}
+
 	/* Now deal with any kind of add index during normal operation. */
 	struct iterator *it = pk->allocIterator();
 	IteratorGuard guard(it);
@@ -488,6 +1229,12 @@ MemtxEngine::buildSecondaryKey(struct space *old_space,
 void
 MemtxEngine::keydefCheck(struct space *space, struct key_def *key_def)
 {
+	if (key_def->opts.hint && key_def->type != TREE) {
+		tnt_raise(ClientError, ER_MODIFY_INDEX,
+			  key_def->name,
+			  space_name(space),
+			  "hint is supported by TREE index only");
+	}
 	switch (key_def->type) {
 	case HASH:
 		if (! key_def->opts.is_unique) {
@@ -682,59 +1429,29 @@ MemtxEngine::bootstrap()
 	}
 }
 
+/**
+ * Build a snapshot row for a tuple. The row references
+ * the tuple data and the body header, which must outlive it.
+ */
 static void
-checkpoint_write_row(struct xlog *l, struct xrow_header *row)
-{
-	static ev_tstamp last = 0;
-	if (last == 0) {
-		ev_now_update(loop());
-		last = ev_now(loop());
-	}
-
-	row->tm = last;
-	row->server_id = 0;
-	/**
-	 * Rows in snapshot are numbered from 1 to %rows.
-	 * This makes streaming such rows to a replica or
-	 * to recovery look similar to streaming a normal
-	 * WAL. @sa the place which skips old rows in
-	 * recovery_apply_row().
-	 */
-	row->lsn = ++l->rows;
-	row->sync = 0; /* don't write sync to wal */
-
-	ssize_t written = xlog_write_row(l, row);
-	fiber_gc();
-	if (written < 0) {
-		diag_raise();
-	}
-
-	if (l->rows % 100000 == 0)
-		say_crit("%.1fM rows written", l->rows / 1000000.);
-
-}
-
-static void
-checkpoint_write_tuple(struct xlog *l, uint32_t n, struct tuple *tuple)
+checkpoint_tuple_row(struct xrow_header *row, struct request_replace_body *body,
+		     uint32_t space_id, struct tuple *tuple)
 {
-	struct request_replace_body body;
-	body.m_body = 0x82; /* map of two elements. */
-	body.k_space_id = IPROTO_SPACE_ID;
-	body.m_space_id = 0xce; /* uint32 */
-	body.v_space_id = mp_bswap_u32(n);
-	body.k_tuple = IPROTO_TUPLE;
-
-	struct xrow_header row;
-	memset(&row, 0, sizeof(struct xrow_header));
-	row.type = IPROTO_INSERT;
-
-	row.bodycnt = 2;
-	row.body[0].iov_base = &body;
-	row.body[0].iov_len = sizeof(body);
+	body->m_body = 0x82; /* map of two elements. */
+	body->k_space_id = IPROTO_SPACE_ID;
+	body->m_space_id = 0xce; /* uint32 */
+	body->v_space_id = mp_bswap_u32(space_id);
+	body->k_tuple = IPROTO_TUPLE;
+
+	memset(row, 0, sizeof(struct xrow_header));
+	row->type = IPROTO_INSERT;
+
+	row->bodycnt = 2;
+	row->body[0].iov_base = body;
+	row->body[0].iov_len = sizeof(*body);
 	uint32_t bsize;
-	row.body[1].iov_base = (char *) tuple_data_range(tuple, &bsize);
-	row.body[1].iov_len = bsize;
-	checkpoint_write_row(l, &row);
+	row->body[1].iov_base = (char *) tuple_data_range(tuple, &bsize);
+	row->body[1].iov_len = bsize;
 }
 
 struct checkpoint_entry {
@@ -750,6 +1467,8 @@ struct checkpoint {
 	 */
 	struct rlist entries;
 	uint64_t snap_io_rate_limit;
+	/** Number of threads encoding snapshot rows. */
+	int snap_threads;
 	struct cord cord;
 	bool waiting_for_snap_thread;
 	/** The vclock of the snapshot file. */
@@ -759,12 +1478,13 @@ struct checkpoint {
 
 static void
 checkpoint_init(struct checkpoint *ckpt, const char *snap_dirname,
-		uint64_t snap_io_rate_limit)
+		uint64_t snap_io_rate_limit, int snap_threads)
 {
 	ckpt->entries = RLIST_HEAD_INITIALIZER(ckpt->entries);
 	ckpt->waiting_for_snap_thread = false;
 	xdir_create(&ckpt->dir, snap_dirname, SNAP, &SERVER_UUID);
 	ckpt->snap_io_rate_limit = snap_io_rate_limit;
+	ckpt->snap_threads = snap_threads;
 	/* May be used in abortCheckpoint() */
 	vclock_create(&ckpt->vclock);
 }
@@ -805,6 +1525,283 @@ checkpoint_add_space(struct space *sp, void *data)
 	pk->createReadViewForIterator(entry->iterator);
 };
 
+/* {{{ Parallel snapshot writer */
+
+/*
+ * The snapshot thread walks the read views of all spaces and
+ * cuts the tuples into batches. Snapshot workers encode and
+ * compress the batches into ready-to-write xlog transactions
+ * in parallel, and the snapshot thread appends them to the
+ * snapshot file in the original order. The result is the same
+ * single snapshot file as written by a single thread, with
+ * rows numbered from 1 to %rows.
+ */
+
+enum {
+	/** Max number of rows in a snapshot batch. */
+	CHECKPOINT_BATCH_ROWS_MAX = 4096,
+	/** Max size of tuples in a snapshot batch. */
+	CHECKPOINT_BATCH_SIZE_MAX = 128 * 1024,
+	/** Max number of batches in progress per worker. */
+	CHECKPOINT_BATCHES_PER_WORKER = 4,
+};
+
+struct checkpoint_batch {
+	/** Link in checkpoint_writer::input. */
+	struct stailq_entry in_input;
+	/** Link in checkpoint_writer::inflight. */
+	struct stailq_entry in_inflight;
+	/** LSN of the first row of the batch. */
+	int64_t lsn;
+	/** Total size of the batch tuples. */
+	size_t tuple_size;
+	/** Number of rows in the batch. */
+	uint32_t row_count;
+	struct {
+		uint32_t space_id;
+		struct tuple *tuple;
+	} rows[CHECKPOINT_BATCH_ROWS_MAX];
+	/** Set by a worker when the batch is processed. */
+	bool is_ready;
+	/** Encoded xlog transaction, malloc()ed. */
+	char *data;
+	size_t size;
+	/** Encoding error, if any. */
+	struct diag diag;
+};
+
+struct checkpoint_writer {
+	pthread_mutex_t mutex;
+	/** Signaled when there is a batch to encode or on stop. */
+	pthread_cond_t worker_cond;
+	/** Signaled when a batch is processed. */
+	pthread_cond_t ready_cond;
+	/** Batches to encode, taken by workers. */
+	struct stailq input;
+	/** Batches in progress, in the order of the file. */
+	struct stailq inflight;
+	/** Length of the inflight list. */
+	int inflight_count;
+	/** Set to stop the workers. */
+	bool is_stopped;
+	/** Worker threads. */
+	struct cord *workers;
+	int worker_count;
+	/** Number of rows in submitted batches. */
+	int64_t rows;
+	/** Timestamp of snapshot rows. */
+	double tm;
+};
+
+static struct checkpoint_batch *
+checkpoint_batch_new()
+{
+	struct checkpoint_batch *batch = (struct checkpoint_batch *)
+		malloc(sizeof(*batch));
+	if (batch == NULL) {
+		tnt_raise(OutOfMemory, sizeof(*batch), "malloc",
+			  "struct checkpoint_batch");
+	}
+	batch->tuple_size = 0;
+	batch->row_count = 0;
+	batch->is_ready = false;
+	batch->data = NULL;
+	batch->size = 0;
+	diag_create(&batch->diag);
+	return batch;
+}
+
+static void
+checkpoint_batch_delete(struct checkpoint_batch *batch)
+{
+	diag_destroy(&batch->diag);
+	free(batch->data);
+	free(batch);
+}
+
+/**
+ * Encode the batch rows into an xlog transaction.
+ * Called from a worker thread.
+ */
+static int
+checkpoint_batch_encode(struct checkpoint_batch *batch,
+			struct xlog_tx_buf *buf, double tm)
+{
+	for (uint32_t i = 0; i < batch->row_count; i++) {
+		struct request_replace_body body;
+		struct xrow_header row;
+		checkpoint_tuple_row(&row, &body, batch->rows[i].space_id,
+				     batch->rows[i].tuple);
+		row.tm = tm;
+		/**
+		 * Rows in snapshot are numbered from 1 to %rows.
+		 * This makes streaming such rows to a replica or
+		 * to recovery look similar to streaming a normal
+		 * WAL. @sa the place which skips old rows in
+		 * recovery_apply_row().
+		 */
+		row.lsn = batch->lsn + i;
+		if (xlog_tx_buf_write_row(buf, &row) < 0) {
+			fiber_gc();
+			return -1;
+		}
+	}
+	fiber_gc();
+	batch->data = xlog_tx_buf_finish(buf, &batch->size);
+	return batch->data != NULL ? 0 : -1;
+}
+
+static int
+checkpoint_worker_f(va_list ap)
+{
+	struct checkpoint_writer *writer =
+		va_arg(ap, struct checkpoint_writer *);
+	struct xlog_tx_buf buf;
+	bool has_buf = false;
+
+	tt_pthread_mutex_lock(&writer->mutex);
+	while (!writer->is_stopped) {
+		if (stailq_empty(&writer->input)) {
+			tt_pthread_cond_wait(&writer->worker_cond,
+					     &writer->mutex);
+			continue;
+		}
+		struct checkpoint_batch *batch =
+			stailq_shift_entry(&writer->input,
+					   struct checkpoint_batch, in_input);
+		tt_pthread_mutex_unlock(&writer->mutex);
+
+		if (!has_buf)
+			has_buf = xlog_tx_buf_create(&buf) == 0;
+		if (!has_buf ||
+		    checkpoint_batch_encode(batch, &buf, writer->tm) != 0)
+			diag_move(diag_get(), &batch->diag);
+
+		tt_pthread_mutex_lock(&writer->mutex);
+		batch->is_ready = true;
+		pthread_cond_broadcast(&writer->ready_cond);
+	}
+	tt_pthread_mutex_unlock(&writer->mutex);
+	if (has_buf)
+		xlog_tx_buf_destroy(&buf);
+	return 0;
+}
+
+static void
+checkpoint_writer_stop(struct checkpoint_writer *writer);
+
+static void
+checkpoint_writer_start(struct checkpoint_writer *writer, int worker_count)
+{
+	assert(worker_count > 0);
+	tt_pthread_mutex_init(&writer->mutex, NULL);
+	tt_pthread_cond_init(&writer->worker_cond, NULL);
+	tt_pthread_cond_init(&writer->ready_cond, NULL);
+	stailq_create(&writer->input);
+	stailq_create(&writer->inflight);
+	writer->inflight_count = 0;
+	writer->is_stopped = false;
+	writer->rows = 0;
+	ev_now_update(loop());
+	writer->tm = ev_now(loop());
+	writer->worker_count = 0;
+	writer->workers = (struct cord *)
+		calloc(worker_count, sizeof(struct cord));
+	if (writer->workers == NULL) {
+		checkpoint_writer_stop(writer);
+		tnt_raise(OutOfMemory, worker_count * sizeof(struct cord),
+			  "calloc", "snapshot workers");
+	}
+	for (int i = 0; i < worker_count; i++) {
+		if (cord_costart(&writer->workers[i], "snapshot.worker",
+				 checkpoint_worker_f, writer) != 0) {
+			checkpoint_writer_stop(writer);
+			diag_raise();
+		}
+		writer->worker_count++;
+	}
+}
+
+static void
+checkpoint_writer_stop(struct checkpoint_writer *writer)
+{
+	/* Abort pending batches and wake up the workers. */
+	tt_pthread_mutex_lock(&writer->mutex);
+	writer->is_stopped = true;
+	stailq_create(&writer->input);
+	pthread_cond_broadcast(&writer->worker_cond);
+	tt_pthread_mutex_unlock(&writer->mutex);
+
+	for (int i = 0; i < writer->worker_count; i++)
+		cord_join(&writer->workers[i]);
+	free(writer->workers);
+
+	struct checkpoint_batch *batch, *tmp;
+	stailq_foreach_entry_safe(batch, tmp, &writer->inflight, in_inflight)
+		checkpoint_batch_delete(batch);
+	tt_pthread_cond_destroy(&writer->ready_cond);
+	tt_pthread_cond_destroy(&writer->worker_cond);
+	tt_pthread_mutex_destroy(&writer->mutex);
+}
+
+/**
+ * Wait for the oldest batch in progress and append it
+ * to the snapshot file.
+ */
+static void
+checkpoint_writer_write(struct checkpoint_writer *writer, struct xlog *snap)
+{
+	assert(!stailq_empty(&writer->inflight));
+	struct checkpoint_batch *batch =
+		stailq_first_entry(&writer->inflight,
+				   struct checkpoint_batch, in_inflight);
+	tt_pthread_mutex_lock(&writer->mutex);
+	while (!batch->is_ready)
+		tt_pthread_cond_wait(&writer->ready_cond, &writer->mutex);
+	tt_pthread_mutex_unlock(&writer->mutex);
+
+	if (!diag_is_empty(&batch->diag)) {
+		diag_move(&batch->diag, diag_get());
+		diag_raise();
+	}
+	if (xlog_write_tx(snap, batch->data, batch->size) < 0)
+		diag_raise();
+
+	int64_t rows = snap->rows;
+	snap->rows += batch->row_count;
+	if (snap->rows / 100000 != rows / 100000)
+		say_crit("%.1fM rows written", snap->rows / 1000000.);
+
+	stailq_shift(&writer->inflight);
+	writer->inflight_count--;
+	checkpoint_batch_delete(batch);
+}
+
+/**
+ * Pass a batch to the workers. Before that, wait for the
+ * oldest batches to complete if there are too many of them.
+ */
+static void
+checkpoint_writer_submit(struct checkpoint_writer *writer,
+			 struct checkpoint_batch *batch, struct xlog *snap)
+{
+	while (writer->inflight_count >=
+	       writer->worker_count * CHECKPOINT_BATCHES_PER_WORKER)
+		checkpoint_writer_write(writer, snap);
+
+	batch->lsn = writer->rows + 1;
+	writer->rows += batch->row_count;
+	stailq_add_tail_entry(&writer->inflight, batch, in_inflight);
+	writer->inflight_count++;
+
+	tt_pthread_mutex_lock(&writer->mutex);
+	stailq_add_tail_entry(&writer->input, batch, in_input);
+	tt_pthread_cond_signal(&writer->worker_cond);
+	tt_pthread_mutex_unlock(&writer->mutex);
+}
+
+/* }}} */
+
 int
 checkpoint_f(va_list ap)
 {
@@ -818,15 +1815,42 @@ checkpoint_f(va_list ap)
 	snap.rate_limit = ckpt->snap_io_rate_limit;
 
 	say_info("saving snapshot `%s'", snap.filename);
+	struct checkpoint_writer writer;
+	checkpoint_writer_start(&writer, ckpt->snap_threads);
+	auto writer_guard = make_scoped_guard([&]{
+		checkpoint_writer_stop(&writer);
+	});
+
+	struct checkpoint_batch *batch = NULL;
+	auto batch_guard = make_scoped_guard([&]{
+		if (batch != NULL)
+			checkpoint_batch_delete(batch);
+	});
 	struct checkpoint_entry *entry;
 	rlist_foreach_entry(entry, &ckpt->entries, link) {
 		struct tuple *tuple;
 		struct iterator *it = entry->iterator;
 		for (tuple = it->next(it); tuple; tuple = it->next(it)) {
-			checkpoint_write_tuple(&snap, space_id(entry->space),
-					       tuple);
+			if (batch == NULL)
+				batch = checkpoint_batch_new();
+			batch->rows[batch->row_count].space_id =
+				space_id(entry->space);
+			batch->rows[batch->row_count].tuple = tuple;
+			batch->row_count++;
+			batch->tuple_size += tuple->bsize;
+			if (batch->row_count < CHECKPOINT_BATCH_ROWS_MAX &&
+			    batch->tuple_size < CHECKPOINT_BATCH_SIZE_MAX)
+				continue;
+			checkpoint_writer_submit(&writer, batch, &snap);
+			batch = NULL;
 		}
 	}
+	if (batch != NULL) {
+		checkpoint_writer_submit(&writer, batch, &snap);
+		batch = NULL;
+	}
+	while (!stailq_empty(&writer.inflight))
+		checkpoint_writer_write(&writer, &snap);
 	xlog_flush(&snap);
 	say_info("done");
 	return 0;
@@ -839,7 +1863,8 @@ MemtxEngine::beginCheckpoint()
 
 	m_checkpoint = region_alloc_object_xc(&fiber()->gc, struct checkpoint);
 
-	checkpoint_init(m_checkpoint, m_snap_dir.dirname, m_snap_io_rate_limit);
+	checkpoint_init(m_checkpoint, m_snap_dir.dirname, m_snap_io_rate_limit,
+			m_snap_threads);
 	space_foreach(checkpoint_add_space, m_checkpoint);
 
 	/* increment snapshot version; set tuple deletion to delayed mode */
@@ -102,6 +102,11 @@ struct MemtxEngine: public Engine {
 	{
 		m_snap_io_rate_limit = new_limit * 1024 * 1024;
 	}
+	/* Update snap_threads. */
+	void setSnapThreads(int new_threads)
+	{
+		m_snap_threads = new_threads;
+	}
 	/**
 	 * Return LSN of the most recent snapshot or -1 if there is
 	 * no snapshot.
@@ -118,6 +123,11 @@ private:
 	struct xdir m_snap_dir;
 	/** Limit disk usage of checkpointing (bytes per second). */
 	uint64_t m_snap_io_rate_limit;
+	/**
+	 * Number of threads encoding snapshot rows and sorting
+	 * secondary keys on recovery.
+	 */
+	int m_snap_threads;
 	struct vclock m_last_checkpoint;
 	bool m_has_checkpoint;
 	bool m_panic_on_wal_error;
@@ -39,7 +39,9 @@
 #include "third_party/PMurHash.h"
 
 enum {
-	HASH_SEED = 13U
+	HASH_SEED = 13U,
+	/** How many keys findByKeys() hashes before probing. */
+	HASH_BATCH_SIZE = 32
 };
 
 static inline bool
@@ -275,6 +277,33 @@ MemtxHash::findByKey(const char *key, uint32_t part_count) const
 	return ret;
 }
 
+void
+MemtxHash::findByKeys(const char **keys, uint32_t key_count,
+		      struct tuple **result) const
+{
+	assert(key_def->opts.is_unique);
+	uint32_t hashes[HASH_BATCH_SIZE];
+	for (uint32_t i = 0; i < key_count; i += HASH_BATCH_SIZE) {
+		uint32_t n = MIN(key_count - i, (uint32_t) HASH_BATCH_SIZE);
+		/*
+		 * Hash the whole batch first and prefetch the
+		 * buckets the probes start from: the probes below
+		 * then find them in cache instead of stalling on
+		 * each miss one by one.
+		 */
+		for (uint32_t j = 0; j < n; j++) {
+			hashes[j] = key_hash(keys[i + j], key_def);
+			light_index_prefetch(hash_table, hashes[j]);
+		}
+		for (uint32_t j = 0; j < n; j++) {
+			uint32_t k = light_index_find_key(hash_table, hashes[j],
+							  keys[i + j]);
+			result[i + j] = k != light_index_end ?
+					light_index_get(hash_table, k) : NULL;
+		}
+	}
+}
+
 struct tuple *
 MemtxHash::replace(struct tuple *old_tuple, struct tuple *new_tuple,
 		   enum dup_replace_mode mode)
@@ -45,6 +45,8 @@ public:
 	virtual struct tuple *random(uint32_t rnd) const override;
 	virtual struct tuple *findByKey(const char *key,
 					uint32_t part_count) const override;
+	virtual void findByKeys(const char **keys, uint32_t key_count,
+				struct tuple **result) const override;
 	virtual struct tuple *replace(struct tuple *old_tuple,
 				      struct tuple *new_tuple,
 				      enum dup_replace_mode mode) override;
@@ -55,6 +55,13 @@ void
 MemtxIndex::endBuild()
 {}
 
+bool
+MemtxIndex::replaceInPlace(struct tuple * /* old_tuple */,
+			   struct tuple * /* new_tuple */)
+{
+	return false;
+}
+
 struct tuple *
 MemtxIndex::min(const char *key, uint32_t part_count) const
 {
@@ -87,7 +94,7 @@ MemtxIndex::count(enum iterator_type type, const char *key,
 }
 
 void
-index_build(MemtxIndex *index, MemtxIndex *pk)
+index_build_fill(MemtxIndex *index, MemtxIndex *pk)
 {
 	uint32_t n_tuples = pk->size();
 	uint32_t estimated_tuples = n_tuples * 1.2;
@@ -106,6 +113,11 @@ index_build(MemtxIndex *index, MemtxIndex *pk)
 	struct tuple *tuple;
 	while ((tuple = it->next(it)))
 		index->buildNext(tuple);
+}
 
+void
+index_build(MemtxIndex *index, MemtxIndex *pk)
+{
+	index_build_fill(index, pk);
 	index->endBuild();
 }
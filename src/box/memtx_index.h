@@ -35,8 +35,17 @@
 class MemtxIndex: public Index {
 public:
 	MemtxIndex(struct key_def *key_def_arg)
-		:Index(key_def_arg), m_position(NULL)
-	{}
+		:Index(key_def_arg), column_mask(0), m_position(NULL)
+	{
+		for (uint32_t i = 0; i < key_def->part_count; i++) {
+			uint32_t fieldno = key_def->parts[i].fieldno;
+			if (fieldno >= 64) {
+				column_mask = UINT64_MAX;
+				break;
+			}
+			column_mask |= ((uint64_t) 1) << (63 - fieldno);
+		}
+	}
 	virtual ~MemtxIndex() override {
 		if (m_position != NULL)
 			m_position->free(m_position);
@@ -67,6 +76,22 @@ public:
 	virtual void reserve(uint32_t /* size_hint */);
 	virtual void buildNext(struct tuple *tuple);
 	virtual void endBuild();
+	/**
+	 * Put new_tuple in place of old_tuple, which has the
+	 * same key, without restructuring the index. Return
+	 * false if it can't be done, the index is intact then
+	 * and replace() should be used instead.
+	 */
+	virtual bool replaceInPlace(struct tuple *old_tuple,
+				    struct tuple *new_tuple);
+
+	/**
+	 * Bitmask of the fields used in the key: bit 'n' is
+	 * set if the key has a part with fieldno 'n'. Used to
+	 * skip the indexes an UPDATE doesn't touch
+	 * (@sa memtx_replace_all_keys()).
+	 */
+	uint64_t column_mask;
 protected:
 	/*
 	 * Pre-allocated iterator to speed up the main case of
@@ -79,4 +104,11 @@ protected:
 void
 index_build(MemtxIndex *index, MemtxIndex *pk);
 
+/**
+ * Begin building this index and feed it all tuples of another
+ * index. The caller must finish the build with endBuild().
+ */
+void
+index_build_fill(MemtxIndex *index, MemtxIndex *pk);
+
 #endif /* TARANTOOL_BOX_MEMTX_INDEX_H_INCLUDED */
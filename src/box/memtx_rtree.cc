@@ -317,3 +317,20 @@ MemtxRTree::beginBuild()
 	rtree_purge(&m_tree);
 }
 
+void
+MemtxRTree::buildNext(struct tuple *tuple)
+{
+	struct rtree_rect rect;
+	extract_rectangle(&rect, tuple, key_def);
+	if (rtree_build_next(&m_tree, &rect, tuple) != 0) {
+		tnt_raise(OutOfMemory, m_tree.page_branch_size,
+			  "MemtxRTree", "build buffer");
+	}
+}
+
+void
+MemtxRTree::endBuild()
+{
+	rtree_build_end(&m_tree);
+}
+
@@ -58,6 +58,7 @@ MemtxSpace::MemtxSpace(Engine *e)
 	: Handler(e)
 {
 	replace = memtx_replace_no_keys;
+	build = NULL;
 }
 
 static inline enum dup_replace_mode
@@ -128,7 +129,8 @@ MemtxSpace::prepareUpdate(struct txn_stmt *stmt, struct space *space,
 				       &fiber()->gc,
 				       stmt->old_tuple, request->tuple,
 				       request->tuple_end,
-				       request->index_base, NULL);
+				       request->index_base,
+				       &stmt->column_mask);
 	tuple_ref(stmt->new_tuple);
 }
 
@@ -270,7 +272,7 @@ MemtxSpace::createIndex(struct space *space, struct key_def *key_def_arg)
 	case HASH:
 		return new MemtxHash(key_def_arg);
 	case TREE:
-		return new MemtxTree(key_def_arg);
+		return memtx_tree_new(key_def_arg);
 	case RTREE:
 		return new MemtxRTree(key_def_arg);
 	case BITSET:
@@ -302,6 +304,10 @@ MemtxSpace::prepareAlterSpace(struct space *old_space, struct space *new_space)
 {
 	(void)new_space;
 	MemtxSpace *handler = (MemtxSpace *) old_space->handler;
+	if (handler->build != NULL) {
+		tnt_raise(ClientError, ER_ALTER_SPACE, space_name(old_space),
+			  "an index build is in progress");
+	}
 	replace = handler->replace;
 }
 
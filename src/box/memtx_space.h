@@ -32,6 +32,8 @@
  */
 #include "engine.h"
 
+struct memtx_build_online;
+
 typedef void
 (*engine_replace_f)(struct txn_stmt *, struct space *, enum dup_replace_mode);
 
@@ -159,6 +161,12 @@ public:
 	 * primary key.
 	 */
 	engine_replace_f replace;
+	/**
+	 * A secondary key being built in background, see
+	 * MemtxEngine::buildSecondaryKey(). The space can't
+	 * be altered while it is set.
+	 */
+	struct memtx_build_online *build;
 private:
 	void
 	prepareReplace(struct txn_stmt *stmt, struct space *space,
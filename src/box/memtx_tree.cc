@@ -36,226 +36,602 @@
 #include "memory.h"
 #include "fiber.h"
 #include <third_party/qsort_arg.h>
+#include <math.h>
 
 /* {{{ Utilities. *************************************************/
 
-struct key_data
-{
-	const char *key;
-	uint32_t part_count;
-};
+/** The greatest hint which is not MEMTX_TREE_HINT_NONE. */
+static const uint64_t MEMTX_TREE_HINT_MAX = MEMTX_TREE_HINT_NONE - 1;
 
-int
-memtx_tree_compare(const tuple *a, const tuple *b, struct key_def *key_def)
+/**
+ * Calculate the hint of a key field of the given type.
+ *
+ * Hints must not contradict the field order: if a < b then
+ * hint(a) <= hint(b). Within this restriction as many values
+ * as possible are given distinct hints:
+ * - unsigned values are used as is;
+ * - integer values are shifted by 2^63 so that negative
+ *   values come first;
+ * - numbers are converted to double, whose bits are turned
+ *   into an unsigned integer ordered the same way;
+ * - strings are represented by their first 8 bytes, in
+ *   memcmp() order.
+ * Values which don't fit are clamped to MEMTX_TREE_HINT_MAX,
+ * which is still correct, since equal hints compare nothing.
+ * Other field types have no hint.
+ */
+static uint64_t
+memtx_tree_hint(const char *field, enum field_type type)
 {
-	int r = tuple_compare(a, b, key_def);
-	if (r == 0 && !key_def->opts.is_unique)
-		r = a < b ? -1 : a > b;
-	return r;
+	switch (type) {
+	case FIELD_TYPE_UNSIGNED: {
+		uint64_t val = mp_decode_uint(&field);
+		return MIN(val, MEMTX_TREE_HINT_MAX);
+	}
+	case FIELD_TYPE_INTEGER: {
+		if (mp_typeof(*field) == MP_UINT) {
+			uint64_t val = mp_decode_uint(&field);
+			if (val > INT64_MAX)
+				return MEMTX_TREE_HINT_MAX;
+			return MIN(val + (1ULL << 63), MEMTX_TREE_HINT_MAX);
+		}
+		int64_t val = mp_decode_int(&field);
+		return (uint64_t) val + (1ULL << 63);
+	}
+	case FIELD_TYPE_NUMBER: {
+		double val;
+		switch (mp_typeof(*field)) {
+		case MP_UINT:
+			val = mp_decode_uint(&field);
+			break;
+		case MP_INT:
+			val = mp_decode_int(&field);
+			break;
+		case MP_FLOAT:
+			val = mp_decode_float(&field);
+			break;
+		case MP_DOUBLE:
+			val = mp_decode_double(&field);
+			break;
+		default:
+			return MEMTX_TREE_HINT_NONE;
+		}
+		if (isnan(val))
+			return MEMTX_TREE_HINT_NONE;
+		/* -0.0 and 0.0 are equal and must have equal hints. */
+		if (val == 0)
+			val = 0;
+		uint64_t bits;
+		memcpy(&bits, &val, sizeof(bits));
+		if (bits & (1ULL << 63))
+			bits = ~bits;
+		else
+			bits |= 1ULL << 63;
+		return MIN(bits, MEMTX_TREE_HINT_MAX);
+	}
+	case FIELD_TYPE_STRING: {
+		uint32_t len = mp_decode_strl(&field);
+		uint64_t hint = 0;
+		for (uint32_t i = 0; i < sizeof(hint); i++) {
+			hint <<= 8;
+			if (i < len)
+				hint |= (unsigned char) field[i];
+		}
+		return MIN(hint, MEMTX_TREE_HINT_MAX);
+	}
+	default:
+		return MEMTX_TREE_HINT_NONE;
+	}
 }
 
-int
-memtx_tree_compare_key(const tuple *a, const struct key_data *key_data,
-		       struct key_def *key_def)
+static inline uint64_t
+memtx_tree_tuple_hint(struct tuple *tuple, struct key_def *key_def)
 {
-	return tuple_compare_with_key(a, key_data->key,
-				      key_data->part_count, key_def);
+	if (!key_def->opts.hint)
+		return MEMTX_TREE_HINT_NONE;
+	const struct key_part *part = &key_def->parts[0];
+	return memtx_tree_hint(tuple_field(tuple, part->fieldno), part->type);
 }
 
-int
-memtx_tree_qcompare(const void* a, const void *b, void *c)
+static inline void
+memtx_tree_key_data_create(struct memtx_tree_key_data *key_data,
+			   const char *key, uint32_t part_count,
+			   struct key_def *key_def)
 {
-	return memtx_tree_compare(*(struct tuple **)a,
-		*(struct tuple **)b, (struct key_def *)c);
+	key_data->key = key;
+	key_data->part_count = part_count;
+	if (part_count > 0 && key_def->opts.hint)
+		key_data->hint = memtx_tree_hint(key, key_def->parts[0].type);
+	else
+		key_data->hint = MEMTX_TREE_HINT_NONE;
 }
 
-/* {{{ MemtxTree Iterators ****************************************/
-struct tree_iterator {
-	struct iterator base;
-	const struct memtx_tree *tree;
-	struct key_def *key_def;
-	struct memtx_tree_iterator tree_iterator;
-	struct key_data key_data;
-};
-
-static void
-tree_iterator_free(struct iterator *iterator);
-
-static inline struct tree_iterator *
-tree_iterator(struct iterator *it)
+/*
+ * Operations on tree elements, overloaded for trees of plain
+ * tuple pointers and for trees with hints.
+ */
+static inline struct tuple *
+memtx_tree_elem_tuple(struct tuple *elem)
 {
-	assert(it->free == tree_iterator_free);
-	return (struct tree_iterator *) it;
+	return elem;
 }
 
-static void
-tree_iterator_free(struct iterator *iterator)
+static inline struct tuple *
+memtx_tree_elem_tuple(const struct memtx_tree_data &elem)
 {
-	free(iterator);
+	return elem.tuple;
 }
 
-static struct tuple *
-tree_iterator_dummie(struct iterator *iterator)
+static inline void
+memtx_tree_elem_create(struct tuple **elem, struct tuple *tuple,
+		       struct key_def *key_def)
 {
-	(void)iterator;
-	return 0;
+	(void) key_def;
+	*elem = tuple;
 }
 
-static struct tuple *
-tree_iterator_fwd(struct iterator *iterator)
+static inline void
+memtx_tree_elem_create(struct memtx_tree_data *elem, struct tuple *tuple,
+		       struct key_def *key_def)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
-	tuple **res = memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
-	if (!res)
-		return 0;
-	memtx_tree_iterator_next(it->tree, &it->tree_iterator);
-	return *res;
+	elem->tuple = tuple;
+	elem->hint = memtx_tree_tuple_hint(tuple, key_def);
 }
 
-static struct tuple *
-tree_iterator_bwd(struct iterator *iterator)
+static inline int
+memtx_tree_elem_compare(struct tuple *const *a, struct tuple *const *b,
+			struct key_def *key_def)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
-	tuple **res = memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
-	if (!res)
-		return 0;
-	memtx_tree_iterator_prev(it->tree, &it->tree_iterator);
-	return *res;
+	return memtx_tree_compare(*a, *b, key_def);
 }
 
-static struct tuple *
-tree_iterator_fwd_check_equality(struct iterator *iterator)
+static inline int
+memtx_tree_elem_compare(const struct memtx_tree_data *a,
+			const struct memtx_tree_data *b,
+			struct key_def *key_def)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
-	tuple **res = memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
-	if (!res)
-		return 0;
-	if (memtx_tree_compare_key(*res, &it->key_data, it->key_def) != 0) {
-		it->tree_iterator = memtx_tree_invalid_iterator();
-		return 0;
-	}
-	memtx_tree_iterator_next(it->tree, &it->tree_iterator);
-	return *res;
+	return memtx_tree_compare(a, b, key_def);
 }
 
-static struct tuple *
-tree_iterator_fwd_check_next_equality(struct iterator *iterator)
+static inline int
+memtx_tree_elem_compare_key(struct tuple *const *a,
+			    const struct memtx_tree_key_data *key_data,
+			    struct key_def *key_def)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
-	tuple **res = memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
-	if (!res)
-		return 0;
-	memtx_tree_iterator_next(it->tree, &it->tree_iterator);
-	iterator->next = tree_iterator_fwd_check_equality;
-	return *res;
+	return memtx_tree_compare_key(*a, key_data, key_def);
 }
 
-static struct tuple *
-tree_iterator_bwd_skip_one(struct iterator *iterator)
+static inline int
+memtx_tree_elem_compare_key(const struct memtx_tree_data *a,
+			    const struct memtx_tree_key_data *key_data,
+			    struct key_def *key_def)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
-	memtx_tree_iterator_prev(it->tree, &it->tree_iterator);
-	iterator->next = tree_iterator_bwd;
-	return tree_iterator_bwd(iterator);
+	return memtx_tree_compare_key(a, key_data, key_def);
 }
 
-static struct tuple *
-tree_iterator_bwd_check_equality(struct iterator *iterator)
+template <class Elem>
+static int
+memtx_tree_qcompare(const void *a, const void *b, void *c)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
-	tuple **res = memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
-	if (!res)
-		return 0;
-	if (memtx_tree_compare_key(*res, &it->key_data, it->key_def) != 0) {
-		it->tree_iterator = memtx_tree_invalid_iterator();
-		return 0;
-	}
-	memtx_tree_iterator_prev(it->tree, &it->tree_iterator);
-	return *res;
+	return memtx_tree_elem_compare((const Elem *) a, (const Elem *) b,
+				       (struct key_def *) c);
 }
 
-static struct tuple *
-tree_iterator_bwd_skip_one_check_next_equality(struct iterator *iterator)
+/**
+ * Define a struct binding the functions of a bps_tree instance
+ * named @a name, so that MemtxTreeImpl can be instantiated
+ * with either tree.
+ */
+#define MEMTX_TREE_TRAITS(name, elem_type)				\
+struct name##_traits {							\
+	typedef struct name tree_t;					\
+	typedef struct name##_iterator iterator_t;			\
+	typedef elem_type elem_t;					\
+									\
+	static void							\
+	create(tree_t *tree, struct key_def *key_def)			\
+	{								\
+		name##_create(tree, key_def, memtx_index_extent_alloc,	\
+			      memtx_index_extent_free, NULL);		\
+	}								\
+	static void							\
+	destroy(tree_t *tree) { name##_destroy(tree); }			\
+	static int							\
+	build(tree_t *tree, elem_t *array, size_t size)			\
+	{								\
+		return name##_build(tree, array, size);			\
+	}								\
+	static size_t							\
+	size(const tree_t *tree) { return name##_size(tree); }		\
+	static size_t							\
+	mem_used(const tree_t *tree) { return name##_mem_used(tree); }	\
+	static elem_t *							\
+	random(const tree_t *tree, size_t rnd)				\
+	{								\
+		return name##_random(tree, rnd);			\
+	}								\
+	static elem_t *							\
+	find(const tree_t *tree, struct memtx_tree_key_data *key)	\
+	{								\
+		return name##_find(tree, key);				\
+	}								\
+	static int							\
+	insert(tree_t *tree, elem_t elem, elem_t *replaced)		\
+	{								\
+		return name##_insert(tree, elem, replaced);		\
+	}								\
+	static int							\
+	remove(tree_t *tree, elem_t elem)				\
+	{								\
+		return name##_delete(tree, elem);			\
+	}								\
+	static int							\
+	replace_elem(tree_t *tree, elem_t old_elem, elem_t new_elem)	\
+	{								\
+		return name##_replace_elem(tree, old_elem, new_elem);	\
+	}								\
+	static iterator_t						\
+	invalid_iterator() { return name##_invalid_iterator(); }	\
+	static iterator_t						\
+	iterator_first(const tree_t *tree)				\
+	{								\
+		return name##_iterator_first(tree);			\
+	}								\
+	static iterator_t						\
+	lower_bound(const tree_t *tree,					\
+		    struct memtx_tree_key_data *key, bool *exact)	\
+	{								\
+		return name##_lower_bound(tree, key, exact);		\
+	}								\
+	static iterator_t						\
+	upper_bound(const tree_t *tree,					\
+		    struct memtx_tree_key_data *key, bool *exact)	\
+	{								\
+		return name##_upper_bound(tree, key, exact);		\
+	}								\
+	static elem_t *							\
+	iterator_get_elem(const tree_t *tree, iterator_t *it)		\
+	{								\
+		return name##_iterator_get_elem(tree, it);		\
+	}								\
+	static bool							\
+	iterator_next(const tree_t *tree, iterator_t *it)		\
+	{								\
+		return name##_iterator_next(tree, it);			\
+	}								\
+	static bool							\
+	iterator_prev(const tree_t *tree, iterator_t *it)		\
+	{								\
+		return name##_iterator_prev(tree, it);			\
+	}								\
+	static void							\
+	iterator_freeze(tree_t *tree, iterator_t *it)			\
+	{								\
+		name##_iterator_freeze(tree, it);			\
+	}								\
+	static void							\
+	iterator_destroy(tree_t *tree, iterator_t *it)			\
+	{								\
+		name##_iterator_destroy(tree, it);			\
+	}								\
+}
+
+MEMTX_TREE_TRAITS(memtx_tree, struct tuple *);
+MEMTX_TREE_TRAITS(memtx_hint_tree, struct memtx_tree_data);
+
+#undef MEMTX_TREE_TRAITS
+
+/** A key of a findByKeys() batch and its position in the batch. */
+struct memtx_tree_batch_key {
+	struct memtx_tree_key_data key_data;
+	uint32_t pos;
+};
+
+static int
+memtx_tree_batch_key_qcompare(const void *a, const void *b, void *c)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
-	memtx_tree_iterator_prev(it->tree, &it->tree_iterator);
-	iterator->next = tree_iterator_bwd_check_equality;
-	return tree_iterator_bwd_check_equality(iterator);
+	const struct memtx_tree_key_data *key_a =
+		&((const struct memtx_tree_batch_key *) a)->key_data;
+	const struct memtx_tree_key_data *key_b =
+		&((const struct memtx_tree_batch_key *) b)->key_data;
+	int r = memtx_tree_hint_compare(key_a->hint, key_b->hint);
+	if (r != 0)
+		return r;
+	return tuple_compare_key_raw(key_a->key, key_a->part_count,
+				     key_b->key, key_b->part_count,
+				     (struct key_def *) c);
 }
+
+/* {{{ MemtxTree Iterators ****************************************/
+template <class Traits>
+struct tree_iterator {
+	typedef typename Traits::tree_t tree_t;
+	typedef typename Traits::elem_t elem_t;
+
+	struct iterator base;
+	const tree_t *tree;
+	struct key_def *key_def;
+	typename Traits::iterator_t tree_iterator;
+	struct memtx_tree_key_data key_data;
+
+	static struct tree_iterator *
+	cast(struct iterator *it)
+	{
+		assert(it->free == free_cb);
+		return (struct tree_iterator *) it;
+	}
+
+	static void
+	free_cb(struct iterator *iterator)
+	{
+		free(iterator);
+	}
+
+	static struct tuple *
+	dummie(struct iterator *iterator)
+	{
+		(void)iterator;
+		return 0;
+	}
+
+	static struct tuple *
+	fwd(struct iterator *iterator)
+	{
+		struct tree_iterator *it = cast(iterator);
+		elem_t *res = Traits::iterator_get_elem(it->tree,
+							&it->tree_iterator);
+		if (!res)
+			return 0;
+		Traits::iterator_next(it->tree, &it->tree_iterator);
+		return memtx_tree_elem_tuple(*res);
+	}
+
+	static struct tuple *
+	bwd(struct iterator *iterator)
+	{
+		struct tree_iterator *it = cast(iterator);
+		elem_t *res = Traits::iterator_get_elem(it->tree,
+							&it->tree_iterator);
+		if (!res)
+			return 0;
+		Traits::iterator_prev(it->tree, &it->tree_iterator);
+		return memtx_tree_elem_tuple(*res);
+	}
+
+	static struct tuple *
+	fwd_check_equality(struct iterator *iterator)
+	{
+		struct tree_iterator *it = cast(iterator);
+		elem_t *res = Traits::iterator_get_elem(it->tree,
+							&it->tree_iterator);
+		if (!res)
+			return 0;
+		if (memtx_tree_elem_compare_key(res, &it->key_data,
+						it->key_def) != 0) {
+			it->tree_iterator = Traits::invalid_iterator();
+			return 0;
+		}
+		Traits::iterator_next(it->tree, &it->tree_iterator);
+		return memtx_tree_elem_tuple(*res);
+	}
+
+	static struct tuple *
+	fwd_check_next_equality(struct iterator *iterator)
+	{
+		struct tree_iterator *it = cast(iterator);
+		elem_t *res = Traits::iterator_get_elem(it->tree,
+							&it->tree_iterator);
+		if (!res)
+			return 0;
+		Traits::iterator_next(it->tree, &it->tree_iterator);
+		iterator->next = fwd_check_equality;
+		return memtx_tree_elem_tuple(*res);
+	}
+
+	static struct tuple *
+	bwd_skip_one(struct iterator *iterator)
+	{
+		struct tree_iterator *it = cast(iterator);
+		Traits::iterator_prev(it->tree, &it->tree_iterator);
+		iterator->next = bwd;
+		return bwd(iterator);
+	}
+
+	static struct tuple *
+	bwd_check_equality(struct iterator *iterator)
+	{
+		struct tree_iterator *it = cast(iterator);
+		elem_t *res = Traits::iterator_get_elem(it->tree,
+							&it->tree_iterator);
+		if (!res)
+			return 0;
+		if (memtx_tree_elem_compare_key(res, &it->key_data,
+						it->key_def) != 0) {
+			it->tree_iterator = Traits::invalid_iterator();
+			return 0;
+		}
+		Traits::iterator_prev(it->tree, &it->tree_iterator);
+		return memtx_tree_elem_tuple(*res);
+	}
+
+	static struct tuple *
+	bwd_skip_one_check_next_equality(struct iterator *iterator)
+	{
+		struct tree_iterator *it = cast(iterator);
+		Traits::iterator_prev(it->tree, &it->tree_iterator);
+		iterator->next = bwd_check_equality;
+		return bwd_check_equality(iterator);
+	}
+};
 /* }}} */
 
 /* {{{ MemtxTree  **********************************************************/
 
-MemtxTree::MemtxTree(struct key_def *key_def_arg)
-	: MemtxIndex(key_def_arg), build_array(0), build_array_size(0),
-	  build_array_alloc_size(0)
+/**
+ * A TREE index over the bps_tree instance described by Traits:
+ * memtx_tree_traits or memtx_hint_tree_traits.
+ */
+template <class Traits>
+class MemtxTreeImpl: public MemtxTree {
+	typedef typename Traits::elem_t elem_t;
+	typedef struct tree_iterator<Traits> tree_iterator_t;
+public:
+	MemtxTreeImpl(struct key_def *key_def);
+	virtual ~MemtxTreeImpl();
+
+	virtual void beginBuild();
+	virtual void reserve(uint32_t size_hint);
+	virtual void buildNext(struct tuple *tuple);
+	virtual void endBuild();
+	virtual void sortBuild();
+	virtual struct tuple *findBuildDup() const;
+	virtual size_t size() const;
+	virtual size_t bsize() const;
+	virtual struct tuple *random(uint32_t rnd) const;
+	virtual struct tuple *findByKey(const char *key,
+					uint32_t part_count) const;
+	virtual void findByKeys(const char **keys, uint32_t key_count,
+				struct tuple **result) const;
+	virtual struct tuple *replace(struct tuple *old_tuple,
+				      struct tuple *new_tuple,
+				      enum dup_replace_mode mode);
+	virtual bool replaceInPlace(struct tuple *old_tuple,
+				    struct tuple *new_tuple);
+
+	virtual struct iterator *allocIterator() const;
+	virtual void initIterator(struct iterator *iterator,
+				  enum iterator_type type,
+				  const char *key, uint32_t part_count) const;
+
+	virtual void createReadViewForIterator(struct iterator *iterator);
+	virtual void destroyReadViewForIterator(struct iterator *iterator);
+
+private:
+	typename Traits::tree_t tree;
+	elem_t *build_array;
+	size_t build_array_size, build_array_alloc_size;
+	bool build_array_is_sorted;
+
+	elem_t
+	tupleElem(struct tuple *tuple) const
+	{
+		elem_t elem;
+		memtx_tree_elem_create(&elem, tuple, key_def);
+		return elem;
+	}
+};
+
+template <class Traits>
+MemtxTreeImpl<Traits>::MemtxTreeImpl(struct key_def *key_def_arg)
+	: MemtxTree(key_def_arg), build_array(0), build_array_size(0),
+	  build_array_alloc_size(0), build_array_is_sorted(false)
 {
 	memtx_index_arena_init();
-	memtx_tree_create(&tree, key_def,
-			      memtx_index_extent_alloc,
-			      memtx_index_extent_free, NULL);
+	Traits::create(&tree, key_def);
 }
 
-MemtxTree::~MemtxTree()
+template <class Traits>
+MemtxTreeImpl<Traits>::~MemtxTreeImpl()
 {
-	memtx_tree_destroy(&tree);
+	Traits::destroy(&tree);
 	free(build_array);
 }
 
+template <class Traits>
 size_t
-MemtxTree::size() const
+MemtxTreeImpl<Traits>::size() const
 {
-	return memtx_tree_size(&tree);
+	return Traits::size(&tree);
 }
 
+template <class Traits>
 size_t
-MemtxTree::bsize() const
+MemtxTreeImpl<Traits>::bsize() const
 {
-	return memtx_tree_mem_used(&tree);
+	return Traits::mem_used(&tree);
 }
 
+template <class Traits>
 struct tuple *
-MemtxTree::random(uint32_t rnd) const
+MemtxTreeImpl<Traits>::random(uint32_t rnd) const
 {
-	struct tuple **res = memtx_tree_random(&tree, rnd);
-	return res ? *res : 0;
+	elem_t *res = Traits::random(&tree, rnd);
+	return res ? memtx_tree_elem_tuple(*res) : 0;
 }
 
+template <class Traits>
 struct tuple *
-MemtxTree::findByKey(const char *key, uint32_t part_count) const
+MemtxTreeImpl<Traits>::findByKey(const char *key, uint32_t part_count) const
 {
 	assert(key_def->opts.is_unique && part_count == key_def->part_count);
 
-	struct key_data key_data;
-	key_data.key = key;
-	key_data.part_count = part_count;
-	struct tuple **res = memtx_tree_find(&tree, &key_data);
-	return res ? *res : 0;
+	struct memtx_tree_key_data key_data;
+	memtx_tree_key_data_create(&key_data, key, part_count, key_def);
+	elem_t *res = Traits::find(&tree, &key_data);
+	return res ? memtx_tree_elem_tuple(*res) : 0;
 }
 
+template <class Traits>
+void
+MemtxTreeImpl<Traits>::findByKeys(const char **keys, uint32_t key_count,
+				  struct tuple **result) const
+{
+	assert(key_def->opts.is_unique);
+	/* Sorting doesn't pay off for a handful of keys. */
+	enum { MEMTX_TREE_BATCH_SORT_MIN = 8 };
+	if (key_count < MEMTX_TREE_BATCH_SORT_MIN)
+		return Index::findByKeys(keys, key_count, result);
+
+	struct region *region = &fiber()->gc;
+	size_t region_svp = region_used(region);
+	struct memtx_tree_batch_key *batch = (struct memtx_tree_batch_key *)
+		region_alloc_xc(region, key_count * sizeof(*batch));
+	for (uint32_t i = 0; i < key_count; i++) {
+		memtx_tree_key_data_create(&batch[i].key_data, keys[i],
+					   key_def->part_count, key_def);
+		batch[i].pos = i;
+	}
+	/*
+	 * Look the keys up in the index order, so that each
+	 * descent goes through the blocks which the previous
+	 * one has just brought into the cache.
+	 */
+	qsort_arg(batch, key_count, sizeof(*batch),
+		  memtx_tree_batch_key_qcompare, key_def);
+	for (uint32_t i = 0; i < key_count; i++) {
+		elem_t *res = Traits::find(&tree, &batch[i].key_data);
+		result[batch[i].pos] = res != NULL ?
+				       memtx_tree_elem_tuple(*res) : NULL;
+	}
+	region_truncate(region, region_svp);
+}
+
+template <class Traits>
 struct tuple *
-MemtxTree::replace(struct tuple *old_tuple, struct tuple *new_tuple,
-		   enum dup_replace_mode mode)
+MemtxTreeImpl<Traits>::replace(struct tuple *old_tuple,
+			       struct tuple *new_tuple,
+			       enum dup_replace_mode mode)
 {
 	uint32_t errcode;
 
 	if (new_tuple) {
-		struct tuple *dup_tuple = NULL;
+		elem_t new_elem = tupleElem(new_tuple);
+		elem_t dup_elem = elem_t();
 
 		/* Try to optimistically replace the new_tuple. */
-		int tree_res =
-		memtx_tree_insert(&tree, new_tuple, &dup_tuple);
+		int tree_res = Traits::insert(&tree, new_elem, &dup_elem);
 		if (tree_res) {
-			tnt_raise(OutOfMemory, BPS_TREE_EXTENT_SIZE,
+			tnt_raise(OutOfMemory, MEMTX_EXTENT_SIZE,
 				  "MemtxTree", "replace");
 		}
+		struct tuple *dup_tuple = memtx_tree_elem_tuple(dup_elem);
 
 		errcode = replace_check_dup(old_tuple, dup_tuple, mode);
 
 		if (errcode) {
-			memtx_tree_delete(&tree, new_tuple);
+			Traits::remove(&tree, new_elem);
 			if (dup_tuple)
-				memtx_tree_insert(&tree, dup_tuple, 0);
+				Traits::insert(&tree, dup_elem, 0);
 			struct space *sp = space_cache_find(key_def->space_id);
 			tnt_raise(ClientError, errcode, index_name(this),
 				  space_name(sp));
@@ -263,35 +639,50 @@ MemtxTree::replace(struct tuple *old_tuple, struct tuple *new_tuple,
 		if (dup_tuple)
 			return dup_tuple;
 	}
-	if (old_tuple) {
-		memtx_tree_delete(&tree, old_tuple);
-	}
+	if (old_tuple)
+		Traits::remove(&tree, tupleElem(old_tuple));
 	return old_tuple;
 }
 
+template <class Traits>
+bool
+MemtxTreeImpl<Traits>::replaceInPlace(struct tuple *old_tuple,
+				      struct tuple *new_tuple)
+{
+	/*
+	 * Entries of a non-unique index with equal keys are
+	 * ordered by tuple address, so the new tuple may not fit
+	 * the place of the old one. The tree checks it.
+	 */
+	return Traits::replace_elem(&tree, tupleElem(old_tuple),
+				    tupleElem(new_tuple)) == 0;
+}
+
+template <class Traits>
 struct iterator *
-MemtxTree::allocIterator() const
+MemtxTreeImpl<Traits>::allocIterator() const
 {
-	struct tree_iterator *it = (struct tree_iterator *)
-			calloc(1, sizeof(*it));
+	tree_iterator_t *it = (tree_iterator_t *) calloc(1, sizeof(*it));
 	if (it == NULL) {
-		tnt_raise(OutOfMemory, sizeof(struct tree_iterator),
+		tnt_raise(OutOfMemory, sizeof(tree_iterator_t),
 			  "MemtxTree", "iterator");
 	}
 
 	it->key_def = key_def;
 	it->tree = &tree;
-	it->base.free = tree_iterator_free;
-	it->tree_iterator = memtx_tree_invalid_iterator();
+	it->base.free = tree_iterator_t::free_cb;
+	it->tree_iterator = Traits::invalid_iterator();
 	return (struct iterator *) it;
 }
 
+template <class Traits>
 void
-MemtxTree::initIterator(struct iterator *iterator, enum iterator_type type,
-			const char *key, uint32_t part_count) const
+MemtxTreeImpl<Traits>::initIterator(struct iterator *iterator,
+				    enum iterator_type type,
+				    const char *key, uint32_t part_count) const
 {
 	assert(part_count == 0 || key != NULL);
-	struct tree_iterator *it = tree_iterator(iterator);
+	tree_iterator_t *it = tree_iterator_t::cast(iterator);
 
 	if (part_count == 0) {
 		/*
@@ -305,26 +696,29 @@ MemtxTree::initIterator(struct iterator *iterator, enum iterator_type type,
 		type = iterator_type_is_reverse(type) ? ITER_LE : ITER_GE;
 		key = 0;
 	}
-	it->key_data.key = key;
-	it->key_data.part_count = part_count;
+	memtx_tree_key_data_create(&it->key_data, key, part_count, key_def);
 
 	bool exact = false;
 	if (key == 0) {
 		if (iterator_type_is_reverse(type))
-			it->tree_iterator = memtx_tree_invalid_iterator();
+			it->tree_iterator = Traits::invalid_iterator();
 		else
-			it->tree_iterator = memtx_tree_iterator_first(&tree);
+			it->tree_iterator = Traits::iterator_first(&tree);
 	} else {
 		if (type == ITER_ALL || type == ITER_EQ || type == ITER_GE || type == ITER_LT) {
-			it->tree_iterator = memtx_tree_lower_bound(&tree, &it->key_data, &exact);
+			it->tree_iterator = Traits::lower_bound(&tree,
+							&it->key_data,
+							&exact);
 			if (type == ITER_EQ && !exact) {
-				it->base.next = tree_iterator_dummie;
+				it->base.next = tree_iterator_t::dummie;
 				return;
 			}
 		} else { // ITER_GT, ITER_REQ, ITER_LE
-			it->tree_iterator = memtx_tree_upper_bound(&tree, &it->key_data, &exact);
+			it->tree_iterator = Traits::upper_bound(&tree,
+							&it->key_data,
+							&exact);
 			if (type == ITER_REQ && !exact) {
-				it->base.next = tree_iterator_dummie;
+				it->base.next = tree_iterator_t::dummie;
 				return;
 			}
 		}
@@ -332,97 +726,140 @@ MemtxTree::initIterator(struct iterator *iterator, enum iterator_type type,
 
 	switch (type) {
 	case ITER_EQ:
-		it->base.next = tree_iterator_fwd_check_next_equality;
+		it->base.next = tree_iterator_t::fwd_check_next_equality;
 		break;
 	case ITER_REQ:
-		it->base.next = tree_iterator_bwd_skip_one_check_next_equality;
+		it->base.next =
+			tree_iterator_t::bwd_skip_one_check_next_equality;
 		break;
 	case ITER_ALL:
 	case ITER_GE:
-		it->base.next = tree_iterator_fwd;
+		it->base.next = tree_iterator_t::fwd;
 		break;
 	case ITER_GT:
-		it->base.next = tree_iterator_fwd;
+		it->base.next = tree_iterator_t::fwd;
 		break;
 	case ITER_LE:
-		it->base.next = tree_iterator_bwd_skip_one;
+		it->base.next = tree_iterator_t::bwd_skip_one;
 		break;
 	case ITER_LT:
-		it->base.next = tree_iterator_bwd_skip_one;
+		it->base.next = tree_iterator_t::bwd_skip_one;
 		break;
 	default:
 		return Index::initIterator(iterator, type, key, part_count);
 	}
 }
 
+template <class Traits>
 void
-MemtxTree::beginBuild()
+MemtxTreeImpl<Traits>::beginBuild()
 {
-	assert(memtx_tree_size(&tree) == 0);
+	assert(Traits::size(&tree) == 0);
 }
 
+template <class Traits>
 void
-MemtxTree::reserve(uint32_t size_hint)
+MemtxTreeImpl<Traits>::reserve(uint32_t size_hint)
 {
 	if (size_hint < build_array_alloc_size)
 		return;
-	build_array = (struct tuple**)
-		realloc(build_array, size_hint * sizeof(struct tuple *));
+	build_array = (elem_t *)
+		realloc(build_array, size_hint * sizeof(build_array[0]));
 	build_array_alloc_size = size_hint;
 }
 
+template <class Traits>
 void
-MemtxTree::buildNext(struct tuple *tuple)
+MemtxTreeImpl<Traits>::buildNext(struct tuple *tuple)
 {
 	if (!build_array) {
-		build_array = (struct tuple**)malloc(BPS_TREE_EXTENT_SIZE);
+		build_array = (elem_t *) malloc(MEMTX_EXTENT_SIZE);
 		build_array_alloc_size =
-			BPS_TREE_EXTENT_SIZE / sizeof(struct tuple*);
+			MEMTX_EXTENT_SIZE / sizeof(build_array[0]);
 	}
 	assert(build_array_size <= build_array_alloc_size);
+	assert(!build_array_is_sorted);
 	if (build_array_size == build_array_alloc_size) {
 		build_array_alloc_size = build_array_alloc_size +
 					 build_array_alloc_size / 2;
-		build_array = (struct tuple**)
+		build_array = (elem_t *)
 			realloc(build_array,
 				build_array_alloc_size *
-				sizeof(struct tuple *));
+				sizeof(build_array[0]));
 	}
-	build_array[build_array_size++] = tuple;
+	build_array[build_array_size++] = tupleElem(tuple);
 }
 
+template <class Traits>
 void
-MemtxTree::endBuild()
+MemtxTreeImpl<Traits>::sortBuild()
 {
-	qsort_arg(build_array, build_array_size, sizeof(struct tuple *), memtx_tree_qcompare, key_def);
-	memtx_tree_build(&tree, build_array, build_array_size);
+	qsort_arg(build_array, build_array_size, sizeof(build_array[0]),
+		  memtx_tree_qcompare<elem_t>, key_def);
+	build_array_is_sorted = true;
+}
+
+template <class Traits>
+struct tuple *
+MemtxTreeImpl<Traits>::findBuildDup() const
+{
+	assert(build_array_is_sorted);
+	if (!key_def->opts.is_unique)
+		return NULL;
+	for (size_t i = 1; i < build_array_size; i++) {
+		if (memtx_tree_elem_compare(&build_array[i - 1],
+					    &build_array[i], key_def) == 0)
+			return memtx_tree_elem_tuple(build_array[i]);
+	}
+	return NULL;
+}
+
+template <class Traits>
+void
+MemtxTreeImpl<Traits>::endBuild()
+{
+	if (!build_array_is_sorted)
+		sortBuild();
+	Traits::build(&tree, build_array, build_array_size);
 
 	free(build_array);
 	build_array = 0;
 	build_array_size = 0;
 	build_array_alloc_size = 0;
+	build_array_is_sorted = false;
 }
 
 /**
  * Create a read view for iterator so further index modifications
  * will not affect the iterator iteration.
  */
+template <class Traits>
 void
-MemtxTree::createReadViewForIterator(struct iterator *iterator)
+MemtxTreeImpl<Traits>::createReadViewForIterator(struct iterator *iterator)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
-	struct memtx_tree *tree = (struct memtx_tree *)it->tree;
-	memtx_tree_iterator_freeze(tree, &it->tree_iterator);
+	tree_iterator_t *it = tree_iterator_t::cast(iterator);
+	typename Traits::tree_t *tree = (typename Traits::tree_t *) it->tree;
+	Traits::iterator_freeze(tree, &it->tree_iterator);
 }
 
 /**
  * Destroy a read view of an iterator. Must be called for iterators,
  * for which createReadViewForIterator was called.
  */
+template <class Traits>
 void
-MemtxTree::destroyReadViewForIterator(struct iterator *iterator)
+MemtxTreeImpl<Traits>::destroyReadViewForIterator(struct iterator *iterator)
+{
+	tree_iterator_t *it = tree_iterator_t::cast(iterator);
+	typename Traits::tree_t *tree = (typename Traits::tree_t *) it->tree;
+	Traits::iterator_destroy(tree, &it->tree_iterator);
+}
+
+MemtxTree *
+memtx_tree_new(struct key_def *key_def)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
-	struct memtx_tree *tree = (struct memtx_tree *)it->tree;
-	memtx_tree_iterator_destroy(tree, &it->tree_iterator);
+	if (key_def->opts.hint)
+		return new MemtxTreeImpl<memtx_hint_tree_traits>(key_def);
+	return new MemtxTreeImpl<memtx_tree_traits>(key_def);
 }
+/* }}} */
@@ -33,66 +33,157 @@
 
 #include "memtx_index.h"
 #include "memtx_engine.h"
+#include "tuple_compare.h"
 
 struct tuple;
-struct key_data;
 
-int
-memtx_tree_compare(const struct tuple *a, const struct tuple *b, struct key_def *key_def);
+/**
+ * A hint is an order-preserving 64-bit image of the first key
+ * part of a tuple or a search key: if the hints of two entries
+ * differ, they are ordered the same way as the entries, so the
+ * comparison is done without touching the tuple. Equal hints
+ * mean nothing, and the tuples have to be compared.
+ * See memtx_tree_hint() for details.
+ */
+enum { MEMTX_TREE_HINT_NONE = UINT64_MAX };
+
+/**
+ * An element of a TREE index with key hints: a tuple with a
+ * hint of its key. It takes 16 bytes rather than 8, so only
+ * indexes with key_opts.hint set use it, others store plain
+ * tuple pointers.
+ */
+struct memtx_tree_data {
+	struct tuple *tuple;
+	uint64_t hint;
+};
+
+/**
+ * A search key with its hint. The hint is MEMTX_TREE_HINT_NONE
+ * if the index doesn't use hints.
+ */
+struct memtx_tree_key_data {
+	const char *key;
+	uint32_t part_count;
+	uint64_t hint;
+};
+
+/**
+ * Compare two hints. Return 0 if the hints can't tell the
+ * order of the entries.
+ */
+static inline int
+memtx_tree_hint_compare(uint64_t a, uint64_t b)
+{
+	if (a == b || a == MEMTX_TREE_HINT_NONE || b == MEMTX_TREE_HINT_NONE)
+		return 0;
+	return a < b ? -1 : 1;
+}
+
+static inline int
+memtx_tree_compare(struct tuple *a, struct tuple *b, struct key_def *key_def)
+{
+	int r = tuple_compare(a, b, key_def);
+	if (r == 0 && !key_def->opts.is_unique)
+		r = a < b ? -1 : a > b;
+	return r;
+}
+
+static inline int
+memtx_tree_compare_key(struct tuple *a,
+		       const struct memtx_tree_key_data *key_data,
+		       struct key_def *key_def)
+{
+	return tuple_compare_with_key(a, key_data->key,
+				      key_data->part_count, key_def);
+}
 
-int
-memtx_tree_compare_key(const tuple *a, const key_data *b, struct key_def *key_def);
+static inline int
+memtx_tree_compare(const struct memtx_tree_data *a,
+		   const struct memtx_tree_data *b, struct key_def *key_def)
+{
+	int r = memtx_tree_hint_compare(a->hint, b->hint);
+	if (r != 0)
+		return r;
+	return memtx_tree_compare(a->tuple, b->tuple, key_def);
+}
 
+static inline int
+memtx_tree_compare_key(const struct memtx_tree_data *a,
+		       const struct memtx_tree_key_data *key_data,
+		       struct key_def *key_def)
+{
+	int r = memtx_tree_hint_compare(a->hint, key_data->hint);
+	if (r != 0)
+		return r;
+	return memtx_tree_compare_key(a->tuple, key_data, key_def);
+}
+
+/* A tree of tuple pointers. */
 #define BPS_TREE_NAME memtx_tree
 #define BPS_TREE_BLOCK_SIZE (512)
 #define BPS_TREE_EXTENT_SIZE MEMTX_EXTENT_SIZE
 #define BPS_TREE_COMPARE(a, b, arg) memtx_tree_compare(a, b, arg)
 #define BPS_TREE_COMPARE_KEY(a, b, arg) memtx_tree_compare_key(a, b, arg)
 #define bps_tree_elem_t struct tuple *
-#define bps_tree_key_t struct key_data *
+#define bps_tree_key_t struct memtx_tree_key_data *
 #define bps_tree_arg_t struct key_def *
+#define BPS_TREE_NO_DEBUG
+
+#include "salad/bps_tree.h"
+
+#undef BPS_TREE_NAME
+#undef BPS_TREE_COMPARE
+#undef BPS_TREE_COMPARE_KEY
+#undef bps_tree_elem_t
+
+/* A tree of tuples with hints, for indexes with key_opts.hint. */
+#define BPS_TREE_NAME memtx_hint_tree
+#define BPS_TREE_COMPARE(a, b, arg) memtx_tree_compare(&(a), &(b), arg)
+#define BPS_TREE_COMPARE_KEY(a, b, arg) memtx_tree_compare_key(&(a), b, arg)
+#define bps_tree_elem_t struct memtx_tree_data
 
 #include "salad/bps_tree.h"
 
+#undef BPS_TREE_NAME
+#undef BPS_TREE_BLOCK_SIZE
+#undef BPS_TREE_EXTENT_SIZE
+#undef BPS_TREE_COMPARE
+#undef BPS_TREE_COMPARE_KEY
+#undef bps_tree_elem_t
+#undef bps_tree_key_t
+#undef bps_tree_arg_t
+#undef BPS_TREE_NO_DEBUG
+
+/**
+ * A TREE index. Created with memtx_tree_new(), which picks
+ * a tree of plain tuple pointers or a tree with key hints.
+ */
 class MemtxTree: public MemtxIndex {
 public:
-	MemtxTree(struct key_def *key_def);
-	virtual ~MemtxTree() override;
-
-	virtual void beginBuild() override;
-	virtual void reserve(uint32_t size_hint) override;
-	virtual void buildNext(struct tuple *tuple) override;
-	virtual void endBuild() override;
-	virtual size_t size() const override;
-	virtual struct tuple *random(uint32_t rnd) const override;
-	virtual struct tuple *findByKey(const char *key,
-					uint32_t part_count) const override;
-	virtual struct tuple *replace(struct tuple *old_tuple,
-				      struct tuple *new_tuple,
-				      enum dup_replace_mode mode) override;
-
-	virtual size_t bsize() const override;
-	virtual struct iterator *allocIterator() const override;
-	virtual void initIterator(struct iterator *iterator,
-				  enum iterator_type type,
-				  const char *key,
-				  uint32_t part_count) const override;
-
+	MemtxTree(struct key_def *key_def_arg)
+		: MemtxIndex(key_def_arg) {}
 	/**
-	 * Create a read view for iterator so further index modifications
-	 * will not affect the iterator iteration.
+	 * Sort the tuples added with buildNext(). Only touches
+	 * the build array, so may be called from a thread other
+	 * than tx, e.g. to sort several indexes in parallel.
+	 * endBuild() skips the sort if it was already done.
 	 */
-	virtual void createReadViewForIterator(struct iterator *iterator) override;
+	virtual void sortBuild() = 0;
 	/**
-	 * Destroy a read view of an iterator. Must be called for iterators,
-	 * for which createReadViewForIterator was called.
+	 * Return a tuple which has the same key as another tuple
+	 * in the sorted build array of a unique index, or NULL if
+	 * there is no such tuple. Like sortBuild(), may be called
+	 * from any thread.
 	 */
-	virtual void destroyReadViewForIterator(struct iterator *iterator) override;
-
-// protected:
-	struct memtx_tree tree;
-	struct tuple **build_array;
-	size_t build_array_size, build_array_alloc_size;
+	virtual struct tuple *findBuildDup() const = 0;
 };
 
+/**
+ * Create a TREE index. The index stores key hints next to
+ * tuple pointers if key_def->opts.hint is set.
+ */
+MemtxTree *
+memtx_tree_new(struct key_def *key_def);
+
 #endif /* TARANTOOL_BOX_MEMTX_TREE_H_INCLUDED */
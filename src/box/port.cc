@@ -32,7 +32,9 @@
 #include "tuple.h"
 #include <small/slab_cache.h>
 #include <small/mempool.h>
+#include <small/obuf.h>
 #include <fiber.h>
+#include <msgpuck.h>
 
 static struct mempool port_entry_pool;
 
@@ -41,14 +43,16 @@ port_add_tuple(struct port *port, struct tuple *tuple)
 {
 	struct port_entry *e;
 	if (port->size == 0) {
-		tuple_ref_xc(tuple); /* throws */
+		if (tuple != NULL)
+			tuple_ref_xc(tuple); /* throws */
 		e = &port->first_entry;
 		port->first = port->last = e;
 	} else {
 		e = (struct port_entry *)
 			mempool_alloc_xc(&port_entry_pool); /* throws */
 		try {
-			tuple_ref_xc(tuple); /* throws */
+			if (tuple != NULL)
+				tuple_ref_xc(tuple); /* throws */
 		} catch (Exception *) {
 			mempool_free(&port_entry_pool, e);
 			throw;
@@ -69,38 +73,62 @@ port_create(struct port *port)
 	port->last = NULL;
 }
 
+static inline void
+port_entry_unref(struct port_entry *e)
+{
+	if (e->tuple != NULL)
+		tuple_unref(e->tuple);
+}
+
+/** Store the entry tuple in iproto format, MP_NIL if it is missing. */
+static inline int
+port_entry_dump(struct port_entry *e, struct obuf *out)
+{
+	if (e->tuple != NULL)
+		return tuple_to_obuf(e->tuple, out);
+	char *data = (char *) obuf_alloc(out, mp_sizeof_nil());
+	if (data == NULL) {
+		diag_set(OutOfMemory, mp_sizeof_nil(), "obuf_alloc", "nil");
+		return -1;
+	}
+	mp_encode_nil(data);
+	return 0;
+}
+
 void
 port_destroy(struct port *port)
 {
 	struct port_entry *e = port->first;
 	if (e == NULL)
 		return;
-	tuple_unref(e->tuple);
+	port_entry_unref(e);
 	e = e->next;
 	while (e != NULL) {
 		struct port_entry *cur = e;
 		e = e->next;
-		tuple_unref(cur->tuple);
+		port_entry_unref(cur);
 		mempool_free(&port_entry_pool, cur);
 	}
 }
 
-void
+int
 port_dump(struct port *port, struct obuf *out)
 {
 	struct port_entry *e = port->first;
 	if (e == NULL)
-		return;
-	tuple_to_obuf(e->tuple, out);
-	tuple_unref(e->tuple);
+		return 0;
+	int rc = port_entry_dump(e, out);
+	port_entry_unref(e);
 	e = e->next;
 	while (e != NULL) {
 		struct port_entry *cur = e;
-		tuple_to_obuf(e->tuple, out);
+		if (rc == 0)
+			rc = port_entry_dump(e, out);
 		e = e->next;
-		tuple_unref(cur->tuple);
+		port_entry_unref(cur);
 		mempool_free(&port_entry_pool, cur);
 	}
+	return rc;
 }
 
 void
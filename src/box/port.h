@@ -78,9 +78,18 @@ port_create(struct port *port);
 void
 port_destroy(struct port *port);
 
-void
+/**
+ * Encode all tuples to the buffer and destroy the port.
+ * @retval  0 success
+ * @retval -1 out of memory, the port is destroyed anyway
+ */
+int
 port_dump(struct port *port, struct obuf *out);
 
+/**
+ * Add a tuple to the port. NULL is allowed and is dumped as
+ * MP_NIL, e.g. for a key missing in a multi-get request.
+ */
 void
 port_add_tuple(struct port *port, struct tuple *tuple);
 
@@ -199,6 +199,30 @@ recovery_exit(struct recovery *r)
 	recovery_delete(r);
 }
 
+/**
+ * Apply a row unless it has been applied already.
+ * @retval true the row is applied
+ */
+static bool
+recover_row(struct recovery *r, struct xstream *stream,
+	    struct xrow_header *row)
+{
+	int64_t current_lsn = vclock_get(&r->vclock, row->server_id);
+	if (row->lsn <= current_lsn)
+		return false; /* already applied, skip */
+
+	try {
+		xstream_write(stream, row);
+	} catch (ClientError *e) {
+		say_error("can't apply row: ");
+		e->log();
+		if (r->wal_dir.panic_if_error)
+			throw;
+		return false;
+	}
+	return true;
+}
+
 /**
  * Read all rows in a file starting from the last position.
  * Advance the position. If end of file is reached,
@@ -225,22 +249,10 @@ recover_xlog(struct recovery *r, struct xstream *stream,
 		if (stop_vclock != NULL &&
 		    r->vclock.signature >= stop_vclock->signature)
 			return;
-		int64_t current_lsn = vclock_get(&r->vclock, row.server_id);
-		if (row.lsn <= current_lsn)
-			continue; /* already applied, skip */
-
-		try {
-			xstream_write(stream, &row);
-			++row_count;
-			if (row_count % 100000 == 0)
-				say_info("%.1fM rows processed",
-					 row_count / 1000000.);
-		} catch (ClientError *e) {
-			say_error("can't apply row: ");
-			e->log();
-			if (r->wal_dir.panic_if_error)
-				throw;
-		}
+		if (recover_row(r, stream, &row) &&
+		    ++row_count % 100000 == 0)
+			say_info("%.1fM rows processed",
+				 row_count / 1000000.);
 	}
 }
 
@@ -478,6 +490,35 @@ public:
 	}
 };
 
+/**
+ * Read the rows following the recovery vclock from the
+ * in-memory ring of the WAL writer, if it still has them.
+ *
+ * @retval 0 all rows available at the moment are read
+ * @retval -1 the rows must be read from the WAL files
+ */
+static int
+recover_from_ring(struct recovery *r, struct wal_ring_reader *reader,
+		  struct xstream *stream)
+{
+	if (reader->block == NULL) {
+		if (wal_ring_reader_attach(wal, reader, &r->vclock) != 0)
+			return -1;
+		/*
+		 * No need to keep the current WAL file open:
+		 * should the ring be lost, the right file is
+		 * found by the vclock.
+		 */
+		if (r->cursor.state != XLOG_CURSOR_CLOSED)
+			xlog_cursor_close(&r->cursor, false);
+	}
+	struct xrow_header row;
+	int rc;
+	while ((rc = wal_ring_reader_next(wal, reader, &row)) > 0)
+		recover_row(r, stream, &row);
+	return rc;
+}
+
 static int
 recovery_follow_f(va_list ap)
 {
@@ -487,8 +528,20 @@ recovery_follow_f(va_list ap)
 	fiber_set_user(fiber(), &admin_credentials);
 
 	WalSubscription subscription(r->wal_dir.dirname);
+	struct wal_ring_reader reader;
+	wal_ring_reader_create(&reader);
+	auto reader_guard = make_scoped_guard([&]{
+		wal_ring_reader_destroy(&reader);
+	});
 
 	while (! fiber_is_cancelled()) {
+		/*
+		 * Rows written by the WAL writer of this instance
+		 * are taken from its memory, unless the recovery
+		 * has lagged behind.
+		 */
+		if (recover_from_ring(r, &reader, stream) == 0)
+			goto wait;
 
 		/*
 		 * Recover until there is no new stuff which appeared in
@@ -526,7 +579,9 @@ recovery_follow_f(va_list ap)
 
 		subscription.set_log_path(r->cursor.state != XLOG_CURSOR_CLOSED ?
 					  r->cursor.name: NULL);
-
+wait:
+		/* Nothing more to read, send the buffered rows. */
+		xstream_flush(stream);
 		if (subscription.signaled == false) {
 			/**
 			 * Allow an immediate wakeup/break loop
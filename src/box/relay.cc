@@ -45,12 +45,25 @@
 #include "errinj.h"
 #include "xrow_io.h"
 
+enum {
+	/**
+	 * Rows are sent to the replica as soon as this many
+	 * bytes are buffered, or there are no more rows to
+	 * send at the moment.
+	 */
+	RELAY_FLUSH_SIZE = 128 * 1024
+};
+
 static void
 relay_send_initial_join_row(struct xstream *stream, struct xrow_header *row);
 static void
 relay_send_final_join_row(struct xstream *stream, struct xrow_header *packet);
 static void
 relay_send_subscribe_row(struct xstream *stream, struct xrow_header *row);
+static void
+relay_flush(struct relay *relay);
+static void
+relay_stream_flush(struct xstream *stream);
 
 static inline void
 relay_create(struct relay *relay, int fd, uint64_t sync,
@@ -58,6 +71,7 @@ relay_create(struct relay *relay, int fd, uint64_t sync,
 {
 	memset(relay, 0, sizeof(*relay));
 	xstream_create(&relay->stream, stream_write);
+	relay->stream.flush = relay_stream_flush;
 	coio_init(&relay->io, fd);
 	relay->sync = sync;
 }
@@ -68,6 +82,22 @@ relay_destroy(struct relay *relay)
 	(void) relay;
 }
 
+/**
+ * Create the output buffer of a relay. Must be called
+ * in the thread sending the rows.
+ */
+static inline void
+relay_start_output(struct relay *relay)
+{
+	obuf_create(&relay->out, &cord()->slabc, RELAY_FLUSH_SIZE);
+}
+
+static inline void
+relay_stop_output(struct relay *relay)
+{
+	obuf_destroy(&relay->out);
+}
+
 static inline void
 relay_set_cord_name(int fd)
 {
@@ -85,12 +115,15 @@ relay_initial_join(int fd, uint64_t sync)
 {
 	struct relay relay;
 	relay_create(&relay, fd, sync, relay_send_initial_join_row);
+	relay_start_output(&relay);
 	auto scope_guard = make_scoped_guard([&]{
+		relay_stop_output(&relay);
 		relay_destroy(&relay);
 	});
 
 	assert(relay.stream.write != NULL);
 	engine_join(&relay.stream);
+	relay_flush(&relay);
 }
 
 int
@@ -99,12 +132,17 @@ relay_final_join_f(va_list ap)
 	struct relay *relay = va_arg(ap, struct relay *);
 	coeio_enable();
 	relay_set_cord_name(relay->io.fd);
+	relay_start_output(relay);
+	auto guard = make_scoped_guard([=]{
+		relay_stop_output(relay);
+	});
 
 	/* Send all WALs until stop_vclock */
 	assert(relay->stream.write != NULL);
 	xdir_scan_xc(&relay->r->wal_dir);
 	recover_remaining_wals(relay->r, &relay->stream, &relay->stop_vclock);
 	assert(vclock_compare(&relay->r->vclock, &relay->stop_vclock) == 0);
+	relay_flush(relay);
 	return 0;
 }
 
@@ -147,6 +185,10 @@ relay_subscribe_f(va_list ap)
 	coeio_enable();
 	relay->stream.write = relay_send_subscribe_row;
 	relay_set_cord_name(relay->io.fd);
+	relay_start_output(relay);
+	auto guard = make_scoped_guard([=]{
+		relay_stop_output(relay);
+	});
 	recovery_follow_local(r, &relay->stream, fiber_name(fiber()),
 			      relay->wal_dir_rescan_delay);
 
@@ -235,12 +277,42 @@ relay_subscribe(int fd, uint64_t sync, struct server *server,
 		diag_raise();
 }
 
+/** Write the buffered rows to the replica with a single writev(). */
+static void
+relay_flush(struct relay *relay)
+{
+	size_t size = obuf_size(&relay->out);
+	if (size == 0)
+		return;
+	coio_writev(&relay->io, relay->out.iov, relay->out.pos + 1, size);
+	relay->bytes += size;
+	relay->flushes++;
+	obuf_reset(&relay->out);
+}
+
+static void
+relay_stream_flush(struct xstream *stream)
+{
+	relay_flush(container_of(stream, struct relay, stream));
+}
+
 static void
 relay_send(struct relay *relay, struct xrow_header *packet)
 {
 	packet->sync = relay->sync;
-	coio_write_xrow(&relay->io, packet);
+	struct iovec iov[XROW_IOVMAX];
+	int iovcnt = xrow_to_iovec(packet, iov);
+	for (int i = 0; i < iovcnt; i++) {
+		if (obuf_dup(&relay->out, iov[i].iov_base,
+			     iov[i].iov_len) != iov[i].iov_len) {
+			tnt_raise(OutOfMemory, iov[i].iov_len,
+				  "relay", "output buffer");
+		}
+	}
 	fiber_gc();
+	relay->rows++;
+	if (obuf_size(&relay->out) >= RELAY_FLUSH_SIZE)
+		relay_flush(relay);
 }
 
 static void
@@ -250,6 +322,7 @@ relay_send_initial_join_row(struct xstream *stream, struct xrow_header *row)
 	relay_send(relay, row);
 	ERROR_INJECT(ERRINJ_RELAY,
 	{
+		relay_flush(relay);
 		fiber_sleep(1000.0);
 	});
 }
@@ -266,6 +339,7 @@ relay_send_final_join_row(struct xstream *stream, struct xrow_header *row)
 	relay_send(relay, row);
 	ERROR_INJECT(ERRINJ_RELAY,
 	{
+		relay_flush(relay);
 		fiber_sleep(1000.0);
 	});
 }
@@ -288,6 +362,7 @@ relay_send_subscribe_row(struct xstream *stream, struct xrow_header *packet)
 		relay_send(relay, packet);
 		ERROR_INJECT(ERRINJ_RELAY,
 		{
+			relay_flush(relay);
 			fiber_sleep(1000.0);
 		});
 	}
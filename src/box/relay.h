@@ -30,6 +30,7 @@
  * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
  * SUCH DAMAGE.
  */
+#include <small/obuf.h>
 #include "evio.h"
 #include "fiber.h"
 #include "vclock.h"
@@ -50,6 +51,17 @@ struct relay {
 	struct xstream stream;
 	struct vclock stop_vclock;
 	ev_tstamp wal_dir_rescan_delay;
+	/**
+	 * Rows waiting to be sent. They are written to the
+	 * socket in batches, see relay_flush().
+	 */
+	struct obuf out;
+	/** The number of rows sent, for box.info.replication. */
+	int64_t rows;
+	/** The number of bytes sent. */
+	int64_t bytes;
+	/** The number of writes to the socket. */
+	int64_t flushes;
 };
 
 /**
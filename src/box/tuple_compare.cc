@@ -371,6 +371,27 @@ field_compare<FIELD_TYPE_STRING>(const char **field_a, const char **field_b)
 	return r;
 }
 
+template <>
+inline int
+field_compare<FIELD_TYPE_INTEGER>(const char **field_a, const char **field_b)
+{
+	return mp_compare_integer(*field_a, *field_b);
+}
+
+template <>
+inline int
+field_compare<FIELD_TYPE_NUMBER>(const char **field_a, const char **field_b)
+{
+	return mp_compare_number(*field_a, *field_b);
+}
+
+template <>
+inline int
+field_compare<FIELD_TYPE_SCALAR>(const char **field_a, const char **field_b)
+{
+	return mp_compare_scalar(*field_a, *field_b);
+}
+
 template <int TYPE>
 static inline int
 field_compare_and_next(const char **field_a, const char **field_b);
@@ -526,6 +547,154 @@ static const comparator_signature cmp_arr[] = {
 
 #undef COMPARATOR
 
+/**
+ * Max number of key parts for which comparators specialized
+ * by field types are generated. The number of generated
+ * functions grows as 5^n, so keep it small.
+ */
+enum { TUPLE_COMPARE_BY_TYPE_PARTS_MAX = 3 };
+
+namespace /* local symbols */ {
+
+/**
+ * Create a comparator specialized by the types of the key parts
+ * of \a part. Each type found in the key definition is appended
+ * to TYPES, and once all parts are processed C<TYPES...> is
+ * returned. Returns NULL if there are too many parts or a part
+ * has a type no comparator is generated for.
+ */
+template <typename F, template <int ...> class C, int DEPTH, int ...TYPES>
+struct ComparatorByTypeFactory
+{
+	static F create(const struct key_part *part, uint32_t part_count)
+	{
+		if (part_count == 0)
+			return C<TYPES...>::compare;
+		switch (part->type) {
+		case FIELD_TYPE_UNSIGNED:
+			return ComparatorByTypeFactory<F, C, DEPTH - 1, TYPES...,
+				FIELD_TYPE_UNSIGNED>::create(part + 1,
+							     part_count - 1);
+		case FIELD_TYPE_STRING:
+			return ComparatorByTypeFactory<F, C, DEPTH - 1, TYPES...,
+				FIELD_TYPE_STRING>::create(part + 1,
+							   part_count - 1);
+		case FIELD_TYPE_INTEGER:
+			return ComparatorByTypeFactory<F, C, DEPTH - 1, TYPES...,
+				FIELD_TYPE_INTEGER>::create(part + 1,
+							    part_count - 1);
+		case FIELD_TYPE_NUMBER:
+			return ComparatorByTypeFactory<F, C, DEPTH - 1, TYPES...,
+				FIELD_TYPE_NUMBER>::create(part + 1,
+							   part_count - 1);
+		case FIELD_TYPE_SCALAR:
+			return ComparatorByTypeFactory<F, C, DEPTH - 1, TYPES...,
+				FIELD_TYPE_SCALAR>::create(part + 1,
+							   part_count - 1);
+		default:
+			return NULL;
+		}
+	}
+};
+
+template <typename F, template <int ...> class C, int ...TYPES>
+struct ComparatorByTypeFactory<F, C, 0, TYPES...>
+{
+	static F create(const struct key_part *, uint32_t part_count)
+	{
+		if (part_count == 0)
+			return C<TYPES...>::compare;
+		return NULL;
+	}
+};
+
+template <int TYPE, int ...MORE_TYPES> struct FieldCompareByType { };
+
+/**
+ * Compare the current key part and proceed to the next one.
+ * Field numbers are taken from the key definition, the fields
+ * are fetched with their offsets from the field map.
+ */
+template <int TYPE, int TYPE2, int ...MORE_TYPES>
+struct FieldCompareByType<TYPE, TYPE2, MORE_TYPES...>
+{
+	inline static int compare(const struct tuple_format *format_a,
+				  const char *tuple_a,
+				  const uint32_t *field_map_a,
+				  const struct tuple_format *format_b,
+				  const char *tuple_b,
+				  const uint32_t *field_map_b,
+				  const struct key_part *part)
+	{
+		const char *field_a = tuple_field_raw(format_a, tuple_a,
+						      field_map_a,
+						      part->fieldno);
+		const char *field_b = tuple_field_raw(format_b, tuple_b,
+						      field_map_b,
+						      part->fieldno);
+		int r = field_compare<TYPE>(&field_a, &field_b);
+		if (r != 0)
+			return r;
+		return FieldCompareByType<TYPE2, MORE_TYPES...>::
+			compare(format_a, tuple_a, field_map_a,
+				format_b, tuple_b, field_map_b, part + 1);
+	}
+};
+
+template <int TYPE>
+struct FieldCompareByType<TYPE>
+{
+	inline static int compare(const struct tuple_format *format_a,
+				  const char *tuple_a,
+				  const uint32_t *field_map_a,
+				  const struct tuple_format *format_b,
+				  const char *tuple_b,
+				  const uint32_t *field_map_b,
+				  const struct key_part *part)
+	{
+		const char *field_a = tuple_field_raw(format_a, tuple_a,
+						      field_map_a,
+						      part->fieldno);
+		const char *field_b = tuple_field_raw(format_b, tuple_b,
+						      field_map_b,
+						      part->fieldno);
+		return field_compare<TYPE>(&field_a, &field_b);
+	}
+};
+
+/**
+ * Tuple comparator specialized by key part types, for key
+ * parts with arbitrary field numbers.
+ */
+template <int ...TYPES>
+struct TupleCompareByType
+{
+	static int compare(const struct tuple *tuple_a,
+			   const struct tuple *tuple_b,
+			   const struct key_def *key_def)
+	{
+		return FieldCompareByType<TYPES...>::
+			compare(tuple_format(tuple_a), tuple_data(tuple_a),
+				tuple_field_map(tuple_a),
+				tuple_format(tuple_b), tuple_data(tuple_b),
+				tuple_field_map(tuple_b), key_def->parts);
+	}
+};
+
+/** Key definitions always have parts, only needed to compile. */
+template <>
+struct TupleCompareByType<>
+{
+	static int compare(const struct tuple *, const struct tuple *,
+			   const struct key_def *)
+	{
+		unreachable();
+		return 0;
+	}
+};
+
+} /* end of anonymous namespace */
+
 tuple_compare_t
 tuple_compare_create(const struct key_def *def) {
 	for (uint32_t k = 0; k < sizeof(cmp_arr) / sizeof(cmp_arr[0]); k++) {
@@ -537,6 +706,13 @@ tuple_compare_create(const struct key_def *def) {
 		if (i == def->part_count && cmp_arr[k].p[i * 2] == UINT32_MAX)
 			return cmp_arr[k].f;
 	}
+	if (def->part_count > 0) {
+		tuple_compare_t cmp = ComparatorByTypeFactory<tuple_compare_t,
+			TupleCompareByType, TUPLE_COMPARE_BY_TYPE_PARTS_MAX>::
+				create(def->parts, def->part_count);
+		if (cmp != NULL)
+			return cmp;
+	}
 	return tuple_compare_default;
 }
 
@@ -567,6 +743,27 @@ field_compare_with_key<FIELD_TYPE_STRING>(const char **field, const char **key)
 	return r;
 }
 
+template <>
+inline int
+field_compare_with_key<FIELD_TYPE_INTEGER>(const char **field, const char **key)
+{
+	return mp_compare_integer(*field, *key);
+}
+
+template <>
+inline int
+field_compare_with_key<FIELD_TYPE_NUMBER>(const char **field, const char **key)
+{
+	return mp_compare_number(*field, *key);
+}
+
+template <>
+inline int
+field_compare_with_key<FIELD_TYPE_SCALAR>(const char **field, const char **key)
+{
+	return mp_compare_scalar(*field, *key);
+}
+
 template <int TYPE>
 static inline int
 field_compare_with_key_and_next(const char **field_a, const char **field_b);
@@ -719,6 +916,83 @@ static const comparator_with_key_signature cmp_wk_arr[] = {
 
 #undef KEY_COMPARATOR
 
+namespace /* local symbols */ {
+
+template <int TYPE, int ...MORE_TYPES> struct FieldCompareWithKeyByType { };
+
+template <int TYPE, int TYPE2, int ...MORE_TYPES>
+struct FieldCompareWithKeyByType<TYPE, TYPE2, MORE_TYPES...>
+{
+	inline static int compare(const struct tuple_format *format,
+				  const char *tuple, const uint32_t *field_map,
+				  const char *key, uint32_t part_count,
+				  const struct key_part *part)
+	{
+		const char *field = tuple_field_raw(format, tuple, field_map,
+						    part->fieldno);
+		/* Comparison of a string moves the pointer. */
+		const char *key_field = key;
+		int r = field_compare_with_key<TYPE>(&field, &key_field);
+		if (r != 0 || part_count == 1)
+			return r;
+		mp_next(&key);
+		return FieldCompareWithKeyByType<TYPE2, MORE_TYPES...>::
+			compare(format, tuple, field_map, key,
+				part_count - 1, part + 1);
+	}
+};
+
+template <int TYPE>
+struct FieldCompareWithKeyByType<TYPE>
+{
+	inline static int compare(const struct tuple_format *format,
+				  const char *tuple, const uint32_t *field_map,
+				  const char *key, uint32_t,
+				  const struct key_part *part)
+	{
+		const char *field = tuple_field_raw(format, tuple, field_map,
+						    part->fieldno);
+		return field_compare_with_key<TYPE>(&field, &key);
+	}
+};
+
+/**
+ * Tuple with key comparator specialized by key part types,
+ * for key parts with arbitrary field numbers.
+ */
+template <int ...TYPES>
+struct TupleCompareWithKeyByType
+{
+	static int
+	compare(const struct tuple *tuple, const char *key,
+		uint32_t part_count, const struct key_def *key_def)
+	{
+		/* Part count can be 0 in wildcard searches. */
+		if (part_count == 0)
+			return 0;
+		assert(part_count <= key_def->part_count);
+		return FieldCompareWithKeyByType<TYPES...>::
+			compare(tuple_format(tuple), tuple_data(tuple),
+				tuple_field_map(tuple), key, part_count,
+				key_def->parts);
+	}
+};
+
+/** Key definitions always have parts, only needed to compile. */
+template <>
+struct TupleCompareWithKeyByType<>
+{
+	static int
+	compare(const struct tuple *, const char *, uint32_t,
+		const struct key_def *)
+	{
+		unreachable();
+		return 0;
+	}
+};
+
+} /* end of anonymous namespace */
+
 tuple_compare_with_key_t
 tuple_compare_with_key_create(const struct key_def *def)
 {
@@ -738,6 +1012,14 @@ tuple_compare_with_key_create(const struct key_def *def)
 		if (i == def->part_count)
 			return cmp_wk_arr[k].f;
 	}
+	if (def->part_count > 0) {
+		tuple_compare_with_key_t cmp = ComparatorByTypeFactory<
+			tuple_compare_with_key_t, TupleCompareWithKeyByType,
+			TUPLE_COMPARE_BY_TYPE_PARTS_MAX>::
+				create(def->parts, def->part_count);
+		if (cmp != NULL)
+			return cmp;
+	}
 	return tuple_compare_with_key_default;
 }
 
@@ -37,6 +37,16 @@ static intptr_t recycled_format_ids = FORMAT_ID_NIL;
 
 static uint32_t formats_size = 0, formats_capacity = 0;
 
+/** Number of threads reading tuple_formats, see tuple_formats_pin(). */
+static int formats_pin_count = 0;
+/**
+ * Tables replaced while tuple_formats was pinned. The capacity
+ * doubles on each growth and is bounded by FORMAT_ID_MAX, so
+ * there can't be many of them.
+ */
+static struct tuple_format **formats_retired[24];
+static int formats_retired_count = 0;
+
 
 /** Extract all available type info from keys. */
 static int
@@ -80,9 +90,28 @@ tuple_format_register(struct tuple_format *format)
 			uint32_t new_capacity = formats_capacity ?
 						formats_capacity * 2 : 16;
 			struct tuple_format **formats;
-			formats = (struct tuple_format **)
-				realloc(tuple_formats, new_capacity *
-						       sizeof(tuple_formats[0]));
+			if (formats_pin_count > 0) {
+				/*
+				 * Other threads may be reading the
+				 * table: keep it until unpinned.
+				 */
+				assert(formats_retired_count <
+				       (int) lengthof(formats_retired));
+				formats = (struct tuple_format **)
+					malloc(new_capacity *
+					       sizeof(tuple_formats[0]));
+				if (formats != NULL) {
+					memcpy(formats, tuple_formats,
+					       formats_size *
+					       sizeof(tuple_formats[0]));
+					int i = formats_retired_count++;
+					formats_retired[i] = tuple_formats;
+				}
+			} else {
+				formats = (struct tuple_format **)
+					realloc(tuple_formats, new_capacity *
+						sizeof(tuple_formats[0]));
+			}
 			if (formats == NULL) {
 				diag_set(OutOfMemory,
 					 sizeof(struct tuple_format), "malloc",
@@ -104,6 +133,23 @@ tuple_format_register(struct tuple_format *format)
 	return 0;
 }
 
+void
+tuple_formats_pin(void)
+{
+	formats_pin_count++;
+}
+
+void
+tuple_formats_unpin(void)
+{
+	assert(formats_pin_count > 0);
+	if (--formats_pin_count > 0)
+		return;
+	for (int i = 0; i < formats_retired_count; i++)
+		free(formats_retired[i]);
+	formats_retired_count = 0;
+}
+
 static void
 tuple_format_deregister(struct tuple_format *format)
 {
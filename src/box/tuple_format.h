@@ -151,6 +151,20 @@ tuple_format_by_id(uint32_t tuple_format_id)
 	return tuple_formats[tuple_format_id];
 }
 
+/**
+ * Pin the table of tuple formats while a thread other than tx
+ * reads it, e.g. to compare tuples: until unpinned, the table
+ * isn't freed when a new format makes it grow. The formats
+ * themselves must be kept alive by the tuples being read.
+ * Must be called from the tx thread only.
+ */
+void
+tuple_formats_pin(void);
+
+/** Release the table of tuple formats pinned by tuple_formats_pin(). */
+void
+tuple_formats_unpin(void);
+
 /** Delete a format with zero ref count. */
 void
 tuple_format_delete(struct tuple_format *format);
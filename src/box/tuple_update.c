@@ -93,6 +93,12 @@
  * it disappears from the rope and all subsequent operations
  * on this field number instead affect the field following the
  * deleted one.
+ *
+ * The rope is not needed at all when the operations only replace
+ * existing fields with values of the same encoded size, e.g.
+ * increment a counter: then the old tuple is copied with a single
+ * memcpy() and the changed fields are overwritten in the copy,
+ * see update_do_ops_in_place().
  */
 
 /** Update internal state */
@@ -1064,6 +1070,141 @@ update_read_ops(struct tuple_update *update, const char *expr,
 	return 0;
 }
 
+enum {
+	/** Max number of operations done by update_do_ops_in_place(). */
+	UPDATE_IN_PLACE_OPS_MAX = 8,
+};
+
+/**
+ * Try to do the update without building a rope. If every
+ * operation changes a single existing field and the new value
+ * has the same encoded size as the old one, which is usually the
+ * case for counter increments and flag sets, the new tuple is a
+ * copy of the old one with the changed fields patched in place.
+ *
+ * The operations are left intact, so that the update can be
+ * retried with the rope. Any error is left to the rope path too,
+ * so errors are reported the same way in both cases.
+ *
+ * @retval  0 success, the new tuple is returned in *p_buffer
+ * @retval  1 the fast path is not applicable
+ * @retval -1 out of memory
+ */
+static int
+update_do_ops_in_place(struct tuple_update *update, const char *old_data,
+		       const char *old_data_end, const char **p_buffer,
+		       uint32_t *p_tuple_len)
+{
+	if (update->op_count > UPDATE_IN_PLACE_OPS_MAX)
+		return 1;
+	struct {
+		/** Subject field no, adjusted to the field count. */
+		int32_t field_no;
+		/** The field in the old tuple. */
+		const char *field;
+		/** The new value. */
+		union update_op_arg arg;
+	} patch[UPDATE_IN_PLACE_OPS_MAX];
+	const char *data = old_data;
+	int32_t field_count = mp_decode_array(&data);
+	int32_t field_no_max = 0;
+	for (uint32_t i = 0; i < update->op_count; i++) {
+		struct update_op *op = &update->ops[i];
+		switch (op->opcode) {
+		case '=':
+		case '+':
+		case '-':
+		case '&':
+		case '|':
+		case '^':
+			break;
+		default:
+			return 1;
+		}
+		int32_t field_no = op->field_no;
+		if (field_no < 0)
+			field_no += field_count;
+		if (field_no < 0 || field_no >= field_count)
+			return 1;
+		for (uint32_t j = 0; j < i; j++) {
+			if (patch[j].field_no == field_no)
+				return 1;
+		}
+		patch[i].field_no = field_no;
+		field_no_max = MAX(field_no_max, field_no);
+	}
+	/* Locate all changed fields in a single pass. */
+	for (int32_t field_no = 0; field_no <= field_no_max; field_no++) {
+		for (uint32_t i = 0; i < update->op_count; i++) {
+			if (patch[i].field_no == field_no)
+				patch[i].field = data;
+		}
+		mp_next(&data);
+	}
+	for (uint32_t i = 0; i < update->op_count; i++) {
+		struct update_op *op = &update->ops[i];
+		const char *old = patch[i].field;
+		const char *old_end = old;
+		mp_next(&old_end);
+		uint32_t new_field_len;
+		switch (op->opcode) {
+		case '=':
+			patch[i].arg.set = op->arg.set;
+			new_field_len = op->arg.set.length;
+			break;
+		case '+':
+		case '-': {
+			enum mp_type type = mp_typeof(*old);
+			if (type != MP_UINT && type != MP_INT &&
+			    type != MP_DOUBLE && type != MP_FLOAT)
+				return 1;
+			struct op_arith_arg left_arg;
+			if (mp_read_arith_arg(update->index_base, op, &old,
+					      &left_arg))
+				return 1;
+			uint32_t field_id = update->index_base +
+					   patch[i].field_no;
+			if (make_arith_operation(left_arg, op->arg.arith,
+						 op->opcode, field_id,
+						 &patch[i].arg.arith))
+				return 1;
+			new_field_len =
+				mp_sizeof_op_arith_arg(patch[i].arg.arith);
+			break;
+		}
+		default: {
+			if (mp_typeof(*old) != MP_UINT)
+				return 1;
+			uint64_t val = mp_decode_uint(&old);
+			if (op->opcode == '&')
+				val &= op->arg.bit.val;
+			else if (op->opcode == '^')
+				val ^= op->arg.bit.val;
+			else
+				val |= op->arg.bit.val;
+			patch[i].arg.bit.val = val;
+			new_field_len = mp_sizeof_uint(val);
+			break;
+		}
+		}
+		if (new_field_len != (uint32_t) (old_end - patch[i].field))
+			return 1;
+	}
+	uint32_t tuple_len = old_data_end - old_data;
+	char *buffer = (char *) update->alloc(update->alloc_ctx, tuple_len);
+	if (buffer == NULL)
+		return -1;
+	memcpy(buffer, old_data, tuple_len);
+	for (uint32_t i = 0; i < update->op_count; i++) {
+		struct update_op *op = &update->ops[i];
+		op->meta->store(&patch[i].arg, patch[i].field,
+				buffer + (patch[i].field - old_data));
+	}
+	*p_buffer = buffer;
+	*p_tuple_len = tuple_len;
+	return 0;
+}
+
 static int
 update_do_ops(struct tuple_update *update, const char *old_data,
 	      const char *old_data_end)
@@ -1148,11 +1289,19 @@ tuple_update_execute(tuple_update_alloc_func alloc, void *alloc_ctx,
 
 	if (update_read_ops(&update, expr, expr_end))
 		return NULL;
-	if (update_do_ops(&update, old_data, old_data_end))
-		return NULL;
 	if (column_mask)
 		*column_mask = update.column_mask;
 
+	const char *new_data;
+	int rc = update_do_ops_in_place(&update, old_data, old_data_end,
+					&new_data, p_tuple_len);
+	if (rc < 0)
+		return NULL;
+	if (rc == 0)
+		return new_data;
+
+	if (update_do_ops(&update, old_data, old_data_end))
+		return NULL;
 	return update_finish(&update, p_tuple_len);
 }
 
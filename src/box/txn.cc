@@ -85,6 +85,7 @@ txn_stmt_new(struct txn *txn)
 	stmt->old_tuple = NULL;
 	stmt->new_tuple = NULL;
 	stmt->engine_savepoint = NULL;
+	stmt->column_mask = UINT64_MAX;
 	stmt->row = NULL;
 
 	stailq_add_tail_entry(&txn->stmts, stmt, next);
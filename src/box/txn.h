@@ -60,6 +60,13 @@ struct txn_stmt {
 	struct tuple *new_tuple;
 	/** Engine savepoint for the start of this statement. */
 	void *engine_savepoint;
+	/**
+	 * Bitmask of the fields changed by an UPDATE: bit 'n'
+	 * is set if field 'n' may differ between old_tuple and
+	 * new_tuple (@sa tuple_update_execute()). UINT64_MAX
+	 * for other statements.
+	 */
+	uint64_t column_mask;
 	/** Redo info: the binary log row */
 	struct xrow_header *row;
 };
@@ -77,6 +77,8 @@
 
 #define HEAP_FORWARD_DECLARATION
 #include "salad/heap.h"
+#include "salad/bloom.h"
+#include "third_party/PMurHash.h"
 
 #define vy_cmp(a, b) \
 	((a) == (b) ? 0 : (((a) > (b)) ? 1 : -1))
@@ -95,6 +97,7 @@ struct vy_scheduler;
 struct vy_task;
 struct vy_stat;
 struct vy_squash_queue;
+struct vy_page_cache;
 
 /**
  * Global configuration of an entire vinyl instance (env object).
@@ -104,6 +107,69 @@ struct vy_conf {
 	char *path;
 	/* memory */
 	uint64_t memory_limit;
+	/* size of the shared page cache */
+	uint64_t page_cache;
+	/* number of pages to read ahead on sequential scans */
+	uint32_t read_ahead;
+	/* max rate of compaction disk writes, bytes per second */
+	uint64_t compact_bandwidth;
+};
+
+/**
+ * Token bucket limiting the rate of disk writes. Shared by
+ * all worker threads, hence protected by a mutex.
+ */
+struct vy_rate_limit {
+	pthread_mutex_t mutex;
+	/** Max rate, in bytes per second. 0 means unlimited. */
+	double rate;
+	/** Number of bytes that can be written without waiting. */
+	double value;
+	/** Time when the value was last updated. */
+	double timestamp;
+};
+
+/**
+ * Threads compressing pages of runs written by compaction, so
+ * that a compaction is a pipeline: the worker merges pages and
+ * writes them in order, while they are encoded and compressed
+ * in parallel. Shared by all workers.
+ */
+struct vy_compress_pool {
+	pthread_mutex_t mutex;
+	/** Signaled when there is a page to compress or on stop. */
+	pthread_cond_t worker_cond;
+	/** Signaled when a page is compressed. */
+	pthread_cond_t ready_cond;
+	/** Pages to compress, taken by threads. */
+	struct stailq input;
+	/** Set to stop the threads. */
+	bool is_stopped;
+	/** Compression threads. */
+	struct cord *workers;
+	int worker_count;
+};
+
+/**
+ * State shared by tuple caches of all indexes, see
+ * vy_cache_entry.
+ */
+struct vy_tuple_cache {
+	/** All cached statements, most recently used first */
+	struct rlist lru;
+	/** Memory used by cached statements */
+	size_t used;
+	/**
+	 * Memory quota. The cache may only use memory that is
+	 * left under the quota watermark by in-memory indexes.
+	 */
+	struct vy_quota *quota;
+	/** Number of reads answered by the cache */
+	uint64_t hit;
+	/** Number of reads that had to merge sources */
+	uint64_t miss;
+	/** Number of statements evicted from the cache */
+	uint64_t evict;
 };
 
 struct vy_env {
@@ -125,6 +191,10 @@ struct vy_env {
 	struct vy_stat      *stat;
 	/** Upsert squash queue */
 	struct vy_squash_queue *squash_queue;
+	/** Cache of decompressed run pages */
+	struct vy_page_cache *page_cache;
+	/** Cache of merged read results */
+	struct vy_tuple_cache tuple_cache;
 	/** Mempool for struct vy_cursor */
 	struct mempool      cursor_pool;
 	/** Mempool for struct vy_page_read_task */
@@ -135,6 +205,13 @@ struct vy_env {
 	pthread_key_t       zdctx_key;
 	/** Memory quota */
 	struct vy_quota     quota;
+	/**
+	 * Limits the disk bandwidth used by compaction, so that
+	 * dumps, which reclaim memory, don't starve behind it.
+	 */
+	struct vy_rate_limit compact_rate_limit;
+	/** Threads compressing pages written by compaction. */
+	struct vy_compress_pool compress_pool;
 	/** Timer for updating quota watermark. */
 	ev_timer            quota_timer;
 	/**
@@ -213,6 +290,10 @@ struct vy_stat {
 	 */
 	struct histogram *dump_bw;
 	int64_t dump_total;
+	/** Time transactions spent throttled by memory quota. */
+	struct vy_latency throttle_latency;
+	/** Histogram of throttle time, in milliseconds. */
+	struct histogram *throttle_hist;
 };
 
 static struct vy_stat *
@@ -250,8 +331,21 @@ vy_stat_new()
 	 */
 	histogram_collect(s->dump_bw, 10 * MB);
 
+	static int64_t throttle_buckets[] = {
+		1, 2, 5, 10, 20, 50, 100, 200, 500,
+		1000, 2000, 5000, 10000,
+	};
+	s->throttle_hist = histogram_new(throttle_buckets,
+					 lengthof(throttle_buckets));
+	if (s->throttle_hist == NULL) {
+		histogram_delete(s->dump_bw);
+		free(s);
+		return NULL;
+	}
+
 	s->rmean = rmean_new(vy_stat_strings, VY_STAT_LAST);
 	if (s->rmean == NULL) {
+		histogram_delete(s->throttle_hist);
 		histogram_delete(s->dump_bw);
 		free(s);
 		return NULL;
@@ -262,6 +356,7 @@ vy_stat_new()
 static void
 vy_stat_delete(struct vy_stat *s)
 {
+	histogram_delete(s->throttle_hist);
 	histogram_delete(s->dump_bw);
 	rmean_delete(s->rmean);
 	free(s);
@@ -303,6 +398,13 @@ vy_stat_dump(struct vy_stat *s, ev_tstamp time, size_t written)
 	s->dump_total += written;
 }
 
+static void
+vy_stat_throttle(struct vy_stat *s, ev_tstamp time)
+{
+	vy_latency_update(&s->throttle_latency, time);
+	histogram_collect(s->throttle_hist, time * 1000);
+}
+
 static int64_t
 vy_stat_dump_bandwidth(struct vy_stat *s)
 {
@@ -556,6 +658,10 @@ struct vy_run_info {
 	uint64_t  total;
 	/** Pages meta. */
 	struct vy_page_info *page_infos;
+	/** Set if the run has a bloom filter. */
+	bool has_bloom;
+	/** Bloom filter of all keys in the run. */
+	struct bloom bloom;
 };
 
 struct vy_page_info {
@@ -577,6 +683,27 @@ struct vy_page_info {
 	struct tuple *min_key;
 	/* row index offset in page */
 	uint32_t row_index_offset;
+	/* page data format, see enum vy_page_format */
+	uint32_t format;
+};
+
+/**
+ * Format of page data in a run file. The format is stored in
+ * the page information, so runs written in an older format stay
+ * readable.
+ */
+enum vy_page_format {
+	/**
+	 * A sequence of xrows, one per statement, followed by
+	 * the row index with offsets of all statements.
+	 */
+	VY_PAGE_FORMAT_XROW = 0,
+	/**
+	 * A single blob of packed entries, followed by the row
+	 * index with offsets of restart points. See
+	 * vy_page_encoder_add() for the entry layout.
+	 */
+	VY_PAGE_FORMAT_PACKED = 1,
 };
 
 static int
@@ -628,6 +755,13 @@ struct vy_range {
 	struct rlist runs;
 	/** Number of entries in the ->runs list. */
 	int run_count;
+	/**
+	 * Number of newest runs that should be merged by the next
+	 * compaction of this range, 0 if the range doesn't need
+	 * compaction. Set by vy_range_update_compact_priority()
+	 * according to the index compaction policy.
+	 */
+	int compact_priority;
 	/** Active in-memory index, i.e. the one used for insertions. */
 	struct vy_mem *mem;
 	/**
@@ -655,6 +789,9 @@ struct vy_range {
 
 typedef rb_tree(struct vy_range) vy_range_tree_t;
 
+struct vy_cache_entry;
+typedef rb_tree(struct vy_cache_entry) vy_cache_tree_t;
+
 /**
  * A single operation made by a transaction:
  * a single read or write in a vy_index.
@@ -734,12 +871,24 @@ struct vy_index {
 	 */
 	read_set_t read_set;
 	vy_range_tree_t tree;
+	/** Cache of merged read results, see vy_cache_entry. */
+	vy_cache_tree_t cache;
+	/**
+	 * Incremented on each write to the index. Used to
+	 * discard read results that raced with a write.
+	 */
+	uint32_t cache_version;
 	/** Number of ranges in this index. */
 	int range_count;
 	/** Number of runs in all ranges. */
 	int run_count;
 	/** Number of pages in all runs. */
 	int page_count;
+	/**
+	 * Number of run lookups avoided thanks to
+	 * run bloom filters.
+	 */
+	uint64_t bloom_hit;
 	/**
 	 * Total number of statements in this index,
 	 * stored both in memory and on disk.
@@ -747,6 +896,10 @@ struct vy_index {
 	uint64_t stmt_count;
 	/** Size of data stored on disk. */
 	uint64_t size;
+	/** Number of bytes written to disk by dumps. */
+	uint64_t dump_bytes;
+	/** Number of bytes written to disk by compactions. */
+	uint64_t compact_bytes;
 	/** Amount of memory used by in-memory indexes. */
 	uint64_t used;
 	/** Histogram of number of runs in range. */
@@ -1046,6 +1199,11 @@ struct vy_read_iterator {
 	struct tuple *curr_stmt;
 	/* is lazy search started */
 	bool search_started;
+	/*
+	 * curr_stmt was taken from the cache, so the merge
+	 * iterator has to be restored before it is used.
+	 */
+	bool need_restore;
 };
 
 /**
@@ -1513,8 +1671,11 @@ vy_run_total(struct vy_run *run)
 static uint64_t
 vy_run_size(struct vy_run *run)
 {
-	return sizeof(run->info) +
-	       run->info.count * sizeof(struct vy_page_info);
+	uint64_t size = sizeof(run->info) +
+			run->info.count * sizeof(struct vy_page_info);
+	if (run->info.has_bloom)
+		size += bloom_store_size(&run->info.bloom);
+	return size;
 }
 
 static struct vy_run *
@@ -1545,6 +1706,8 @@ vy_run_delete(struct vy_run *run)
 			vy_page_info_destroy(run->info.page_infos + page_no);
 		free(run->info.page_infos);
 	}
+	if (run->info.has_bloom)
+		bloom_destroy(&run->info.bloom);
 	TRASH(run);
 	free(run);
 }
@@ -1564,6 +1727,180 @@ vy_run_unref(struct vy_run *run)
 		vy_run_delete(run);
 }
 
+/** {{{ Run bloom filter */
+
+enum {
+	/** Seed of bloom filter key hashes. */
+	VY_BLOOM_SEED = 13U
+};
+
+/**
+ * False positive rate of run bloom filters. Takes about
+ * 7.5 bits per key.
+ */
+static const double VY_BLOOM_FPR = 0.05;
+
+/**
+ * Return the number of leading key parts hashed into bloom
+ * filters of the index runs, or 0 if the index runs have no
+ * bloom filters.
+ *
+ * Only the parts declared by the user are hashed, so that
+ * a filter can be used both for a full key lookup and for
+ * a unique secondary key check, which looks up a key without
+ * the primary key parts.
+ *
+ * Equal keys must have equal hashes, so bloom filters are
+ * only built if all of the parts have a type which doesn't
+ * allow different MsgPack encodings of the same value,
+ * integer width aside.
+ */
+static uint32_t
+vy_index_bloom_part_count(const struct vy_index *index)
+{
+	uint32_t part_count = index->user_key_def->part_count;
+	/*
+	 * The user-defined parts come first in the key_def
+	 * of a secondary index as well.
+	 */
+	for (uint32_t i = 0; i < part_count; i++) {
+		switch (index->key_def->parts[i].type) {
+		case FIELD_TYPE_UNSIGNED:
+		case FIELD_TYPE_INTEGER:
+		case FIELD_TYPE_STRING:
+			break;
+		default:
+			return 0;
+		}
+	}
+	return part_count;
+}
+
+/**
+ * Feed a key field to the hash and advance the field pointer.
+ * Integers are hashed by value rather than by their MsgPack
+ * representation, strings are hashed without the header.
+ */
+static inline void
+vy_bloom_hash_field(uint32_t *ph, uint32_t *pcarry, uint32_t *total_size,
+		    const char **field, enum field_type type)
+{
+	const char *data;
+	uint32_t size;
+	uint64_t value;
+	if (type == FIELD_TYPE_STRING) {
+		data = mp_decode_str(field, &size);
+	} else {
+		assert(type == FIELD_TYPE_UNSIGNED ||
+		       type == FIELD_TYPE_INTEGER);
+		if (mp_typeof(**field) == MP_UINT)
+			value = mp_decode_uint(field);
+		else
+			value = (uint64_t) mp_decode_int(field);
+		data = (const char *) &value;
+		size = sizeof(value);
+	}
+	PMurHash32_Process(ph, pcarry, data, size);
+	*total_size += size;
+}
+
+/**
+ * Calculate the bloom filter hash of the first part_count
+ * key parts of a statement. The statement is either a tuple
+ * (REPLACE, UPSERT) or a key (DELETE, SELECT).
+ */
+static bloom_hash_t
+vy_stmt_bloom_hash(const struct tuple *stmt, const struct key_def *key_def,
+		   uint32_t part_count)
+{
+	uint32_t h = VY_BLOOM_SEED;
+	uint32_t carry = 0;
+	uint32_t total_size = 0;
+	const struct key_part *part = key_def->parts;
+	if (vy_stmt_type(stmt) == IPROTO_REPLACE ||
+	    vy_stmt_type(stmt) == IPROTO_UPSERT) {
+		for (uint32_t i = 0; i < part_count; i++, part++) {
+			const char *field = tuple_field(stmt, part->fieldno);
+			vy_bloom_hash_field(&h, &carry, &total_size, &field,
+					    part->type);
+		}
+	} else {
+		const char *field = tuple_data(stmt);
+		uint32_t field_count = mp_decode_array(&field);
+		assert(field_count >= part_count);
+		(void) field_count;
+		for (uint32_t i = 0; i < part_count; i++, part++)
+			vy_bloom_hash_field(&h, &carry, &total_size, &field,
+					    part->type);
+	}
+	return PMurHash32_Result(h, carry, total_size);
+}
+
+/**
+ * Check if a run may contain statements with the given key.
+ * Always true if the run has no bloom filter or the key is
+ * too short to be checked against it.
+ */
+static bool
+vy_run_bloom_possible_has(const struct vy_run *run,
+			  const struct vy_index *index,
+			  const struct tuple *key)
+{
+	if (!run->info.has_bloom)
+		return true;
+	uint32_t part_count = vy_index_bloom_part_count(index);
+	if (part_count == 0 || tuple_field_count(key) < part_count)
+		return true;
+	bloom_hash_t hash = vy_stmt_bloom_hash(key, index->key_def,
+					       part_count);
+	return bloom_possible_has(&run->info.bloom, hash);
+}
+
+/**
+ * Remember the hash of a statement written to a run to build
+ * the run bloom filter when the run is complete. Versions of
+ * the same key are written one after another, so a hash equal
+ * to the previous one is skipped.
+ */
+static int
+vy_run_bloom_add_stmt(struct ibuf *hashes, const struct tuple *stmt,
+		      const struct key_def *key_def, uint32_t part_count)
+{
+	bloom_hash_t hash = vy_stmt_bloom_hash(stmt, key_def, part_count);
+	if (ibuf_used(hashes) > 0 &&
+	    ((bloom_hash_t *) hashes->wpos)[-1] == hash)
+		return 0;
+	bloom_hash_t *slot = ibuf_alloc(hashes, sizeof(hash));
+	if (slot == NULL) {
+		diag_set(OutOfMemory, sizeof(hash), "ibuf", "bloom hash");
+		return -1;
+	}
+	*slot = hash;
+	return 0;
+}
+
+/**
+ * Build the bloom filter of a run from the collected hashes
+ * of its keys.
+ */
+static int
+vy_run_bloom_build(struct vy_run_info *run_info, struct ibuf *hashes)
+{
+	assert(!run_info->has_bloom);
+	uint32_t count = ibuf_used(hashes) / sizeof(bloom_hash_t);
+	if (bloom_create(&run_info->bloom, count, VY_BLOOM_FPR) != 0) {
+		diag_set(OutOfMemory, count, "malloc", "struct bloom");
+		return -1;
+	}
+	const bloom_hash_t *hash = (const bloom_hash_t *) hashes->rpos;
+	for (uint32_t i = 0; i < count; i++)
+		bloom_add(&run_info->bloom, hash[i]);
+	run_info->has_bloom = true;
+	return 0;
+}
+
+/** Run bloom filter }}} */
+
 enum vy_file_type {
 	VY_FILE_INDEX,
 	VY_FILE_RUN,
@@ -1971,28 +2308,6 @@ vy_range_is_adjacent(struct vy_range *a, struct vy_range *b,
 	return vy_key_compare(a->end, b->begin, key_def) == 0;
 }
 
-/* dump statement to the run page buffers (stmt header and data) */
-static int
-vy_run_dump_stmt(struct tuple *value, struct xlog *data_xlog,
-		 struct vy_page_info *info, const struct key_def *key_def)
-{
-	struct xrow_header xrow;
-	if (vy_stmt_encode(value, key_def, &xrow) < 0)
-		return -1;
-	ssize_t row_size;
-	if ((row_size = xlog_write_row(data_xlog, &xrow)) < 0)
-		return -1;
-
-	info->unpacked_size += row_size;
-
-	++info->count;
-	if (vy_stmt_lsn(value) > info->max_lsn)
-		info->max_lsn = vy_stmt_lsn(value);
-	if (vy_stmt_lsn(value) < info->min_lsn)
-		info->min_lsn = vy_stmt_lsn(value);
-	return 0;
-}
-
 struct vy_write_iterator;
 
 static struct vy_write_iterator *
@@ -2074,136 +2389,885 @@ vy_row_index_encode(const uint32_t *row_index, uint32_t count,
 	return xrow->bodycnt >= 0 ? 0 : -1;
 }
 
+/* {{{ Packed page format */
+
+enum {
+	/** Number of entries between two restart points. */
+	VY_PAGE_RESTART_INTERVAL = 16,
+	/** Max size of an entry header, see vy_page_encoder_add(). */
+	VY_PAGE_ENTRY_HEADER_MAX = 5 + 5 + 10 + 1 + 1 + 5 + 5,
+};
+
 /**
- * Write statements from the iterator to a new page in the run,
- * update page and run statistics.
- *
- *  @retval  1 all is ok, the iterator is finished
- *  @retval  0 all is ok, the iterator isn't finished
- *  @retval -1 error occurred
+ * How the statement data is stored in a packed entry, relative
+ * to the key of the entry.
  */
-static int
-vy_run_write_page(struct vy_run_info *run_info, struct xlog *data_xlog,
-		  struct vy_write_iterator *wi, const struct tuple *split_key,
-		  uint32_t *page_info_capacity, struct tuple **curr_stmt,
-		  const struct key_def *key_def)
-{
-	assert(curr_stmt);
-	if (*curr_stmt == NULL)
-		return 1;
-
-	/* row offsets accumulator */
-	struct ibuf row_index_buf;
-	ibuf_create(&row_index_buf, &cord()->slabc, sizeof(uint32_t) * 4096);
+enum vy_page_value_kind {
+	/** The data is the key itself, nothing is stored. */
+	VY_PAGE_VALUE_KEY = 0,
+	/**
+	 * The key fields open the data: only the array header
+	 * and the fields following the key are stored.
+	 */
+	VY_PAGE_VALUE_PREFIX = 1,
+	/** The whole data is stored. */
+	VY_PAGE_VALUE_FULL = 2,
+};
 
-	if (run_info->count >= *page_info_capacity) {
-		uint32_t cap = *page_info_capacity > 0 ?
-			*page_info_capacity * 2 : 16;
-		struct vy_page_info *new_infos =
-			realloc(run_info->page_infos, cap * sizeof(*new_infos));
-		if (new_infos == NULL) {
-			diag_set(OutOfMemory, cap, "realloc",
-				 "struct vy_page_info");
-			goto error_row_index;
-		}
-		run_info->page_infos = new_infos;
-		*page_info_capacity = cap;
+static inline char *
+vy_varint_encode(char *pos, uint64_t value)
+{
+	while (value >= 0x80) {
+		*pos++ = (char) (value | 0x80);
+		value >>= 7;
 	}
-	assert(*page_info_capacity >= run_info->count);
-
-	struct vy_page_info *page = run_info->page_infos + run_info->count;
-	vy_page_info_create(page, data_xlog->offset, key_def, *curr_stmt);
-	bool end_of_run = false;
-	xlog_tx_begin(data_xlog);
-
-	do {
-		uint32_t *offset = (uint32_t *) ibuf_alloc(&row_index_buf,
-							   sizeof(uint32_t));
-		if (offset == NULL) {
-			diag_set(OutOfMemory, sizeof(uint32_t),
-				 "ibuf", "row index");
-			goto error_rollback;
-		}
-		*offset = page->unpacked_size;
-
-		struct tuple *stmt = *curr_stmt;
-		if (vy_run_dump_stmt(stmt, data_xlog, page, key_def) != 0)
-			goto error_rollback;
-
-		if (vy_write_iterator_next(wi, curr_stmt))
-			goto error_rollback;
-
-		end_of_run = *curr_stmt == NULL ||
-			/* Split key reached, proceed to the next run. */
-			     (split_key != NULL &&
-		             vy_stmt_compare_with_key(*curr_stmt, split_key,
-						      key_def) >= 0);
-
-	} while (end_of_run == false &&
-		 obuf_size(&data_xlog->obuf) < key_def->opts.page_size);
-
-	/* Save offset to row index  */
-	page->row_index_offset = page->unpacked_size;
-
-	/* Write row index */
-	struct xrow_header xrow;
-	const uint32_t *row_index = (const uint32_t *) row_index_buf.rpos;
-	assert(ibuf_used(&row_index_buf) == sizeof(uint32_t) * page->count);
-	if (vy_row_index_encode(row_index, page->count, &xrow) < 0)
-		goto error_rollback;
+	*pos++ = (char) value;
+	return pos;
+}
 
-	ssize_t written = xlog_write_row(data_xlog, &xrow);
-	if (written < 0)
-		goto error_rollback;
+static inline uint64_t
+vy_varint_decode(const char **pos)
+{
+	const uint8_t *p = (const uint8_t *) *pos;
+	uint64_t value = 0;
+	for (int shift = 0; ; shift += 7) {
+		uint8_t byte = *p++;
+		value |= (uint64_t) (byte & 0x7f) << shift;
+		if (byte < 0x80)
+			break;
+	}
+	*pos = (const char *) p;
+	return value;
+}
 
-	page->unpacked_size += written;
+/** Map signed deltas to unsigned ones so small values stay short. */
+static inline uint64_t
+vy_zigzag_encode(int64_t value)
+{
+	return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
 
-	written = xlog_tx_commit(data_xlog);
-	if (written == 0)
-		written = xlog_flush(data_xlog);
-	if (written < 0)
-		goto error_row_index;
+static inline int64_t
+vy_zigzag_decode(uint64_t value)
+{
+	return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
 
-	page->size = written;
+/** A decoded entry of a packed page. */
+struct vy_page_entry {
+	/** Length of the prefix shared with the previous key. */
+	uint32_t shared;
+	/** Length of the rest of the key, stored in the entry. */
+	uint32_t unshared;
+	/** LSN of the statement. */
+	int64_t lsn;
+	/** Statement type. */
+	uint8_t type;
+	/** enum vy_page_value_kind */
+	uint8_t value_kind;
+	/** Key bytes following the shared prefix. */
+	const char *key;
+	/** Stored value bytes, see enum vy_page_value_kind. */
+	const char *value;
+	uint32_t value_size;
+	/** UPSERT operations. */
+	const char *ops;
+	uint32_t ops_size;
+};
 
-	assert(page->count > 0);
+/**
+ * Decode the entry starting at @a pos. @a prev_lsn is the LSN of
+ * the previous entry, or 0 at a restart point.
+ * @return the position of the next entry.
+ */
+static const char *
+vy_page_entry_decode(const char *pos, int64_t prev_lsn,
+		     struct vy_page_entry *entry)
+{
+	entry->shared = vy_varint_decode(&pos);
+	entry->unshared = vy_varint_decode(&pos);
+	entry->lsn = prev_lsn + vy_zigzag_decode(vy_varint_decode(&pos));
+	entry->type = (uint8_t) *pos++;
+	entry->value_kind = (uint8_t) *pos++;
+	entry->value_size = vy_varint_decode(&pos);
+	entry->ops_size = entry->type == IPROTO_UPSERT ?
+			  vy_varint_decode(&pos) : 0;
+	entry->key = pos;
+	pos += entry->unshared;
+	entry->value = pos;
+	pos += entry->value_size;
+	entry->ops = pos;
+	pos += entry->ops_size;
+	return pos;
+}
 
-	++run_info->count;
-	if (page->min_lsn < run_info->min_lsn)
-		run_info->min_lsn = page->min_lsn;
-	if (page->max_lsn > run_info->max_lsn)
-		run_info->max_lsn = page->max_lsn;
-	run_info->total += page->size;
-	run_info->keys += page->count;
+/**
+ * Accumulates statements of a page in the packed format.
+ */
+struct vy_page_encoder {
+	/** Packed entries. */
+	struct ibuf entries;
+	/** Offsets of restart points in entries, uint32_t each. */
+	struct ibuf restarts;
+	/** Key of the last added entry. */
+	struct ibuf last_key;
+	/** LSN of the last added entry. */
+	int64_t last_lsn;
+	/** Number of added entries. */
+	uint32_t count;
+};
 
-	ibuf_destroy(&row_index_buf);
-	return !end_of_run ? 0: 1;
+static void
+vy_page_encoder_create(struct vy_page_encoder *enc, size_t page_size)
+{
+	ibuf_create(&enc->entries, &cord()->slabc, page_size);
+	ibuf_create(&enc->restarts, &cord()->slabc,
+		    sizeof(uint32_t) * 256);
+	ibuf_create(&enc->last_key, &cord()->slabc, 1024);
+	enc->last_lsn = 0;
+	enc->count = 0;
+}
 
-error_rollback:
-	xlog_tx_rollback(data_xlog);
-error_row_index:
-	ibuf_destroy(&row_index_buf);
-	return -1;
+static void
+vy_page_encoder_destroy(struct vy_page_encoder *enc)
+{
+	ibuf_destroy(&enc->entries);
+	ibuf_destroy(&enc->restarts);
+	ibuf_destroy(&enc->last_key);
 }
 
 /**
- * Write statements from the iterator to a new run file.
+ * Append a statement to the page. An entry is laid out as
  *
- *  @retval 0, curr_stmt != NULL: all is ok, the iterator is not finished
- *  @retval 0, curr_stmt == NULL: all is ok, the iterator finished
- *  @retval -1 error occurred
+ *   varint shared, varint unshared, varint zigzag(lsn - prev lsn),
+ *   u8 type, u8 value kind, varint value size,
+ *   [varint ops size, UPSERT only],
+ *   unshared key bytes, value bytes, [ops bytes]
+ *
+ * The key is the msgpack array of the key parts. Every
+ * VY_PAGE_RESTART_INTERVAL entries the key is stored in full and
+ * the LSN delta is counted from 0, so that decoding can start
+ * there.
+ *
+ * @retval  0 success
+ * @retval -1 out of memory
  */
 static int
-vy_run_write_data(struct vy_run *run, const char *dirpath,
-		  struct vy_write_iterator *wi, struct tuple **curr_stmt,
-		  const struct tuple *end_key,
-		  const struct key_def *key_def)
+vy_page_encoder_add(struct vy_page_encoder *enc, const struct tuple *stmt,
+		    const struct key_def *key_def)
 {
-	assert(curr_stmt != NULL);
-	struct vy_run_info *run_info = &run->info;
+	struct region *region = &fiber()->gc;
+	size_t region_svp = region_used(region);
+	uint8_t type = vy_stmt_type(stmt);
+	const char *key, *data, *ops = NULL;
+	uint32_t key_size, data_size, ops_size = 0;
+	if (type == IPROTO_DELETE) {
+		key = tuple_data_range(stmt, &key_size);
+		data = key;
+		data_size = key_size;
+	} else {
+		key = tuple_extract_key(stmt, key_def, &key_size);
+		if (key == NULL)
+			return -1;
+		if (type == IPROTO_UPSERT) {
+			data = vy_upsert_data_range(stmt, &data_size);
+			ops = vy_stmt_upsert_ops(stmt, &ops_size);
+		} else {
+			data = tuple_data_range(stmt, &data_size);
+		}
+	}
 
-	char path[PATH_MAX];
-	vy_run_snprint_path(path, sizeof(path), dirpath,
+	/* Elide the data bytes that repeat the key. */
+	const char *value = data;
+	uint32_t value_size = data_size;
+	uint8_t value_kind = VY_PAGE_VALUE_FULL;
+	const char *key_body = key;
+	mp_decode_array(&key_body);
+	uint32_t key_body_size = key + key_size - key_body;
+	const char *data_body = data;
+	mp_decode_array(&data_body);
+	uint32_t header_size = data_body - data;
+	if (data_size == key_size && memcmp(data, key, key_size) == 0) {
+		value_kind = VY_PAGE_VALUE_KEY;
+		value_size = 0;
+	} else if (data_size - header_size >= key_body_size &&
+		   memcmp(data_body, key_body, key_body_size) == 0) {
+		value_kind = VY_PAGE_VALUE_PREFIX;
+		value_size = data_size - key_body_size;
+	}
+
+	bool is_restart = enc->count % VY_PAGE_RESTART_INTERVAL == 0;
+	uint32_t shared = 0;
+	if (is_restart) {
+		uint32_t *offset = ibuf_alloc(&enc->restarts, sizeof(*offset));
+		if (offset == NULL) {
+			diag_set(OutOfMemory, sizeof(*offset), "ibuf",
+				 "page restarts");
+			goto error;
+		}
+		*offset = ibuf_used(&enc->entries);
+		enc->last_lsn = 0;
+	} else {
+		const char *last_key = enc->last_key.rpos;
+		uint32_t last_key_size = ibuf_used(&enc->last_key);
+		while (shared < key_size && shared < last_key_size &&
+		       key[shared] == last_key[shared])
+			shared++;
+	}
+	uint32_t unshared = key_size - shared;
+
+	size_t size = VY_PAGE_ENTRY_HEADER_MAX + unshared + value_size +
+		      ops_size;
+	char *pos = ibuf_reserve(&enc->entries, size);
+	if (pos == NULL) {
+		diag_set(OutOfMemory, size, "ibuf", "page entries");
+		goto error;
+	}
+	char *begin = pos;
+	int64_t lsn = vy_stmt_lsn(stmt);
+	pos = vy_varint_encode(pos, shared);
+	pos = vy_varint_encode(pos, unshared);
+	pos = vy_varint_encode(pos, vy_zigzag_encode(lsn - enc->last_lsn));
+	*pos++ = (char) type;
+	*pos++ = (char) value_kind;
+	pos = vy_varint_encode(pos, value_size);
+	if (type == IPROTO_UPSERT)
+		pos = vy_varint_encode(pos, ops_size);
+	memcpy(pos, key + shared, unshared);
+	pos += unshared;
+	if (value_kind == VY_PAGE_VALUE_PREFIX) {
+		memcpy(pos, data, header_size);
+		pos += header_size;
+		memcpy(pos, data_body + key_body_size,
+		       value_size - header_size);
+		pos += value_size - header_size;
+	} else if (value_kind == VY_PAGE_VALUE_FULL) {
+		memcpy(pos, data, data_size);
+		pos += data_size;
+	}
+	if (ops_size > 0) {
+		memcpy(pos, ops, ops_size);
+		pos += ops_size;
+	}
+	assert((size_t) (pos - begin) <= size);
+	ibuf_alloc(&enc->entries, pos - begin);
+
+	ibuf_reset(&enc->last_key);
+	char *last_key = ibuf_alloc(&enc->last_key, key_size);
+	if (last_key == NULL) {
+		diag_set(OutOfMemory, key_size, "ibuf", "page last key");
+		goto error;
+	}
+	memcpy(last_key, key, key_size);
+	enc->last_lsn = lsn;
+	enc->count++;
+	region_truncate(region, region_svp);
+	return 0;
+error:
+	region_truncate(region, region_svp);
+	return -1;
+}
+
+/**
+ * Encode the packed entries of a page as xrow.
+ * Allocates using region_alloc.
+ *
+ * @retval  0 success
+ * @retval -1 error, check diag
+ */
+static int
+vy_page_entries_encode(const struct vy_page_encoder *enc,
+		       struct xrow_header *xrow)
+{
+	memset(xrow, 0, sizeof(*xrow));
+	xrow->type = IPROTO_REPLACE;
+
+	struct request request;
+	request_create(&request, IPROTO_REPLACE);
+	uint32_t size = ibuf_used(&enc->entries);
+	size_t tuple_size = mp_sizeof_array(1) + mp_sizeof_bin(size);
+	char *tuple = region_alloc(&fiber()->gc, tuple_size);
+	if (tuple == NULL) {
+		diag_set(OutOfMemory, tuple_size, "region", "page entries");
+		return -1;
+	}
+	request.tuple = tuple;
+	tuple = mp_encode_array(tuple, 1);
+	tuple = mp_encode_bin(tuple, enc->entries.rpos, size);
+	request.tuple_end = tuple;
+	assert(request.tuple_end == request.tuple + tuple_size);
+	xrow->bodycnt = request_encode(&request, xrow->body);
+	return xrow->bodycnt >= 0 ? 0 : -1;
+}
+
+/* }}} Packed page format */
+
+static void
+vy_rate_limit_create(struct vy_rate_limit *rl, uint64_t rate)
+{
+	tt_pthread_mutex_init(&rl->mutex, NULL);
+	rl->rate = rate;
+	rl->value = 0;
+	rl->timestamp = clock_monotonic();
+}
+
+static void
+vy_rate_limit_destroy(struct vy_rate_limit *rl)
+{
+	tt_pthread_mutex_destroy(&rl->mutex);
+}
+
+/**
+ * Account @size bytes written to disk and sleep if the rate
+ * limit is exceeded. Up to one second worth of the rate may be
+ * written in a burst. Called from worker threads.
+ */
+static void
+vy_rate_limit_wait(struct vy_rate_limit *rl, size_t size)
+{
+	if (rl->rate == 0)
+		return;
+	tt_pthread_mutex_lock(&rl->mutex);
+	double now = clock_monotonic();
+	rl->value += (now - rl->timestamp) * rl->rate;
+	if (rl->value > rl->rate)
+		rl->value = rl->rate;
+	rl->timestamp = now;
+	rl->value -= size;
+	double delay = rl->value < 0 ? -rl->value / rl->rate : 0;
+	tt_pthread_mutex_unlock(&rl->mutex);
+	if (delay > 0)
+		fiber_sleep(delay);
+}
+
+/* {{{ Page compression pool */
+
+/**
+ * A page of a run being written, encoded and compressed by
+ * the compression pool while the writer merges next pages.
+ */
+struct vy_page_job {
+	/** Link in vy_compress_pool::input. */
+	struct stailq_entry in_input;
+	/** Link in the writer's list of pages in progress. */
+	struct stailq_entry in_inflight;
+	/**
+	 * Statements of the page. Owned by the writer thread,
+	 * only read by the compression thread.
+	 */
+	struct vy_page_encoder enc;
+	/** The number of the page in the run. */
+	uint32_t page_no;
+	/** Set once the page is compressed, or failed to. */
+	bool is_ready;
+	/** The page as an xlog transaction, malloc()ed. */
+	char *data;
+	size_t size;
+	/** See vy_page_info. */
+	uint32_t unpacked_size;
+	uint32_t row_index_offset;
+	/** Compression error, if any. */
+	struct diag diag;
+};
+
+static struct vy_page_job *
+vy_page_job_new(uint32_t page_no, size_t page_size)
+{
+	struct vy_page_job *job = malloc(sizeof(*job));
+	if (job == NULL) {
+		diag_set(OutOfMemory, sizeof(*job), "malloc",
+			 "struct vy_page_job");
+		return NULL;
+	}
+	vy_page_encoder_create(&job->enc, page_size);
+	job->page_no = page_no;
+	job->is_ready = false;
+	job->data = NULL;
+	job->size = 0;
+	job->unpacked_size = 0;
+	job->row_index_offset = 0;
+	diag_create(&job->diag);
+	return job;
+}
+
+/** Must be called from the thread which created the job. */
+static void
+vy_page_job_delete(struct vy_page_job *job)
+{
+	vy_page_encoder_destroy(&job->enc);
+	diag_destroy(&job->diag);
+	free(job->data);
+	free(job);
+}
+
+/**
+ * Encode the page as an xlog transaction: the packed entries
+ * followed by the row index. Called from a compression thread.
+ */
+static int
+vy_page_job_encode(struct vy_page_job *job, struct xlog_tx_buf *buf)
+{
+	struct xrow_header xrow;
+	if (vy_page_entries_encode(&job->enc, &xrow) < 0)
+		goto error;
+	ssize_t written = xlog_tx_buf_write_row(buf, &xrow);
+	if (written < 0)
+		goto error;
+	job->unpacked_size = written;
+	job->row_index_offset = written;
+
+	const uint32_t *row_index = (const uint32_t *) job->enc.restarts.rpos;
+	uint32_t restart_count = ibuf_used(&job->enc.restarts) /
+				 sizeof(uint32_t);
+	if (vy_row_index_encode(row_index, restart_count, &xrow) < 0)
+		goto error;
+	written = xlog_tx_buf_write_row(buf, &xrow);
+	if (written < 0)
+		goto error;
+	job->unpacked_size += written;
+
+	job->data = xlog_tx_buf_finish(buf, &job->size);
+	fiber_gc();
+	return job->data != NULL ? 0 : -1;
+error:
+	fiber_gc();
+	return -1;
+}
+
+static int
+vy_compress_f(va_list ap)
+{
+	struct vy_compress_pool *pool = va_arg(ap, struct vy_compress_pool *);
+	struct xlog_tx_buf buf;
+	bool has_buf = false;
+
+	tt_pthread_mutex_lock(&pool->mutex);
+	while (!pool->is_stopped) {
+		if (stailq_empty(&pool->input)) {
+			tt_pthread_cond_wait(&pool->worker_cond,
+					     &pool->mutex);
+			continue;
+		}
+		struct vy_page_job *job =
+			stailq_shift_entry(&pool->input,
+					   struct vy_page_job, in_input);
+		tt_pthread_mutex_unlock(&pool->mutex);
+
+		if (!has_buf)
+			has_buf = xlog_tx_buf_create(&buf) == 0;
+		if (!has_buf || vy_page_job_encode(job, &buf) != 0) {
+			diag_move(diag_get(), &job->diag);
+			/* Drop rows of the failed page, if any. */
+			if (has_buf) {
+				xlog_tx_buf_destroy(&buf);
+				has_buf = false;
+			}
+		}
+
+		tt_pthread_mutex_lock(&pool->mutex);
+		job->is_ready = true;
+		pthread_cond_broadcast(&pool->ready_cond);
+	}
+	tt_pthread_mutex_unlock(&pool->mutex);
+	if (has_buf)
+		xlog_tx_buf_destroy(&buf);
+	return 0;
+}
+
+/**
+ * Start the compression threads. With no threads, pages are
+ * compressed by the writer itself.
+ */
+static void
+vy_compress_pool_start(struct vy_compress_pool *pool, int worker_count)
+{
+	tt_pthread_mutex_init(&pool->mutex, NULL);
+	tt_pthread_cond_init(&pool->worker_cond, NULL);
+	tt_pthread_cond_init(&pool->ready_cond, NULL);
+	stailq_create(&pool->input);
+	pool->is_stopped = false;
+	pool->worker_count = 0;
+	pool->workers = NULL;
+	if (worker_count <= 0)
+		return;
+	pool->workers = calloc(worker_count, sizeof(struct cord));
+	if (pool->workers == NULL) {
+		say_error("failed to allocate vinyl compression threads");
+		return;
+	}
+	for (int i = 0; i < worker_count; i++) {
+		if (cord_costart(&pool->workers[i], "vinyl.compress",
+				 vy_compress_f, pool) != 0) {
+			error_log(diag_last_error(diag_get()));
+			break;
+		}
+		pool->worker_count++;
+	}
+}
+
+/**
+ * Stop the compression threads. Must be called when no
+ * writer uses the pool.
+ */
+static void
+vy_compress_pool_stop(struct vy_compress_pool *pool)
+{
+	tt_pthread_mutex_lock(&pool->mutex);
+	assert(stailq_empty(&pool->input));
+	pool->is_stopped = true;
+	pthread_cond_broadcast(&pool->worker_cond);
+	tt_pthread_mutex_unlock(&pool->mutex);
+
+	for (int i = 0; i < pool->worker_count; i++)
+		cord_join(&pool->workers[i]);
+	free(pool->workers);
+	pool->workers = NULL;
+	pool->worker_count = 0;
+	tt_pthread_cond_destroy(&pool->ready_cond);
+	tt_pthread_cond_destroy(&pool->worker_cond);
+	tt_pthread_mutex_destroy(&pool->mutex);
+}
+
+static void
+vy_compress_pool_submit(struct vy_compress_pool *pool,
+			struct vy_page_job *job)
+{
+	tt_pthread_mutex_lock(&pool->mutex);
+	stailq_add_tail_entry(&pool->input, job, in_input);
+	pthread_cond_signal(&pool->worker_cond);
+	tt_pthread_mutex_unlock(&pool->mutex);
+}
+
+static void
+vy_compress_pool_wait(struct vy_compress_pool *pool,
+		      struct vy_page_job *job)
+{
+	tt_pthread_mutex_lock(&pool->mutex);
+	while (!job->is_ready)
+		tt_pthread_cond_wait(&pool->ready_cond, &pool->mutex);
+	tt_pthread_mutex_unlock(&pool->mutex);
+}
+
+/* }}} Page compression pool */
+
+/**
+ * Fill a page encoder with statements from the iterator,
+ * add a page to the run and update page and run statistics,
+ * except for the page location in the file, which is set
+ * when the page is written.
+ *
+ *  @retval  1 all is ok, the iterator is finished
+ *  @retval  0 all is ok, the iterator isn't finished
+ *  @retval -1 error occurred
+ */
+static int
+vy_run_fill_page(struct vy_run_info *run_info, struct vy_page_encoder *enc,
+		 struct vy_write_iterator *wi, const struct tuple *split_key,
+		 uint32_t *page_info_capacity, struct tuple **curr_stmt,
+		 const struct key_def *key_def, struct ibuf *bloom_hashes,
+		 uint32_t bloom_part_count)
+{
+	assert(*curr_stmt != NULL);
+	if (run_info->count >= *page_info_capacity) {
+		uint32_t cap = *page_info_capacity > 0 ?
+			*page_info_capacity * 2 : 16;
+		struct vy_page_info *new_infos =
+			realloc(run_info->page_infos, cap * sizeof(*new_infos));
+		if (new_infos == NULL) {
+			diag_set(OutOfMemory, cap, "realloc",
+				 "struct vy_page_info");
+			return -1;
+		}
+		run_info->page_infos = new_infos;
+		*page_info_capacity = cap;
+	}
+	assert(*page_info_capacity >= run_info->count);
+
+	struct vy_page_info *page = run_info->page_infos + run_info->count;
+	if (vy_page_info_create(page, 0, key_def, *curr_stmt) != 0)
+		return -1;
+	page->format = VY_PAGE_FORMAT_PACKED;
+	/* The page is destroyed with the run from now on. */
+	++run_info->count;
+	bool end_of_run = false;
+
+	do {
+		struct tuple *stmt = *curr_stmt;
+		if (vy_page_encoder_add(enc, stmt, key_def) != 0)
+			return -1;
+
+		++page->count;
+		if (vy_stmt_lsn(stmt) > page->max_lsn)
+			page->max_lsn = vy_stmt_lsn(stmt);
+		if (vy_stmt_lsn(stmt) < page->min_lsn)
+			page->min_lsn = vy_stmt_lsn(stmt);
+
+		if (bloom_part_count > 0 &&
+		    vy_run_bloom_add_stmt(bloom_hashes, stmt, key_def,
+					  bloom_part_count) != 0)
+			return -1;
+
+		if (vy_write_iterator_next(wi, curr_stmt))
+			return -1;
+
+		end_of_run = *curr_stmt == NULL ||
+			/* Split key reached, proceed to the next run. */
+			     (split_key != NULL &&
+		             vy_stmt_compare_with_key(*curr_stmt, split_key,
+						      key_def) >= 0);
+
+	} while (end_of_run == false &&
+		 ibuf_used(&enc->entries) < key_def->opts.page_size);
+
+	assert(page->count == enc->count);
+	assert(page->count > 0);
+	assert(ibuf_used(&enc->restarts) / sizeof(uint32_t) ==
+	       (page->count + VY_PAGE_RESTART_INTERVAL - 1) /
+	       VY_PAGE_RESTART_INTERVAL);
+	if (page->min_lsn < run_info->min_lsn)
+		run_info->min_lsn = page->min_lsn;
+	if (page->max_lsn > run_info->max_lsn)
+		run_info->max_lsn = page->max_lsn;
+	run_info->keys += page->count;
+	return !end_of_run ? 0: 1;
+}
+
+/**
+ * Encode a filled page and write it to the run file.
+ *
+ * @retval  0 success
+ * @retval -1 error occurred
+ */
+static int
+vy_run_write_page(struct vy_run_info *run_info, struct vy_page_info *page,
+		  struct vy_page_encoder *enc, struct xlog *data_xlog)
+{
+	page->offset = data_xlog->offset;
+	xlog_tx_begin(data_xlog);
+
+	/* Write packed entries */
+	struct xrow_header xrow;
+	if (vy_page_entries_encode(enc, &xrow) < 0)
+		goto error_rollback;
+	ssize_t written = xlog_write_row(data_xlog, &xrow);
+	if (written < 0)
+		goto error_rollback;
+	page->unpacked_size = written;
+
+	/* Save offset to row index  */
+	page->row_index_offset = page->unpacked_size;
+
+	/* Write row index of restart points */
+	const uint32_t *row_index = (const uint32_t *) enc->restarts.rpos;
+	uint32_t restart_count = ibuf_used(&enc->restarts) / sizeof(uint32_t);
+	if (vy_row_index_encode(row_index, restart_count, &xrow) < 0)
+		goto error_rollback;
+
+	written = xlog_write_row(data_xlog, &xrow);
+	if (written < 0)
+		goto error_rollback;
+
+	page->unpacked_size += written;
+
+	written = xlog_tx_commit(data_xlog);
+	if (written == 0)
+		written = xlog_flush(data_xlog);
+	if (written < 0)
+		return -1;
+
+	page->size = written;
+	run_info->total += page->size;
+	return 0;
+
+error_rollback:
+	xlog_tx_rollback(data_xlog);
+	return -1;
+}
+
+/**
+ * Write a page compressed by the compression pool to the run
+ * file. The pages are written in the order they were filled.
+ *
+ * @retval  0 success
+ * @retval -1 error occurred
+ */
+static int
+vy_run_write_page_job(struct vy_run_info *run_info, struct vy_page_job *job,
+		      struct xlog *data_xlog)
+{
+	if (!diag_is_empty(&job->diag)) {
+		diag_move(&job->diag, diag_get());
+		return -1;
+	}
+	struct vy_page_info *page = run_info->page_infos + job->page_no;
+	page->offset = data_xlog->offset;
+	ssize_t written = xlog_write_tx(data_xlog, job->data, job->size);
+	if (written < 0)
+		return -1;
+	page->size = written;
+	page->unpacked_size = job->unpacked_size;
+	page->row_index_offset = job->row_index_offset;
+	run_info->total += page->size;
+	return 0;
+}
+
+/**
+ * Write statements from the iterator to a new page in the
+ * pre-packed XROW format: one xrow per statement and a row index
+ * of all of them. Runs are never written this way, except when
+ * ERRINJ_VY_RUN_WRITE_XROW is set to test reading old runs.
+ *
+ *  @retval  1 all is ok, the iterator is finished
+ *  @retval  0 all is ok, the iterator isn't finished
+ *  @retval -1 error occurred
+ */
+static int
+vy_run_write_xrow_page(struct vy_run_info *run_info,
+		       struct xlog *data_xlog, struct vy_write_iterator *wi,
+		       const struct tuple *split_key,
+		       uint32_t *page_info_capacity, struct tuple **curr_stmt,
+		       const struct key_def *key_def,
+		       struct ibuf *bloom_hashes, uint32_t bloom_part_count)
+{
+	assert(*curr_stmt != NULL);
+	/* row offsets accumulator */
+	struct ibuf row_index_buf;
+	ibuf_create(&row_index_buf, &cord()->slabc, sizeof(uint32_t) * 4096);
+
+	if (run_info->count >= *page_info_capacity) {
+		uint32_t cap = *page_info_capacity > 0 ?
+			*page_info_capacity * 2 : 16;
+		struct vy_page_info *new_infos =
+			realloc(run_info->page_infos, cap * sizeof(*new_infos));
+		if (new_infos == NULL) {
+			diag_set(OutOfMemory, cap, "realloc",
+				 "struct vy_page_info");
+			goto error_row_index;
+		}
+		run_info->page_infos = new_infos;
+		*page_info_capacity = cap;
+	}
+	assert(*page_info_capacity >= run_info->count);
+
+	struct vy_page_info *page = run_info->page_infos + run_info->count;
+	if (vy_page_info_create(page, data_xlog->offset, key_def,
+				*curr_stmt) != 0)
+		goto error_row_index;
+	assert(page->format == VY_PAGE_FORMAT_XROW);
+	/* The page is destroyed with the run from now on. */
+	++run_info->count;
+	bool end_of_run = false;
+	xlog_tx_begin(data_xlog);
+
+	do {
+		uint32_t *offset = (uint32_t *) ibuf_alloc(&row_index_buf,
+							   sizeof(uint32_t));
+		if (offset == NULL) {
+			diag_set(OutOfMemory, sizeof(uint32_t),
+				 "ibuf", "row index");
+			goto error_rollback;
+		}
+		*offset = page->unpacked_size;
+
+		struct tuple *stmt = *curr_stmt;
+		struct xrow_header xrow;
+		if (vy_stmt_encode(stmt, key_def, &xrow) != 0)
+			goto error_rollback;
+		ssize_t row_size = xlog_write_row(data_xlog, &xrow);
+		if (row_size < 0)
+			goto error_rollback;
+		page->unpacked_size += row_size;
+
+		++page->count;
+		if (vy_stmt_lsn(stmt) > page->max_lsn)
+			page->max_lsn = vy_stmt_lsn(stmt);
+		if (vy_stmt_lsn(stmt) < page->min_lsn)
+			page->min_lsn = vy_stmt_lsn(stmt);
+
+		if (bloom_part_count > 0 &&
+		    vy_run_bloom_add_stmt(bloom_hashes, stmt, key_def,
+					  bloom_part_count) != 0)
+			goto error_rollback;
+
+		if (vy_write_iterator_next(wi, curr_stmt))
+			goto error_rollback;
+
+		end_of_run = *curr_stmt == NULL ||
+			/* Split key reached, proceed to the next run. */
+			     (split_key != NULL &&
+		             vy_stmt_compare_with_key(*curr_stmt, split_key,
+						      key_def) >= 0);
+
+	} while (end_of_run == false &&
+		 obuf_size(&data_xlog->obuf) < key_def->opts.page_size);
+
+	/* Save offset to row index  */
+	page->row_index_offset = page->unpacked_size;
+
+	/* Write row index */
+	struct xrow_header xrow;
+	const uint32_t *row_index = (const uint32_t *) row_index_buf.rpos;
+	assert(ibuf_used(&row_index_buf) == sizeof(uint32_t) * page->count);
+	if (vy_row_index_encode(row_index, page->count, &xrow) < 0)
+		goto error_rollback;
+
+	ssize_t written = xlog_write_row(data_xlog, &xrow);
+	if (written < 0)
+		goto error_rollback;
+
+	page->unpacked_size += written;
+
+	written = xlog_tx_commit(data_xlog);
+	if (written == 0)
+		written = xlog_flush(data_xlog);
+	if (written < 0)
+		goto error_row_index;
+
+	page->size = written;
+
+	assert(page->count > 0);
+	if (page->min_lsn < run_info->min_lsn)
+		run_info->min_lsn = page->min_lsn;
+	if (page->max_lsn > run_info->max_lsn)
+		run_info->max_lsn = page->max_lsn;
+	run_info->total += page->size;
+	run_info->keys += page->count;
+
+	ibuf_destroy(&row_index_buf);
+	return !end_of_run ? 0: 1;
+
+error_rollback:
+	xlog_tx_rollback(data_xlog);
+error_row_index:
+	ibuf_destroy(&row_index_buf);
+	return -1;
+}
+
+/**
+ * Write statements from the iterator to a new run file.
+ * If bloom_part_count is not 0, build a bloom filter of the
+ * first bloom_part_count key parts of the written statements.
+ * If rate_limit is not NULL, throttle writes to obey it.
+ * If compress_pool has threads, pages are compressed by them
+ * while the iterator is read.
+ *
+ *  @retval 0, curr_stmt != NULL: all is ok, the iterator is not finished
+ *  @retval 0, curr_stmt == NULL: all is ok, the iterator finished
+ *  @retval -1 error occurred
+ */
+static int
+vy_run_write_data(struct vy_run *run, const char *dirpath,
+		  struct vy_write_iterator *wi, struct tuple **curr_stmt,
+		  const struct tuple *end_key,
+		  const struct key_def *key_def, uint32_t bloom_part_count,
+		  struct vy_rate_limit *rate_limit,
+		  struct vy_compress_pool *compress_pool)
+{
+	assert(curr_stmt != NULL);
+	struct vy_run_info *run_info = &run->info;
+
+	char path[PATH_MAX];
+	vy_run_snprint_path(path, sizeof(path), dirpath,
 			    run->id, VY_FILE_RUN);
 	struct xlog data_xlog;
 	struct xlog_meta meta = {
@@ -2213,6 +3277,28 @@ vy_run_write_data(struct vy_run *run, const char *dirpath,
 	if (xlog_create(&data_xlog, path, &meta) < 0)
 		return -1;
 
+	/* Key hashes accumulator for the bloom filter. */
+	struct ibuf bloom_hashes;
+	ibuf_create(&bloom_hashes, &cord()->slabc,
+		    sizeof(bloom_hash_t) * 4096);
+
+	/*
+	 * Pages being compressed by the pool, in the order of
+	 * the file. Keep each compression thread busy with up
+	 * to two pages, so that it doesn't wait for the merge.
+	 */
+	struct stailq inflight;
+	stailq_create(&inflight);
+	int inflight_count = 0;
+	int inflight_max = compress_pool != NULL ?
+			   2 * compress_pool->worker_count : 0;
+	struct vy_page_job *job;
+	bool write_xrow = false;
+	ERROR_INJECT(ERRINJ_VY_RUN_WRITE_XROW, {
+		write_xrow = true;
+		inflight_max = 0;
+	});
+
 	/*
 	 * Read from the iterator until it's exhausted or
 	 * the split key is reached.
@@ -2220,15 +3306,74 @@ vy_run_write_data(struct vy_run *run, const char *dirpath,
 	run_info->min_lsn = INT64_MAX;
 	assert(run_info->page_infos == NULL);
 	uint32_t page_infos_capacity = 0;
-	int rc;
-	do {
-		rc = vy_run_write_page(run_info, &data_xlog, wi,
-				       end_key, &page_infos_capacity,
-				       curr_stmt, key_def);
-		if (rc < 0)
-			goto err;
+	int rc = *curr_stmt != NULL ? 0 : 1;
+	while (rc == 0 || inflight_count > 0) {
+		uint64_t written = run_info->total;
+		if (rc == 0 && write_xrow) {
+			rc = vy_run_write_xrow_page(run_info, &data_xlog, wi,
+						    end_key,
+						    &page_infos_capacity,
+						    curr_stmt, key_def,
+						    &bloom_hashes,
+						    bloom_part_count);
+			if (rc < 0)
+				goto err;
+		} else if (rc == 0 && inflight_max == 0) {
+			/* Merge, compress and write the page here. */
+			struct vy_page_encoder enc;
+			vy_page_encoder_create(&enc, key_def->opts.page_size);
+			rc = vy_run_fill_page(run_info, &enc, wi, end_key,
+					      &page_infos_capacity, curr_stmt,
+					      key_def, &bloom_hashes,
+					      bloom_part_count);
+			if (rc >= 0 &&
+			    vy_run_write_page(run_info,
+					      run_info->page_infos +
+					      run_info->count - 1,
+					      &enc, &data_xlog) != 0)
+				rc = -1;
+			vy_page_encoder_destroy(&enc);
+			if (rc < 0)
+				goto err;
+		} else if (rc == 0 && inflight_count < inflight_max) {
+			/* Merge the page and pass it on to the pool. */
+			job = vy_page_job_new(run_info->count,
+					      key_def->opts.page_size);
+			if (job == NULL)
+				goto err;
+			rc = vy_run_fill_page(run_info, &job->enc, wi, end_key,
+					      &page_infos_capacity, curr_stmt,
+					      key_def, &bloom_hashes,
+					      bloom_part_count);
+			if (rc < 0) {
+				vy_page_job_delete(job);
+				goto err;
+			}
+			stailq_add_tail_entry(&inflight, job, in_inflight);
+			inflight_count++;
+			vy_compress_pool_submit(compress_pool, job);
+			continue;
+		} else {
+			/* Write the oldest page in progress. */
+			job = stailq_shift_entry(&inflight, struct vy_page_job,
+						 in_inflight);
+			inflight_count--;
+			vy_compress_pool_wait(compress_pool, job);
+			int write_rc = vy_run_write_page_job(run_info, job,
+							     &data_xlog);
+			vy_page_job_delete(job);
+			if (write_rc != 0)
+				goto err;
+		}
 		fiber_gc();
-	} while (rc == 0);
+		if (rate_limit != NULL)
+			vy_rate_limit_wait(rate_limit,
+					   run_info->total - written);
+	}
+
+	if (bloom_part_count > 0 &&
+	    vy_run_bloom_build(run_info, &bloom_hashes) != 0)
+		goto err;
 
 	/* Sync data and link the file to the final name. */
 	if (xlog_sync(&data_xlog) < 0 ||
@@ -2237,11 +3382,20 @@ vy_run_write_data(struct vy_run *run, const char *dirpath,
 
 	run->fd = data_xlog.fd;
 	xlog_close(&data_xlog, true);
+	ibuf_destroy(&bloom_hashes);
 	fiber_gc();
 
 	return 0;
 err:
+	/* Compression threads may still be reading the pages. */
+	while (!stailq_empty(&inflight)) {
+		job = stailq_shift_entry(&inflight, struct vy_page_job,
+					 in_inflight);
+		vy_compress_pool_wait(compress_pool, job);
+		vy_page_job_delete(job);
+	}
 	xlog_close(&data_xlog, false);
+	ibuf_destroy(&bloom_hashes);
 	fiber_gc();
 	return -1;
 }
@@ -2252,20 +3406,23 @@ enum vy_request_page_key {
 	VY_PAGE_REQUEST_COUNT = 1,
 	VY_PAGE_MIN_KEY = 2,
 	VY_PAGE_DATA_SIZE = 3,
-	VY_PAGE_ROW_INDEX_OFFSET = 4
+	VY_PAGE_ROW_INDEX_OFFSET = 4,
+	VY_PAGE_FORMAT = 5
 };
 
 const char *vy_page_info_key_strs[] = {
 	"count",
 	"min",
 	"data size",
-	"row index"
+	"row index",
+	"format"
 };
 
 const uint64_t vy_page_info_key_map = (1 << VY_PAGE_REQUEST_COUNT) |
 				      (1 << VY_PAGE_MIN_KEY) |
 				      (1 << VY_PAGE_DATA_SIZE) |
 				      (1 << VY_PAGE_ROW_INDEX_OFFSET);
+/* VY_PAGE_FORMAT is optional: pages written without it are xrows. */
 
 /**
  * Encode vy_page_info as xrow.
@@ -2290,14 +3447,17 @@ vy_page_info_encode(const struct vy_page_info *page_info,
 	const char *min_key = tuple_data_range(page_info->min_key,
 					       &min_key_size);
 
+	/* XROW pages are encoded as before the format key existed. */
+	bool has_format = page_info->format != VY_PAGE_FORMAT_XROW;
+	uint32_t map_size = has_format ? 5 : 4;
+
 	/* calc tuple size */
 	uint32_t size;
 	/* 3 items: page offset, size, and map */
 	size = mp_sizeof_array(3) +
 	       mp_sizeof_uint(page_info->offset) +
 	       mp_sizeof_uint(page_info->size) +
-	       /* page map contains 4 items */
-	       mp_sizeof_map(4) +
+	       mp_sizeof_map(map_size) +
 	       mp_sizeof_uint(VY_PAGE_REQUEST_COUNT) +
 	       mp_sizeof_uint(page_info->count) +
 	       mp_sizeof_uint(VY_PAGE_MIN_KEY) +
@@ -2306,6 +3466,9 @@ vy_page_info_encode(const struct vy_page_info *page_info,
 	       mp_sizeof_uint(page_info->unpacked_size) +
 	       mp_sizeof_uint(VY_PAGE_ROW_INDEX_OFFSET) +
 	       mp_sizeof_uint(page_info->row_index_offset);
+	if (has_format)
+		size += mp_sizeof_uint(VY_PAGE_FORMAT) +
+			mp_sizeof_uint(page_info->format);
 
 	char *pos = region_alloc(region, size);
 	if (pos == NULL) {
@@ -2317,7 +3480,7 @@ vy_page_info_encode(const struct vy_page_info *page_info,
 	pos = mp_encode_array(pos, 3);
 	pos = mp_encode_uint(pos, page_info->offset);
 	pos = mp_encode_uint(pos, page_info->size);
-	pos = mp_encode_map(pos, 4);
+	pos = mp_encode_map(pos, map_size);
 	pos = mp_encode_uint(pos, VY_PAGE_REQUEST_COUNT);
 	pos = mp_encode_uint(pos, page_info->count);
 	pos = mp_encode_uint(pos, VY_PAGE_MIN_KEY);
@@ -2327,6 +3490,10 @@ vy_page_info_encode(const struct vy_page_info *page_info,
 	pos = mp_encode_uint(pos, page_info->unpacked_size);
 	pos = mp_encode_uint(pos, VY_PAGE_ROW_INDEX_OFFSET);
 	pos = mp_encode_uint(pos, page_info->row_index_offset);
+	if (has_format) {
+		pos = mp_encode_uint(pos, VY_PAGE_FORMAT);
+		pos = mp_encode_uint(pos, page_info->format);
+	}
 	request.tuple_end = pos;
 
 	memset(xrow, 0, sizeof(*xrow));
@@ -2390,6 +3557,15 @@ vy_page_info_decode(struct vy_page_info *page, const struct xrow_header *xrow,
 		case VY_PAGE_ROW_INDEX_OFFSET:
 			page->row_index_offset = mp_decode_uint(&pos);
 			break;
+		case VY_PAGE_FORMAT:
+			page->format = mp_decode_uint(&pos);
+			if (page->format > VY_PAGE_FORMAT_PACKED) {
+				diag_set(ClientError, ER_VINYL, "Can't decode "
+					 "page meta unknown page format %u",
+					 (unsigned) page->format);
+				return -1;
+			}
+			break;
 		default:
 			diag_set(ClientError, ER_VINYL, "Can't decode page meta "
 				 "unknown page meta key %d", key);
@@ -2416,6 +3592,7 @@ enum vy_request_run_key {
 	VY_RUN_MIN_LSN = 1,
 	VY_RUN_MAX_LSN = 2,
 	VY_RUN_PAGE_COUNT = 3,
+	VY_RUN_BLOOM = 4,
 };
 
 const char *vy_run_info_key_strs[] = {
@@ -2447,14 +3624,25 @@ vy_run_info_encode(const struct vy_run_info *run_info,
 	size_t size = mp_sizeof_array(1);
 	/*
 	 * run map size: min lsn, max lsn, page count
+	 * and optional bloom filter
 	 */
-	size += mp_sizeof_map(3);
+	uint32_t map_size = run_info->has_bloom ? 4 : 3;
+	size += mp_sizeof_map(map_size);
 	size += mp_sizeof_uint(VY_RUN_MIN_LSN) +
 		mp_sizeof_uint(run_info->min_lsn);
 	size += mp_sizeof_uint(VY_RUN_MAX_LSN) +
 		mp_sizeof_uint(run_info->max_lsn);
 	size += mp_sizeof_uint(VY_RUN_PAGE_COUNT) +
 		mp_sizeof_uint(run_info->count);
+	const struct bloom *bloom = &run_info->bloom;
+	if (run_info->has_bloom) {
+		/* bloom: [hash count, block count, table] */
+		size += mp_sizeof_uint(VY_RUN_BLOOM) +
+			mp_sizeof_array(3) +
+			mp_sizeof_uint(bloom->hash_count) +
+			mp_sizeof_uint(bloom->block_count) +
+			mp_sizeof_bin(bloom_store_size(bloom));
+	}
 
 	char *tuple = region_alloc(&fiber()->gc, size);
 	if (tuple == NULL) {
@@ -2464,13 +3652,21 @@ vy_run_info_encode(const struct vy_run_info *run_info,
 	char *pos = tuple;
 	/* encode values */
 	pos = mp_encode_array(pos, 1);
-	pos = mp_encode_map(pos, 3);
+	pos = mp_encode_map(pos, map_size);
 	pos = mp_encode_uint(pos, VY_RUN_MIN_LSN);
 	pos = mp_encode_uint(pos, run_info->min_lsn);
 	pos = mp_encode_uint(pos, VY_RUN_MAX_LSN);
 	pos = mp_encode_uint(pos, run_info->max_lsn);
 	pos = mp_encode_uint(pos, VY_RUN_PAGE_COUNT);
 	pos = mp_encode_uint(pos, run_info->count);
+	if (run_info->has_bloom) {
+		pos = mp_encode_uint(pos, VY_RUN_BLOOM);
+		pos = mp_encode_array(pos, 3);
+		pos = mp_encode_uint(pos, bloom->hash_count);
+		pos = mp_encode_uint(pos, bloom->block_count);
+		pos = mp_encode_binl(pos, bloom_store_size(bloom));
+		pos = bloom_store(bloom, pos);
+	}
 
 	/* put tuple in a replace request to run's space */
 	struct request request;
@@ -2486,6 +3682,40 @@ vy_run_info_encode(const struct vy_run_info *run_info,
 	return 0;
 }
 
+/**
+ * Decode the run bloom filter: [hash count, block count, table].
+ *
+ * @retval  0 success
+ * @retval -1 error (check diag)
+ */
+static int
+vy_run_bloom_decode(struct vy_run_info *run_info, const char **data)
+{
+	if (run_info->has_bloom || mp_decode_array(data) != 3) {
+		diag_set(ClientError, ER_VINYL, "Can't decode run meta: "
+			 "invalid bloom filter");
+		return -1;
+	}
+	uint32_t hash_count = mp_decode_uint(data);
+	uint32_t block_count = mp_decode_uint(data);
+	uint32_t table_size;
+	const char *table = mp_decode_bin(data, &table_size);
+	if (hash_count == 0 || hash_count > BLOOM_HASH_COUNT_MAX ||
+	    block_count == 0 ||
+	    table_size != block_count * sizeof(struct bloom_block)) {
+		diag_set(ClientError, ER_VINYL, "Can't decode run meta: "
+			 "invalid bloom filter");
+		return -1;
+	}
+	if (bloom_load(&run_info->bloom, block_count, hash_count,
+		       table) != 0) {
+		diag_set(OutOfMemory, table_size, "malloc", "struct bloom");
+		return -1;
+	}
+	run_info->has_bloom = true;
+	return 0;
+}
+
 /**
  * Decode the run metadata from xrow.
  *
@@ -2531,6 +3761,10 @@ vy_run_info_decode(struct vy_run_info *run_info,
 		case VY_RUN_PAGE_COUNT:
 			run_info->count = mp_decode_uint(&pos);
 			break;
+		case VY_RUN_BLOOM:
+			if (vy_run_bloom_decode(run_info, &pos) != 0)
+				return -1;
+			break;
 		default:
 			diag_set(ClientError, ER_VINYL,
 				 "Unknown run meta key %d", key);
@@ -2776,7 +4010,9 @@ vy_range_delete(struct vy_range *range)
  */
 static int
 vy_range_write_run(struct vy_range *range, struct vy_write_iterator *wi,
-		   struct tuple **stmt, size_t *written)
+		   struct tuple **stmt, size_t *written,
+		   struct vy_rate_limit *rate_limit,
+		   struct vy_compress_pool *compress_pool)
 {
 	assert(stmt != NULL);
 	const struct vy_index *index = range->index;
@@ -2790,7 +4026,9 @@ vy_range_write_run(struct vy_range *range, struct vy_write_iterator *wi,
 			       "vinyl range dump"); return -1;});
 
 	if (vy_run_write_data(run, index->path, wi, stmt,
-			      range->end, key_def) != 0 ||
+			      range->end, key_def,
+			      vy_index_bloom_part_count(index),
+			      rate_limit, compress_pool) != 0 ||
 	    vy_run_write_index(run, index->path) != 0)
 		return -1;
 
@@ -2845,6 +4083,77 @@ vy_range_needs_split(struct vy_range *range, const char **p_split_key)
 	return true;
 }
 
+/**
+ * Recalculate the compaction priority of a range.
+ *
+ * Runs of a range are organized in levels, each next level is
+ * run_size_ratio times bigger than the previous one, and runs
+ * that don't fit in the last level are accounted to it.
+ *
+ * - tiered: the first level is sized after the newest run. A
+ *   level is merged along with all newer runs into the next
+ *   level when it has accumulated compact_wm runs.
+ * - leveled: the last level is sized after the oldest run, and
+ *   the first level is the smallest one not smaller than a page,
+ *   so the budgets don't drift with the size of the latest dump.
+ *   A level is merged along with all newer runs when it has more
+ *   than one run or, unless it's the last level, the total size
+ *   of the runs down to it exceeds the level budget.
+ *
+ * The priority is the number of runs to merge, so ranges with
+ * a deeper level due for compaction are picked first.
+ */
+static void
+vy_range_update_compact_priority(struct vy_range *range)
+{
+	struct key_opts *opts = &range->index->key_def->opts;
+	bool is_leveled = opts->compaction == VINYL_COMPACTION_LEVELED;
+
+	range->compact_priority = 0;
+	if (range->run_count < 2)
+		return;
+
+	struct vy_run *run;
+	uint64_t target;
+	uint32_t last_level = opts->level_count;
+	if (is_leveled) {
+		run = rlist_last_entry(&range->runs, struct vy_run, in_range);
+		target = MAX(vy_run_total(run), (uint64_t)opts->page_size);
+		last_level = 1;
+		while (last_level < opts->level_count &&
+		       target / opts->run_size_ratio >= opts->page_size) {
+			target /= opts->run_size_ratio;
+			last_level++;
+		}
+	} else {
+		run = rlist_first_entry(&range->runs, struct vy_run, in_range);
+		target = MAX(vy_run_total(run), (uint64_t)opts->page_size);
+	}
+	uint32_t level = 1;
+	int level_runs = 0, total_runs = 0;
+	uint64_t est_size = 0;
+	rlist_foreach_entry(run, &range->runs, in_range) {
+		uint64_t size = vy_run_total(run);
+		while (size > target && level < last_level) {
+			/* The run belongs to the next level. */
+			level++;
+			target *= opts->run_size_ratio;
+			level_runs = 0;
+		}
+		level_runs++;
+		total_runs++;
+		est_size += size;
+		bool needs_merge;
+		if (is_leveled)
+			needs_merge = level_runs > 1 ||
+				(level < last_level && est_size > target);
+		else
+			needs_merge = (unsigned)level_runs >= opts->compact_wm;
+		if (needs_merge && total_runs > 1)
+			range->compact_priority = total_runs;
+	}
+}
+
 /**
  * Create an index directory for a new index.
  * TODO: create index files only after the WAL
@@ -3195,6 +4504,9 @@ vy_stmt_is_committed(struct vy_index *index, const struct tuple *stmt)
 	return vy_stmt_lsn(stmt) <= run->info.max_lsn;
 }
 
+static void
+vy_index_cache_invalidate(struct vy_index *index, struct tuple *stmt);
+
 /*
  * Commit a single write operation made by a transaction.
  */
@@ -3218,6 +4530,7 @@ vy_tx_write(struct txv *v, enum vinyl_status status, int64_t lsn)
 		if (vy_stmt_is_committed(index, stmt))
 			return 0;
 	}
+	vy_index_cache_invalidate(index, stmt);
 	/* Match range. */
 	range = vy_range_tree_find_by_key(&index->tree, ITER_EQ, index->key_def,
 					  stmt);
@@ -3282,6 +4595,11 @@ struct vy_task {
 	struct vy_range *range;
 	/** Write iterator producing statements for the new run. */
 	struct vy_write_iterator *wi;
+	/**
+	 * Compaction only: number of newest runs of the range
+	 * merged by this task. Older runs are left intact.
+	 */
+	int run_count;
 	/**
 	 * A link in the list of all pending tasks, generated by
 	 * task scheduler.
@@ -3329,7 +4647,8 @@ vy_task_dump_execute(struct vy_task *task)
 	/* Start iteration. */
 	if (vy_write_iterator_next(wi, &stmt) != 0)
 		return -1;
-	if (vy_range_write_run(range, wi, &stmt, &task->dump_size) != 0)
+	if (vy_range_write_run(range, wi, &stmt, &task->dump_size,
+			       NULL, NULL) != 0)
 		return -1;
 	return 0;
 }
@@ -3362,6 +4681,7 @@ vy_task_dump_complete(struct vy_task *task, bool in_shutdown)
 	rlist_add_entry(&range->runs, run, in_range);
 	range->run_count++;
 	vy_index_acct_range_dump(index, range, run);
+	index->dump_bytes += task->dump_size;
 
 	/*
 	 * Release dumped in-memory indexes.
@@ -3481,6 +4801,7 @@ static int
 vy_task_compact_execute(struct vy_task *task)
 {
 	struct vy_range *range = task->range;
+	struct vy_env *env = range->index->env;
 	struct vy_write_iterator *wi = task->wi;
 	struct tuple *stmt;
 	struct vy_range *r;
@@ -3501,7 +4822,9 @@ vy_task_compact_execute(struct vy_task *task)
 					       "vinyl range split");
 				      return -1;});
 		}
-		if (vy_range_write_run(r, wi, &stmt, &task->dump_size) != 0)
+		if (vy_range_write_run(r, wi, &stmt, &task->dump_size,
+				       &env->compact_rate_limit,
+				       &env->compress_pool) != 0)
 			return -1;
 	}
 	return 0;
@@ -3528,11 +4851,26 @@ vy_task_compact_complete(struct vy_task *task, bool in_shutdown)
 		vy_log_tx_rollback(env->log);
 		return -1;
 	}
+	/* Runs that were not compacted, see vy_task_compact_new(). */
+	int keep_count = range->run_count - task->run_count;
 	rlist_foreach_entry(r, &range->compact_list, compact_list) {
 		if (vy_log_insert_range(env->log, index->key_def->opts.lsn, r->id,
 				r->begin != NULL ? tuple_data(r->begin) : NULL,
-				r->end != NULL ? tuple_data(r->end) : NULL) < 0 ||
-		    vy_log_insert_run(env->log, r->id, r->new_run->id) < 0) {
+				r->end != NULL ? tuple_data(r->end) : NULL) < 0) {
+			vy_log_tx_rollback(env->log);
+			return -1;
+		}
+		/* Runs must be logged in chronological order. */
+		int n = 0;
+		rlist_foreach_entry_reverse(run, &range->runs, in_range) {
+			if (n++ == keep_count)
+				break;
+			if (vy_log_insert_run(env->log, r->id, run->id) < 0) {
+				vy_log_tx_rollback(env->log);
+				return -1;
+			}
+		}
+		if (vy_log_insert_run(env->log, r->id, r->new_run->id) < 0) {
 			vy_log_tx_rollback(env->log);
 			return -1;
 		}
@@ -3545,13 +4883,28 @@ vy_task_compact_complete(struct vy_task *task, bool in_shutdown)
 	vy_write_iterator_delete(task->wi);
 
 	/*
-	 * If compaction completed successfully, all runs and mems of
-	 * the original range were dumped and hence we don't need it any
-	 * longer. So unlink new ranges from the original one and delete
-	 * the latter.
+	 * If compaction completed successfully, all mems and merged
+	 * runs of the original range were dumped and the runs left
+	 * out of compaction are moved to the new range, so we don't
+	 * need the original range any longer. So unlink new ranges
+	 * from the original one and delete the latter.
 	 */
 	vy_index_unacct_range(index, range);
+	index->compact_bytes += task->dump_size;
 	rlist_foreach_entry_safe(r, &range->compact_list, compact_list, tmp) {
+		/*
+		 * Move the runs left out of compaction, oldest first,
+		 * so that newer runs end up closer to the list head.
+		 * There's only one new range in this case.
+		 */
+		for (int i = 0; i < keep_count; i++) {
+			run = rlist_last_entry(&range->runs,
+					       struct vy_run, in_range);
+			rlist_del_entry(run, in_range);
+			rlist_add_entry(&r->runs, run, in_range);
+			r->run_count++;
+		}
+		keep_count = 0;
 		/* Add the new run created by compaction to the list. */
 		rlist_add_entry(&r->runs, r->new_run, in_range);
 		r->run_count++;
@@ -3657,8 +5010,18 @@ vy_task_compact_new(struct mempool *pool, struct vy_range *range)
 	if (task == NULL)
 		goto err_task;
 
+	/*
+	 * Merge as many newest runs as the compaction policy
+	 * requests. Deleted statements can only be discarded if
+	 * all runs of the range are merged.
+	 */
+	assert(range->compact_priority > 0);
+	assert(range->compact_priority <= range->run_count);
+	task->run_count = range->compact_priority;
+	bool is_last_level = (task->run_count == range->run_count);
+
 	struct vy_write_iterator *wi;
-	wi = vy_write_iterator_new(index, true, tx_manager_vlsn(xm));
+	wi = vy_write_iterator_new(index, is_last_level, tx_manager_vlsn(xm));
 	if (wi == NULL)
 		goto err_wi;
 
@@ -3674,14 +5037,21 @@ vy_task_compact_new(struct mempool *pool, struct vy_range *range)
 			goto err_wi_sub;
 	}
 	struct vy_run *run;
+	int n = 0;
 	rlist_foreach_entry(run, &range->runs, in_range) {
+		if (n++ == task->run_count)
+			break;
 		if (vy_write_iterator_add_run(wi, range, run) != 0)
 			goto err_wi_sub;
 	}
 
-	/* Determine new ranges' boundaries. */
+	/*
+	 * Determine new ranges' boundaries. A range can only be
+	 * split if all its runs are merged, because runs left out
+	 * of compaction can't be split.
+	 */
 	keys[0] = range->begin;
-	if (vy_range_needs_split(range, &split_key_raw)) {
+	if (is_last_level && vy_range_needs_split(range, &split_key_raw)) {
 		split_key = vy_key_from_msgpack(index->format, split_key_raw);
 		if (split_key == NULL)
 			goto err_split_key;
@@ -3789,7 +5159,7 @@ heap_compact_less(struct heap_node *a, struct heap_node *b)
 				container_of(a, struct vy_range, in_compact);
 	const struct vy_range *right =
 				container_of(b, struct vy_range, in_compact);
-	return left->run_count > right->run_count;
+	return left->compact_priority > right->compact_priority;
 }
 
 #define HEAP_LESS(h, l, r) heap_compact_less(l, r)
@@ -3966,6 +5336,7 @@ static void
 vy_scheduler_add_range(struct vy_scheduler *scheduler,
 		       struct vy_range *range)
 {
+	vy_range_update_compact_priority(range);
 	vy_dump_heap_insert(&scheduler->dump_heap, &range->in_dump);
 	vy_compact_heap_insert(&scheduler->compact_heap, &range->in_compact);
 	assert(range->in_dump.pos != UINT32_MAX);
@@ -4022,16 +5393,15 @@ vy_scheduler_peek_compact(struct vy_scheduler *scheduler,
 			  struct vy_task **ptask)
 {
 	/* try to peek a range with a biggest number
-	 * of runs */
+	 * of runs to merge */
 	struct vy_range *range;
 	struct heap_node *pn = NULL;
 	struct heap_iterator it;
 	vy_compact_heap_iterator_init(&scheduler->compact_heap, &it);
 	while ((pn = vy_compact_heap_iterator_next(&it))) {
 		range = container_of(pn, struct vy_range, in_compact);
-		if ((unsigned)range->run_count <
-		    range->index->key_def->opts.compact_wm)
-			break; /* TODO: why ? */
+		if (range->compact_priority == 0)
+			break; /* nothing to do */
 		*ptask = vy_task_compact_new(&scheduler->task_pool,
 					     range);
 		if (*ptask == NULL)
@@ -4043,8 +5413,15 @@ vy_scheduler_peek_compact(struct vy_scheduler *scheduler,
 	return 0; /* nothing to do */
 }
 
+/**
+ * Pick a task for a worker. Dumps go first. If there are
+ * several workers, the last available one is reserved for
+ * dumps, so that long compactions can't hold up memory
+ * reclaim.
+ */
 static int
-vy_schedule(struct vy_scheduler *scheduler, struct vy_task **ptask)
+vy_schedule(struct vy_scheduler *scheduler, int workers_available,
+	    struct vy_task **ptask)
 {
 	*ptask = NULL;
 	if (rlist_empty(&scheduler->env->indexes))
@@ -4055,6 +5432,9 @@ vy_schedule(struct vy_scheduler *scheduler, struct vy_task **ptask)
 	if (*ptask != NULL)
 		return 0;
 
+	if (workers_available == 1 && scheduler->worker_pool_size > 1)
+		return 0;
+
 	if (vy_scheduler_peek_compact(scheduler, ptask) != 0)
 		goto fail;
 	if (*ptask != NULL)
@@ -4163,7 +5543,7 @@ vy_scheduler_f(va_list va)
 		if (workers_available == 0)
 			goto wait;
 		/* Get a task to schedule. */
-		if (vy_schedule(scheduler, &task) != 0)
+		if (vy_schedule(scheduler, workers_available, &task) != 0)
 			goto error;
 		/* Nothing to do. */
 		if (task == NULL)
@@ -4268,6 +5648,8 @@ vy_scheduler_start_workers(struct vy_scheduler *scheduler)
 	if (scheduler->worker_pool == NULL)
 		panic("failed to allocate vinyl worker pool");
 	ev_async_start(scheduler->loop, &scheduler->scheduler_async);
+	vy_compress_pool_start(&scheduler->env->compress_pool,
+			       cfg_geti("vinyl.compress_threads"));
 	for (int i = 0; i < scheduler->worker_pool_size; i++) {
 		cord_costart(&scheduler->worker_pool[i], "vinyl.worker",
 			     vy_worker_f, scheduler);
@@ -4296,6 +5678,7 @@ vy_scheduler_stop_workers(struct vy_scheduler *scheduler)
 	for (int i = 0; i < scheduler->worker_pool_size; i++)
 		cord_join(&scheduler->worker_pool[i]);
 	ev_async_stop(scheduler->loop, &scheduler->scheduler_async);
+	vy_compress_pool_stop(&scheduler->env->compress_pool);
 	free(scheduler->worker_pool);
 	scheduler->worker_pool = NULL;
 	scheduler->worker_pool_size = 0;
@@ -4412,6 +5795,21 @@ vy_conf_new()
 		return NULL;
 	}
 	conf->memory_limit = cfg_getd("vinyl.memory_limit")*1024*1024*1024;
+	conf->page_cache = cfg_getd("vinyl.page_cache")*1024*1024*1024;
+	int read_ahead = cfg_geti("vinyl.read_ahead");
+	if (read_ahead < 0) {
+		diag_set(ClientError, ER_CFG, "vinyl.read_ahead",
+			 "the value must not be negative");
+		goto error_1;
+	}
+	conf->read_ahead = read_ahead;
+	int64_t compact_bandwidth = cfg_geti64("vinyl.compact_bandwidth");
+	if (compact_bandwidth < 0) {
+		diag_set(ClientError, ER_CFG, "vinyl.compact_bandwidth",
+			 "the value must not be negative");
+		goto error_1;
+	}
+	conf->compact_bandwidth = compact_bandwidth;
 
 	conf->path = strdup(cfg_gets("vinyl_dir"));
 	if (conf->path == NULL) {
@@ -4463,6 +5861,18 @@ vy_info_append_u64(struct vy_info_handler *h, const char *key, uint64_t value)
 	h->fn(&node, h->ctx);
 }
 
+static void
+vy_info_append_double(struct vy_info_handler *h, const char *key,
+		      double value)
+{
+	struct vy_info_node node = {
+		.type = VY_INFO_DOUBLE,
+		.key = key,
+		.value.d = value,
+	};
+	h->fn(&node, h->ctx);
+}
+
 static void
 vy_info_append_str(struct vy_info_handler *h, const char *key,
 		   const char *value)
@@ -4518,6 +5928,12 @@ vy_info_append_memory(struct vy_env *env, struct vy_info_handler *h)
 	vy_info_table_end(h);
 }
 
+static void
+vy_page_cache_info(struct vy_page_cache *cache, struct vy_info_handler *h);
+
+static void
+vy_tuple_cache_info(struct vy_tuple_cache *cache, struct vy_info_handler *h);
+
 static int
 vy_info_append_stat_rmean(const char *name, int rps, int64_t total, void *ctx)
 {
@@ -4544,6 +5960,7 @@ static void
 vy_info_append_performance(struct vy_env *env, struct vy_info_handler *h)
 {
 	struct vy_stat *stat = env->stat;
+	char buf[1024];
 
 	vy_info_table_begin(h, "performance");
 
@@ -4554,62 +5971,426 @@ vy_info_append_performance(struct vy_env *env, struct vy_info_handler *h)
 	vy_info_append_stat_latency(h, "tx_latency", &stat->tx_latency);
 	vy_info_append_stat_latency(h, "get_latency", &stat->get_latency);
 	vy_info_append_stat_latency(h, "cursor_latency", &stat->cursor_latency);
+	vy_info_append_stat_latency(h, "throttle_latency",
+				    &stat->throttle_latency);
+	histogram_snprint(buf, sizeof(buf), stat->throttle_hist);
+	vy_info_append_str(h, "throttle_histogram", buf);
+
+	vy_info_append_u64(h, "tx_rollback", stat->tx_rlb);
+	vy_info_append_u64(h, "tx_conflict", stat->tx_conflict);
+	vy_info_append_u32(h, "tx_active_rw", env->xm->count_rw);
+	vy_info_append_u32(h, "tx_active_ro", env->xm->count_rd);
+
+	vy_info_append_u64(h, "dump_bandwidth", vy_stat_dump_bandwidth(stat));
+	vy_info_append_u64(h, "dump_total", stat->dump_total);
+
+	vy_info_table_end(h);
+}
+
+static void
+vy_info_append_metric(struct vy_env *env, struct vy_info_handler *h)
+{
+	vy_info_table_begin(h, "metric");
+	vy_info_append_u64(h, "lsn", env->xm->lsn);
+	vy_info_table_end(h);
+}
+
+/**
+ * Estimate amplification factors of an index:
+ *
+ * - write: bytes written by dumps and compactions
+ *   per byte written by dumps;
+ * - read: runs to look up per range;
+ * - space: size of all runs per size of the oldest
+ *   runs, which would be the size of a fully merged index.
+ */
+static void
+vy_info_append_amplification(struct vy_index *index,
+			     struct vy_info_handler *h)
+{
+	uint64_t oldest_size = 0;
+	struct vy_range *range = vy_range_tree_first(&index->tree);
+	for (; range != NULL; range = vy_range_tree_next(&index->tree, range)) {
+		if (range->run_count == 0)
+			continue;
+		struct vy_run *run = rlist_last_entry(&range->runs,
+						      struct vy_run, in_range);
+		oldest_size += vy_run_size(run) + vy_run_total(run);
+	}
+	vy_info_append_double(h, "write_amplification",
+			      index->dump_bytes == 0 ? 0 :
+			      (double)(index->dump_bytes +
+				       index->compact_bytes) /
+			      index->dump_bytes);
+	vy_info_append_double(h, "read_amplification",
+			      index->range_count == 0 ? 0 :
+			      (double)index->run_count / index->range_count);
+	vy_info_append_double(h, "space_amplification",
+			      oldest_size == 0 ? 0 :
+			      (double)index->size / oldest_size);
+}
+
+static void
+vy_info_append_indices(struct vy_env *env, struct vy_info_handler *h)
+{
+	struct vy_index *i;
+	char buf[1024];
+
+	vy_info_table_begin(h, "db");
+	rlist_foreach_entry(i, &env->indexes, link) {
+		vy_info_table_begin(h, i->name);
+		vy_info_append_u64(h, "range_size", i->key_def->opts.range_size);
+		vy_info_append_u64(h, "page_size", i->key_def->opts.page_size);
+		vy_info_append_str(h, "compaction", vinyl_compaction_strs[
+				   i->key_def->opts.compaction]);
+		vy_info_append_u64(h, "memory_used", i->used);
+		vy_info_append_u64(h, "size", i->size);
+		vy_info_append_u64(h, "count", i->stmt_count);
+		vy_info_append_u32(h, "page_count", i->page_count);
+		vy_info_append_u64(h, "bloom_hit", i->bloom_hit);
+		vy_info_append_u32(h, "range_count", i->range_count);
+		vy_info_append_u32(h, "run_count", i->run_count);
+		vy_info_append_u32(h, "run_avg", i->run_count / i->range_count);
+		histogram_snprint(buf, sizeof(buf), i->run_hist);
+		vy_info_append_str(h, "run_histogram", buf);
+		vy_info_append_amplification(i, h);
+		vy_info_table_end(h);
+	}
+	vy_info_table_end(h);
+}
+
+void
+vy_info_gather(struct vy_env *env, struct vy_info_handler *h)
+{
+	vy_info_append_indices(env, h);
+	vy_info_append_global(env, h);
+	vy_info_append_memory(env, h);
+	vy_page_cache_info(env->page_cache, h);
+	vy_tuple_cache_info(&env->tuple_cache, h);
+	vy_info_append_metric(env, h);
+	vy_info_append_performance(env, h);
+}
+
+/** }}} Introspection */
+
+/* {{{ Tuple cache */
+
+/**
+ * Each index caches fully merged statements found by read
+ * iterators in a tree ordered by the index key, so that hot
+ * reads don't have to merge the transaction write set, all
+ * in-memory indexes and all runs of a range over and over
+ * again.
+ *
+ * Besides the statements themselves, the cache remembers which
+ * of them were returned by an iterator one after another: if
+ * two adjacent entries are linked, there are no keys between
+ * them in the index. This lets a range scan walk the cache from
+ * one entry to the next without looking at the sources at all,
+ * and lets a point lookup of a missing key inside a chain return
+ * nothing right away.
+ *
+ * The cache stores the newest committed data, so it only serves
+ * readers that see the newest data and have no uncommitted
+ * changes of their own. Writes update or drop cached statements
+ * and break chains as they are committed, see
+ * vy_index_cache_invalidate().
+ *
+ * The cache only uses memory that is left under the quota
+ * watermark by in-memory indexes and gives it up, least recently
+ * used statements first, as writers need it.
+ */
+enum {
+	/** There are no keys between the entry and the previous one. */
+	VY_CACHE_LEFT_LINKED = 1 << 0,
+	/** There are no keys between the entry and the next one. */
+	VY_CACHE_RIGHT_LINKED = 1 << 1,
+};
+
+struct vy_cache_entry {
+	/** Index this entry belongs to. */
+	struct vy_index *index;
+	/** Cached REPLACE statement. */
+	struct tuple *stmt;
+	/** Bitmask of VY_CACHE_LEFT_LINKED, VY_CACHE_RIGHT_LINKED. */
+	uint8_t flags;
+	/** Member of vy_index->cache. */
+	rb_node(struct vy_cache_entry) in_tree;
+	/** Link in vy_tuple_cache->lru. */
+	struct rlist in_lru;
+};
+
+static int
+vy_cache_tree_cmp(struct vy_cache_entry *a, struct vy_cache_entry *b)
+{
+	return vy_stmt_compare(a->stmt, b->stmt, a->index->key_def);
+}
+
+static int
+vy_cache_tree_key_cmp(const struct tuple *key, struct vy_cache_entry *entry)
+{
+	return vy_stmt_compare(key, entry->stmt, entry->index->key_def);
+}
+
+rb_gen_ext_key(MAYBE_UNUSED static inline, vy_cache_tree_, vy_cache_tree_t,
+	       struct vy_cache_entry, in_tree, vy_cache_tree_cmp,
+	       const struct tuple *, vy_cache_tree_key_cmp);
+
+static inline size_t
+vy_cache_entry_size(const struct vy_cache_entry *entry)
+{
+	return sizeof(*entry) + tuple_size(entry->stmt);
+}
+
+static void
+vy_tuple_cache_create(struct vy_tuple_cache *cache, struct vy_quota *quota)
+{
+	memset(cache, 0, sizeof(*cache));
+	rlist_create(&cache->lru);
+	cache->quota = quota;
+}
 
-	vy_info_append_u64(h, "tx_rollback", stat->tx_rlb);
-	vy_info_append_u64(h, "tx_conflict", stat->tx_conflict);
-	vy_info_append_u32(h, "tx_active_rw", env->xm->count_rw);
-	vy_info_append_u32(h, "tx_active_ro", env->xm->count_rd);
+/**
+ * Break the chains going through an entry, because the
+ * neighbours of the entry are no longer known to be linked
+ * with each other once it is gone.
+ */
+static void
+vy_cache_entry_unlink(struct vy_cache_entry *entry)
+{
+	vy_cache_tree_t *tree = &entry->index->cache;
+	if (entry->flags & VY_CACHE_LEFT_LINKED) {
+		struct vy_cache_entry *prev = vy_cache_tree_prev(tree, entry);
+		assert(prev->flags & VY_CACHE_RIGHT_LINKED);
+		prev->flags &= ~VY_CACHE_RIGHT_LINKED;
+	}
+	if (entry->flags & VY_CACHE_RIGHT_LINKED) {
+		struct vy_cache_entry *next = vy_cache_tree_next(tree, entry);
+		assert(next->flags & VY_CACHE_LEFT_LINKED);
+		next->flags &= ~VY_CACHE_LEFT_LINKED;
+	}
+	entry->flags = 0;
+}
 
-	vy_info_append_u64(h, "dump_bandwidth", vy_stat_dump_bandwidth(stat));
-	vy_info_append_u64(h, "dump_total", stat->dump_total);
+/** Remove an entry from the cache and free it. */
+static void
+vy_cache_entry_delete(struct vy_tuple_cache *cache,
+		      struct vy_cache_entry *entry)
+{
+	vy_cache_tree_remove(&entry->index->cache, entry);
+	rlist_del_entry(entry, in_lru);
+	assert(cache->used >= vy_cache_entry_size(entry));
+	cache->used -= vy_cache_entry_size(entry);
+	tuple_unref(entry->stmt);
+	TRASH(entry);
+	free(entry);
+}
 
-	vy_info_table_end(h);
+/**
+ * Evict least recently used statements until @size more bytes
+ * fit in the memory left under the quota watermark.
+ * @retval true if @size bytes can be added to the cache.
+ */
+static bool
+vy_tuple_cache_evict(struct vy_tuple_cache *cache, size_t size)
+{
+	struct vy_quota *q = cache->quota;
+	size_t room = q->watermark > q->used ? q->watermark - q->used : 0;
+	while (cache->used + size > room && !rlist_empty(&cache->lru)) {
+		struct vy_cache_entry *entry;
+		entry = rlist_last_entry(&cache->lru, struct vy_cache_entry,
+					 in_lru);
+		vy_cache_entry_unlink(entry);
+		vy_cache_entry_delete(cache, entry);
+		cache->evict++;
+	}
+	return cache->used + size <= room;
 }
 
 static void
-vy_info_append_metric(struct vy_env *env, struct vy_info_handler *h)
+vy_tuple_cache_info(struct vy_tuple_cache *cache, struct vy_info_handler *h)
 {
-	vy_info_table_begin(h, "metric");
-	vy_info_append_u64(h, "lsn", env->xm->lsn);
+	vy_info_table_begin(h, "tuple_cache");
+	vy_info_append_u64(h, "used", cache->used);
+	vy_info_append_u64(h, "hit", cache->hit);
+	vy_info_append_u64(h, "miss", cache->miss);
+	vy_info_append_u64(h, "evict", cache->evict);
 	vy_info_table_end(h);
 }
 
+/** Drop all statements cached for an index. */
 static void
-vy_info_append_indices(struct vy_env *env, struct vy_info_handler *h)
+vy_index_cache_destroy(struct vy_index *index)
 {
-	struct vy_index *i;
-	char buf[1024];
+	struct vy_tuple_cache *cache = &index->env->tuple_cache;
+	struct vy_cache_entry *entry;
+	while ((entry = vy_cache_tree_first(&index->cache)) != NULL)
+		vy_cache_entry_delete(cache, entry);
+}
 
-	vy_info_table_begin(h, "db");
-	rlist_foreach_entry(i, &env->indexes, link) {
-		vy_info_table_begin(h, i->name);
-		vy_info_append_u64(h, "range_size", i->key_def->opts.range_size);
-		vy_info_append_u64(h, "page_size", i->key_def->opts.page_size);
-		vy_info_append_u64(h, "memory_used", i->used);
-		vy_info_append_u64(h, "size", i->size);
-		vy_info_append_u64(h, "count", i->stmt_count);
-		vy_info_append_u32(h, "page_count", i->page_count);
-		vy_info_append_u32(h, "range_count", i->range_count);
-		vy_info_append_u32(h, "run_count", i->run_count);
-		vy_info_append_u32(h, "run_avg", i->run_count / i->range_count);
-		histogram_snprint(buf, sizeof(buf), i->run_hist);
-		vy_info_append_str(h, "run_histogram", buf);
-		vy_info_table_end(h);
+/**
+ * Look up the statement a read iterator should return next.
+ * @param index    Index to look up in.
+ * @param type     Iterator type.
+ * @param key      Iterator key.
+ * @param last     Statement returned by the iterator last time,
+ *                 or NULL if nothing has been returned yet.
+ * @param[out] ret The next statement or NULL if there is none.
+ *
+ * @retval true  The cache knows the answer.
+ * @retval false The sources have to be merged.
+ */
+static bool
+vy_index_cache_get(struct vy_index *index, enum iterator_type type,
+		   const struct tuple *key, const struct tuple *last,
+		   struct tuple **ret)
+{
+	struct vy_tuple_cache *cache = &index->env->tuple_cache;
+	vy_cache_tree_t *tree = &index->cache;
+	struct key_def *def = index->key_def;
+	bool is_forward = type != ITER_LE && type != ITER_LT;
+	uint8_t link = is_forward ? VY_CACHE_RIGHT_LINKED :
+				    VY_CACHE_LEFT_LINKED;
+	struct vy_cache_entry *entry;
+	*ret = NULL;
+	if (last != NULL) {
+		entry = vy_cache_tree_search(tree, last);
+	} else {
+		/*
+		 * A partial key may match many statements, and
+		 * we can't tell if all of them are cached.
+		 */
+		if (tuple_field_count(key) < def->part_count)
+			goto miss;
+		entry = vy_cache_tree_search(tree, key);
+		if (entry == NULL) {
+			/* Check if the key falls inside a chain. */
+			entry = is_forward ? vy_cache_tree_psearch(tree, key) :
+					     vy_cache_tree_nsearch(tree, key);
+		} else if (type != ITER_GT && type != ITER_LT) {
+			goto hit;
+		}
 	}
-	vy_info_table_end(h);
+	if (entry == NULL || !(entry->flags & link))
+		goto miss;
+	entry = is_forward ? vy_cache_tree_next(tree, entry) :
+			     vy_cache_tree_prev(tree, entry);
+	assert(entry != NULL);
+	if (type == ITER_EQ &&
+	    vy_stmt_compare_with_key(entry->stmt, key, def) != 0) {
+		/* The next key doesn't match, the search is over. */
+		cache->hit++;
+		return true;
+	}
+hit:
+	cache->hit++;
+	rlist_move_entry(&cache->lru, entry, in_lru);
+	*ret = entry->stmt;
+	return true;
+miss:
+	cache->miss++;
+	return false;
 }
 
-void
-vy_info_gather(struct vy_env *env, struct vy_info_handler *h)
+/**
+ * Add a statement returned by a read iterator to the cache.
+ * If @prev, the statement returned by the iterator before,
+ * is cached too, link them: there are no keys between them.
+ */
+static void
+vy_index_cache_add(struct vy_index *index, enum iterator_type type,
+		   struct tuple *stmt, struct tuple *prev)
 {
-	vy_info_append_indices(env, h);
-	vy_info_append_global(env, h);
-	vy_info_append_memory(env, h);
-	vy_info_append_metric(env, h);
-	vy_info_append_performance(env, h);
+	assert(vy_stmt_type(stmt) == IPROTO_REPLACE);
+	struct vy_tuple_cache *cache = &index->env->tuple_cache;
+	vy_cache_tree_t *tree = &index->cache;
+	struct vy_cache_entry *entry = vy_cache_tree_search(tree, stmt);
+	if (entry != NULL) {
+		rlist_move_entry(&cache->lru, entry, in_lru);
+	} else {
+		size_t size = sizeof(*entry) + tuple_size(stmt);
+		if (!vy_tuple_cache_evict(cache, size))
+			return;
+		entry = malloc(sizeof(*entry));
+		if (entry == NULL)
+			return; /* caching is optional */
+		entry->index = index;
+		entry->stmt = stmt;
+		entry->flags = 0;
+		tuple_ref(stmt);
+		vy_cache_tree_insert(tree, entry);
+		rlist_add_entry(&cache->lru, entry, in_lru);
+		cache->used += size;
+	}
+	if (prev == NULL)
+		return;
+	struct vy_cache_entry *prev_entry = vy_cache_tree_search(tree, prev);
+	if (prev_entry == NULL)
+		return;
+	bool is_forward = type != ITER_LE && type != ITER_LT;
+	struct vy_cache_entry *left = is_forward ? prev_entry : entry;
+	struct vy_cache_entry *right = is_forward ? entry : prev_entry;
+	if (vy_cache_tree_next(tree, left) != right)
+		return;
+	left->flags |= VY_CACHE_RIGHT_LINKED;
+	right->flags |= VY_CACHE_LEFT_LINKED;
 }
 
-/** }}} Introspection */
+/**
+ * Update the cache of an index on commit of @stmt to the index.
+ */
+static void
+vy_index_cache_invalidate(struct vy_index *index, struct tuple *stmt)
+{
+	index->cache_version++;
+	struct vy_tuple_cache *cache = &index->env->tuple_cache;
+	vy_cache_tree_t *tree = &index->cache;
+	struct vy_cache_entry *entry = vy_cache_tree_search(tree, stmt);
+	if (entry == NULL) {
+		/*
+		 * Deleting a key that isn't cached can't break
+		 * a chain, because the key is either missing or
+		 * not linked with anything. A new key can.
+		 */
+		if (vy_stmt_type(stmt) == IPROTO_DELETE)
+			return;
+		struct vy_cache_entry *prev = vy_cache_tree_psearch(tree, stmt);
+		if (prev != NULL && (prev->flags & VY_CACHE_RIGHT_LINKED)) {
+			struct vy_cache_entry *next =
+				vy_cache_tree_next(tree, prev);
+			prev->flags &= ~VY_CACHE_RIGHT_LINKED;
+			next->flags &= ~VY_CACHE_LEFT_LINKED;
+		}
+		return;
+	}
+	switch (vy_stmt_type(stmt)) {
+	case IPROTO_REPLACE:
+		/* The key stays, so do the chains. */
+		cache->used -= tuple_size(entry->stmt);
+		cache->used += tuple_size(stmt);
+		tuple_ref(stmt);
+		tuple_unref(entry->stmt);
+		entry->stmt = stmt;
+		break;
+	case IPROTO_DELETE:
+		/*
+		 * If the key was linked with both neighbours, they
+		 * are linked with each other now that it's gone.
+		 */
+		if ((entry->flags & VY_CACHE_LEFT_LINKED) == 0 ||
+		    (entry->flags & VY_CACHE_RIGHT_LINKED) == 0)
+			vy_cache_entry_unlink(entry);
+		vy_cache_entry_delete(cache, entry);
+		break;
+	default:
+		/* UPSERT: the new value is unknown until merged. */
+		vy_cache_entry_unlink(entry);
+		vy_cache_entry_delete(cache, entry);
+		break;
+	}
+}
+
+/* }}} Tuple cache */
 
 static int
 vy_index_conf_create(struct vy_index *conf, struct key_def *key_def)
@@ -4839,6 +6620,7 @@ vy_index_new(struct vy_env *e, struct key_def *user_key_def,
 	}
 
 	vy_range_tree_new(&index->tree);
+	vy_cache_tree_new(&index->cache);
 	index->version = 1;
 	rlist_create(&index->link);
 	read_set_new(&index->read_set);
@@ -4883,6 +6665,7 @@ static void
 vy_index_delete(struct vy_index *index)
 {
 	read_set_iter(&index->read_set, NULL, read_set_delete_cb, NULL);
+	vy_index_cache_destroy(index);
 	vy_range_tree_iter(&index->tree, NULL, vy_range_tree_free_cb, index);
 	free(index->name);
 	free(index->path);
@@ -6148,7 +7931,27 @@ vy_commit(struct vy_env *e, struct vy_tx *tx, int64_t lsn)
 	TRASH(tx);
 	free(tx);
 
+	/* Give the memory used by the tuple cache to the writer. */
+	vy_tuple_cache_evict(&e->tuple_cache, write_size);
+
+	/*
+	 * Block the writer until a dump completes if the memory
+	 * limit is hit, or slow it down if memory is consumed
+	 * faster than dumps can free it. A slowed down writer is
+	 * woken up early as soon as a dump releases memory.
+	 */
+	ev_tstamp start = ev_now(loop());
 	vy_quota_use(quota, write_size);
+	if (e->status == VINYL_ONLINE) {
+		double delay = vy_quota_delay(quota, write_size,
+					      ev_now(loop()));
+		if (delay > 0)
+			ipc_cond_wait_timeout(&e->scheduler->quota_cond,
+					      delay);
+	}
+	ev_tstamp throttle_time = ev_now(loop()) - start;
+	if (throttle_time > 0)
+		vy_stat_throttle(e->stat, throttle_time);
 	return 0;
 }
 
@@ -6242,6 +8045,9 @@ vy_env_quota_timer_cb(ev_loop *loop, ev_timer *timer, int events)
 
 	vy_quota_update_watermark(&e->quota, max_range_size,
 				  tx_write_rate, dump_bandwidth);
+	vy_quota_set_throttle_rate(&e->quota, dump_bandwidth);
+	/* The watermark may have gone down. */
+	vy_tuple_cache_evict(&e->tuple_cache, 0);
 }
 
 /** Destructor for env->zdctx_key thread-local variable */
@@ -6256,6 +8062,12 @@ static struct vy_squash_queue *
 vy_squash_queue_new(void);
 static void
 vy_squash_queue_delete(struct vy_squash_queue *q);
+static struct vy_page_cache *
+vy_page_cache_new(size_t limit);
+static void
+vy_page_cache_delete(struct vy_page_cache *cache);
+static void
+vy_page_cache_drain(struct vy_page_cache *cache);
 
 struct vy_env *
 vy_env_new(void)
@@ -6286,6 +8098,9 @@ vy_env_new(void)
 	e->log = vy_log_new(e->conf->path);
 	if (e->log == NULL)
 		goto error_log;
+	e->page_cache = vy_page_cache_new(e->conf->page_cache);
+	if (e->page_cache == NULL)
+		goto error_page_cache;
 
 	struct slab_cache *slab_cache = cord_slab_cache();
 	mempool_create(&e->cursor_pool, slab_cache,
@@ -6297,10 +8112,15 @@ vy_env_new(void)
 
 	vy_quota_init(&e->quota, e->conf->memory_limit,
 		      vy_scheduler_quota_cb, e->scheduler);
+	vy_tuple_cache_create(&e->tuple_cache, &e->quota);
+	vy_rate_limit_create(&e->compact_rate_limit,
+			     e->conf->compact_bandwidth);
 	ev_timer_init(&e->quota_timer, vy_env_quota_timer_cb, 0, 1.);
 	e->quota_timer.data = e;
 	ev_timer_start(loop(), &e->quota_timer);
 	return e;
+error_page_cache:
+	vy_log_delete(e->log);
 error_log:
 	vy_squash_queue_delete(e->squash_queue);
 error_squash_queue:
@@ -6320,15 +8140,22 @@ void
 vy_env_delete(struct vy_env *e)
 {
 	struct vy_index *index, *tmp;
+	/*
+	 * Read ahead tasks reference the page cache, the runs
+	 * and read_task_pool: let them finish before freeing.
+	 */
+	vy_page_cache_drain(e->page_cache);
 	rlist_foreach_entry_safe(index, &e->indexes, link, tmp)
 		vy_index_unref(index);
 	ev_timer_stop(loop(), &e->quota_timer);
 	vy_squash_queue_delete(e->squash_queue);
 	vy_scheduler_delete(e->scheduler);
+	vy_rate_limit_destroy(&e->compact_rate_limit);
 	tx_manager_delete(e->xm);
 	vy_conf_delete(e->conf);
 	vy_stat_delete(e->stat);
 	vy_log_delete(e->log);
+	vy_page_cache_delete(e->page_cache);
 	if (e->recovery != NULL)
 		vy_recovery_delete(e->recovery);
 	mempool_destroy(&e->cursor_pool);
@@ -6476,6 +8303,27 @@ struct vy_run_iterator_pos {
 	uint32_t pos_in_page;
 };
 
+/**
+ * Sequential decoder of a packed page, see vy_page_encoder_add().
+ * The key is rebuilt in a buffer owned by the cursor, so a cursor
+ * may outlive a single lookup and continue from where it stopped.
+ */
+struct vy_page_cursor {
+	/** The page being decoded, NULL if not positioned. */
+	const struct vy_page *page;
+	/** Position of the next entry. */
+	const char *pos;
+	/** Number of the next entry in the page. */
+	uint32_t stmt_no;
+	/** True if an entry was decoded since the last seek. */
+	bool has_entry;
+	/** The last decoded entry. */
+	struct vy_page_entry entry;
+	/** Key of the last decoded entry. */
+	char *key;
+	uint32_t key_capacity;
+};
+
 /**
  * Return statements from vy_run based on initial search key,
  * iteration order and view lsn.
@@ -6522,9 +8370,20 @@ struct vy_run_iterator {
 	struct tuple *curr_stmt;
 	/** Position of record that spawned curr_stmt */
 	struct vy_run_iterator_pos curr_stmt_pos;
-	/** LRU cache of two active pages (two pages is enough). */
+	/**
+	 * Two most recently used pages, referenced by the
+	 * iterator (two pages is enough). In the tx thread the
+	 * pages are shared via env->page_cache.
+	 */
 	struct vy_page *curr_page;
 	struct vy_page *prev_page;
+	/**
+	 * Decoder of the last read packed page. In-order reads
+	 * continue from it instead of the restart point.
+	 */
+	struct vy_page_cursor cursor;
+	/** Number of page boundaries crossed by next_key() */
+	uint32_t seq_page_count;
 	/** Is false until first .._get ot .._next_.. method is called */
 	bool search_started;
 	/** Search is finished, you will not get more values from iterator */
@@ -6538,68 +8397,502 @@ vy_run_iterator_open(struct vy_run_iterator *itr, struct vy_range *range,
 
 /* }}} vy_run_iterator API forward declaration */
 
-/* {{{ vy_run_iterator vy_run_iterator support functions */
-/* TODO: move to appropriate c file and remove */
+/* {{{ vy_run_iterator vy_run_iterator support functions */
+/* TODO: move to appropriate c file and remove */
+
+/**
+ * Page
+ */
+struct vy_page {
+	/** ID of the run the page belongs to */
+	int64_t run_id;
+	/** Page position in the run file */
+	uint32_t page_no;
+	/** The number of statements */
+	uint32_t count;
+	/** Page data size */
+	uint32_t unpacked_size;
+	/** Page data format, see enum vy_page_format */
+	uint32_t format;
+	/**
+	 * Array with row offsets in page data, or with offsets
+	 * of restart points in entries for a packed page
+	 */
+	uint32_t *row_index;
+	/** Page data */
+	char *data;
+	/** Packed entries, points into data */
+	const char *entries;
+	/** Number of restart points in a packed page */
+	uint32_t restart_count;
+	/**
+	 * Reference counter: one for each iterator using the
+	 * page, plus one if the page is in the page cache.
+	 */
+	int refs;
+	/** True if the page is in the page cache */
+	bool in_cache;
+	/** True if the page is in the hot list of the page cache */
+	bool is_hot;
+	/** Link in vy_page_cache->cold or vy_page_cache->hot */
+	struct rlist in_lru;
+};
+
+static struct vy_page *
+vy_page_new(const struct vy_page_info *page_info)
+{
+	struct vy_page *page = malloc(sizeof(*page));
+	if (page == NULL) {
+		diag_set(OutOfMemory, sizeof(*page),
+			"load_page", "page cache");
+		return NULL;
+	}
+	page->run_id = -1;
+	page->page_no = UINT32_MAX;
+	page->count = page_info->count;
+	page->unpacked_size = page_info->unpacked_size;
+	page->format = page_info->format;
+	page->entries = NULL;
+	page->restart_count = (page->count + VY_PAGE_RESTART_INTERVAL - 1) /
+			      VY_PAGE_RESTART_INTERVAL;
+	page->refs = 1;
+	page->in_cache = false;
+	page->is_hot = false;
+	rlist_create(&page->in_lru);
+	page->row_index = calloc(page_info->count, sizeof(uint32_t));
+	if (page->row_index == NULL) {
+		diag_set(OutOfMemory, page_info->count * sizeof(uint32_t),
+			 "malloc", "page->row_index");
+		free(page);
+		return NULL;
+	}
+
+	page->data = (char *)malloc(page_info->unpacked_size);
+	if (page->data == NULL) {
+		diag_set(OutOfMemory, page_info->unpacked_size,
+			 "malloc", "page->data");
+		free(page->row_index);
+		free(page);
+		return NULL;
+	}
+	return page;
+}
+
+static void
+vy_page_delete(struct vy_page *page)
+{
+	assert(!page->in_cache);
+	uint32_t *row_index = page->row_index;
+	char *data = page->data;
+#if !defined(NDEBUG)
+	memset(page->row_index, '#', sizeof(uint32_t) * page->count);
+	memset(page->data, '#', page->unpacked_size);
+	memset(page, '#', sizeof(*page));
+#endif /* !defined(NDEBUG) */
+	free(row_index);
+	free(data);
+	free(page);
+}
+
+static inline void
+vy_page_ref(struct vy_page *page)
+{
+	assert(page->refs > 0);
+	page->refs++;
+}
+
+static inline void
+vy_page_unref(struct vy_page *page)
+{
+	assert(page->refs > 0);
+	if (--page->refs == 0)
+		vy_page_delete(page);
+}
+
+/** Memory used by a page, for page cache accounting. */
+static inline size_t
+vy_page_size(const struct vy_page *page)
+{
+	return sizeof(*page) + page->unpacked_size +
+		page->count * sizeof(uint32_t);
+}
+
+/* {{{ Page cache */
+
+/**
+ * A cache of decompressed run pages shared by all iterators of
+ * the tx thread, keyed by (run id, page no). Runs are immutable,
+ * and run ids are never reused, so a cached page never goes
+ * stale. Pages of deleted runs are never looked up again and
+ * simply age out of the cache.
+ *
+ * Eviction follows the 2Q policy, which is resistant to scans:
+ * a newly loaded page enters the FIFO 'cold' list and is moved
+ * to the LRU 'hot' list only if it is accessed again while still
+ * cached. The cold list is allowed to take a quarter of the cache
+ * at most, so a long range scan can't wash hot pages out.
+ *
+ * An evicted page is freed only when the last iterator using it
+ * drops its reference.
+ *
+ * Sequential scans read pages ahead in background, see
+ * vy_page_prefetch(). Pages being read are tracked, so that an
+ * iterator needing one waits for the read instead of issuing
+ * another one.
+ */
+struct vy_page_cache_key {
+	int64_t run_id;
+	uint32_t page_no;
+};
+
+static inline uint32_t
+vy_page_cache_hash(int64_t run_id, uint32_t page_no)
+{
+	uint64_t h = (uint64_t)run_id * 0x9E3779B97F4A7C15ULL + page_no;
+	return (uint32_t)(h ^ (h >> 32));
+}
+
+#define mh_name _vy_page
+#define mh_key_t const struct vy_page_cache_key *
+#define mh_node_t struct vy_page *
+#define mh_arg_t void *
+#define mh_hash(a, arg) vy_page_cache_hash((*(a))->run_id, (*(a))->page_no)
+#define mh_hash_key(a, arg) vy_page_cache_hash((a)->run_id, (a)->page_no)
+#define mh_cmp(a, b, arg) ((*(a))->run_id != (*(b))->run_id || \
+			   (*(a))->page_no != (*(b))->page_no)
+#define mh_cmp_key(a, b, arg) ((a)->run_id != (*(b))->run_id || \
+			       (a)->page_no != (*(b))->page_no)
+#define MH_SOURCE 1
+#include "salad/mhash.h"
+
+struct vy_page_cache {
+	/** (run id, page no) -> struct vy_page */
+	struct mh_vy_page_t *pages;
+	/** Pages being read ahead, not in the cache yet */
+	struct mh_vy_page_t *loading;
+	/** Signaled when a page read ahead is loaded */
+	struct ipc_cond loaded;
+	/** Pages accessed once, in order of loading, newest first */
+	struct rlist cold;
+	/** Pages accessed more than once, most recently used first */
+	struct rlist hot;
+	/** Memory used by pages in the cold list */
+	size_t cold_size;
+	/** Memory used by all cached pages */
+	size_t size;
+	/** Max memory the cache may use, vinyl.page_cache */
+	size_t limit;
+	/** Number of lookups that found the page in the cache */
+	uint64_t hit;
+	/** Number of lookups that had to read the page from disk */
+	uint64_t miss;
+	/** Number of pages evicted from the cache */
+	uint64_t evict;
+	/** Number of pages read ahead */
+	uint64_t prefetch;
+};
+
+static struct vy_page_cache *
+vy_page_cache_new(size_t limit)
+{
+	struct vy_page_cache *cache = calloc(1, sizeof(*cache));
+	if (cache == NULL) {
+		diag_set(OutOfMemory, sizeof(*cache), "malloc",
+			 "struct vy_page_cache");
+		return NULL;
+	}
+	cache->pages = mh_vy_page_new();
+	if (cache->pages == NULL) {
+		diag_set(OutOfMemory, sizeof(*cache->pages), "malloc",
+			 "page cache hash");
+		free(cache);
+		return NULL;
+	}
+	cache->loading = mh_vy_page_new();
+	if (cache->loading == NULL) {
+		diag_set(OutOfMemory, sizeof(*cache->loading), "malloc",
+			 "page cache hash");
+		mh_vy_page_delete(cache->pages);
+		free(cache);
+		return NULL;
+	}
+	ipc_cond_create(&cache->loaded);
+	rlist_create(&cache->cold);
+	rlist_create(&cache->hot);
+	cache->limit = limit;
+	return cache;
+}
+
+static void
+vy_page_cache_remove(struct vy_page_cache *cache, struct vy_page *page)
+{
+	assert(page->in_cache);
+	struct vy_page_cache_key key = { page->run_id, page->page_no };
+	mh_int_t k = mh_vy_page_find(cache->pages, &key, NULL);
+	assert(k != mh_end(cache->pages));
+	mh_vy_page_del(cache->pages, k, NULL);
+	rlist_del_entry(page, in_lru);
+	size_t size = vy_page_size(page);
+	if (!page->is_hot)
+		cache->cold_size -= size;
+	cache->size -= size;
+	page->in_cache = false;
+	page->is_hot = false;
+	vy_page_unref(page);
+}
+
+static void
+vy_page_cache_delete(struct vy_page_cache *cache)
+{
+	struct vy_page *page, *tmp;
+	rlist_foreach_entry_safe(page, &cache->cold, in_lru, tmp)
+		vy_page_cache_remove(cache, page);
+	rlist_foreach_entry_safe(page, &cache->hot, in_lru, tmp)
+		vy_page_cache_remove(cache, page);
+	mh_vy_page_delete(cache->pages);
+	/* Pages being read belong to their coio tasks. */
+	mh_vy_page_delete(cache->loading);
+	ipc_cond_destroy(&cache->loaded);
+	free(cache);
+}
+
+/** Evict pages until the cache fits in its limit. */
+static void
+vy_page_cache_evict(struct vy_page_cache *cache)
+{
+	while (cache->size > cache->limit) {
+		struct rlist *victims = &cache->hot;
+		if (cache->cold_size > cache->limit / 4 ||
+		    rlist_empty(&cache->hot))
+			victims = &cache->cold;
+		struct vy_page *page = rlist_last_entry(victims,
+							struct vy_page, in_lru);
+		vy_page_cache_remove(cache, page);
+		cache->evict++;
+	}
+}
+
+static struct vy_page *
+vy_page_cache_find(struct vy_page_cache *cache, int64_t run_id,
+		   uint32_t page_no)
+{
+	struct vy_page_cache_key key = { run_id, page_no };
+	mh_int_t k = mh_vy_page_find(cache->pages, &key, NULL);
+	if (k == mh_end(cache->pages))
+		return NULL;
+	return *mh_vy_page_node(cache->pages, k);
+}
+
+/**
+ * Look up a page in the cache.
+ * @retval page with an extra reference if found
+ * @retval NULL otherwise
+ */
+static struct vy_page *
+vy_page_cache_get(struct vy_page_cache *cache, int64_t run_id,
+		  uint32_t page_no)
+{
+	struct vy_page *page = vy_page_cache_find(cache, run_id, page_no);
+	if (page == NULL) {
+		cache->miss++;
+		return NULL;
+	}
+	cache->hit++;
+	if (!page->is_hot) {
+		/* The second access: promote the page. */
+		cache->cold_size -= vy_page_size(page);
+		page->is_hot = true;
+	}
+	rlist_move_entry(&cache->hot, page, in_lru);
+	vy_page_ref(page);
+	return page;
+}
+
+/**
+ * Add a freshly loaded page to the cache. Failure to add a page
+ * is not an error: the page stays private to the caller.
+ */
+static void
+vy_page_cache_put(struct vy_page_cache *cache, struct vy_page *page)
+{
+	assert(!page->in_cache);
+	size_t size = vy_page_size(page);
+	if (size > cache->limit / 4)
+		return; /* would wash out the whole cold list */
+	if (vy_page_cache_find(cache, page->run_id, page->page_no) != NULL)
+		return; /* another copy was loaded meanwhile */
+	if (mh_vy_page_put(cache->pages, &page, NULL,
+			   NULL) == mh_end(cache->pages))
+		return;
+	vy_page_ref(page);
+	page->in_cache = true;
+	page->is_hot = false;
+	rlist_add_entry(&cache->cold, page, in_lru);
+	cache->cold_size += size;
+	cache->size += size;
+	vy_page_cache_evict(cache);
+}
+
+static void
+vy_page_cache_info(struct vy_page_cache *cache, struct vy_info_handler *h)
+{
+	vy_info_table_begin(h, "page_cache");
+	vy_info_append_u64(h, "used", cache->size);
+	vy_info_append_u64(h, "limit", cache->limit);
+	vy_info_append_u64(h, "hit", cache->hit);
+	vy_info_append_u64(h, "miss", cache->miss);
+	vy_info_append_u64(h, "evict", cache->evict);
+	vy_info_append_u64(h, "prefetch", cache->prefetch);
+	vy_info_table_end(h);
+}
+
+/* }}} Page cache */
+
+static void
+vy_page_cursor_create(struct vy_page_cursor *cursor)
+{
+	memset(cursor, 0, sizeof(*cursor));
+}
+
+static void
+vy_page_cursor_destroy(struct vy_page_cursor *cursor)
+{
+	free(cursor->key);
+}
+
+/** Position the cursor at the given restart point. */
+static void
+vy_page_cursor_seek(struct vy_page_cursor *cursor,
+		    const struct vy_page *page, uint32_t restart)
+{
+	assert(page->format == VY_PAGE_FORMAT_PACKED);
+	assert(restart < page->restart_count);
+	cursor->page = page;
+	cursor->pos = page->entries + page->row_index[restart];
+	cursor->stmt_no = restart * VY_PAGE_RESTART_INTERVAL;
+	cursor->has_entry = false;
+	cursor->entry.lsn = 0;
+}
 
 /**
- * Page
+ * Decode the next entry and rebuild its key.
+ * @retval  0 success
+ * @retval -1 out of memory
  */
-struct vy_page {
-	/** Page position in the run file (used by run_iterator->page_cache */
-	uint32_t page_no;
-	/** The number of statements */
-	uint32_t count;
-	/** Page data size */
-	uint32_t unpacked_size;
-	/** Array with row offsets in page data */
-	uint32_t *row_index;
-	/** Page data */
-	char *data;
-};
-
-static struct vy_page *
-vy_page_new(const struct vy_page_info *page_info)
-{
-	struct vy_page *page = malloc(sizeof(*page));
-	if (page == NULL) {
-		diag_set(OutOfMemory, sizeof(*page),
-			"load_page", "page cache");
-		return NULL;
-	}
-	page->count = page_info->count;
-	page->unpacked_size = page_info->unpacked_size;
-	page->row_index = calloc(page_info->count, sizeof(uint32_t));
-	if (page->row_index == NULL) {
-		diag_set(OutOfMemory, page_info->count * sizeof(uint32_t),
-			 "malloc", "page->row_index");
-		free(page);
-		return NULL;
+static int
+vy_page_cursor_next(struct vy_page_cursor *cursor)
+{
+	assert(cursor->stmt_no < cursor->page->count);
+	struct vy_page_entry *entry = &cursor->entry;
+	cursor->pos = vy_page_entry_decode(cursor->pos, entry->lsn, entry);
+	cursor->stmt_no++;
+	uint32_t key_size = entry->shared + entry->unshared;
+	if (key_size > cursor->key_capacity) {
+		uint32_t capacity = MAX(key_size, cursor->key_capacity * 2);
+		/* realloc() keeps the shared prefix in place. */
+		char *key = realloc(cursor->key, capacity);
+		if (key == NULL) {
+			diag_set(OutOfMemory, capacity, "realloc", "page key");
+			cursor->page = NULL;
+			return -1;
+		}
+		cursor->key = key;
+		cursor->key_capacity = capacity;
 	}
+	cursor->has_entry = true;
+	memcpy(cursor->key + entry->shared, entry->key, entry->unshared);
+	return 0;
+}
 
-	page->data = (char *)malloc(page_info->unpacked_size);
-	if (page->data == NULL) {
-		diag_set(OutOfMemory, page_info->unpacked_size,
-			 "malloc", "page->data");
-		free(page->row_index);
-		free(page);
+/** Create a statement from the last decoded entry. */
+static struct tuple *
+vy_page_cursor_stmt(struct vy_page_cursor *cursor,
+		    struct tuple_format *format, const struct key_def *key_def)
+{
+	const struct vy_page_entry *entry = &cursor->entry;
+	const char *key = cursor->key;
+	uint32_t key_size = entry->shared + entry->unshared;
+	const char *data = key;
+	uint32_t data_size = key_size;
+	if (entry->value_kind == VY_PAGE_VALUE_FULL) {
+		data = entry->value;
+		data_size = entry->value_size;
+	} else if (entry->value_kind == VY_PAGE_VALUE_PREFIX) {
+		const char *key_body = key;
+		mp_decode_array(&key_body);
+		uint32_t key_body_size = key + key_size - key_body;
+		const char *value_body = entry->value;
+		mp_decode_array(&value_body);
+		uint32_t header_size = value_body - entry->value;
+		data_size = entry->value_size + key_body_size;
+		char *buf = region_alloc(&fiber()->gc, data_size);
+		if (buf == NULL) {
+			diag_set(OutOfMemory, data_size, "region", "page stmt");
+			return NULL;
+		}
+		memcpy(buf, entry->value, header_size);
+		memcpy(buf + header_size, key_body, key_body_size);
+		memcpy(buf + header_size + key_body_size, value_body,
+		       entry->value_size - header_size);
+		data = buf;
+	}
+	struct tuple *stmt;
+	struct iovec ops;
+	uint32_t part_count;
+	switch (entry->type) {
+	case IPROTO_DELETE:
+		part_count = mp_decode_array(&data);
+		assert(part_count == key_def->part_count);
+		stmt = vy_stmt_new_delete(format, data, part_count);
+		break;
+	case IPROTO_REPLACE:
+		stmt = vy_stmt_new_replace(data, data + data_size, format,
+					   key_def->part_count);
+		break;
+	case IPROTO_UPSERT:
+		ops.iov_base = (char *) entry->ops;
+		ops.iov_len = entry->ops_size;
+		stmt = vy_stmt_new_upsert(data, data + data_size, format,
+					  key_def->part_count, &ops, 1);
+		break;
+	default:
+		diag_set(ClientError, ER_VINYL, "unknown request type");
 		return NULL;
 	}
-	return page;
+	if (stmt == NULL)
+		return NULL; /* OOM */
+	vy_stmt_lsn_set(stmt, entry->lsn);
+	return stmt;
 }
 
-static void
-vy_page_delete(struct vy_page *page)
-{
-	uint32_t *row_index = page->row_index;
-	char *data = page->data;
-#if !defined(NDEBUG)
-	memset(page->row_index, '#', sizeof(uint32_t) * page->count);
-	memset(page->data, '#', page->unpacked_size);
-	memset(page, '#', sizeof(*page));
-#endif /* !defined(NDEBUG) */
-	free(row_index);
-	free(data);
-	free(page);
+/**
+ * Read a statement from a packed page. If the cursor is already
+ * positioned between the closest preceding restart point and the
+ * statement, decoding continues from the cursor, so in-order
+ * reads decode every entry once. Otherwise the cursor is moved
+ * to the restart point.
+ */
+static struct tuple *
+vy_page_packed_stmt(struct vy_page *page, uint32_t stmt_no,
+		    struct tuple_format *format, const struct key_def *key_def,
+		    struct vy_page_cursor *cursor)
+{
+	uint32_t restart = stmt_no / VY_PAGE_RESTART_INTERVAL;
+	if (cursor->page != page || cursor->stmt_no > stmt_no + 1 ||
+	    cursor->stmt_no < restart * VY_PAGE_RESTART_INTERVAL ||
+	    (cursor->stmt_no == stmt_no + 1 && !cursor->has_entry))
+		vy_page_cursor_seek(cursor, page, restart);
+	struct region *region = &fiber()->gc;
+	size_t region_svp = region_used(region);
+	struct tuple *stmt = NULL;
+	while (cursor->stmt_no <= stmt_no) {
+		if (vy_page_cursor_next(cursor) != 0)
+			goto out;
+	}
+	stmt = vy_page_cursor_stmt(cursor, format, key_def);
+out:
+	region_truncate(region, region_svp);
+	return stmt;
 }
 
 /**
@@ -6607,13 +8900,18 @@ vy_page_delete(struct vy_page *page)
  * \param page page
  * \param stmt_no stmt position in the page
  * \param[out] pinfo stmt metadata
+ * \param cursor decoder of a packed page, unused for XROW pages
  * \return stmt data including offsets table
  */
 static struct tuple *
 vy_page_stmt(struct vy_page *page, uint32_t stmt_no,
-	     struct tuple_format *format, const struct key_def *key_def)
+	     struct tuple_format *format, const struct key_def *key_def,
+	     struct vy_page_cursor *cursor)
 {
 	assert(stmt_no < page->count);
+	if (page->format == VY_PAGE_FORMAT_PACKED)
+		return vy_page_packed_stmt(page, stmt_no, format, key_def,
+					   cursor);
 	const char *data = page->data + page->row_index[stmt_no];
 	const char *data_end = stmt_no + 1 < page->count ?
 		page->data + page->row_index[stmt_no + 1] :
@@ -6625,7 +8923,7 @@ vy_page_stmt(struct vy_page *page, uint32_t stmt_no,
 }
 
 /**
- * Get page from LRU cache
+ * Get page from the iterator LRU cache
  * @retval page if found
  * @retval NULL otherwise
  */
@@ -6661,17 +8959,19 @@ vy_run_iterator_cache_touch(struct vy_run_iterator *itr, uint32_t page_no)
 }
 
 /**
- * Put page to LRU cache
+ * Put page to the iterator LRU cache. The cache takes over
+ * the caller's reference to the page.
  */
 static void
-vy_run_iterator_cache_put(struct vy_run_iterator *itr, struct vy_page *page,
-			  uint32_t page_no)
+vy_run_iterator_cache_put(struct vy_run_iterator *itr, struct vy_page *page)
 {
-	if (itr->prev_page != NULL)
-		vy_page_delete(itr->prev_page);
+	if (itr->prev_page != NULL) {
+		if (itr->cursor.page == itr->prev_page)
+			itr->cursor.page = NULL;
+		vy_page_unref(itr->prev_page);
+	}
 	itr->prev_page = itr->curr_page;
 	itr->curr_page = page;
-	page->page_no = page_no;
 }
 
 /**
@@ -6686,11 +8986,12 @@ vy_run_iterator_cache_clean(struct vy_run_iterator *itr)
 		itr->curr_stmt_pos.page_no = UINT32_MAX;
 	}
 	if (itr->curr_page != NULL) {
-		vy_page_delete(itr->curr_page);
+		vy_page_unref(itr->curr_page);
 		if (itr->prev_page != NULL)
-			vy_page_delete(itr->prev_page);
+			vy_page_unref(itr->prev_page);
 		itr->curr_page = itr->prev_page = NULL;
 	}
+	itr->cursor.page = NULL;
 }
 
 static int
@@ -6719,6 +9020,35 @@ error:
 	assert(pos == request.tuple_end);
 	return 0;
 }
+
+/**
+ * Find the packed entries of a page in the decoded xrow.
+ * The entries are not copied, the page refers to the xrow body.
+ */
+static int
+vy_page_entries_decode(struct vy_page *page, struct xrow_header *xrow)
+{
+	struct request request;
+	request_create(&request, xrow->type);
+	if (request_decode(&request, xrow->body->iov_base,
+			   xrow->body->iov_len) == -1) {
+		return -1;
+	}
+	if (request.tuple == NULL) {
+error:
+		diag_set(ClientError, ER_VINYL, "Can't decode page entries");
+		return -1;
+	}
+	const char *pos = request.tuple;
+	if (mp_decode_array(&pos) != 1 || mp_typeof(*pos) != MP_BIN)
+		goto error;
+	uint32_t size = mp_decode_binl(&pos);
+	if (pos + size != request.tuple_end)
+		goto error;
+	page->entries = pos;
+	return 0;
+}
+
 /**
  * Read a page requests from vinyl xlog data file.
  *
@@ -6759,11 +9089,21 @@ vy_page_read(struct vy_page *page, const struct vy_page_info *page_info, int fd,
 		goto error;
 
 	struct xrow_header xrow;
+	uint32_t row_index_count = page->count;
+	if (page->format == VY_PAGE_FORMAT_PACKED) {
+		data_pos = page->data;
+		data_end = page->data + page_info->row_index_offset;
+		if (xrow_header_decode(&xrow, &data_pos, data_end) == -1)
+			goto error;
+		if (vy_page_entries_decode(page, &xrow) != 0)
+			goto error;
+		row_index_count = page->restart_count;
+	}
 	data_pos = page->data + page_info->row_index_offset;
 	data_end = page->data + page_info->unpacked_size;
 	if (xrow_header_decode(&xrow, &data_pos, data_end) == -1)
 		goto error;
-	if (vy_row_index_decode(page->row_index, page->count, &xrow) != 0)
+	if (vy_row_index_decode(page->row_index, row_index_count, &xrow) != 0)
 		goto error;
 	region_truncate(&fiber()->gc, region_svp);
 	ERROR_INJECT(ERRINJ_VY_READ_PAGE, {
@@ -6824,6 +9164,160 @@ vy_page_read_cb_free(struct coio_task *base)
 	return 0;
 }
 
+/**
+ * Completion callback of a page read ahead, runs in the tx
+ * thread: put the page to the cache and wake up the fibers
+ * waiting for it.
+ */
+static int
+vy_page_prefetch_cb_free(struct coio_task *base)
+{
+	struct vy_page_read_task *task = (struct vy_page_read_task *)base;
+	struct vy_page_cache *cache = task->env->page_cache;
+	struct vy_page *page = task->page;
+	struct vy_page_cache_key key = { page->run_id, page->page_no };
+	mh_int_t k = mh_vy_page_find(cache->loading, &key, NULL);
+	assert(k != mh_end(cache->loading));
+	mh_vy_page_del(cache->loading, k, NULL);
+	if (task->rc == 0)
+		vy_page_cache_put(cache, page);
+	vy_page_unref(page);
+	task->page = NULL;
+	ipc_cond_broadcast(&cache->loaded);
+	return vy_page_read_cb_free(base);
+}
+
+static bool
+vy_page_cache_is_loading(struct vy_page_cache *cache, int64_t run_id,
+			 uint32_t page_no)
+{
+	struct vy_page_cache_key key = { run_id, page_no };
+	return mh_vy_page_find(cache->loading, &key,
+			       NULL) != mh_end(cache->loading);
+}
+
+/**
+ * Start reading a page into the page cache in background,
+ * unless it is cached or being read already. Reading ahead
+ * is an optimization, so errors are ignored.
+ */
+static void
+vy_page_prefetch(struct vy_env *env, struct vy_run *run, uint32_t page_no)
+{
+	struct vy_page_cache *cache = env->page_cache;
+	if (vy_page_cache_find(cache, run->id, page_no) != NULL ||
+	    vy_page_cache_is_loading(cache, run->id, page_no))
+		return;
+	struct vy_page_info *page_info = vy_run_page_info(run, page_no);
+	struct vy_page *page = vy_page_new(page_info);
+	if (page == NULL)
+		return;
+	page->run_id = run->id;
+	page->page_no = page_no;
+
+	struct vy_page_read_task *task =
+		(struct vy_page_read_task *)mempool_alloc(&env->read_task_pool);
+	if (task == NULL) {
+		vy_page_delete(page);
+		return;
+	}
+	coio_task_create(&task->base, vy_page_read_cb,
+			 vy_page_prefetch_cb_free);
+	task->run = run;
+	vy_run_ref(task->run);
+	task->page_info = *page_info;
+	task->env = env;
+	task->page = page;
+	task->rc = -1;
+	if (mh_vy_page_put(cache->loading, &page, NULL,
+			   NULL) == mh_end(cache->loading)) {
+		vy_page_read_cb_free(&task->base);
+		return;
+	}
+	cache->prefetch++;
+	coio_task_post_async(&task->base);
+}
+
+/**
+ * Wait for all pages being read ahead to be loaded. Used on
+ * shutdown, when the event loop may not run anymore, so the
+ * completion callbacks are invoked by polling eio directly.
+ */
+static void
+vy_page_cache_drain(struct vy_page_cache *cache)
+{
+	while (mh_size(cache->loading) > 0) {
+		if (eio_poll() == 0 && mh_size(cache->loading) > 0) {
+			/* The reads are still in progress. */
+			usleep(1000);
+		}
+	}
+}
+
+/**
+ * Wait until a page being read ahead is loaded.
+ *
+ * @retval 0 success, the page may be found in the cache
+ * @retval -1 the fiber is cancelled
+ * @retval -2 invalid iterator
+ */
+static NODISCARD int
+vy_run_iterator_wait_page(struct vy_run_iterator *itr, uint32_t page_no)
+{
+	struct vy_page_cache *cache = itr->index->env->page_cache;
+	uint32_t index_version = itr->index->version;
+	uint32_t range_version = itr->range->version;
+	int64_t run_id = itr->run->id;
+	while (vy_page_cache_is_loading(cache, run_id, page_no)) {
+		ipc_cond_wait(&cache->loaded);
+		if (fiber_is_cancelled()) {
+			diag_set(FiberIsCancelled);
+			return -1;
+		}
+	}
+	/* See vy_run_iterator_load_page() */
+	if (index_version != itr->index->version ||
+	    range_version != itr->range->version) {
+		itr->index = NULL;
+		itr->range = NULL;
+		itr->run = NULL;
+		return -2; /* iterator is no more valid */
+	}
+	return 0;
+}
+
+/** Number of page boundaries a scan crosses before reading ahead. */
+enum { VY_READ_AHEAD_TRIGGER = 2 };
+
+/**
+ * Read ahead the pages following the current one if the
+ * iterator scans the run sequentially, so that a scan of a cold
+ * run is bound by the disk throughput rather than by the latency
+ * of each page read. Iterators over different runs read ahead
+ * independently, so the runs of a range are read in parallel.
+ */
+static void
+vy_run_iterator_read_ahead(struct vy_run_iterator *itr)
+{
+	struct vy_env *env = itr->index->env;
+	if (!cord_is_main() || env->status != VINYL_ONLINE ||
+	    env->conf->read_ahead == 0)
+		return;
+	/* A lookup of a few adjacent keys is not a scan. */
+	if (++itr->seq_page_count < VY_READ_AHEAD_TRIGGER)
+		return;
+	bool backward = itr->iterator_type == ITER_LE ||
+			itr->iterator_type == ITER_LT;
+	uint32_t page_no = itr->curr_pos.page_no;
+	uint32_t page_count = itr->run->info.count;
+	for (uint32_t i = 1; i <= env->conf->read_ahead; i++) {
+		if (backward ? page_no < i : page_no + i >= page_count)
+			break;
+		vy_page_prefetch(env, itr->run,
+				 backward ? page_no - i : page_no + i);
+	}
+}
+
 /**
  * Get a page by the given number the cache or load it from the disk.
  *
@@ -6837,17 +9331,39 @@ vy_run_iterator_load_page(struct vy_run_iterator *itr, uint32_t page_no,
 {
 	struct vy_index *index = itr->index;
 	const struct vy_env *env = index->env;
+	/*
+	 * The shared page cache belongs to the tx thread,
+	 * workers keep the pages they read to themselves.
+	 */
+	struct vy_page_cache *page_cache = cord_is_main() ?
+					   env->page_cache : NULL;
 
 	/* Check cache */
 	*result = vy_run_iterator_cache_get(itr, page_no);
 	if (*result != NULL)
 		return 0;
+	if (page_cache != NULL) {
+		if (vy_page_cache_is_loading(page_cache, itr->run->id,
+					     page_no)) {
+			int rc = vy_run_iterator_wait_page(itr, page_no);
+			if (rc != 0)
+				return rc;
+		}
+		*result = vy_page_cache_get(page_cache, itr->run->id,
+					    page_no);
+		if (*result != NULL) {
+			vy_run_iterator_cache_put(itr, *result);
+			return 0;
+		}
+	}
 
 	/* Allocate buffers */
 	struct vy_page_info *page_info = vy_run_page_info(itr->run, page_no);
 	struct vy_page *page = vy_page_new(page_info);
 	if (page == NULL)
 		return -1;
+	page->run_id = itr->run->id;
+	page->page_no = page_no;
 
 	/* Read page data from the disk */
 	int rc;
@@ -6917,11 +9433,13 @@ vy_run_iterator_load_page(struct vy_run_iterator *itr, uint32_t page_no,
 		 * during WAL recovery (env->status != VINYL_ONLINE).
 		 */
 		ZSTD_DStream *zdctx = vy_env_get_zdctx(itr->index->env);
-		if (zdctx == NULL)
+		if (zdctx == NULL) {
+			vy_page_delete(page);
 			return -1;
+		}
 		if (vy_page_read(page, page_info, itr->run->fd, zdctx) != 0) {
 			vy_page_delete(page);
-			page = NULL;
+			return -1;
 		}
 	}
 
@@ -6929,7 +9447,23 @@ vy_run_iterator_load_page(struct vy_run_iterator *itr, uint32_t page_no,
 	assert(vy_run_iterator_cache_get(itr, page_no) == NULL);
 
 	/* Update cache */
-	vy_run_iterator_cache_put(itr, page, page_no);
+	if (page_cache != NULL) {
+		/*
+		 * Another fiber could have loaded the same page
+		 * while we were waiting for coio. Share its copy.
+		 */
+		struct vy_page *cached = vy_page_cache_find(page_cache,
+							    page->run_id,
+							    page_no);
+		if (cached != NULL) {
+			vy_page_ref(cached);
+			vy_page_unref(page);
+			page = cached;
+		} else {
+			vy_page_cache_put(page_cache, page);
+		}
+	}
+	vy_run_iterator_cache_put(itr, page);
 
 	*result = page;
 	return 0;
@@ -6954,7 +9488,7 @@ vy_run_iterator_read(struct vy_run_iterator *itr,
 	if (rc != 0)
 		return rc;
 	*stmt = vy_page_stmt(page, pos.pos_in_page, itr->index->format,
-			     itr->index->key_def);
+			     itr->index->key_def, &itr->cursor);
 	if (*stmt == NULL)
 		return -1;
 	return 0;
@@ -6994,6 +9528,87 @@ vy_run_iterator_search_page(struct vy_run_iterator *itr,
 	return end;
 }
 
+/**
+ * Binary search in a packed page. Restart point keys are stored
+ * in full, so they are compared in place, and only the entries
+ * of one restart interval are decoded. No statements are created.
+ * The scan uses the iterator cursor, so the read of the found
+ * position continues from where the search stopped.
+ * @sa vy_run_iterator_search_in_page
+ */
+static uint32_t
+vy_run_iterator_search_in_packed_page(struct vy_run_iterator *itr,
+				      const struct tuple *key,
+				      struct vy_page *page, bool *equal_key)
+{
+	/* for upper bound we change zero comparison result to -1 */
+	int zero_cmp = itr->iterator_type == ITER_GT ||
+		       itr->iterator_type == ITER_LE ? -1 : 0;
+	const struct key_def *key_def = itr->index->key_def;
+	struct region *region = &fiber()->gc;
+	size_t region_svp = region_used(region);
+	uint32_t result = page->count;
+	const char *key_mp;
+	if (vy_stmt_type(key) == IPROTO_REPLACE ||
+	    vy_stmt_type(key) == IPROTO_UPSERT) {
+		key_mp = tuple_extract_key(key, key_def, NULL);
+		if (key_mp == NULL)
+			goto out;
+	} else {
+		key_mp = tuple_data(key);
+	}
+
+	/* Find the first restart point not less than the key. */
+	uint32_t beg = 0;
+	uint32_t end = page->restart_count;
+	int end_cmp = -1;
+	while (beg != end) {
+		uint32_t mid = beg + (end - beg) / 2;
+		struct vy_page_entry entry;
+		vy_page_entry_decode(page->entries + page->row_index[mid], 0,
+				     &entry);
+		assert(entry.shared == 0);
+		int cmp = vy_key_compare_raw(entry.key, key_mp, key_def);
+		cmp = cmp ? cmp : zero_cmp;
+		if (cmp < 0) {
+			beg = mid + 1;
+		} else {
+			end = mid;
+			end_cmp = cmp;
+		}
+	}
+	result = MIN(end * VY_PAGE_RESTART_INTERVAL, page->count);
+	int result_cmp = end_cmp;
+	if (end > 0) {
+		/* Scan the preceding interval, its first key is less. */
+		struct vy_page_cursor *cursor = &itr->cursor;
+		vy_page_cursor_seek(cursor, page, end - 1);
+		if (vy_page_cursor_next(cursor) != 0) {
+			result = page->count;
+			goto out;
+		}
+		while (cursor->stmt_no < result) {
+			if (vy_page_cursor_next(cursor) != 0) {
+				result = page->count;
+				goto out;
+			}
+			int cmp = vy_key_compare_raw(cursor->key, key_mp,
+						     key_def);
+			cmp = cmp ? cmp : zero_cmp;
+			if (cmp >= 0) {
+				result = cursor->stmt_no - 1;
+				result_cmp = cmp;
+				break;
+			}
+		}
+	}
+	if (result < page->count)
+		*equal_key = *equal_key || result_cmp == 0;
+out:
+	region_truncate(region, region_svp);
+	return result;
+}
+
 /**
  * Binary search in page
  * In terms of STL, makes lower_bound for EQ,GE,LT and upper_bound for GT,LE
@@ -7006,6 +9621,9 @@ vy_run_iterator_search_in_page(struct vy_run_iterator *itr,
 			       const struct tuple *key, struct vy_page *page,
 			       bool *equal_key)
 {
+	if (page->format == VY_PAGE_FORMAT_PACKED)
+		return vy_run_iterator_search_in_packed_page(itr, key, page,
+							     equal_key);
 	uint32_t beg = 0;
 	uint32_t end = page->count;
 	/* for upper bound we change zero comparison result to -1 */
@@ -7015,7 +9633,7 @@ vy_run_iterator_search_in_page(struct vy_run_iterator *itr,
 	while (beg != end) {
 		uint32_t mid = beg + (end - beg) / 2;
 		struct tuple *fnd_key = vy_page_stmt(page, mid, idx->format,
-						       idx->key_def);
+						       idx->key_def, NULL);
 		if (fnd_key == NULL)
 			return end;
 		int cmp = vy_stmt_compare(fnd_key, key, idx->key_def);
@@ -7223,6 +9841,15 @@ vy_run_iterator_start(struct vy_run_iterator *itr, struct tuple **ret)
 	itr->search_started = true;
 	*ret = NULL;
 
+	if (itr->iterator_type == ITER_EQ &&
+	    !vy_run_bloom_possible_has(itr->run, itr->index, itr->key)) {
+		/* The run doesn't contain the key, skip it. */
+		itr->index->bloom_hit++;
+		vy_run_iterator_cache_clean(itr);
+		itr->search_ended = true;
+		return 0;
+	}
+
 	if (itr->run->info.count == 1) {
 		/* there can be a stupid bootstrap run in which it's EOF */
 		struct vy_page_info *page_info = itr->run->info.page_infos;
@@ -7329,6 +9956,8 @@ vy_run_iterator_open(struct vy_run_iterator *itr, struct vy_range *range,
 	itr->curr_stmt_pos.page_no = UINT32_MAX;
 	itr->curr_page = NULL;
 	itr->prev_page = NULL;
+	vy_page_cursor_create(&itr->cursor);
+	itr->seq_page_count = 0;
 
 	itr->search_started = false;
 	itr->search_ended = false;
@@ -7437,6 +10066,8 @@ vy_run_iterator_next_key(struct vy_stmt_iterator *vitr, struct tuple **ret)
 			cur_key = NULL;
 			return 0;
 		}
+		if (itr->curr_pos.page_no != cur_key_page_no)
+			vy_run_iterator_read_ahead(itr);
 
 		/*
 		 * The cache is at least two pages. Ensure that
@@ -7618,6 +10249,7 @@ vy_run_iterator_close(struct vy_stmt_iterator *vitr)
 	struct vy_run_iterator *itr = (struct vy_run_iterator *) vitr;
 
 	vy_run_iterator_cache_clean(itr);
+	vy_page_cursor_destroy(&itr->cursor);
 	TRASH(itr);
 }
 
@@ -9312,6 +11944,7 @@ vy_read_iterator_open(struct vy_read_iterator *itr, struct vy_index *index,
 	itr->vlsn = vlsn;
 	itr->only_disk = only_disk;
 	itr->search_started = false;
+	itr->need_restore = false;
 	itr->curr_stmt = NULL;
 	itr->curr_range = NULL;
 }
@@ -9323,9 +11956,10 @@ void
 vy_read_iterator_start(struct vy_read_iterator *itr)
 {
 	assert(!itr->search_started);
-	assert(itr->curr_stmt == NULL);
 	assert(itr->curr_range == NULL);
 	itr->search_started = true;
+	/* The iterator may have been advanced by the cache. */
+	itr->need_restore = itr->curr_stmt != NULL;
 
 	vy_range_iterator_open(&itr->range_iterator, itr->index,
 			       itr->iterator_type, itr->key);
@@ -9370,7 +12004,14 @@ vy_read_iterator_merge_next_key(struct vy_read_iterator *itr,
 	int rc;
 	*ret = NULL;
 	struct vy_merge_iterator *mi = &itr->merge_iterator;
-	while ((rc = vy_merge_iterator_next_key(mi, ret)) == -2) {
+	if (itr->need_restore) {
+		/* Catch up with the statement taken from the cache. */
+		itr->need_restore = false;
+		rc = -2;
+	} else {
+		rc = vy_merge_iterator_next_key(mi, ret);
+	}
+	while (rc == -2) {
 		if (vy_read_iterator_restore(itr) < 0)
 			return -1;
 		/* Check if the iterator is restored not on the same key. */
@@ -9381,6 +12022,7 @@ vy_read_iterator_merge_next_key(struct vy_read_iterator *itr,
 			if (rc == -2) {
 				if (vy_read_iterator_restore(itr) < 0)
 					return -1;
+				rc = vy_merge_iterator_next_key(mi, ret);
 				continue;
 			}
 			/* If the iterator is empty then return. */
@@ -9391,11 +12033,14 @@ vy_read_iterator_merge_next_key(struct vy_read_iterator *itr,
 			 * then go to the next.
 			 */
 			if (vy_stmt_compare(itr->curr_stmt, *ret,
-					    itr->index->key_def) == 0)
+					    itr->index->key_def) == 0) {
+				rc = vy_merge_iterator_next_key(mi, ret);
 				continue;
+			}
 			/* Else return the new key. */
 			break;
 		}
+		rc = vy_merge_iterator_next_key(mi, ret);
 	}
 	return rc;
 }
@@ -9427,8 +12072,12 @@ vy_read_iterator_next_range(struct vy_read_iterator *itr, struct tuple **ret)
 	return rc;
 }
 
+/**
+ * Get the next statement by merging the sources.
+ */
 static NODISCARD int
-vy_read_iterator_next(struct vy_read_iterator *itr, struct tuple **result)
+vy_read_iterator_merge_next(struct vy_read_iterator *itr,
+			    struct tuple **result)
 {
 	if (!itr->search_started)
 		vy_read_iterator_start(itr);
@@ -9482,6 +12131,57 @@ restart:
 	return 0;
 }
 
+/**
+ * The cache stores the newest committed data, so it can only
+ * serve readers that see the newest data and have no changes
+ * of their own.
+ */
+static bool
+vy_read_iterator_use_cache(struct vy_read_iterator *itr)
+{
+	if (itr->only_disk)
+		return false;
+	if (*itr->vlsn < itr->index->env->xm->lsn)
+		return false;
+	return itr->tx == NULL || write_set_first(&itr->tx->write_set) == NULL;
+}
+
+static NODISCARD int
+vy_read_iterator_next(struct vy_read_iterator *itr, struct tuple **result)
+{
+	struct vy_index *index = itr->index;
+	bool use_cache = vy_read_iterator_use_cache(itr);
+	if (use_cache && vy_index_cache_get(index, itr->iterator_type,
+					    itr->key, itr->curr_stmt,
+					    result)) {
+		if (*result == NULL)
+			return 0;
+		tuple_ref(*result);
+		if (itr->curr_stmt != NULL)
+			tuple_unref(itr->curr_stmt);
+		itr->curr_stmt = *result;
+		itr->need_restore = true;
+		return 0;
+	}
+	/*
+	 * Keep the previous statement to link it with the next
+	 * one in the cache, unless a write to the index sneaks in
+	 * while we are reading the disk.
+	 */
+	uint32_t cache_version = index->cache_version;
+	struct tuple *prev = itr->curr_stmt;
+	if (prev != NULL)
+		tuple_ref(prev);
+	int rc = vy_read_iterator_merge_next(itr, result);
+	if (rc == 0 && *result != NULL && use_cache &&
+	    cache_version == index->cache_version &&
+	    vy_read_iterator_use_cache(itr))
+		vy_index_cache_add(index, itr->iterator_type, *result, prev);
+	if (prev != NULL)
+		tuple_unref(prev);
+	return rc;
+}
+
 /**
  * Close the iterator and free resources
  */
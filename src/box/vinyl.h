@@ -94,6 +94,7 @@ enum vy_info_type {
 	VY_INFO_STRING,
 	VY_INFO_U32,
 	VY_INFO_U64,
+	VY_INFO_DOUBLE,
 };
 
 struct vy_info_node {
@@ -103,6 +104,7 @@ struct vy_info_node {
 		const char *str;
 		uint32_t u32;
 		uint64_t u64;
+		double d;
 	} value;
 };
 
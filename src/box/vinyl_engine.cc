@@ -237,6 +237,21 @@ VinylEngine::keydefCheck(struct space *space, struct key_def *key_def)
 		          key_def->name,
 		          space_name(space));
 	}
+	if (key_def->opts.run_size_ratio < 2) {
+		tnt_raise(ClientError, ER_MODIFY_INDEX,
+			  key_def->name, space_name(space),
+			  "run_size_ratio must be greater than 1");
+	}
+	if (key_def->opts.level_count < 1) {
+		tnt_raise(ClientError, ER_MODIFY_INDEX,
+			  key_def->name, space_name(space),
+			  "level_count must be greater than 0");
+	}
+	if (key_def->opts.hint) {
+		tnt_raise(ClientError, ER_MODIFY_INDEX,
+			  key_def->name, space_name(space),
+			  "hint is not supported by vinyl");
+	}
 }
 
 void
@@ -31,7 +31,10 @@
  * SUCH DAMAGE.
  */
 
+#include <assert.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #if defined(__cplusplus)
 extern "C" {
@@ -67,6 +70,20 @@ struct vy_quota {
 	size_t watermark;
 	/** Current memory consumption. */
 	size_t used;
+	/**
+	 * Rate at which memory is released by dumps, in bytes
+	 * per second. Once the watermark is exceeded, writers
+	 * are slowed down to this rate so as not to hit the hard
+	 * limit. 0 disables throttling.
+	 */
+	size_t throttle_rate;
+	/**
+	 * Token bucket of throttling: the number of bytes that
+	 * can be consumed without a delay.
+	 */
+	double throttle_value;
+	/** Time of the last update of throttle_value. */
+	double throttle_timestamp;
 	/** Quota callback. */
 	vy_quota_cb cb;
 	/** Argument passed to cb. */
@@ -80,6 +97,9 @@ vy_quota_init(struct vy_quota *q, int64_t limit,
 	q->limit = limit;
 	q->watermark = limit;
 	q->used = 0;
+	q->throttle_rate = 0;
+	q->throttle_value = 0;
+	q->throttle_timestamp = 0;
 	q->cb = cb;
 	q->cb_arg = cb_arg;
 }
@@ -115,6 +135,68 @@ vy_quota_update_watermark(struct vy_quota *q, size_t chunk_size,
 		q->watermark = 0;
 }
 
+/**
+ * Set the rate memory is released at, see vy_quota::throttle_rate.
+ */
+static inline void
+vy_quota_set_throttle_rate(struct vy_quota *q, size_t rate)
+{
+	q->throttle_rate = rate;
+}
+
+/**
+ * Max time, in seconds, worth of writes the throttling token
+ * bucket may accumulate, both as a credit (bursts) and as a
+ * debt (delays). So a writer never sleeps longer than that.
+ */
+static const double VY_QUOTA_THROTTLE_WINDOW = 0.1;
+
+/**
+ * Return the time, in seconds, a writer that has just consumed
+ * @size bytes should sleep for, @now is the current time.
+ *
+ * Between the watermark and the hard limit writers may consume
+ * memory at a rate that goes down linearly from twice the dump
+ * rate to 0, so the closer we are to the limit, the longer they
+ * sleep. This way the memory consumption settles down half way
+ * to the limit instead of bumping into it and blocking all
+ * writers until a dump completes. The delay is bounded by
+ * VY_QUOTA_THROTTLE_WINDOW, however close to the limit we are:
+ * a writer that hits the limit is blocked by vy_quota_use().
+ */
+static inline double
+vy_quota_delay(struct vy_quota *q, size_t size, double now)
+{
+	if (q->used < q->watermark || q->throttle_rate == 0 ||
+	    q->watermark >= q->limit) {
+		q->throttle_value = 0;
+		q->throttle_timestamp = now;
+		return 0;
+	}
+	if (q->used >= q->limit)
+		return 0; /* writers are blocked by vy_quota_use() */
+	double rate = 2.0 * q->throttle_rate * (q->limit - q->used) /
+		      (q->limit - q->watermark);
+	double window = rate * VY_QUOTA_THROTTLE_WINDOW;
+	q->throttle_value += (now - q->throttle_timestamp) * rate;
+	/* Allow bursts of up to a window worth of writes. */
+	if (q->throttle_value > window)
+		q->throttle_value = window;
+	q->throttle_timestamp = now;
+	q->throttle_value -= size;
+	if (q->throttle_value >= 0)
+		return 0;
+	/*
+	 * Don't let the debt of earlier writers or a low rate
+	 * near the limit grow the delay beyond the window.
+	 */
+	if (q->throttle_value < -window)
+		q->throttle_value = -window;
+	double delay = -q->throttle_value / rate;
+	return delay < VY_QUOTA_THROTTLE_WINDOW ?
+	       delay : VY_QUOTA_THROTTLE_WINDOW;
+}
+
 /**
  * Consume @size bytes of memory. Throttle the caller if
  * the limit is exceeded.
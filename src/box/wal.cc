@@ -34,16 +34,306 @@
 #include "fiber.h"
 #include "fio.h"
 #include "errinj.h"
+#include "say.h"
 
 #include "xlog.h"
 #include "xrow.h"
 #include "cbus.h"
 #include "coeio.h"
+#include "coeio_file.h"
+#include "ipc.h"
+#include "rmean.h"
+#include <pmatomic.h>
 
 const char *wal_mode_STRS[] = { "none", "write", "fsync", NULL };
 
+const char *wal_stat_strings[] = {
+	"SYNC", "SYNC_BATCH", "SYNC_ROWS", "RING_ROWS"
+};
+
 int wal_dir_lock = -1;
 
+/* {{{ WAL ring */
+
+enum {
+	/**
+	 * The size of a ring block. Bigger rows get blocks
+	 * of their own.
+	 */
+	WAL_RING_BLOCK_SIZE = 256 * 1024
+};
+
+/** A piece of struct wal_ring. */
+struct wal_ring_block {
+	/**
+	 * The reference of the ring and those of readers.
+	 * Atomic, so that a reader can drop its reference
+	 * even after the ring is destroyed.
+	 */
+	int refs;
+	/** The sequence number of the block. */
+	int64_t id;
+	/**
+	 * The generation of the ring the block belongs to.
+	 * Blocks of different generations are not contiguous.
+	 */
+	int64_t gen;
+	/** The size of the data visible to readers. */
+	size_t used;
+	/** The size of the data written, known to the writer. */
+	size_t end;
+	/** The size of the data area. */
+	size_t size;
+	/** The WAL vclock preceding the first row of the block. */
+	struct vclock vclock;
+	/**
+	 * Rows, each stored as a 32-bit length followed by the
+	 * encoded header and body.
+	 */
+	char data[0];
+};
+
+/**
+ * Rows recently written to the WAL, in memory. The WAL thread
+ * appends rows to the last block and evicts the oldest block
+ * when the ring is full. Readers run in relay threads.
+ */
+struct wal_ring {
+	/**
+	 * Protects the block array, first, last and the
+	 * used size and references of the blocks.
+	 */
+	pthread_mutex_t mutex;
+	/** Block slots, a block with id N is at N % block_count. */
+	struct wal_ring_block **blocks;
+	/** The number of slots, 0 if the ring is disabled. */
+	uint32_t block_count;
+	/** The id of the oldest block in the ring. */
+	int64_t first;
+	/**
+	 * The id of the block being written. The ring is empty
+	 * if it is less than first.
+	 */
+	int64_t last;
+	/** The size of the data written to the last block. */
+	size_t wpos;
+	/** The id of the last block with published rows. */
+	int64_t published;
+	/**
+	 * The current generation, bumped whenever the ring
+	 * loses rows, see wal_ring_reset().
+	 */
+	int64_t gen;
+	/** The WAL vclock after the last appended row. */
+	struct vclock vclock;
+};
+
+/** Release a block reference. Doesn't need the ring lock. */
+static void
+wal_ring_block_unref(struct wal_ring_block *block)
+{
+	int refs = pm_atomic_fetch_sub(&block->refs, 1);
+	assert(refs > 0);
+	if (refs == 1)
+		free(block);
+}
+
+/** Acquire a block reference. Called with the ring locked. */
+static void
+wal_ring_block_ref(struct wal_ring_block *block)
+{
+	pm_atomic_fetch_add(&block->refs, 1);
+}
+
+static void
+wal_ring_create(struct wal_ring *ring, int64_t size,
+		const struct vclock *vclock)
+{
+	tt_pthread_mutex_init(&ring->mutex, NULL);
+	ring->blocks = NULL;
+	ring->block_count = 0;
+	if (size > 0) {
+		ring->block_count = MAX(2, (size + WAL_RING_BLOCK_SIZE - 1) /
+					   WAL_RING_BLOCK_SIZE);
+		ring->blocks = (struct wal_ring_block **)
+			calloc(ring->block_count, sizeof(*ring->blocks));
+		if (ring->blocks == NULL) {
+			say_error("failed to allocate the WAL ring, "
+				  "relays will read the WAL files");
+			ring->block_count = 0;
+		}
+	}
+	ring->first = 0;
+	ring->last = -1;
+	ring->wpos = 0;
+	ring->published = -1;
+	ring->gen = 0;
+	vclock_copy(&ring->vclock, vclock);
+}
+
+/**
+ * Evict all blocks, so that readers fall back to the WAL files.
+ * Used when a row can't be stored, since readers must never
+ * skip rows: the generation is bumped, so that readers of the
+ * evicted blocks don't step over to the blocks created after
+ * the lost row.
+ */
+static void
+wal_ring_reset(struct wal_ring *ring)
+{
+	tt_pthread_mutex_lock(&ring->mutex);
+	for (int64_t id = ring->first; id <= ring->last; id++) {
+		struct wal_ring_block **slot =
+			&ring->blocks[id % ring->block_count];
+		wal_ring_block_unref(*slot);
+		*slot = NULL;
+	}
+	ring->first = ring->last + 1;
+	ring->gen++;
+	tt_pthread_mutex_unlock(&ring->mutex);
+}
+
+static void
+wal_ring_destroy(struct wal_ring *ring)
+{
+	/* Readers may still hold evicted blocks. */
+	wal_ring_reset(ring);
+	free(ring->blocks);
+	tt_pthread_mutex_destroy(&ring->mutex);
+}
+
+/**
+ * Start a new block big enough for a row of the given size,
+ * evicting the oldest block if the ring is full.
+ */
+static struct wal_ring_block *
+wal_ring_new_block(struct wal_ring *ring, size_t size)
+{
+	size = MAX(size, (size_t) WAL_RING_BLOCK_SIZE);
+	int64_t id = ring->last + 1;
+	struct wal_ring_block **slot = &ring->blocks[id % ring->block_count];
+	struct wal_ring_block *block = NULL;
+
+	if (ring->first <= ring->last) {
+		/* Published by wal_ring_publish(). */
+		ring->blocks[ring->last % ring->block_count]->end =
+			ring->wpos;
+	}
+	tt_pthread_mutex_lock(&ring->mutex);
+	if (*slot != NULL) {
+		assert((*slot)->id == ring->first);
+		ring->first++;
+		/*
+		 * Reuse the evicted block if no one reads it:
+		 * new references are taken with the ring locked.
+		 */
+		if (pm_atomic_load(&(*slot)->refs) == 1 &&
+		    (*slot)->size == size)
+			block = *slot;
+		else
+			wal_ring_block_unref(*slot);
+		*slot = NULL;
+	}
+	tt_pthread_mutex_unlock(&ring->mutex);
+
+	if (block == NULL) {
+		block = (struct wal_ring_block *)
+			malloc(sizeof(*block) + size);
+		if (block == NULL)
+			return NULL;
+	}
+	block->refs = 1;
+	block->id = id;
+	block->gen = ring->gen;
+	block->used = 0;
+	block->end = 0;
+	block->size = size;
+	vclock_copy(&block->vclock, &ring->vclock);
+
+	tt_pthread_mutex_lock(&ring->mutex);
+	*slot = block;
+	if (ring->first > ring->last)
+		ring->first = id;
+	ring->last = id;
+	tt_pthread_mutex_unlock(&ring->mutex);
+	ring->wpos = 0;
+	return block;
+}
+
+/**
+ * Append a written row to the ring. The row becomes visible
+ * to readers after wal_ring_publish(), once it is on disk.
+ */
+static void
+wal_ring_append(struct wal_ring *ring, struct xrow_header *row)
+{
+	if (ring->block_count == 0)
+		return;
+	struct iovec iov[XROW_IOVMAX];
+	int iovcnt = xrow_header_encode(row, iov, 0);
+	if (iovcnt < 0)
+		goto error;
+	{
+		uint32_t len = 0;
+		for (int i = 0; i < iovcnt; i++)
+			len += iov[i].iov_len;
+		size_t size = sizeof(len) + len;
+		struct wal_ring_block *block = ring->first <= ring->last ?
+			ring->blocks[ring->last % ring->block_count] : NULL;
+		if (block == NULL || ring->wpos + size > block->size) {
+			block = wal_ring_new_block(ring, size);
+			if (block == NULL)
+				goto error;
+		}
+		char *data = block->data + ring->wpos;
+		memcpy(data, &len, sizeof(len));
+		data += sizeof(len);
+		for (int i = 0; i < iovcnt; i++) {
+			memcpy(data, iov[i].iov_base, iov[i].iov_len);
+			data += iov[i].iov_len;
+		}
+		ring->wpos += size;
+	}
+	vclock_follow(&ring->vclock, row->server_id, row->lsn);
+	return;
+error:
+	/* Readers will get the row from the WAL file. */
+	wal_ring_reset(ring);
+	vclock_follow(&ring->vclock, row->server_id, row->lsn);
+}
+
+/**
+ * Make the rows appended up to the given position visible to
+ * readers. The position is the id of a block and the size of
+ * the block data, as returned by wal_ring_tell().
+ */
+static void
+wal_ring_publish(struct wal_ring *ring, int64_t id, size_t pos)
+{
+	if (ring->block_count == 0)
+		return;
+	tt_pthread_mutex_lock(&ring->mutex);
+	/* Evicted blocks have no readers to publish to. */
+	for (int64_t i = MAX(ring->published, ring->first);
+	     i <= id && i <= ring->last; i++) {
+		struct wal_ring_block *block =
+			ring->blocks[i % ring->block_count];
+		block->used = i == id ? pos : block->end;
+	}
+	ring->published = MAX(ring->published, id);
+	tt_pthread_mutex_unlock(&ring->mutex);
+}
+
+/** The position of the last appended row, see wal_ring_publish(). */
+static void
+wal_ring_tell(struct wal_ring *ring, int64_t *id, size_t *pos)
+{
+	*id = ring->last;
+	*pos = ring->wpos;
+}
+
+/* }}} WAL ring */
+
 /*
  * WAL writer - maintain a Write Ahead Log for every change
  * in the data state.
@@ -109,6 +399,38 @@ struct wal_writer
 	struct rlist watchers;
 	/** The lock protecting the watchers list. */
 	pthread_mutex_t watchers_mutex;
+	/** Rows recently written, for replication relays. */
+	struct wal_ring ring;
+	/* ------------- group commit -------------- */
+	/**
+	 * In fsync mode, the longest time a written batch
+	 * may wait for fdatasync() so that more batches can
+	 * share it - wal_sync_delay.
+	 */
+	double sync_delay;
+	/**
+	 * Don't wait for sync_delay to expire once this many
+	 * bytes are waiting for fdatasync() - wal_sync_max_bytes.
+	 */
+	int64_t sync_max_bytes;
+	/**
+	 * Batches written to the current WAL but not synced
+	 * yet, in the order of writing.
+	 */
+	struct stailq sync_queue;
+	/** Size of sync_queue contents, in bytes. */
+	int64_t sync_queue_bytes;
+	/** The time the first batch in sync_queue was written. */
+	ev_tstamp sync_queue_start;
+	/**
+	 * Batches covered by fdatasync() currently in progress.
+	 * They precede batches in sync_queue.
+	 */
+	struct stailq sync_inflight;
+	/** Fiber syncing the WAL on behalf of queued batches. */
+	struct fiber *sync_f;
+	/** Signalled when there is work for sync_f. */
+	struct ipc_cond sync_cond;
 };
 
 struct wal_msg: public cmsg {
@@ -119,12 +441,23 @@ struct wal_msg: public cmsg {
 	 * be rolled back.
 	 */
 	struct stailq rollback;
+	/** A member of wal_writer::sync_queue. */
+	struct stailq_entry in_sync_queue;
+	/** Number of rows written to disk by this batch. */
+	int64_t rows;
+	/**
+	 * The position of the ring after the rows of the batch,
+	 * published once the batch is on disk.
+	 */
+	int64_t ring_id;
+	size_t ring_pos;
 };
 
 static struct wal_writer wal_writer_singleton;
 
 struct wal_writer *wal = NULL;
 struct rmean *rmean_tx_wal_bus;
+struct rmean *rmean_wal;
 
 static void
 wal_write_to_disk(struct cmsg *msg);
@@ -132,8 +465,15 @@ wal_write_to_disk(struct cmsg *msg);
 static void
 tx_schedule_commit(struct cmsg *msg);
 
+static void
+wal_notify_watchers(struct wal_writer *writer);
+
+/*
+ * The first hop has no pipe: wal_write_to_disk() passes a
+ * batch on to tx itself, possibly after a group commit.
+ */
 static struct cmsg_hop wal_request_route[] = {
-	{wal_write_to_disk, &wal_writer_singleton.tx_pipe},
+	{wal_write_to_disk, NULL},
 	{tx_schedule_commit, NULL},
 };
 
@@ -143,6 +483,9 @@ wal_msg_create(struct wal_msg *batch)
 	cmsg_init(batch, wal_request_route);
 	stailq_create(&batch->commit);
 	stailq_create(&batch->rollback);
+	batch->rows = 0;
+	batch->ring_id = -1;
+	batch->ring_pos = 0;
 }
 
 static struct wal_msg *
@@ -219,15 +562,28 @@ tx_schedule_rollback(struct cmsg *msg)
 static void
 wal_writer_create(struct wal_writer *writer, enum wal_mode wal_mode,
 		  const char *wal_dirname, const struct tt_uuid *server_uuid,
-		  struct vclock *vclock, int64_t rows_per_wal)
+		  struct vclock *vclock, int64_t rows_per_wal,
+		  double sync_delay, int64_t sync_max_bytes,
+		  int64_t ring_size)
 {
 	writer->wal_mode = wal_mode;
 	writer->rows_per_wal = rows_per_wal;
 
 	xdir_create(&writer->wal_dir, wal_dirname, XLOG, server_uuid);
 	writer->is_active = false;
-	if (wal_mode == WAL_FSYNC)
-		writer->wal_dir.open_wflags |= O_SYNC;
+	/*
+	 * In fsync mode the WAL is not opened with O_SYNC:
+	 * written batches are synced by a group commit in
+	 * wal_sync_f() instead.
+	 */
+	writer->sync_delay = sync_delay;
+	writer->sync_max_bytes = sync_max_bytes;
+	stailq_create(&writer->sync_queue);
+	stailq_create(&writer->sync_inflight);
+	writer->sync_queue_bytes = 0;
+	writer->sync_queue_start = 0;
+	writer->sync_f = NULL;
+	ipc_cond_create(&writer->sync_cond);
 	cbus_create(&writer->tx_wal_bus);
 
 	cpipe_create(&writer->tx_pipe);
@@ -243,6 +599,7 @@ wal_writer_create(struct wal_writer *writer, enum wal_mode wal_mode,
 
 	tt_pthread_mutex_init(&writer->watchers_mutex, NULL);
 	rlist_create(&writer->watchers);
+	wal_ring_create(&writer->ring, ring_size, vclock);
 }
 
 /** Destroy a WAL writer structure. */
@@ -252,6 +609,8 @@ wal_writer_destroy(struct wal_writer *writer)
 	xdir_destroy(&writer->wal_dir);
 	cbus_destroy(&writer->tx_wal_bus);
 	tt_pthread_mutex_destroy(&writer->watchers_mutex);
+	wal_ring_destroy(&writer->ring);
+	ipc_cond_destroy(&writer->sync_cond);
 }
 
 /** WAL writer thread routine. */
@@ -277,7 +636,8 @@ wal_opt_rotate(struct wal_writer *writer);
 void
 wal_writer_start(enum wal_mode wal_mode, const char *wal_dirname,
 		 const struct tt_uuid *server_uuid, struct vclock *vclock,
-		 int64_t rows_per_wal)
+		 int64_t rows_per_wal, double sync_delay,
+		 int64_t sync_max_bytes, int64_t ring_size)
 {
 	assert(rows_per_wal > 1);
 
@@ -285,9 +645,13 @@ wal_writer_start(enum wal_mode wal_mode, const char *wal_dirname,
 
 	/* I. Initialize the state. */
 	wal_writer_create(writer, wal_mode, wal_dirname, server_uuid,
-			vclock, rows_per_wal);
+			vclock, rows_per_wal, sync_delay, sync_max_bytes,
+			ring_size);
 
 	rmean_tx_wal_bus = writer->tx_wal_bus.stats;
+	rmean_wal = rmean_new(wal_stat_strings, WAL_STAT_LAST);
+	if (rmean_wal == NULL)
+		panic_syserror("wal_writer_start");
 
 	/* II. Start the thread. */
 
@@ -332,9 +696,177 @@ wal_writer_stop()
 	wal_writer_destroy(writer);
 
 	rmean_tx_wal_bus = NULL;
+	rmean_delete(rmean_wal);
+	rmean_wal = NULL;
 	wal = NULL;
 }
 
+/* {{{ group commit */
+
+/**
+ * fdatasync() if the platform has it, fsync() otherwise.
+ */
+static int
+wal_fdatasync(int fd)
+{
+#ifdef HAVE_FDATASYNC
+	return fdatasync(fd);
+#else
+	return fsync(fd);
+#endif
+}
+
+/**
+ * Acknowledge synced batches: pass them on to the tx thread
+ * in the order they were written.
+ */
+static void
+wal_sync_ack(struct wal_writer *writer, struct stailq *batches)
+{
+	if (stailq_empty(batches))
+		return;
+	int64_t n_batches = 0, n_rows = 0;
+	struct wal_msg *batch, *tmp;
+	/* The rows are on disk now, let relays read them. */
+	batch = stailq_last_entry(batches, struct wal_msg, in_sync_queue);
+	wal_ring_publish(&writer->ring, batch->ring_id, batch->ring_pos);
+	wal_notify_watchers(writer);
+	stailq_foreach_entry_safe(batch, tmp, batches, in_sync_queue) {
+		n_batches++;
+		n_rows += batch->rows;
+		/*
+		 * The first hop of wal_request_route has no
+		 * pipe, so route the message to tx by hand.
+		 */
+		batch->hop++;
+		cpipe_push_input(&writer->tx_pipe, batch);
+	}
+	stailq_create(batches);
+	cpipe_flush_input(&writer->tx_pipe);
+	rmean_collect(rmean_wal, WAL_STAT_SYNC, 1);
+	rmean_collect(rmean_wal, WAL_STAT_SYNC_BATCH, n_batches);
+	rmean_collect(rmean_wal, WAL_STAT_SYNC_ROWS, n_rows);
+}
+
+/**
+ * Queue a written batch for group commit. The batch is
+ * acknowledged to tx by wal_sync_f() once the WAL is synced.
+ */
+static void
+wal_sync_queue_add(struct wal_writer *writer, struct wal_msg *batch,
+		   int64_t bytes)
+{
+	if (stailq_empty(&writer->sync_queue))
+		writer->sync_queue_start = ev_now(loop());
+	stailq_add_tail_entry(&writer->sync_queue, batch, in_sync_queue);
+	writer->sync_queue_bytes += bytes;
+	ipc_cond_signal(&writer->sync_cond);
+}
+
+/**
+ * Pass a processed batch on to tx. In fsync mode this happens
+ * only after the rows of the batch are synced to disk. A batch
+ * never overtakes the batches written before it, even if it has
+ * nothing to sync, to keep the order of commits and rollbacks.
+ */
+static void
+wal_msg_complete(struct wal_writer *writer, struct wal_msg *batch,
+		 int64_t bytes)
+{
+	if (writer->wal_mode == WAL_FSYNC &&
+	    (batch->rows > 0 || ! stailq_empty(&writer->sync_queue) ||
+	     ! stailq_empty(&writer->sync_inflight))) {
+		wal_sync_queue_add(writer, batch, bytes);
+		return;
+	}
+	wal_ring_publish(&writer->ring, batch->ring_id, batch->ring_pos);
+	wal_notify_watchers(writer);
+	batch->hop++;
+	cpipe_push(&writer->tx_pipe, batch);
+}
+
+/**
+ * Sync the current WAL file right away, without yielding,
+ * and acknowledge everything written to it so far. Used
+ * before the file is closed, since the group commit fiber
+ * must never outlive the file it syncs.
+ */
+static void
+wal_sync_now(struct wal_writer *writer)
+{
+	if (stailq_empty(&writer->sync_inflight) &&
+	    stailq_empty(&writer->sync_queue))
+		return;
+	if (wal_fdatasync(writer->current_wal.fd) < 0)
+		panic_syserror("%s: fdatasync() failed",
+			       writer->current_wal.filename);
+	/*
+	 * Batches being synced by wal_sync_f() are older
+	 * and must be acknowledged first.
+	 */
+	stailq_concat(&writer->sync_inflight, &writer->sync_queue);
+	writer->sync_queue_bytes = 0;
+	wal_sync_ack(writer, &writer->sync_inflight);
+}
+
+/**
+ * Group commit fiber of the WAL thread. While fdatasync() runs
+ * in the coio thread pool, the WAL thread keeps on writing new
+ * batches, which are then all synced by the next fdatasync()
+ * and acknowledged together.
+ */
+static int
+wal_sync_f(va_list ap)
+{
+	struct wal_writer *writer = va_arg(ap, struct wal_writer *);
+	while (! fiber_is_cancelled()) {
+		if (stailq_empty(&writer->sync_queue)) {
+			ipc_cond_wait(&writer->sync_cond);
+			continue;
+		}
+		/* Let more batches join this sync, if configured. */
+		double delay = writer->sync_queue_start +
+			writer->sync_delay - ev_now(loop());
+		if (delay > 0 &&
+		    writer->sync_queue_bytes < writer->sync_max_bytes) {
+			ipc_cond_wait_timeout(&writer->sync_cond, delay);
+			continue;
+		}
+		assert(stailq_empty(&writer->sync_inflight));
+		stailq_concat(&writer->sync_inflight, &writer->sync_queue);
+		writer->sync_queue_bytes = 0;
+		if (writer->is_active) {
+			/*
+			 * Sync a duplicate of the descriptor, so
+			 * that the WAL thread is free to close the
+			 * file meanwhile.
+			 */
+			int fd = dup(writer->current_wal.fd);
+			if (fd < 0 || coeio_fdatasync(fd) < 0)
+				panic_syserror("%s: fdatasync() failed",
+					       writer->current_wal.filename);
+			close(fd);
+		}
+		/*
+		 * Could have been acknowledged already by
+		 * wal_sync_now() if the WAL was closed.
+		 */
+		wal_sync_ack(writer, &writer->sync_inflight);
+	}
+	return 0;
+}
+
+/** Close the current WAL, syncing unacknowledged batches first. */
+static void
+wal_close_current(struct wal_writer *writer)
+{
+	wal_sync_now(writer);
+	xlog_close(&writer->current_wal, false);
+	writer->is_active = false;
+}
+
+/* }}} group commit */
+
 struct wal_checkpoint: public cmsg
 {
 	struct vclock *vclock;
@@ -347,6 +879,12 @@ wal_checkpoint_f(struct cmsg *data)
 {
 	struct wal_checkpoint *msg = (struct wal_checkpoint *) data;
 	struct wal_writer *writer = wal;
+	/*
+	 * Acknowledge the batches waiting for group commit:
+	 * the caller expects every write submitted before the
+	 * checkpoint to be complete by the time it is woken up.
+	 */
+	wal_sync_now(writer);
 	/*
 	 * Avoid closing the current WAL if it has no rows (empty).
 	 */
@@ -354,8 +892,7 @@ wal_checkpoint_f(struct cmsg *data)
 	    vclock_sum(&writer->current_wal.meta.vclock) !=
 	    vclock_sum(&writer->vclock)) {
 
-		xlog_close(&writer->current_wal, false);
-		writer->is_active = false;
+		wal_close_current(writer);
 		/*
 		 * Avoid creating an empty xlog if this is the
 		 * last snapshot before shutdown.
@@ -419,8 +956,7 @@ wal_opt_rotate(struct wal_writer *writer)
 		 * A warning is written to the server
 		 * log file.
 		 */
-		xlog_close(&writer->current_wal, false);
-		writer->is_active = false;
+		wal_close_current(writer);
 	}
 
 	if (writer->is_active)
@@ -475,6 +1011,12 @@ wal_writer_begin_rollback(struct wal_writer *writer)
 		{ wal_writer_end_rollback, NULL }
 	};
 
+	/*
+	 * Batches awaiting group commit must reach tx
+	 * before the rollback message does.
+	 */
+	if (writer->is_active)
+		wal_sync_now(writer);
 	/*
 	 * Make sure the WAL writer rolls back
 	 * all input until rollback mode is off.
@@ -483,9 +1025,6 @@ wal_writer_begin_rollback(struct wal_writer *writer)
 	cpipe_push(&writer->tx_pipe, &writer->in_rollback);
 }
 
-static void
-wal_notify_watchers(struct wal_writer *writer);
-
 static void
 wal_write_to_disk(struct cmsg *msg)
 {
@@ -497,12 +1036,13 @@ wal_write_to_disk(struct cmsg *msg)
 	if (writer->in_rollback.route != NULL) {
 		/* We're rolling back a failed write. */
 		stailq_concat(&wal_msg->rollback, &wal_msg->commit);
-		return;
+		return wal_msg_complete(writer, wal_msg, 0);
 	}
 
 	/* Xlog is only rotated between queue processing  */
 	if (wal_opt_rotate(writer) != 0) {
 		stailq_concat(&wal_msg->rollback, &wal_msg->commit);
+		wal_msg_complete(writer, wal_msg, 0);
 		return wal_writer_begin_rollback(writer);
 	}
 
@@ -528,6 +1068,7 @@ wal_write_to_disk(struct cmsg *msg)
 	 */
 
 	struct xlog *l = &writer->current_wal;
+	off_t start_offset = l->offset;
 
 	/*
 	 * Iterate over requests (transactions)
@@ -574,6 +1115,10 @@ done:
 		stailq_next_entry(last_commit_req, fifo) : req;
 	/* Update status of the successfully committed requests. */
 	for (; req != rollback_req; req = stailq_next_entry(req, fifo)) {
+		/* Keep the rows in memory for replication relays. */
+		struct xrow_header **row = req->rows;
+		for (; row < req->rows + req->n_rows; row++)
+			wal_ring_append(&writer->ring, *row);
 
 		/* Update internal vclock */
 		vclock_follow(&writer->vclock,
@@ -581,16 +1126,19 @@ done:
 			      req->rows[req->n_rows - 1]->lsn);
 		/* Update row counter for wal_opt_rotate() */
 		l->rows += req->n_rows;
+		wal_msg->rows += req->n_rows;
 		/* Mark request as successful for tx thread */
 		req->res = vclock_sum(&writer->vclock);
 	}
 	if (rollback_req) {
 		/* Rollback unprocessed requests */
 		stailq_splice(&wal_msg->commit, &req->fifo, &wal_msg->rollback);
-		wal_writer_begin_rollback(writer);
 	}
+	wal_ring_tell(&writer->ring, &wal_msg->ring_id, &wal_msg->ring_pos);
 	fiber_gc();
-	wal_notify_watchers(writer);
+	wal_msg_complete(writer, wal_msg, l->offset - start_offset);
+	if (rollback_req)
+		wal_writer_begin_rollback(writer);
 }
 
 /** WAL writer thread main loop.  */
@@ -604,12 +1152,23 @@ wal_writer_f(va_list ap)
 	writer->main_f = fiber();
 	cbus_join(&writer->tx_wal_bus, &writer->wal_pipe);
 
+	if (writer->wal_mode == WAL_FSYNC) {
+		writer->sync_f = fiber_new("wal_sync", wal_sync_f);
+		if (writer->sync_f == NULL)
+			panic("failed to start WAL sync fiber");
+		fiber_set_joinable(writer->sync_f, true);
+		fiber_start(writer->sync_f, writer);
+	}
+
 	fiber_yield();
 
-	if (writer->is_active) {
-		xlog_close(&writer->current_wal, false);
-		writer->is_active = false;
+	if (writer->sync_f != NULL) {
+		fiber_cancel(writer->sync_f);
+		fiber_join(writer->sync_f);
+		writer->sync_f = NULL;
 	}
+	if (writer->is_active)
+		wal_close_current(writer);
 	return 0;
 }
 
@@ -696,6 +1255,121 @@ wal_clear_watcher(struct wal_writer *writer, struct wal_watcher *watcher)
 	tt_pthread_mutex_unlock(&writer->watchers_mutex);
 }
 
+/* {{{ WAL ring readers */
+
+void
+wal_ring_reader_create(struct wal_ring_reader *reader)
+{
+	reader->block = NULL;
+	reader->pos = 0;
+	reader->used = 0;
+	reader->rows = 0;
+}
+
+void
+wal_ring_reader_destroy(struct wal_ring_reader *reader)
+{
+	if (reader->block == NULL)
+		return;
+	/* The ring may be destroyed already, don't lock it. */
+	wal_ring_block_unref(reader->block);
+	reader->block = NULL;
+}
+
+int
+wal_ring_reader_attach(struct wal_writer *writer,
+		       struct wal_ring_reader *reader,
+		       const struct vclock *vclock)
+{
+	assert(reader->block == NULL);
+	if (writer == NULL)
+		return -1;
+	struct wal_ring *ring = &writer->ring;
+	tt_pthread_mutex_lock(&ring->mutex);
+	/* Look for the newest block preceding the vclock. */
+	for (int64_t id = ring->last; id >= ring->first; id--) {
+		struct wal_ring_block *block =
+			ring->blocks[id % ring->block_count];
+		if (vclock_compare(&block->vclock, vclock) <= 0) {
+			wal_ring_block_ref(block);
+			reader->block = block;
+			reader->pos = 0;
+			reader->used = block->used;
+			break;
+		}
+	}
+	tt_pthread_mutex_unlock(&ring->mutex);
+	return reader->block != NULL ? 0 : -1;
+}
+
+int
+wal_ring_reader_next(struct wal_writer *writer,
+		     struct wal_ring_reader *reader,
+		     struct xrow_header *row)
+{
+	struct wal_ring *ring = &writer->ring;
+	assert(reader->block != NULL);
+	if (reader->pos == reader->used) {
+		struct wal_ring_block *block = reader->block;
+		struct wal_ring_block *next = NULL;
+		int rc = 0;
+		tt_pthread_mutex_lock(&ring->mutex);
+		/*
+		 * Account the rows as soon as they are read, not
+		 * on the next WAL write: the master may be idle.
+		 * The ring mutex serializes readers, the WAL thread
+		 * doesn't touch this counter.
+		 */
+		rmean_collect(rmean_wal, WAL_STAT_RING_ROWS, reader->rows);
+		reader->rows = 0;
+		if (block->id + 1 >= ring->first &&
+		    block->id + 1 <= ring->last) {
+			next = ring->blocks[(block->id + 1) %
+					    ring->block_count];
+		}
+		bool in_ring = block->gen == ring->gen &&
+			       block->id >= ring->first;
+		if (block->used > reader->used) {
+			reader->used = block->used;
+		} else if (in_ring && (block->id == ring->last ||
+				       block->used < block->end)) {
+			/* Caught up with the published rows. */
+		} else if (block->used < block->end || next == NULL ||
+			   next->id != block->id + 1 ||
+			   next->gen != block->gen) {
+			/*
+			 * The rest of the block or the next block
+			 * is evicted, or some rows between the
+			 * blocks are lost.
+			 */
+			wal_ring_block_unref(block);
+			reader->block = NULL;
+			rc = -1;
+		} else {
+			wal_ring_block_ref(next);
+			wal_ring_block_unref(block);
+			reader->block = next;
+			reader->pos = 0;
+			reader->used = next->used;
+		}
+		tt_pthread_mutex_unlock(&ring->mutex);
+		if (rc != 0)
+			return rc;
+		if (reader->pos == reader->used)
+			return 0;
+	}
+	const char *data = reader->block->data + reader->pos;
+	uint32_t len;
+	memcpy(&len, data, sizeof(len));
+	data += sizeof(len);
+	xrow_header_decode_xc(row, &data, data + len);
+	reader->pos += sizeof(len) + len;
+	reader->rows++;
+	return 1;
+}
+
+/* }}} */
+
 static void
 wal_notify_watchers(struct wal_writer *writer)
 {
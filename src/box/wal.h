@@ -37,14 +37,35 @@
 
 struct fiber;
 struct wal_writer;
+struct vclock;
+struct xrow_header;
 
 enum wal_mode { WAL_NONE = 0, WAL_WRITE, WAL_FSYNC, WAL_MODE_MAX };
 
 /** String constants for the supported modes. */
 extern const char *wal_mode_STRS[];
 
+/**
+ * WAL statistics. The group commit ones are collected in
+ * fsync mode only.
+ */
+enum wal_stat_name {
+	/** fdatasync() calls. */
+	WAL_STAT_SYNC,
+	/** Batches acknowledged by those calls. */
+	WAL_STAT_SYNC_BATCH,
+	/** Rows acknowledged by those calls. */
+	WAL_STAT_SYNC_ROWS,
+	/** Rows relays read from the WAL ring. */
+	WAL_STAT_RING_ROWS,
+	WAL_STAT_LAST
+};
+
+extern const char *wal_stat_strings[];
+
 extern struct wal_writer *wal;
 extern struct rmean *rmean_tx_wal_bus;
+extern struct rmean *rmean_wal;
 extern int wal_dir_lock;
 
 #if defined(__cplusplus)
@@ -69,10 +90,22 @@ int64_t
 wal_write(struct wal_writer *writer, struct wal_request *req);
 
 
+/**
+ * Start the WAL thread.
+ *
+ * In fsync mode, written batches are synced by a group commit:
+ * a batch waits for fdatasync() at most sync_delay seconds, or
+ * less if sync_max_bytes are already pending.
+ *
+ * The last ring_size bytes of written rows are kept in memory
+ * for replication relays, see struct wal_ring_reader. Zero
+ * disables the ring.
+ */
 void
 wal_writer_start(enum wal_mode wal_mode, const char *wal_dirname,
 		 const struct tt_uuid *server_uuid, struct vclock *vclock,
-		 int64_t rows_per_wal);
+		 int64_t rows_per_wal, double sync_delay,
+		 int64_t sync_max_bytes, int64_t ring_size);
 
 void
 wal_writer_stop();
@@ -96,6 +129,66 @@ wal_set_watcher(struct wal_writer *, struct wal_watcher *,
 void
 wal_clear_watcher(struct wal_writer *, struct wal_watcher *);
 
+struct wal_ring_block;
+
+/**
+ * A reader of the in-memory ring of rows recently written to
+ * the WAL. Replication relays read rows from the ring rather
+ * than re-read the files the WAL thread has just written. All
+ * readers share the same memory: the ring consists of reference
+ * counted blocks, and a block stays alive while it is being
+ * read even if the WAL writer has already evicted it.
+ */
+struct wal_ring_reader {
+	/** The block being read, referenced. NULL if detached. */
+	struct wal_ring_block *block;
+	/** Offset of the next row in the block. */
+	size_t pos;
+	/** The size of the block data known to the reader. */
+	size_t used;
+	/** Rows read since the reader last locked the ring. */
+	int64_t rows;
+};
+
+void
+wal_ring_reader_create(struct wal_ring_reader *reader);
+
+/**
+ * Detach the reader from the ring, if attached. Safe to
+ * call after the WAL writer is stopped.
+ */
+void
+wal_ring_reader_destroy(struct wal_ring_reader *reader);
+
+/**
+ * Attach a reader to the ring so that it reads all rows
+ * following the given vclock. The reader may also see some
+ * rows preceding the vclock, which must be skipped.
+ *
+ * @retval 0 success
+ * @retval -1 some of the rows following the vclock are not
+ *         in the ring, or there is no ring
+ */
+int
+wal_ring_reader_attach(struct wal_writer *writer,
+		       struct wal_ring_reader *reader,
+		       const struct vclock *vclock);
+
+/**
+ * Read the next row. The row body points to the ring memory
+ * and stays valid until the next call.
+ *
+ * @retval 1 a row is read
+ * @retval 0 there are no more rows at the moment
+ * @retval -1 the reader lagged behind the ring and got
+ *         detached, the rest of rows must be read from
+ *         the WAL files
+ */
+int
+wal_ring_reader_next(struct wal_writer *writer,
+		     struct wal_ring_reader *reader,
+		     struct xrow_header *row);
+
 void
 wal_atfork();
 
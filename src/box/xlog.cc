@@ -846,31 +846,29 @@ xdir_create_xlog(struct xdir *dir, struct xlog *xlog,
 }
 
 /**
- * Write a sequence of uncompressed xrow objects.
- *
- * @retval -1 error
- * @retval >= 0 the number of bytes written
+ * Populate the fixheader of a sequence of uncompressed xrow
+ * objects accumulated in obuf.
  */
-static off_t
-xlog_tx_write_plain(struct xlog *log)
+static void
+xlog_tx_encode_plain(struct obuf *obuf)
 {
 	/**
 	 * We created an obuf savepoint at start of xlog_tx,
 	 * now populate it with data.
 	 */
-	char *fixheader = (char *)log->obuf.iov[0].iov_base;
+	char *fixheader = (char *)obuf->iov[0].iov_base;
 	*(log_magic_t *)fixheader = row_marker;
 	char *data = fixheader + sizeof(log_magic_t);
 
 	data = mp_encode_uint(data,
-			      obuf_size(&log->obuf) - XLOG_FIXHEADER_SIZE);
+			      obuf_size(obuf) - XLOG_FIXHEADER_SIZE);
 	/* Encode crc32 for previous row */
 	data = mp_encode_uint(data, 0);
 	/* Encode crc32 for current row */
 	uint32_t crc32c = 0;
 	struct iovec *iov;
 	size_t offset = XLOG_FIXHEADER_SIZE;
-	for (iov = log->obuf.iov; iov->iov_len; ++iov) {
+	for (iov = obuf->iov; iov->iov_len; ++iov) {
 		crc32c = crc32_calc(crc32c,
 				    (char *)iov->iov_base + offset,
 				    iov->iov_len - offset);
@@ -889,6 +887,18 @@ xlog_tx_write_plain(struct xlog *log)
 			data += padding - 1;
 		}
 	}
+}
+
+/**
+ * Write a sequence of uncompressed xrow objects.
+ *
+ * @retval -1 error
+ * @retval >= 0 the number of bytes written
+ */
+static off_t
+xlog_tx_write_plain(struct xlog *log)
+{
+	xlog_tx_encode_plain(&log->obuf);
 
 	ERROR_INJECT(ERRINJ_WAL_WRITE_DISK, {
 		diag_set(ClientError, ER_INJECTION, "xlog write injection");
@@ -905,30 +915,35 @@ xlog_tx_write_plain(struct xlog *log)
 }
 
 /**
- * Write a compressed block of xrow objects.
- * @retval -1  error
- * @retval >= 0 the number of bytes written
+ * Compress a block of xrow objects accumulated in obuf
+ * into zbuf, prefixed with a fixheader.
+ * @retval -1 error
+ * @retval 0 success
  */
-static off_t
-xlog_tx_write_zstd(struct xlog *log)
+static int
+xlog_tx_encode_zstd(struct obuf *obuf, struct obuf *zbuf, ZSTD_CCtx *zctx)
 {
-	char *fixheader = (char *)obuf_alloc(&log->zbuf,
-					     XLOG_FIXHEADER_SIZE);
+	char *fixheader = (char *)obuf_alloc(zbuf, XLOG_FIXHEADER_SIZE);
+	if (fixheader == NULL) {
+		tnt_error(OutOfMemory, XLOG_FIXHEADER_SIZE, "runtime arena",
+			  "compression buffer");
+		return -1;
+	}
 
 	uint32_t crc32c = 0;
 	struct iovec *iov;
 	/* 3 is compression level. */
-	ZSTD_compressBegin(log->zctx, 3);
+	ZSTD_compressBegin(zctx, 3);
 	size_t offset = XLOG_FIXHEADER_SIZE;
-	for (iov = log->obuf.iov; iov->iov_len; ++iov) {
+	for (iov = obuf->iov; iov->iov_len; ++iov) {
 		/* Estimate max output buffer size. */
 		size_t zmax_size = ZSTD_compressBound(iov->iov_len - offset);
 		/* Allocate a destination buffer. */
-		void *zdst = obuf_reserve(&log->zbuf, zmax_size);
+		void *zdst = obuf_reserve(zbuf, zmax_size);
 		if (!zdst) {
 			tnt_error(OutOfMemory, zmax_size, "runtime arena",
 				  "compression buffer");
-			goto error;
+			return -1;
 		}
 		size_t (*fcompress)(ZSTD_CCtx *, void *, size_t,
 				    const void *, size_t);
@@ -936,22 +951,22 @@ xlog_tx_write_zstd(struct xlog *log)
 		 * If it's the last iov or the last
 		 * log has 0 bytes, end the stream.
 		 */
-		if (iov == log->obuf.iov + log->obuf.pos ||
+		if (iov == obuf->iov + obuf->pos ||
 		    !(iov + 1)->iov_len) {
 			fcompress = ZSTD_compressEnd;
 		} else {
 			fcompress = ZSTD_compressContinue;
 		}
-		size_t zsize = fcompress(log->zctx, zdst, zmax_size,
+		size_t zsize = fcompress(zctx, zdst, zmax_size,
 					 (char *)iov->iov_base + offset,
 					 iov->iov_len - offset);
 		if (ZSTD_isError(zsize)) {
 			diag_set(ClientError, ER_COMPRESSION,
 				 ZSTD_getErrorName(zsize));
-			goto error;
+			return -1;
 		}
 		/* Advance output buffer to the end of compressed data. */
-		obuf_alloc(&log->zbuf, zsize);
+		obuf_alloc(zbuf, zsize);
 		/* Update crc32c */
 		crc32c = crc32_calc(crc32c, (char *)zdst, zsize);
 		/* Discount fixheader size for all iovs after first. */
@@ -962,7 +977,7 @@ xlog_tx_write_zstd(struct xlog *log)
 	char *data;
 	data = fixheader + sizeof(log_magic_t);
 	data = mp_encode_uint(data,
-			      obuf_size(&log->zbuf) - XLOG_FIXHEADER_SIZE);
+			      obuf_size(zbuf) - XLOG_FIXHEADER_SIZE);
 	/* Encode crc32 for previous row */
 	data = mp_encode_uint(data, 0);
 	/* Encode crc32 for current row */
@@ -977,6 +992,19 @@ xlog_tx_write_zstd(struct xlog *log)
 			data += padding - 1;
 		}
 	}
+	return 0;
+}
+
+/**
+ * Write a compressed block of xrow objects.
+ * @retval -1  error
+ * @retval >= 0 the number of bytes written
+ */
+static off_t
+xlog_tx_write_zstd(struct xlog *log)
+{
+	if (xlog_tx_encode_zstd(&log->obuf, &log->zbuf, log->zctx) != 0)
+		goto error;
 
 	ERROR_INJECT(ERRINJ_WAL_WRITE_DISK, {
 		diag_set(ClientError, ER_INJECTION, "xlog write injection");
@@ -1004,6 +1032,9 @@ error:
 #define SYNC_ROUND_DOWN(size)	((size) & ~(4096 - 1))
 #define SYNC_ROUND_UP(size)	(SYNC_ROUND_DOWN(size + SYNC_MASK))
 
+static ssize_t
+xlog_tx_write_done(struct xlog *log, ssize_t written);
+
 /**
  * Writes xlog batch to file
  */
@@ -1022,6 +1053,19 @@ xlog_tx_write(struct xlog *log)
 	ERROR_INJECT(ERRINJ_WAL_WRITE, written = -1;);
 
 	obuf_reset(&log->obuf);
+	return xlog_tx_write_done(log, written);
+}
+
+/**
+ * Account a chunk written to the log file: advance the write
+ * offset, or truncate the file after a failed write, and sync
+ * the file according to the sync interval and the rate limit.
+ *
+ * @retval written
+ */
+static ssize_t
+xlog_tx_write_done(struct xlog *log, ssize_t written)
+{
 	log->offset += written > 0 ? written : 0;
 	/*
 	 * Simplify recovery after a temporary write failure:
@@ -1073,48 +1117,61 @@ xlog_tx_write(struct xlog *log)
 }
 
 /*
- * Add a row to a log and possibly flush the log.
+ * Encode a row into a tx output buffer.
  *
  * @retval  -1 error, check diag.
- * @retval >=0 the number of bytes written to buffer.
+ * @retval >=0 the number of bytes added to the buffer.
  */
-ssize_t
-xlog_write_row(struct xlog *log, const struct xrow_header *packet)
+static ssize_t
+xlog_encode_row(struct obuf *obuf, const struct xrow_header *packet)
 {
 	/*
 	 * Automatically reserve space for a fixheader when adding
 	 * the first row in * a log. The fixheader is populated
 	 * at write. @sa xlog_tx_write().
 	 */
-	if (obuf_size(&log->obuf) == 0) {
-		if (!obuf_alloc(&log->obuf, XLOG_FIXHEADER_SIZE)) {
+	if (obuf_size(obuf) == 0) {
+		if (!obuf_alloc(obuf, XLOG_FIXHEADER_SIZE)) {
 			tnt_error(OutOfMemory, XLOG_FIXHEADER_SIZE,
 				  "runtime arena", "xlog tx output buffer");
 			return -1;
 		}
 	}
 
-	size_t page_offset = obuf_size(&log->obuf);
+	size_t page_offset = obuf_size(obuf);
 	/** encode row into iovec */
 	struct iovec iov[XROW_IOVMAX];
 	int iovcnt = xrow_header_encode(packet, iov, 0);
-	struct obuf_svp svp = obuf_create_svp(&log->obuf);
+	struct obuf_svp svp = obuf_create_svp(obuf);
 	for (int i = 0; i < iovcnt; ++i) {
-		ERROR_INJECT_U64(ERRINJ_WAL_WRITE_PARTIAL, obuf_size(&log->obuf), >,
+		ERROR_INJECT_U64(ERRINJ_WAL_WRITE_PARTIAL, obuf_size(obuf), >,
 			{	tnt_error(ClientError, ER_INJECTION, "xlog write injection");
-				obuf_rollback_to_svp(&log->obuf, &svp);
+				obuf_rollback_to_svp(obuf, &svp);
 				return -1;});
-		if (obuf_dup(&log->obuf, iov[i].iov_base, iov[i].iov_len) <
+		if (obuf_dup(obuf, iov[i].iov_base, iov[i].iov_len) <
 		    iov[i].iov_len) {
 			tnt_error(OutOfMemory, XLOG_FIXHEADER_SIZE,
 				  "runtime arena", "xlog tx output buffer");
-			obuf_rollback_to_svp(&log->obuf, &svp);
+			obuf_rollback_to_svp(obuf, &svp);
 			return -1;
 		}
 	}
 	assert(iovcnt <= XROW_IOVMAX);
+	return obuf_size(obuf) - page_offset;
+}
 
-	size_t row_size = obuf_size(&log->obuf) - page_offset;
+/*
+ * Add a row to a log and possibly flush the log.
+ *
+ * @retval  -1 error, check diag.
+ * @retval >=0 the number of bytes written to buffer.
+ */
+ssize_t
+xlog_write_row(struct xlog *log, const struct xrow_header *packet)
+{
+	ssize_t row_size = xlog_encode_row(&log->obuf, packet);
+	if (row_size < 0)
+		return -1;
 	if (log->is_autocommit &&
 	    obuf_size(&log->obuf) >= XLOG_TX_AUTOCOMMIT_THRESHOLD &&
 	    xlog_tx_write(log) < 0)
@@ -1175,6 +1232,95 @@ xlog_flush(struct xlog *log)
 	return xlog_tx_write(log);
 }
 
+ssize_t
+xlog_write_tx(struct xlog *log, const char *data, size_t size)
+{
+	/* The chunk must not be mixed with buffered rows. */
+	assert(log->is_autocommit && log->obuf.used == 0);
+	ERROR_INJECT(ERRINJ_WAL_WRITE_DISK, {
+		diag_set(ClientError, ER_INJECTION, "xlog write injection");
+		return -1;
+	});
+	ssize_t written = fio_writen(log->fd, data, size);
+	if (written < 0) {
+		diag_set(SystemError, "failed to write to '%s' file",
+			 log->filename);
+	} else {
+		written = size;
+	}
+	ERROR_INJECT(ERRINJ_WAL_WRITE, written = -1;);
+	return xlog_tx_write_done(log, written);
+}
+
+/* {{{ xlog_tx_buf */
+
+int
+xlog_tx_buf_create(struct xlog_tx_buf *buf)
+{
+	obuf_create(&buf->obuf, &cord()->slabc, XLOG_TX_AUTOCOMMIT_THRESHOLD);
+	obuf_create(&buf->zbuf, &cord()->slabc, XLOG_TX_AUTOCOMMIT_THRESHOLD);
+	buf->zctx = ZSTD_createCCtx();
+	if (buf->zctx == NULL) {
+		obuf_destroy(&buf->obuf);
+		obuf_destroy(&buf->zbuf);
+		diag_set(ClientError, ER_COMPRESSION,
+			 "failed to create context");
+		return -1;
+	}
+	return 0;
+}
+
+void
+xlog_tx_buf_destroy(struct xlog_tx_buf *buf)
+{
+	obuf_destroy(&buf->obuf);
+	obuf_destroy(&buf->zbuf);
+	ZSTD_freeCCtx(buf->zctx);
+	TRASH(buf);
+}
+
+ssize_t
+xlog_tx_buf_write_row(struct xlog_tx_buf *buf,
+		      const struct xrow_header *packet)
+{
+	return xlog_encode_row(&buf->obuf, packet);
+}
+
+char *
+xlog_tx_buf_finish(struct xlog_tx_buf *buf, size_t *size)
+{
+	assert(obuf_size(&buf->obuf) > XLOG_FIXHEADER_SIZE);
+	char *data = NULL;
+	struct obuf *out = &buf->obuf;
+	if (obuf_size(&buf->obuf) >= XLOG_TX_COMPRESS_THRESHOLD) {
+		if (xlog_tx_encode_zstd(&buf->obuf, &buf->zbuf,
+					buf->zctx) != 0)
+			goto out;
+		out = &buf->zbuf;
+	} else {
+		xlog_tx_encode_plain(&buf->obuf);
+	}
+	*size = obuf_size(out);
+	data = (char *)malloc(*size);
+	if (data == NULL) {
+		diag_set(OutOfMemory, *size, "malloc", "xlog tx");
+		goto out;
+	}
+	char *pos;
+	pos = data;
+	for (struct iovec *iov = out->iov; iov->iov_len; ++iov) {
+		memcpy(pos, iov->iov_base, iov->iov_len);
+		pos += iov->iov_len;
+	}
+	assert(pos == data + *size);
+out:
+	obuf_reset(&buf->obuf);
+	obuf_reset(&buf->zbuf);
+	return data;
+}
+
+/* }}} */
+
 static int
 sync_cb(eio_req *req)
 {
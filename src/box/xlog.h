@@ -363,6 +363,86 @@ xlog_tx_rollback(struct xlog *log);
 ssize_t
 xlog_flush(struct xlog *log);
 
+/**
+ * Append a chunk prepared with xlog_tx_buf_finish() to the
+ * log. The log must have no buffered rows.
+ *
+ * @retval count of written bytes
+ * @retval -1 if error
+ */
+ssize_t
+xlog_write_tx(struct xlog *log, const char *data, size_t size);
+
+/* {{{ xlog_tx_buf - prepare xlog transactions off the log */
+
+/**
+ * A buffer to encode and compress an xlog transaction
+ * without access to the log file, e.g. in a worker thread.
+ * The result is a ready-to-write chunk of the file, which is
+ * appended to the log with xlog_write_tx(). This allows to
+ * prepare a big file, such as a snapshot, in parallel.
+ *
+ * The buffer uses the slab cache of the cord which created
+ * it, so it must not be passed to another thread.
+ */
+struct xlog_tx_buf {
+	/** Encoded rows, with room for the fixheader. */
+	struct obuf obuf;
+	/** Compressed rows. */
+	struct obuf zbuf;
+	/** The context of zstd compression. */
+	ZSTD_CCtx *zctx;
+};
+
+/**
+ * Create a transaction buffer.
+ *
+ * @retval 0 for success
+ * @retval -1 if error
+ */
+int
+xlog_tx_buf_create(struct xlog_tx_buf *buf);
+
+/**
+ * Destroy a transaction buffer.
+ */
+void
+xlog_tx_buf_destroy(struct xlog_tx_buf *buf);
+
+/**
+ * Add a row to the transaction.
+ *
+ * @retval count of buffered bytes
+ * @retval -1 if error
+ */
+ssize_t
+xlog_tx_buf_write_row(struct xlog_tx_buf *buf,
+		      const struct xrow_header *packet);
+
+/**
+ * Size of rows buffered in the transaction.
+ */
+static inline size_t
+xlog_tx_buf_size(struct xlog_tx_buf *buf)
+{
+	return obuf_size(&buf->obuf);
+}
+
+/**
+ * Finish the transaction: compress the rows if it is worth
+ * it, encode the fixheader and copy the result to a memory
+ * chunk, which must be freed with free(). The buffer is reset
+ * for the next transaction. Must have at least one row.
+ *
+ * @param[out] size size of the returned chunk
+ * @retval the transaction chunk
+ * @retval NULL if error
+ */
+char *
+xlog_tx_buf_finish(struct xlog_tx_buf *buf, size_t *size);
+
+/* }}} */
+
 
 /**
  * Sync a log file. The exact action is defined
@@ -247,6 +247,15 @@ coio_task_post(struct coio_task *task, double timeout)
 	return 0;
 }
 
+void
+coio_task_post_async(struct coio_task *task)
+{
+	assert(task->base.type == EIO_CUSTOM);
+	/* Nobody waits: coio_on_destroy() will run the timeout_cb. */
+	task->fiber = NULL;
+	eio_submit(&task->base);
+}
+
 static void
 coio_on_call(eio_req *req)
 {
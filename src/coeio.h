@@ -116,6 +116,17 @@ coio_task_destroy(struct coio_task *task);
 int
 coio_task_post(struct coio_task *task, double timeout);
 
+/**
+ * Post coio task to EIO thread pool and return immediately.
+ * The result is never waited for: when the task is finished,
+ * its timeout callback is invoked in the posting thread to
+ * consume the result and free the task.
+ *
+ * @param task coio task.
+ */
+void
+coio_task_post_async(struct coio_task *task);
+
 /** \cond public */
 
 /**
@@ -100,6 +100,46 @@ sse42_enabled_cpu()
 	return (cx & (1 << 20)) != 0;
 }
 
+bool
+avx2_enabled_cpu()
+{
+	unsigned int ax, bx, cx, dx;
+
+	if (__get_cpuid(1, &ax, &bx, &cx, &dx) == 0)
+		return 0;
+
+	/* OSXSAVE and AVX */
+	if ((cx & (1 << 27)) == 0 || (cx & (1 << 28)) == 0)
+		return 0;
+
+	/* The OS must save XMM and YMM registers: XGETBV(0) */
+	unsigned int xcr0_lo, xcr0_hi;
+	__asm__ __volatile__(
+		".byte 0x0f, 0x01, 0xd0"
+		:"=a"(xcr0_lo), "=d"(xcr0_hi)
+		:"c"(0)
+	);
+	if ((xcr0_lo & 0x6) != 0x6)
+		return 0;
+
+	if (__get_cpuid_max(0, NULL) < 7)
+		return 0;
+
+	__cpuid_count(7, 0, ax, bx, cx, dx);
+	return (bx & (1 << 5)) != 0;
+}
+
+bool
+popcnt_enabled_cpu()
+{
+	unsigned int ax, bx, cx, dx;
+
+	if (__get_cpuid(1, &ax, &bx, &cx, &dx) == 0)
+		return 0;
+
+	return (cx & (1 << 23)) != 0;
+}
+
 #else /* !(defined (__x86_64__) || defined (__i386__)) */
 
 bool
@@ -108,4 +148,16 @@ sse42_enabled_cpu()
 	return false;
 }
 
+bool
+avx2_enabled_cpu()
+{
+	return false;
+}
+
+bool
+popcnt_enabled_cpu()
+{
+	return false;
+}
+
 #endif
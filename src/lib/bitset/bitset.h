@@ -87,6 +87,17 @@ struct bitset {
 	/** @endcond */
 };
 
+/**
+ * @brief Choose the implementation of page operations used by
+ * bitsets and iterators. Portable code is used until this is
+ * called. The caller is responsible for checking that the CPU
+ * supports the requested instructions (@sa cpu_feature.h).
+ * @param has_avx2 use AVX2 to AND, OR and NOT whole pages
+ * @param has_popcnt use POPCNT to count bits set in pages
+ */
+void
+bitset_init(bool has_avx2, bool has_popcnt);
+
 /**
  * @brief Construct \a bitset
  * @param bitset bitset
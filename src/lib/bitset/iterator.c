@@ -296,9 +296,21 @@ bitset_iterator_conj_cmp(const void *p1, const void *p2)
 	}
 }
 
-static void
+/** dst op= src on BITSET_PAGE_DATA_SIZE bytes of page data */
+typedef void (*bitset_page_op_f)(void *dst, const void *src);
+
+/*
+ * Evaluation of a result page is instantiated for each set of
+ * page kernels: the kernels are passed as constant arguments
+ * and get inlined. The instance is chosen once per expression
+ * evaluation, see bitset_iterator_first_page(), instead of
+ * calling a kernel through a pointer for every page.
+ */
+static inline __attribute__((always_inline)) void
 bitset_iterator_conj_prepare_page(struct bitset_iterator_conj *conj,
-				  struct bitset_page *dst)
+				  struct bitset_page *dst,
+				  bitset_page_op_f and_data,
+				  bitset_page_op_f nand_data)
 {
 	assert(conj != NULL);
 	assert(dst != NULL);
@@ -306,11 +318,12 @@ bitset_iterator_conj_prepare_page(struct bitset_iterator_conj *conj,
 	assert(conj->page_first_pos != SIZE_MAX);
 
 	bitset_page_set_ones(dst);
+	void *dst_data = bitset_page_data(dst);
 	for (size_t b = 0; b < conj->size; b++) {
 		if (!conj->pre_nots[b]) {
 			/* conj->pages[b] is rewinded to conj->page_first_pos */
 			assert(conj->pages[b]->first_pos == conj->page_first_pos);
-			bitset_page_and(dst, conj->pages[b]);
+			and_data(dst_data, bitset_page_data(conj->pages[b]));
 		} else {
 			/*
 			 * If page is NULL or its position is not equal
@@ -324,13 +337,16 @@ bitset_iterator_conj_prepare_page(struct bitset_iterator_conj *conj,
 			    conj->pages[b]->first_pos != conj->page_first_pos)
 				continue;
 
-			bitset_page_nand(dst, conj->pages[b]);
+			nand_data(dst_data, bitset_page_data(conj->pages[b]));
 		}
 	}
 }
 
-static void
-bitset_iterator_prepare_page(struct bitset_iterator *it)
+static inline __attribute__((always_inline)) void
+bitset_iterator_prepare_page_impl(struct bitset_iterator *it,
+				  bitset_page_op_f and_data,
+				  bitset_page_op_f nand_data,
+				  bitset_page_op_f or_data)
 {
 	qsort(it->conjs, it->size, sizeof(*it->conjs),
 	      bitset_iterator_conj_cmp);
@@ -352,9 +368,11 @@ bitset_iterator_prepare_page(struct bitset_iterator *it)
 			break;
 
 		/* Get result from conj */
-		bitset_iterator_conj_prepare_page(&it->conjs[c], it->page_tmp);
+		bitset_iterator_conj_prepare_page(&it->conjs[c], it->page_tmp,
+						  and_data, nand_data);
 		/* OR page from conjunction with it->page */
-		bitset_page_or(it->page, it->page_tmp);
+		or_data(bitset_page_data(it->page),
+			bitset_page_data(it->page_tmp));
 	}
 
 	/* Init the bit iterator on it->page */
@@ -362,11 +380,45 @@ bitset_iterator_prepare_page(struct bitset_iterator *it)
 		      BITSET_PAGE_DATA_SIZE, true);
 }
 
+static void
+bitset_iterator_prepare_page_portable(struct bitset_iterator *it)
+{
+	bitset_iterator_prepare_page_impl(it, bitset_page_and_data,
+					  bitset_page_nand_data,
+					  bitset_page_or_data);
+}
+
+#if defined(BITSET_PAGE_SIMD)
+__attribute__((target("avx2")))
+static void
+bitset_iterator_prepare_page_avx2(struct bitset_iterator *it)
+{
+	bitset_iterator_prepare_page_impl(it, bitset_page_and_data_avx2,
+					  bitset_page_nand_data_avx2,
+					  bitset_page_or_data_avx2);
+}
+#endif /* defined(BITSET_PAGE_SIMD) */
+
+static void
+bitset_iterator_prepare_page(struct bitset_iterator *it)
+{
+#if defined(BITSET_PAGE_SIMD)
+	if (it->use_avx2) {
+		bitset_iterator_prepare_page_avx2(it);
+		return;
+	}
+#endif /* defined(BITSET_PAGE_SIMD) */
+	bitset_iterator_prepare_page_portable(it);
+}
+
 static void
 bitset_iterator_first_page(struct bitset_iterator *it)
 {
 	assert(it != NULL);
 
+	/* Choose the page kernels for this evaluation */
+	it->use_avx2 = bitset_page_features.avx2;
+
 	/* Rewind all conjunctions to first positions */
 	for (size_t c = 0; c < it->size; c++) {
 		bitset_iterator_conj_rewind(&it->conjs[c], 0);
@@ -425,3 +477,44 @@ bitset_iterator_next(struct bitset_iterator *it)
 		bitset_iterator_next_page(it);
 	}
 }
+
+static inline __attribute__((always_inline)) size_t
+bitset_iterator_count_impl(struct bitset_iterator *it,
+			   size_t (*count_data)(const void *data))
+{
+	size_t count = 0;
+	for (bitset_iterator_first_page(it);
+	     it->page->first_pos != SIZE_MAX;
+	     bitset_iterator_next_page(it)) {
+		count += count_data(bitset_page_data(it->page));
+	}
+
+	return count;
+}
+
+static size_t
+bitset_iterator_count_portable(struct bitset_iterator *it)
+{
+	return bitset_iterator_count_impl(it, bitset_page_count_data);
+}
+
+#if defined(BITSET_PAGE_SIMD)
+__attribute__((target("popcnt")))
+static size_t
+bitset_iterator_count_popcnt(struct bitset_iterator *it)
+{
+	return bitset_iterator_count_impl(it, bitset_page_count_data_popcnt);
+}
+#endif /* defined(BITSET_PAGE_SIMD) */
+
+size_t
+bitset_iterator_count(struct bitset_iterator *it)
+{
+	assert(it != NULL);
+
+#if defined(BITSET_PAGE_SIMD)
+	if (bitset_page_features.popcnt)
+		return bitset_iterator_count_popcnt(it);
+#endif /* defined(BITSET_PAGE_SIMD) */
+	return bitset_iterator_count_portable(it);
+}
@@ -71,6 +71,8 @@ struct bitset_iterator {
 	struct bitset_page *page_tmp;
 	void *(*realloc)(void *ptr, size_t size);
 	struct bit_iterator page_it;
+	/* Use AVX2 page kernels, chosen on rewind. */
+	bool use_avx2;
 	/** @endcond **/
 };
 
@@ -135,6 +137,18 @@ bitset_iterator_rewind(struct bitset_iterator *it);
 size_t
 bitset_iterator_next(struct bitset_iterator *it);
 
+/**
+ * @brief Count positions where the expression evaluates to true.
+ * Whole pages of the result are counted at once, without visiting
+ * each position. The iterator is rewound before counting and is
+ * exhausted afterwards.
+ * @param it bitset iterator
+ * @return the number of bits in the result set
+ * @see @link bitset_iterator_init @endlink
+ */
+size_t
+bitset_iterator_count(struct bitset_iterator *it);
+
 #if defined(__cplusplus)
 }
 #endif /* defined(__cplusplus) */
@@ -53,14 +53,22 @@ bitset_page_set_zeros(struct bitset_page *page);
 extern inline void
 bitset_page_set_ones(struct bitset_page *page);
 
-extern inline void
-bitset_page_and(struct bitset_page *dst, struct bitset_page *src);
-
-extern inline void
-bitset_page_nand(struct bitset_page *dst, struct bitset_page *src);
+struct bitset_page_features bitset_page_features = {
+	.avx2 = false,
+	.popcnt = false,
+};
 
-extern inline void
-bitset_page_or(struct bitset_page *dst, struct bitset_page *src);
+void
+bitset_init(bool has_avx2, bool has_popcnt)
+{
+#if defined(BITSET_PAGE_SIMD)
+	bitset_page_features.avx2 = has_avx2;
+	bitset_page_features.popcnt = has_popcnt;
+#else
+	(void) has_avx2;
+	(void) has_popcnt;
+#endif /* defined(BITSET_PAGE_SIMD) */
+}
 
 #if defined(DEBUG)
 void
@@ -72,6 +72,17 @@ typedef uint64_t bitset_word_t;
 typedef uint32_t bitset_word_t;
 #endif
 
+/**
+ * CPU features the page kernels may use, set by bitset_init().
+ * Only portable kernels are used by default.
+ */
+struct bitset_page_features {
+	bool avx2;
+	bool popcnt;
+};
+
+extern struct bitset_page_features bitset_page_features;
+
 #if (defined(__GLIBC__) && (__WORDSIZE == 64) && \
      ((__GLIBC__ > 2) || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 8))) || \
     (defined(__FreeBSD__) && !defined(__arm__) && !defined(__mips__)) || \
@@ -147,11 +158,13 @@ bitset_page_set_ones(struct bitset_page *page)
 	memset(data, -1, BITSET_PAGE_DATA_SIZE);
 }
 
-inline void
-bitset_page_and(struct bitset_page *dst, struct bitset_page *src)
+/* {{{ Page kernels: operations on BITSET_PAGE_DATA_SIZE bytes */
+
+static inline void
+bitset_page_and_data(void *dst, const void *src)
 {
-	bitset_word_t *d = (bitset_word_t *) bitset_page_data(dst);
-	bitset_word_t *s = (bitset_word_t *) bitset_page_data(src);
+	bitset_word_t *d = (bitset_word_t *) dst;
+	const bitset_word_t *s = (const bitset_word_t *) src;
 
 	assert(BITSET_PAGE_DATA_SIZE % sizeof(bitset_word_t) == 0);
 	int cnt = BITSET_PAGE_DATA_SIZE / sizeof(bitset_word_t);
@@ -160,11 +173,11 @@ bitset_page_and(struct bitset_page *dst, struct bitset_page *src)
 	}
 }
 
-inline void
-bitset_page_nand(struct bitset_page *dst, struct bitset_page *src)
+static inline void
+bitset_page_nand_data(void *dst, const void *src)
 {
-	bitset_word_t *d = (bitset_word_t *) bitset_page_data(dst);
-	bitset_word_t *s = (bitset_word_t *) bitset_page_data(src);
+	bitset_word_t *d = (bitset_word_t *) dst;
+	const bitset_word_t *s = (const bitset_word_t *) src;
 
 	assert(BITSET_PAGE_DATA_SIZE % sizeof(bitset_word_t) == 0);
 	int cnt = BITSET_PAGE_DATA_SIZE / sizeof(bitset_word_t);
@@ -173,11 +186,11 @@ bitset_page_nand(struct bitset_page *dst, struct bitset_page *src)
 	}
 }
 
-inline void
-bitset_page_or(struct bitset_page *dst, struct bitset_page *src)
+static inline void
+bitset_page_or_data(void *dst, const void *src)
 {
-	bitset_word_t *d = (bitset_word_t *) bitset_page_data(dst);
-	bitset_word_t *s = (bitset_word_t *) bitset_page_data(src);
+	bitset_word_t *d = (bitset_word_t *) dst;
+	const bitset_word_t *s = (const bitset_word_t *) src;
 
 	assert(BITSET_PAGE_DATA_SIZE % sizeof(bitset_word_t) == 0);
 	int cnt = BITSET_PAGE_DATA_SIZE / sizeof(bitset_word_t);
@@ -186,6 +199,100 @@ bitset_page_or(struct bitset_page *dst, struct bitset_page *src)
 	}
 }
 
+static inline size_t
+bitset_page_count_data(const void *data)
+{
+	const uint64_t *d = (const uint64_t *) data;
+	size_t count = 0;
+
+	assert(BITSET_PAGE_DATA_SIZE % sizeof(uint64_t) == 0);
+	int cnt = BITSET_PAGE_DATA_SIZE / sizeof(uint64_t);
+	for (int i = 0; i < cnt; i++) {
+		count += bit_count_u64(*d++);
+	}
+	return count;
+}
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || \
+     (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+/*
+ * The SIMD kernels are compiled for the instruction set given
+ * in the function attribute rather than for the whole library,
+ * and are only called if the CPU supports it. They are inline
+ * so that a caller compiled for the same instruction set, e.g.
+ * the page evaluation loop of an iterator, gets them inlined
+ * rather than calling a kernel per page.
+ */
+#define BITSET_PAGE_SIMD 1
+#include <immintrin.h>
+
+enum { BITSET_PAGE_DATA_YMM = BITSET_PAGE_DATA_SIZE / sizeof(__m256i) };
+
+__attribute__((target("avx2")))
+static inline void
+bitset_page_and_data_avx2(void *dst, const void *src)
+{
+	__m256i *d = (__m256i *) dst;
+	const __m256i *s = (const __m256i *) src;
+
+	assert(BITSET_PAGE_DATA_SIZE % sizeof(__m256i) == 0);
+	for (int i = 0; i < BITSET_PAGE_DATA_YMM; i++) {
+		__m256i r = _mm256_and_si256(_mm256_loadu_si256(d + i),
+					     _mm256_loadu_si256(s + i));
+		_mm256_storeu_si256(d + i, r);
+	}
+}
+
+__attribute__((target("avx2")))
+static inline void
+bitset_page_nand_data_avx2(void *dst, const void *src)
+{
+	__m256i *d = (__m256i *) dst;
+	const __m256i *s = (const __m256i *) src;
+
+	assert(BITSET_PAGE_DATA_SIZE % sizeof(__m256i) == 0);
+	for (int i = 0; i < BITSET_PAGE_DATA_YMM; i++) {
+		/* _mm256_andnot_si256(a, b) is ~a & b */
+		__m256i r = _mm256_andnot_si256(_mm256_loadu_si256(s + i),
+						_mm256_loadu_si256(d + i));
+		_mm256_storeu_si256(d + i, r);
+	}
+}
+
+__attribute__((target("avx2")))
+static inline void
+bitset_page_or_data_avx2(void *dst, const void *src)
+{
+	__m256i *d = (__m256i *) dst;
+	const __m256i *s = (const __m256i *) src;
+
+	assert(BITSET_PAGE_DATA_SIZE % sizeof(__m256i) == 0);
+	for (int i = 0; i < BITSET_PAGE_DATA_YMM; i++) {
+		__m256i r = _mm256_or_si256(_mm256_loadu_si256(d + i),
+					    _mm256_loadu_si256(s + i));
+		_mm256_storeu_si256(d + i, r);
+	}
+}
+
+__attribute__((target("popcnt")))
+static inline size_t
+bitset_page_count_data_popcnt(const void *data)
+{
+	const uint64_t *d = (const uint64_t *) data;
+	size_t count = 0;
+
+	assert(BITSET_PAGE_DATA_SIZE % sizeof(uint64_t) == 0);
+	int cnt = BITSET_PAGE_DATA_SIZE / sizeof(uint64_t);
+	for (int i = 0; i < cnt; i++) {
+		count += __builtin_popcountll(*d++);
+	}
+	return count;
+}
+#endif /* SIMD */
+
+/* }}} Page kernels */
+
 #if defined(DEBUG)
 void
 bitset_page_dump(struct bitset_page *page, FILE *stream);
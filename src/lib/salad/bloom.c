@@ -0,0 +1,121 @@
+/*
+ * Copyright 2010-2016, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "bloom.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+/**
+ * Blocking skews the distribution of values over the table,
+ * which increases the false positive rate compared to a classic
+ * filter of the same size. Reserve some more bits to make up
+ * for it.
+ */
+static const double BLOOM_BLOCK_OVERHEAD = 1.2;
+
+/**
+ * Allocate a table of the given number of blocks aligned to
+ * the block size, so that each block occupies exactly one
+ * cache line and a lookup touches a single line.
+ */
+static struct bloom_block *
+bloom_table_new(uint32_t block_count)
+{
+	void *table;
+	if (posix_memalign(&table, sizeof(struct bloom_block),
+			   (size_t) block_count *
+			   sizeof(struct bloom_block)) != 0)
+		return NULL;
+	return (struct bloom_block *) table;
+}
+
+int
+bloom_create(struct bloom *bloom, uint32_t number_of_values,
+	     double false_positive_rate)
+{
+	assert(false_positive_rate > 0 && false_positive_rate < 1);
+	if (number_of_values == 0)
+		number_of_values = 1;
+	/* m/n = -ln(p) / ln(2)^2, k = m/n * ln(2) */
+	double bits_per_value = -log(false_positive_rate) / (M_LN2 * M_LN2);
+	double hash_count = round(bits_per_value * M_LN2);
+	if (hash_count < 1)
+		hash_count = 1;
+	if (hash_count > BLOOM_HASH_COUNT_MAX)
+		hash_count = BLOOM_HASH_COUNT_MAX;
+	double bit_count = ceil(bits_per_value * BLOOM_BLOCK_OVERHEAD *
+				number_of_values);
+	double block_count = ceil(bit_count / BLOOM_BLOCK_BITS);
+	if (block_count > UINT32_MAX)
+		block_count = UINT32_MAX;
+
+	bloom->block_count = block_count;
+	bloom->hash_count = hash_count;
+	bloom->table = bloom_table_new(bloom->block_count);
+	if (bloom->table == NULL)
+		return -1;
+	memset(bloom->table, 0, bloom_store_size(bloom));
+	return 0;
+}
+
+void
+bloom_destroy(struct bloom *bloom)
+{
+	free(bloom->table);
+	bloom->table = NULL;
+}
+
+char *
+bloom_store(const struct bloom *bloom, char *buf)
+{
+	size_t size = bloom_store_size(bloom);
+	memcpy(buf, bloom->table, size);
+	return buf + size;
+}
+
+int
+bloom_load(struct bloom *bloom, uint32_t block_count, uint32_t hash_count,
+	   const char *buf)
+{
+	assert(block_count > 0);
+	assert(hash_count > 0 && hash_count <= BLOOM_HASH_COUNT_MAX);
+	bloom->block_count = block_count;
+	bloom->hash_count = hash_count;
+	size_t size = bloom_store_size(bloom);
+	bloom->table = bloom_table_new(block_count);
+	if (bloom->table == NULL)
+		return -1;
+	memcpy(bloom->table, buf, size);
+	return 0;
+}
@@ -0,0 +1,199 @@
+#ifndef TARANTOOL_LIB_SALAD_BLOOM_H_INCLUDED
+#define TARANTOOL_LIB_SALAD_BLOOM_H_INCLUDED
+/*
+ * Copyright 2010-2016, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Blocked bloom filter.
+ *
+ * The filter is an array of cache line sized blocks. A value
+ * is mapped to exactly one block and all its bits are set and
+ * checked within that block, so that a lookup touches one cache
+ * line no matter how many hash functions are used. The price is
+ * a slightly higher false positive rate than that of a classic
+ * bloom filter of the same size, which is compensated by
+ * allocating a few more bits per value.
+ *
+ * The filter doesn't store or hash values itself: the caller
+ * passes a 32-bit hash of a value, which is then expanded into
+ * the block number and bit positions.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+typedef uint32_t bloom_hash_t;
+
+enum {
+	/** Size of a block, in bits. Equals a cache line. */
+	BLOOM_BLOCK_BITS = 512,
+	/** Number of 64-bit words in a block. */
+	BLOOM_BLOCK_WORDS = BLOOM_BLOCK_BITS / 64,
+	/** Max number of bits set per value. */
+	BLOOM_HASH_COUNT_MAX = 16,
+};
+
+struct bloom_block {
+	uint64_t bits[BLOOM_BLOCK_WORDS];
+};
+
+struct bloom {
+	/** Number of blocks in the table. */
+	uint32_t block_count;
+	/** Number of bits set in a block per value. */
+	uint32_t hash_count;
+	/** The bit table, block_count blocks. */
+	struct bloom_block *table;
+};
+
+/**
+ * Allocate and initialize an empty bloom filter.
+ *
+ * @param bloom                bloom filter to initialize
+ * @param number_of_values     expected number of values
+ * @param false_positive_rate  desired false positive rate,
+ *                             must be in (0, 1)
+ * @retval 0 success
+ * @retval -1 memory allocation error
+ */
+int
+bloom_create(struct bloom *bloom, uint32_t number_of_values,
+	     double false_positive_rate);
+
+/**
+ * Free the bloom filter table.
+ */
+void
+bloom_destroy(struct bloom *bloom);
+
+/**
+ * Size of the bloom filter table, in bytes.
+ */
+static inline size_t
+bloom_store_size(const struct bloom *bloom)
+{
+	return (size_t)bloom->block_count * sizeof(struct bloom_block);
+}
+
+/**
+ * Copy the table of the bloom filter to a buffer of
+ * bloom_store_size() bytes.
+ *
+ * @retval pointer to the end of the stored data
+ */
+char *
+bloom_store(const struct bloom *bloom, char *buf);
+
+/**
+ * Initialize a bloom filter from a table stored with
+ * bloom_store().
+ *
+ * @param bloom        bloom filter to initialize
+ * @param block_count  number of blocks in the stored table
+ * @param hash_count   number of hash functions
+ * @param buf          stored table, block_count blocks
+ * @retval 0 success
+ * @retval -1 memory allocation error
+ */
+int
+bloom_load(struct bloom *bloom, uint32_t block_count, uint32_t hash_count,
+	   const char *buf);
+
+/** Find the block of a value. */
+static inline struct bloom_block *
+bloom_block(const struct bloom *bloom, bloom_hash_t hash)
+{
+	/* Map the hash to [0, block_count) without a division. */
+	uint32_t block_no = ((uint64_t)hash * bloom->block_count) >> 32;
+	return bloom->table + block_no;
+}
+
+/**
+ * Derive the step of bit positions in a block. The block is
+ * selected by the high bits of the hash, so mix the hash to
+ * make the positions independent of the block number.
+ */
+static inline uint32_t
+bloom_hash_mix(bloom_hash_t hash)
+{
+	hash ^= hash >> 16;
+	hash *= 0x7feb352dU;
+	hash ^= hash >> 15;
+	hash *= 0x846ca68bU;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+/**
+ * Add a value to the bloom filter.
+ */
+static inline void
+bloom_add(struct bloom *bloom, bloom_hash_t hash)
+{
+	struct bloom_block *block = bloom_block(bloom, hash);
+	uint32_t h1 = bloom_hash_mix(hash);
+	uint32_t h2 = (h1 >> 16) | 1;
+	for (uint32_t i = 0; i < bloom->hash_count; i++) {
+		uint32_t bit = (h1 + i * h2) % BLOOM_BLOCK_BITS;
+		block->bits[bit / 64] |= (uint64_t)1 << (bit % 64);
+	}
+}
+
+/**
+ * Check whether a value might have been added to the filter.
+ *
+ * @retval false the value definitely was not added
+ * @retval true  the value may have been added
+ */
+static inline bool
+bloom_possible_has(const struct bloom *bloom, bloom_hash_t hash)
+{
+	const struct bloom_block *block = bloom_block(bloom, hash);
+	uint32_t h1 = bloom_hash_mix(hash);
+	uint32_t h2 = (h1 >> 16) | 1;
+	for (uint32_t i = 0; i < bloom->hash_count; i++) {
+		uint32_t bit = (h1 + i * h2) % BLOOM_BLOCK_BITS;
+		if ((block->bits[bit / 64] & ((uint64_t)1 << (bit % 64))) == 0)
+			return false;
+	}
+	return true;
+}
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* defined(__cplusplus) */
+
+#endif /* TARANTOOL_LIB_SALAD_BLOOM_H_INCLUDED */
@@ -139,6 +139,7 @@
  * bps_tree_elem_t *bps_tree_find(tree, key);
  * int bps_tree_insert(tree, new_elem, replaced_elem);
  * int bps_tree_delete(tree, elem);
+ * int bps_tree_replace_elem(tree, old_elem, new_elem);
  * size_t bps_tree_size(tree);
  * size_t bps_tree_mem_used(tree);
  * bps_tree_elem_t *bps_tree_random(tree, rnd);
@@ -347,6 +348,7 @@ typedef uint32_t bps_tree_block_id_t;
 #define bps_tree_find _api_name(find)
 #define bps_tree_insert _api_name(insert)
 #define bps_tree_delete _api_name(delete)
+#define bps_tree_replace_elem _api_name(replace_elem)
 #define bps_tree_size _api_name(size)
 #define bps_tree_mem_used _api_name(mem_used)
 #define bps_tree_random _api_name(random)
@@ -625,6 +627,21 @@ bps_tree_insert(struct bps_tree *tree, bps_tree_elem_t new_elem,
 BPS_TREE_PROTO int
 bps_tree_delete(struct bps_tree *tree, bps_tree_elem_t elem);
 
+/**
+ * @brief Replace an element with another one that takes the same
+ *  place in the order, without restructuring the tree.
+ * The new element must be greater than the previous element and
+ *  less than the next element of the replaced one.
+ * @param tree - pointer to a tree
+ * @param old_elem - the element to replace
+ * @param new_elem - the element to put in place of old_elem
+ * @return - 0 on success or -1 if old_elem was not found in the tree
+ *  or new_elem doesn't fit its place; the tree is intact then
+ */
+BPS_TREE_PROTO int
+bps_tree_replace_elem(struct bps_tree *tree, bps_tree_elem_t old_elem,
+		      bps_tree_elem_t new_elem);
+
 /**
  * @brief Get size of tree, i.e. count of elements in tree
  * @param tree - pointer to a tree
@@ -4203,6 +4220,58 @@ bps_tree_delete(struct bps_tree *tree, bps_tree_elem_t elem)
 	return 0;
 }
 
+/**
+ * @brief Replace an element with another one that takes the same
+ *  place in the order, without restructuring the tree.
+ * @param tree - pointer to a tree
+ * @param old_elem - the element to replace
+ * @param new_elem - the element to put in place of old_elem
+ * @return - 0 on success or -1 if old_elem was not found in the tree
+ *  or new_elem doesn't fit its place
+ */
+BPS_TREE_IMPL int
+bps_tree_replace_elem(struct bps_tree *tree, bps_tree_elem_t old_elem,
+		      bps_tree_elem_t new_elem)
+{
+	if (tree->root_id == (bps_tree_block_id_t)(-1))
+		return -1;
+	struct bps_inner_path_elem path[BPS_TREE_MAX_DEPTH];
+	struct bps_leaf_path_elem leaf_path_elem;
+	bool exact;
+	bps_tree_collect_path(tree, old_elem, path, &leaf_path_elem, &exact);
+	if (!exact)
+		return -1;
+
+	/* Check that the neighbours keep their order. */
+	struct bps_leaf *leaf = leaf_path_elem.block;
+	bps_tree_pos_t pos = leaf_path_elem.insertion_point;
+	struct bps_leaf *neighbour;
+	if (pos > 0) {
+		if (BPS_TREE_COMPARE(leaf->elems[pos - 1], new_elem,
+				     tree->arg) >= 0)
+			return -1;
+	} else if (leaf->prev_id != (bps_tree_block_id_t)(-1)) {
+		neighbour = (struct bps_leaf *)
+			bps_tree_restore_block(tree, leaf->prev_id);
+		if (BPS_TREE_COMPARE(neighbour->elems[neighbour->header.size - 1],
+				     new_elem, tree->arg) >= 0)
+			return -1;
+	}
+	if (pos < leaf->header.size - 1) {
+		if (BPS_TREE_COMPARE(new_elem, leaf->elems[pos + 1],
+				     tree->arg) >= 0)
+			return -1;
+	} else if (leaf->next_id != (bps_tree_block_id_t)(-1)) {
+		neighbour = (struct bps_leaf *)
+			bps_tree_restore_block(tree, leaf->next_id);
+		if (BPS_TREE_COMPARE(new_elem, neighbour->elems[0],
+				     tree->arg) >= 0)
+			return -1;
+	}
+	bps_tree_process_replace(tree, &leaf_path_elem, new_elem, NULL);
+	return 0;
+}
+
 /**
  * @brief Recursively find a maximum element in subtree.
  * Used only for debug purposes
@@ -5720,6 +5789,7 @@ bps_tree_debug_check_internal_functions(bool assertme)
 #undef bps_tree_find
 #undef bps_tree_insert
 #undef bps_tree_delete
+#undef bps_tree_replace_elem
 #undef bps_tree_size
 #undef bps_tree_mem_used
 #undef bps_tree_random
@@ -29,9 +29,11 @@
  * SUCH DAMAGE.
  */
 #include "rtree.h"
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 #include <limits.h>
+#include <math.h>
 #include <stddef.h>
 #include <sys/types.h>
 
@@ -75,18 +77,27 @@ struct rtree_reinsert_list {
 	int level;
 };
 
-static int
-neighbor_cmp(struct rtree_neighbor *a, struct rtree_neighbor *b)
+static inline struct rtree_neighbor *
+rtree_neighbor_of(struct heap_node *node)
 {
-	return a->distance < b->distance ? -1 :
-	       a->distance > b->distance ? 1 :
-	       a->level < b->level ? -1 :
-	       a->level > b->level ? 1 :
-	       a < b ? -1 : a > b ? 1 : 0;
-	return 0;
+	return (struct rtree_neighbor *)
+		((char *)node - offsetof(struct rtree_neighbor, in_heap));
+}
+
+static bool
+neighbor_less(struct heap_node *node_a, struct heap_node *node_b)
+{
+	struct rtree_neighbor *a = rtree_neighbor_of(node_a);
+	struct rtree_neighbor *b = rtree_neighbor_of(node_b);
+	return a->distance < b->distance ? true :
+	       a->distance > b->distance ? false :
+	       a->level != b->level ? a->level < b->level :
+	       a < b;
 }
 
-rb_gen(, rtnt_, rtnt_t, struct rtree_neighbor, link, neighbor_cmp);
+#define HEAP_NAME rtnh
+#define HEAP_LESS(h, l, r) neighbor_less(l, r)
+#include "heap.h"
 
 /*------------------------------------------------------------------------- */
 /* R-tree rectangle methods */
@@ -132,6 +143,31 @@ rtree_set2dp(struct rtree_rect *rect, coord_t x, coord_t y)
 	rect->coords[3] = y;
 }
 
+static coord_t
+rtree_min(coord_t a, coord_t b)
+{
+	return a < b ? a : b;
+}
+
+static coord_t
+rtree_max(coord_t a, coord_t b)
+{
+	return a > b ? a : b;
+}
+
+/*
+ * Distance from a point to a rectangle along one axis. At most one
+ * of the two differences is positive, so there is no need to branch
+ * on the side the point is at. This keeps the loops below free of
+ * unpredictable branches and lets the compiler vectorize them.
+ */
+static sq_coord_t
+rtree_axis_distance(const coord_t *coords, coord_t neigh_coord)
+{
+	return (sq_coord_t)(rtree_max(coords[0] - neigh_coord, 0) +
+			    rtree_max(neigh_coord - coords[1], 0));
+}
+
 /* Manhattan distance */
 static sq_coord_t
 rtree_rect_neigh_distance(const struct rtree_rect *rect,
@@ -140,15 +176,8 @@ rtree_rect_neigh_distance(const struct rtree_rect *rect,
 {
 	sq_coord_t result = 0;
 	for (int i = dimension; --i >= 0; ) {
-		const coord_t *coords = &rect->coords[2 * i];
-		coord_t neigh_coord = neigh_rect->coords[2 * i];
-		if (neigh_coord < coords[0]) {
-			sq_coord_t diff = (sq_coord_t)(neigh_coord - coords[0]);
-			result += -diff;
-		} else if (neigh_coord > coords[1]) {
-			sq_coord_t diff = (sq_coord_t)(neigh_coord - coords[1]);
-			result += diff;
-		}
+		result += rtree_axis_distance(&rect->coords[2 * i],
+					      neigh_rect->coords[2 * i]);
 	}
 	return result;
 }
@@ -161,15 +190,9 @@ rtree_rect_neigh_distance2(const struct rtree_rect *rect,
 {
 	sq_coord_t result = 0;
 	for (int i = dimension; --i >= 0; ) {
-		const coord_t *coords = &rect->coords[2 * i];
-		coord_t neigh_coord = neigh_rect->coords[2 * i];
-		if (neigh_coord < coords[0]) {
-			sq_coord_t diff = (sq_coord_t)(neigh_coord - coords[0]);
-			result += diff * diff;
-		} else if (neigh_coord > coords[1]) {
-			sq_coord_t diff = (sq_coord_t)(neigh_coord - coords[1]);
-			result += diff * diff;
-		}
+		sq_coord_t diff = rtree_axis_distance(&rect->coords[2 * i],
+						      neigh_rect->coords[2 * i]);
+		result += diff * diff;
 	}
 	return result;
 }
@@ -210,18 +233,6 @@ rtree_rect_add(struct rtree_rect *to, const struct rtree_rect *item,
 	}
 }
 
-static coord_t
-rtree_min(coord_t a, coord_t b)
-{
-	return a < b ? a : b;
-}
-
-static coord_t
-rtree_max(coord_t a, coord_t b)
-{
-	return a > b ? a : b;
-}
-
 static void
 rtree_rect_cover(const struct rtree_rect *item1,
 		 const struct rtree_rect *item2,
@@ -256,18 +267,24 @@ rtree_rect_intersection(const struct rtree_rect *item1,
 	}
 }
 
+/*
+ * The most frequently called comparator: it checks internal pages
+ * for all search types but SOP_EQUALS and SOP_CONTAINS. The result
+ * is accumulated without early exit to keep the loop branch-free.
+ */
 static bool
 rtree_rect_intersects_rect(const struct rtree_rect *rt1,
 			   const struct rtree_rect *rt2,
 			   unsigned dimension)
 {
+	bool result = true;
 	for (int i = dimension; --i >= 0; ) {
 		const coord_t *coords1 = &rt1->coords[2 * i];
 		const coord_t *coords2 = &rt2->coords[2 * i];
-		if (coords1[0] > coords2[1] || coords1[1] < coords2[0])
-			return false;
+		result &= !(coords1[0] > coords2[1]) &
+			  !(coords1[1] < coords2[0]);
 	}
-	return true;
+	return result;
 }
 
 static bool
@@ -716,6 +733,126 @@ rtree_page_purge(struct rtree *tree, struct rtree_page *page, int level)
 	rtree_page_free(tree, page);
 }
 
+/*------------------------------------------------------------------------- */
+/* R-tree bulk loading (Sort-Tile-Recursive) */
+/*------------------------------------------------------------------------- */
+
+struct rtree_str_item {
+	/* Doubled center of the branch along the axis being sorted */
+	coord_t center;
+	const struct rtree_page_branch *branch;
+};
+
+static int
+rtree_str_item_cmp(const void *a, const void *b)
+{
+	coord_t ca = ((const struct rtree_str_item *)a)->center;
+	coord_t cb = ((const struct rtree_str_item *)b)->center;
+	return ca < cb ? -1 : ca > cb;
+}
+
+/*
+ * Order branches so that each run of page_max_fill of them covers
+ * a compact tile: sort by the first axis, cut into slices holding
+ * the same number of pages, sort each slice by the next axis and
+ * so on.
+ */
+static void
+rtree_str_sort(const struct rtree *tree, struct rtree_str_item *items,
+	       size_t n, unsigned axis)
+{
+	for (size_t i = 0; i < n; i++) {
+		const coord_t *coords = &items[i].branch->rect.coords[2 * axis];
+		items[i].center = coords[0] + coords[1];
+	}
+	qsort(items, n, sizeof(*items), rtree_str_item_cmp);
+	if (axis + 1 >= tree->dimension)
+		return;
+	size_t fill = tree->page_max_fill;
+	size_t n_pages = (n + fill - 1) / fill;
+	size_t n_slices = (size_t)ceil(pow((double)n_pages,
+					   1.0 / (tree->dimension - axis)));
+	size_t slice_size = fill * ((n_pages + n_slices - 1) / n_slices);
+	for (size_t i = 0; i < n; i += slice_size) {
+		size_t count = n - i < slice_size ? n - i : slice_size;
+		rtree_str_sort(tree, items + i, count, axis + 1);
+	}
+}
+
+/*
+ * Put ordered branches to full pages. If the last page would be
+ * underfilled, the last two pages share their branches evenly.
+ * Branches pointing to the new pages are stored to @a upper.
+ * Return the number of pages.
+ */
+static size_t
+rtree_str_pack(struct rtree *tree, const struct rtree_str_item *items,
+	       size_t n, char *upper)
+{
+	size_t fill = tree->page_max_fill;
+	size_t n_pages = (n + fill - 1) / fill;
+	size_t pos = 0;
+	for (size_t p = 0; p < n_pages; p++) {
+		size_t count = n - pos;
+		if (count > fill + tree->page_min_fill)
+			count = fill;
+		else if (count > fill)
+			count -= count / 2;
+		struct rtree_page *page = rtree_page_alloc(tree);
+		tree->n_pages++;
+		page->n = count;
+		for (size_t i = 0; i < count; i++) {
+			rtree_branch_copy(rtree_branch_get(tree, page, i),
+					  items[pos + i].branch,
+					  tree->dimension);
+		}
+		pos += count;
+		struct rtree_page_branch *b = (struct rtree_page_branch *)
+			(upper + p * tree->page_branch_size);
+		b->data.page = page;
+		rtree_page_cover(tree, page, &b->rect);
+	}
+	assert(pos == n);
+	return n_pages;
+}
+
+/*
+ * Build the tree level by level from the bottom. @a buf holds
+ * n leaf branches, @a upper has room for branches of the pages
+ * of the next level. Both buffers are used as scratch space.
+ */
+static void
+rtree_str_build(struct rtree *tree, struct rtree_str_item *items,
+		char *buf, size_t n, char *upper)
+{
+	unsigned height = 1;
+	while (n > tree->page_max_fill) {
+		for (size_t i = 0; i < n; i++) {
+			items[i].branch = (struct rtree_page_branch *)
+				(buf + i * tree->page_branch_size);
+		}
+		rtree_str_sort(tree, items, n, 0);
+		n = rtree_str_pack(tree, items, n, upper);
+		/* Branches of the level just built are not needed */
+		char *tmp = buf;
+		buf = upper;
+		upper = tmp;
+		height++;
+	}
+	struct rtree_page *root = rtree_page_alloc(tree);
+	tree->n_pages++;
+	root->n = n;
+	for (size_t i = 0; i < n; i++) {
+		rtree_branch_copy(rtree_branch_get(tree, root, i),
+				  (struct rtree_page_branch *)
+				  (buf + i * tree->page_branch_size),
+				  tree->dimension);
+	}
+	assert(height <= RTREE_MAX_HEIGHT);
+	tree->root = root;
+	tree->height = height;
+}
+
 /*------------------------------------------------------------------------- */
 /* R-tree iterator methods */
 /*------------------------------------------------------------------------- */
@@ -795,23 +932,9 @@ rtree_iterator_destroy(struct rtree_iterator *itr)
 	}
 	itr->page_list = NULL;
 	itr->page_pos = INT_MAX;
-}
-
-struct rtree_neighbor *
-rtree_iterator_reset_cb(rtnt_t *t, struct rtree_neighbor *n, void *d)
-{
-	(void) t;
-	struct rtree_iterator *itr = (struct rtree_iterator *)d;
-	n->next = itr->neigh_free_list;
-	itr->neigh_free_list = n;
-	return 0;
-}
-
-static void
-rtree_iterator_reset(struct rtree_iterator *itr)
-{
-	rtnt_iter(&itr->neigh_tree, 0, rtree_iterator_reset_cb, (void *)itr);
-	rtnt_new(&itr->neigh_tree);
+	itr->neigh_free_list = NULL;
+	rtnh_destroy(&itr->neigh_heap);
+	rtnh_create(&itr->neigh_heap);
 }
 
 static struct rtree_neighbor *
@@ -851,17 +974,29 @@ rtree_iterator_free_neighbor(struct rtree_iterator *itr,
 	itr->neigh_free_list = n;
 }
 
+static void
+rtree_iterator_reset(struct rtree_iterator *itr)
+{
+	/*
+	 * Free the entries in order of distance so that they
+	 * are reused in the same order as with a sorted list.
+	 */
+	struct heap_node *node;
+	while ((node = rtnh_pop(&itr->neigh_heap)) != NULL)
+		rtree_iterator_free_neighbor(itr, rtree_neighbor_of(node));
+}
+
 void
 rtree_iterator_init(struct rtree_iterator *itr)
 {
 	itr->tree = 0;
-	rtnt_new(&itr->neigh_tree);
+	rtnh_create(&itr->neigh_heap);
 	itr->neigh_free_list = NULL;
 	itr->page_list = NULL;
 	itr->page_pos = INT_MAX;
 }
 
-static void
+static int
 rtree_iterator_process_neigh(struct rtree_iterator *itr,
 			     struct rtree_neighbor *neighbor)
 {
@@ -883,8 +1018,12 @@ rtree_iterator_process_neigh(struct rtree_iterator *itr,
 		struct rtree_neighbor *neigh =
 			rtree_iterator_new_neighbor(itr, b->data.page,
 						    distance, level - 1);
-		rtnt_insert(&itr->neigh_tree, neigh);
+		if (rtnh_insert(&itr->neigh_heap, &neigh->in_heap) != 0) {
+			rtree_iterator_free_neighbor(itr, neigh);
+			return -1;
+		}
 	}
+	return 0;
 }
 
 
@@ -911,17 +1050,20 @@ rtree_iterator_next(struct rtree_iterator *itr)
 		 *      page and insert them in sorted list
 		*/
 		while (true) {
-			struct rtree_neighbor *neighbor =
-				rtnt_first(&itr->neigh_tree);
-			if (neighbor == NULL)
+			struct heap_node *node = rtnh_pop(&itr->neigh_heap);
+			if (node == NULL)
 				return NULL;
-			rtnt_remove(&itr->neigh_tree, neighbor);
+			struct rtree_neighbor *neighbor =
+				rtree_neighbor_of(node);
 			if (neighbor->level == 0) {
 				void *child = neighbor->child;
 				rtree_iterator_free_neighbor(itr, neighbor);
 				return (record_t)child;
-			} else {
-				rtree_iterator_process_neigh(itr, neighbor);
+			} else if (rtree_iterator_process_neigh(itr,
+								neighbor) != 0) {
+				/* Out of memory: stop the iteration */
+				rtree_iterator_reset(itr);
+				return NULL;
 			}
 		}
 	}
@@ -951,6 +1093,9 @@ rtree_init(struct rtree *tree, unsigned dimension, uint32_t extent_size,
 	tree->version = 0;
 	tree->n_pages = 0;
 	tree->free_pages = 0;
+	tree->build_buf = NULL;
+	tree->build_count = 0;
+	tree->build_capacity = 0;
 
 	tree->dimension = dimension;
 	tree->distance_type = distance_type;
@@ -978,6 +1123,7 @@ void
 rtree_destroy(struct rtree *tree)
 {
 	rtree_purge(tree);
+	free(tree->build_buf);
 	matras_destroy(&tree->mtab);
 }
 
@@ -1006,6 +1152,60 @@ rtree_insert(struct rtree *tree, struct rtree_rect *rect, record_t obj)
 	tree->n_records++;
 }
 
+int
+rtree_build_next(struct rtree *tree, const struct rtree_rect *rect,
+		 record_t obj)
+{
+	assert(tree->root == NULL);
+	if (tree->build_count == tree->build_capacity) {
+		size_t capacity = tree->build_capacity == 0 ?
+			tree->page_max_fill : tree->build_capacity * 2;
+		char *buf = (char *)realloc(tree->build_buf,
+					    capacity * tree->page_branch_size);
+		if (buf == NULL)
+			return -1;
+		tree->build_buf = buf;
+		tree->build_capacity = capacity;
+	}
+	struct rtree_page_branch *b = (struct rtree_page_branch *)
+		(tree->build_buf + tree->build_count * tree->page_branch_size);
+	b->data.record = obj;
+	rtree_rect_copy(&b->rect, rect, tree->dimension);
+	tree->build_count++;
+	return 0;
+}
+
+void
+rtree_build_end(struct rtree *tree)
+{
+	assert(tree->root == NULL);
+	size_t n = tree->build_count;
+	if (n == 0)
+		return;
+	size_t n_pages = (n + tree->page_max_fill - 1) / tree->page_max_fill;
+	struct rtree_str_item *items =
+		(struct rtree_str_item *)malloc(n * sizeof(*items));
+	char *upper = (char *)malloc(n_pages * tree->page_branch_size);
+	if (items != NULL && upper != NULL) {
+		rtree_str_build(tree, items, tree->build_buf, n, upper);
+		tree->n_records = n;
+		tree->version++;
+	} else {
+		for (size_t i = 0; i < n; i++) {
+			struct rtree_page_branch *b =
+				(struct rtree_page_branch *)
+				(tree->build_buf + i * tree->page_branch_size);
+			rtree_insert(tree, &b->rect, b->data.record);
+		}
+	}
+	free(items);
+	free(upper);
+	free(tree->build_buf);
+	tree->build_buf = NULL;
+	tree->build_count = 0;
+	tree->build_capacity = 0;
+}
+
 bool
 rtree_remove(struct rtree *tree, const struct rtree_rect *rect, record_t obj)
 {
@@ -1109,7 +1309,10 @@ rtree_search(const struct rtree *tree, const struct rtree_rect *rect,
 				rtree_iterator_new_neighbor(itr, tree->root,
 							    distance,
 							    tree->height);
-			rtnt_insert(&itr->neigh_tree, n);
+			if (rtnh_insert(&itr->neigh_heap, &n->in_heap) != 0) {
+				rtree_iterator_free_neighbor(itr, n);
+				return false;
+			}
 			return true;
 		} else {
 			return false;
@@ -1129,6 +1332,7 @@ rtree_search(const struct rtree *tree, const struct rtree_rect *rect,
 void
 rtree_purge(struct rtree *tree)
 {
+	tree->build_count = 0;
 	if (tree->root != NULL) {
 		rtree_page_purge(tree, tree->root, tree->height);
 		tree->root = NULL;
@@ -34,8 +34,8 @@
 #include <stdbool.h>
 #include "small/matras.h"
 
-#define RB_COMPACT 1
-#include "small/rb.h"
+#define HEAP_FORWARD_DECLARATION
+#include "heap.h"
 
 /**
  * In-memory Guttman's R-tree
@@ -55,15 +55,13 @@ extern "C" {
 #endif /* defined(__cplusplus) */
 
 struct rtree_neighbor {
-	rb_node(struct rtree_neighbor) link;
+	struct heap_node in_heap;
 	struct rtree_neighbor *next;
 	void *child;
 	int level;
 	sq_coord_t distance;
 };
 
-typedef rb_tree(struct rtree_neighbor) rtnt_t;
-
 enum {
 	/** Maximal possible R-tree height */
 	RTREE_MAX_HEIGHT = 16,
@@ -152,6 +150,12 @@ struct rtree
 	void *free_pages;
 	/* Distance type */
 	enum rtree_distance_type distance_type;
+	/* Records added by rtree_build_next(), as leaf page branches */
+	char *build_buf;
+	/* Number of records in build_buf */
+	size_t build_count;
+	/* Number of records build_buf has room for */
+	size_t build_capacity;
 };
 
 /* Struct for iteration and retrieving rtree values */
@@ -168,13 +172,13 @@ struct rtree_iterator
 	/* A verion of a tree when the iterator was created */
 	unsigned version;
 
-	/* Special rb tree of closest neqighbors
+	/* Binary heap of closest neighbors, ordered by distance
 	 * Used only for iteration with op = SOP_NEIGHBOR
 	 * For allocating list entries, page allocator of tree is used.
 	 * Allocated page is much bigger than list entry and thus
 	 * provides several list entries.
 	 */
-	rtnt_t neigh_tree;
+	heap_t neigh_heap;
 	/* List of unused (deleted) list entries */
 	struct rtree_neighbor *neigh_free_list;
 	/* List of tree pages, allocated for list entries */
@@ -275,6 +279,29 @@ rtree_search(const struct rtree *tree, const struct rtree_rect *rect,
 void
 rtree_insert(struct rtree *tree, struct rtree_rect *rect, record_t obj);
 
+/**
+ * @brief Add a record to an empty tree being bulk loaded. Records
+ * are only collected here; the tree is built by rtree_build_end()
+ * in one pass, which is much faster than inserting them one by one
+ * and gives better packed pages.
+ * @return 0 on success, -1 on memory allocation error
+ * @param tree - pointer to a tree
+ * @param rect - rectangle to insert
+ * @param obj - record to insert
+ */
+int
+rtree_build_next(struct rtree *tree, const struct rtree_rect *rect,
+		 record_t obj);
+
+/**
+ * @brief Build the tree from records added by rtree_build_next()
+ * with Sort-Tile-Recursive packing. If there is not enough memory
+ * to sort the records, they are inserted one by one.
+ * @param tree - pointer to a tree
+ */
+void
+rtree_build_end(struct rtree *tree);
+
 /**
  * @brief Remove the record from a tree
  * @return true if the record deleted (false otherwise)
@@ -52,6 +52,8 @@
 #include <fiber.h>
 #include <coeio.h>
 #include <crc32.h>
+#include <cpu_feature.h>
+#include "bitset/bitset.h"
 #include "memory.h"
 #include <say.h>
 #include <rmean.h>
@@ -598,6 +600,7 @@ main(int argc, char **argv)
 	random_init();
 
 	crc32_init();
+	bitset_init(avx2_enabled_cpu(), popcnt_enabled_cpu());
 	memory_init();
 
 	main_argc = argc;
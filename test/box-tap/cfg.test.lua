@@ -4,7 +4,7 @@ local tap = require('tap')
 local test = tap.test('cfg')
 local socket = require('socket')
 local fio = require('fio')
-test:plan(43)
+test:plan(49)
 
 --------------------------------------------------------------------------------
 -- Invalid values
@@ -25,6 +25,12 @@ invalid('slab_alloc_minimal', 1000000000)
 invalid('replication_source', '//guest@localhost:3301')
 invalid('wal_mode', 'invalid')
 invalid('rows_per_wal', -1)
+invalid('wal_sync_delay', -1)
+invalid('wal_sync_max_bytes', 0)
+invalid('wal_ring_size', -1)
+invalid('snap_threads', 0)
+invalid('iproto_threads', 0)
+invalid('iproto_threads', 65)
 invalid('listen', '//!')
 invalid('logger', ':')
 invalid('logger', 'syslog:xxx=')
@@ -0,0 +1,35 @@
+fiber = require('fiber')
+test_run = require('test_run').new()
+-- no WAL writes, so DML below doesn't yield
+s = box.schema.space.create('test', {temporary = true})
+_ = s:create_index('pk')
+for i = 1, 20000 do s:insert{i, i} end
+test_run:cmd("setopt delimiter ';'")
+function build(name, f)
+    local ch = fiber.channel(1)
+    fiber.create(function()
+        local ok, err = pcall(s.create_index, s, name,
+                              {parts = {2, 'unsigned'}})
+        ch:put(ok or tostring(err))
+    end)
+    local res = {f()}
+    table.insert(res, 1, ch:get())
+    return res
+end;
+test_run:cmd("setopt delimiter ''");
+-- the space is served and changes are caught up while the index is built
+build('sk', function() s:replace{1, 100000} s:delete{2} s:insert{20001, 20001} return s:count() end)
+s.index.sk:count()
+s.index.sk:get{100000}
+s.index.sk:get{1}
+s.index.sk:get{2}
+s.index.sk:get{20001}
+s.index.sk:select({19999}, {iterator = 'GE'})
+-- the space can't be altered until the build is over
+build('sk2', function() local ok, err = pcall(s.create_index, s, 'sk3', {parts = {2, 'unsigned'}}) return ok, tostring(err) end)
+s.index.sk2:drop()
+-- a duplicate inserted while the index is built
+_ = s.index.sk:drop()
+build('sk', function() s:insert{20002, 5} end)
+s.index.sk
+s:drop()
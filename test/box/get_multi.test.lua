@@ -0,0 +1,48 @@
+remote = require('net.box')
+test_run = require('test_run').new()
+
+box.schema.user.grant('guest', 'read,write,execute', 'universe')
+s = box.schema.space.create('test')
+_ = s:create_index('pk', {type = 'hash'})
+_ = s:create_index('sk', {type = 'tree', parts = {2, 'unsigned'}})
+_ = s:create_index('nu', {type = 'tree', parts = {3, 'string'}, unique = false})
+for i = 1, 20 do s:insert{i, 100 + i, 'v' .. i % 3} end
+
+cn = remote.connect(box.cfg.listen)
+
+test_run:cmd("setopt delimiter ';'")
+function show(res, n)
+    local r = {}
+    for i = 1, n do r[i] = res[i] == nil and 'missing' or res[i] end
+    return r
+end;
+test_run:cmd("setopt delimiter ''");
+
+-- hash index, nil stands for a missing key
+show(cn.space.test:get_multi({3, 25, {1}, 0, 20}), 5)
+cn.space.test:get_multi({})
+
+-- tree index, enough keys to look them up in the index order
+keys = {}
+for i = 1, 12 do keys[i] = 100 + (i * 7) % 24 end
+show(cn.space.test.index.sk:get_multi(keys), 12)
+
+-- errors
+cn.space.test.index.nu:get_multi({'v1'})
+cn.space.test:get_multi({{1, 2}})
+cn.space.test:get_multi({'abc'})
+cn.space.test:get_multi(1)
+
+cn:close()
+
+-- local calls go through box_index_get_multi()
+show(s:get_multi({3, 25, {1}, 0, 20}), 5)
+s:get_multi({})
+show(s.index.sk:get_multi(keys), 12)
+show(s.index.pk:get_multi_luac({3, 25, 20}), 3)
+s.index.nu:get_multi({'v1'})
+s:get_multi({{1, 2}})
+s:get_multi(1)
+
+s:drop()
+box.schema.user.revoke('guest', 'read,write,execute', 'universe')
@@ -0,0 +1,22 @@
+#!/usr/bin/env tarantool
+os = require('os')
+
+-- get the number of net threads from the file name
+-- (iproto_threads4.lua => 4)
+local IPROTO_THREADS = tonumber(string.match(arg[0], "(%d+)%.lua$"))
+
+box.cfg{
+    listen              = os.getenv("LISTEN"),
+    slab_alloc_arena    = 0.1,
+    pid_file            = "tarantool.pid",
+    iproto_threads      = IPROTO_THREADS
+}
+
+require('console').listen(os.getenv('ADMIN'))
+
+box.once('bench', function()
+    box.schema.user.grant('guest', 'read,write,execute', 'universe')
+    local s = box.schema.space.create('test')
+    s:create_index('primary')
+    for i = 1, 1000 do s:insert{i, 'value' .. i} end
+end)
@@ -0,0 +1,68 @@
+--
+-- Connections are spread among several net threads and are
+-- served the same way as with a single thread. The throughput
+-- of small SELECTs with 1 and 4 net threads is written to
+-- the log.
+--
+test_run = require('test_run').new()
+fiber = require('fiber')
+net_box = require('net.box')
+log = require('log')
+
+test_run:cmd("create server iproto1 with script='box/iproto_threads1.lua'")
+test_run:cmd("create server iproto4 with script='box/iproto_threads4.lua'")
+test_run:cmd("start server iproto1")
+test_run:cmd("start server iproto4")
+
+test_run:cmd("setopt delimiter ';'")
+function bench(server, conn_count, fiber_count, duration)
+    local uri = test_run:eval(server, 'return box.cfg.listen')[1]
+    local conns = {}
+    for i = 1, conn_count do
+        conns[i] = net_box.connect(uri)
+    end
+    local count, errors = 0, 0
+    local stop = false
+    local done = fiber.channel(fiber_count)
+    for i = 1, fiber_count do
+        fiber.create(function()
+            local conn = conns[i % conn_count + 1]
+            while not stop do
+                local t = conn.space.test:select{math.random(1000)}
+                if #t == 1 then
+                    count = count + 1
+                else
+                    errors = errors + 1
+                end
+            end
+            done:put(true)
+        end)
+    end
+    fiber.sleep(duration)
+    stop = true
+    for i = 1, fiber_count do done:get() end
+    for i = 1, conn_count do conns[i]:close() end
+    return count, errors
+end;
+test_run:cmd("setopt delimiter ''");
+
+count1, errors1 = bench('iproto1', 16, 256, 5)
+count4, errors4 = bench('iproto4', 16, 256, 5)
+log.info("1 net thread: %d selects/sec", count1 / 5)
+log.info("4 net threads: %d selects/sec", count4 / 5)
+count1 > 0 and count4 > 0
+errors1 + errors4
+
+test_run:cmd("switch iproto4")
+box.cfg.iproto_threads
+-- traffic of all threads is accounted
+box.stat.net().RECEIVED.total > 0
+box.stat.net().SENT.total > 0
+-- the option can't be changed on the fly
+box.cfg{iproto_threads = 2}
+test_run:cmd("switch default")
+
+test_run:cmd("stop server iproto1")
+test_run:cmd("cleanup server iproto1")
+test_run:cmd("stop server iproto4")
+test_run:cmd("cleanup server iproto4")
@@ -0,0 +1 @@
+iproto_threads.lua
\ No newline at end of file
@@ -0,0 +1,80 @@
+remote = require('net.box')
+fiber = require('fiber')
+test_run = require('test_run').new()
+
+box.schema.user.grant('guest', 'read,write,execute', 'universe')
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+-- big tuples are sent by reference, mix them with small ones
+for i = 1, 100 do s:insert{i, string.rep(string.char(65 + i % 26), i % 3 == 0 and 10 or 1000 + i * 100)} end
+
+cn = remote.connect(box.cfg.listen)
+
+test_run:cmd("setopt delimiter ';'")
+function check(res, first, count)
+    if #res ~= count then return #res end
+    for i, t in ipairs(res) do
+        if t[1] ~= first + i - 1 or t[2] ~= s:get(t[1])[2] then
+            return t[1]
+        end
+    end
+    return true
+end;
+test_run:cmd("setopt delimiter ''");
+
+check(cn.space.test:select(), 1, 100)
+check(cn.space.test:select({50}, {iterator = 'GE', limit = 7}), 50, 7)
+show = cn.space.test:get_multi({1, 1000, 2})
+#show[1][2], show[2], #show[3][2]
+
+-- concurrent replies share the output buffer
+ch = fiber.channel(10)
+for i = 1, 10 do fiber.create(function() ch:put(check(cn.space.test:select({i}, {iterator = 'GE'}), i, 101 - i)) end) end
+res = {}
+for i = 1, 10 do res[i] = ch:get() end
+res
+
+cn:close()
+s:drop()
+
+-- a reply keeps deleted tuples alive until it is written: the
+-- client doesn't read a reply which doesn't fit in the socket
+-- buffer while its tuples are replaced
+socket = require('socket')
+msgpack = require('msgpack')
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+function value(i, c) return string.rep(string.char(c + i % 26), 64 * 1024) end
+for i = 1, 128 do s:insert{i, value(i, 65)} end
+test_run:cmd("setopt delimiter ';'")
+function encode_select(sync)
+    local header = msgpack.encode({[0x00] = 1, [0x01] = sync})
+    local body = msgpack.encode({[0x10] = s.id, [0x11] = 0,
+                                 [0x12] = 1000, [0x13] = 0,
+                                 [0x14] = 0, [0x20] = {}})
+    return msgpack.encode(#header + #body)..header..body
+end;
+function read_reply(sk)
+    local len = msgpack.decode(sk:read(5))
+    local data = sk:read(len)
+    local header, pos = msgpack.decode(data)
+    return msgpack.decode(data, pos)[0x30]
+end;
+function check_replaced(data)
+    for i, t in ipairs(data) do
+        if t[1] ~= i or t[2] ~= value(i, 65) then return i end
+    end
+    return #data
+end;
+test_run:cmd("setopt delimiter ''");
+sk = socket.tcp_connect('unix/', box.cfg.listen)
+greeting = sk:read(128)
+selects = box.stat().SELECT.total
+sk:write(encode_select(1)) > 0
+while box.stat().SELECT.total == selects do fiber.sleep(0.01) end
+for i = 1, 128 do s:replace{i, value(i, 97)} end
+s:get(1)[2] == value(1, 97)
+check_replaced(read_reply(sk))
+sk:close()
+s:drop()
+box.schema.user.revoke('guest', 'read,write,execute', 'universe')
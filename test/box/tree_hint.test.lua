@@ -0,0 +1,79 @@
+test_run = require('test_run').new()
+
+--
+-- TREE index hints must not change the order of tuples:
+-- compare search results of indexes with and without hints.
+--
+test_run:cmd("setopt delimiter ';'")
+function check(type, values)
+    local s1 = box.schema.space.create('s1')
+    s1:create_index('pk')
+    local i1 = s1:create_index('sk', {parts = {2, type}, unique = false,
+                                      hint = true})
+    local s2 = box.schema.space.create('s2')
+    s2:create_index('pk')
+    local i2 = s2:create_index('sk', {parts = {2, type}, unique = false,
+                                      hint = false})
+    for i, v in ipairs(values) do
+        s1:insert{i, v}
+        s1:insert{i + 1000, v}
+        s2:insert{i, v}
+        s2:insert{i + 1000, v}
+    end
+    local function equal(r1, r2)
+        if #r1 ~= #r2 then
+            return false
+        end
+        for i = 1, #r1 do
+            if r1[i][1] ~= r2[i][1] then
+                return false
+            end
+        end
+        return true
+    end
+    local result = equal(i1:select(), i2:select())
+    for _, v in ipairs(values) do
+        for _, it in ipairs({'EQ', 'REQ', 'GE', 'GT', 'LE', 'LT'}) do
+            if not equal(i1:select({v}, {iterator = it}),
+                         i2:select({v}, {iterator = it})) then
+                result = false
+            end
+        end
+    end
+    s1:drop()
+    s2:drop()
+    return result
+end;
+test_run:cmd("setopt delimiter ''");
+
+check('unsigned', {0, 1, 2, 1000, 2^53, tonumber64('9223372036854775807'), tonumber64('18446744073709551614'), tonumber64('18446744073709551615')})
+check('integer', {tonumber64('-9223372036854775808'), -1000, -1, 0, 1, tonumber64('9223372036854775807'), tonumber64('9223372036854775808'), tonumber64('18446744073709551615')})
+check('number', {-math.huge, -1e300, -1.5, -1, -0.0, 0, 0.5, 1, 1.5, 2^53, 2^53 + 1, 1e300, math.huge})
+check('string', {'', 'a', 'ab', 'aaaaaaa', 'aaaaaaaa', 'aaaaaaaaa', 'aaaaaaab', '\255\255\255\255\255\255\255\254', '\255\255\255\255\255\255\255\255', '\255\255\255\255\255\255\255\255\255'})
+check('scalar', {false, true, -1, 0, 1.5, 'a', 'abcdefghij'})
+
+-- The option is stored in _index and changes the index layout.
+s = box.schema.space.create('test')
+pk = s:create_index('pk')
+-- Hints are off by default: they double the size of a tree element,
+-- indexes without them keep plain tuple pointers.
+box.space._index:get{s.id, pk.id}[5].hint
+sk = s:create_index('sk', {parts = {2, 'string'}, hint = false})
+box.space._index:get{s.id, sk.id}[5].hint
+for i = 1, 100 do s:insert{i, string.format('key%04d', i)} end
+sk:alter({hint = true})
+box.space._index:get{s.id, sk.id}[5].hint
+sk:select({'key0050'}, {iterator = 'GE', limit = 2})
+sk:select({'key'}, {iterator = 'LT'})
+sk:count()
+s:drop()
+-- Only memtx TREE indexes support hints.
+s = box.schema.space.create('test')
+pk = s:create_index('pk')
+s:create_index('hash', {type = 'hash', hint = true})
+s:create_index('bitset', {type = 'bitset', unique = false, parts = {2, 'unsigned'}, hint = true})
+s:create_index('rtree', {type = 'rtree', unique = false, parts = {2, 'array'}, hint = true})
+s:drop()
+s = box.schema.space.create('vinyl', {engine = 'vinyl'})
+s:create_index('pk', {hint = true})
+s:drop()
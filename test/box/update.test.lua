@@ -259,3 +259,22 @@ s:update({0}, {})
 s = box.space.tweedledum
 
 s:drop()
+
+-- secondary keys untouched by update are swapped in place
+s = box.schema.space.create('tweedledum')
+i1 = s:create_index('pk')
+i2 = s:create_index('uniq', {parts = {2, 'unsigned'}})
+i3 = s:create_index('multi', {parts = {3, 'unsigned', 1, 'unsigned'}, unique = false})
+i4 = s:create_index('hash', {type = 'hash', parts = {2, 'unsigned'}})
+for i = 1, 10 do s:insert{i, i * 10, i % 3, 0} end
+for i = 1, 10 do s:update(i, {{'+', 4, i}}) end
+i2:get{50}
+i3:select{1}
+i4:get{70}
+s:update(5, {{'=', 3, 1}, {'+', 4, 1}})
+i3:select{1}
+i3:select{2}
+box.begin() s:update(2, {{'+', 4, 100}}) box.rollback()
+i2:get{20}
+i3:select{2}
+s:drop()
@@ -0,0 +1,47 @@
+--
+-- Group commit: in fsync mode rows and batches written by
+-- concurrent transactions share one fdatasync().
+--
+test_run = require('test_run').new()
+test_run:cmd("create server wal_sync with script='box/wal_sync.lua'")
+test_run:cmd("start server wal_sync")
+test_run:cmd("switch wal_sync")
+fiber = require('fiber')
+box.cfg.wal_mode
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+
+test_run:cmd("setopt delimiter ';'")
+function stat()
+    local st = box.stat.wal()
+    return st.SYNC.total, st.SYNC_BATCH.total, st.SYNC_ROWS.total
+end;
+-- Each fiber commits its rows one by one, every commit waits
+-- for a sync. The fibers write in different event loop
+-- iterations, so their rows go to different batches.
+function write(id, done)
+    for i = 1, 10 do
+        fiber.sleep(id * 0.001)
+        s:insert{id * 100 + i}
+    end
+    done:put(true)
+end;
+test_run:cmd("setopt delimiter ''");
+
+sync1, batch1, rows1 = stat()
+done = fiber.channel(10)
+for id = 1, 10 do fiber.create(write, id, done) end
+for id = 1, 10 do done:get() end
+s:count()
+-- The statistics are collected after the rows are acknowledged.
+while select(3, stat()) - rows1 < 100 do fiber.sleep(0.01) end
+sync2, batch2, rows2 = stat()
+-- Several rows share one sync.
+sync2 - sync1 < rows2 - rows1
+-- Several batches share one sync.
+sync2 - sync1 < batch2 - batch1
+s:drop()
+
+test_run:cmd("switch default")
+test_run:cmd("stop server wal_sync")
+test_run:cmd("cleanup server wal_sync")
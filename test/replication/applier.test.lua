@@ -0,0 +1,80 @@
+env = require('test_run')
+test_run = env.new()
+fiber = require('fiber')
+
+box.schema.user.grant('guest', 'replication')
+v = box.schema.space.create('v', {engine = 'vinyl'})
+_ = v:create_index('pk')
+m = box.schema.space.create('m')
+_ = m:create_index('pk')
+for i = 1, 10 do v:insert{i, 0} end
+m:insert{0}
+
+test_run:cmd("create server replica with rpl_master=default, script='replication/replica.lua'")
+test_run:cmd("start server replica")
+test_run:cmd("switch replica")
+fiber = require('fiber')
+errinj = box.error.injection
+while box.space.m == nil or box.space.m:get{0} == nil do fiber.sleep(0.01) end
+-- updates of v read the old tuple from disk
+box.snapshot()
+order = {}
+_ = box.space.v:on_replace(function(old, new) table.insert(order, 'v'..new[1]) end)
+_ = box.space.m:on_replace(function(old, new) table.insert(order, 'm'..new[1]) end)
+errinj.set("ERRINJ_VY_READ_PAGE_TIMEOUT", true)
+
+--
+-- A row which yields before reaching WAL is not overtaken by the
+-- next rows from the same server: the rows are written by
+-- concurrent fibers to arrive at the replica together.
+--
+test_run:cmd("switch default")
+test_run:cmd("setopt delimiter ';'")
+for i = 1, 3 do
+    fiber.create(function() v:update({i}, {{'=', 2, i}}) end)
+    fiber.create(function() m:insert{i} end)
+end;
+test_run:cmd("setopt delimiter ''");
+test_run:cmd("switch replica")
+while #order < 6 do fiber.sleep(0.01) end
+order
+errinj.set("ERRINJ_VY_READ_PAGE_TIMEOUT", false)
+box.space.v:select{3}
+
+--
+-- An apply error in the middle of a batch stops the applier, the
+-- rows before the failed one are applied, the rows after it not.
+--
+box.space.m:insert{12, 'local'}
+test_run:cmd("switch default")
+for i = 11, 13 do fiber.create(function() m:insert{i} end) end
+test_run:cmd("switch replica")
+while box.info.replication[1].status ~= 'stopped' do fiber.sleep(0.01) end
+box.info.replication[1].message
+box.space.m:select({11}, {iterator = 'GE'})
+box.space.m:delete{12}
+source = box.cfg.replication_source
+box.cfg{replication_source = ''}
+box.cfg{replication_source = source}
+while box.space.m:get{13} == nil do fiber.sleep(0.01) end
+box.space.m:select({11}, {iterator = 'GE'})
+
+--
+-- A failed WAL write of the last row stops the applier without
+-- waiting for the next row.
+--
+errinj.set("ERRINJ_WAL_WRITE", true)
+test_run:cmd("switch default")
+m:insert{14}
+test_run:cmd("switch replica")
+while box.info.replication[1].status ~= 'stopped' do fiber.sleep(0.01) end
+box.info.replication[1].message
+errinj.set("ERRINJ_WAL_WRITE", false)
+box.space.m:get{14}
+
+test_run:cmd("switch default")
+test_run:cmd("stop server replica")
+test_run:cmd("cleanup server replica")
+v:drop()
+m:drop()
+box.schema.user.revoke('guest', 'replication')
@@ -18,6 +18,19 @@ master_vclock = test_run:get_vclock('default')
 r.vclock[1] == master_vclock[1]
 r.vclock[2] == master_vclock[2]
 
+test_run:cmd('switch default')
+-- relay statistics on the master
+fiber = require('fiber')
+box.space._schema:insert({'relay'})
+while box.info.replication[2] == nil or box.info.replication[2].relay.flushes == 0 do fiber.sleep(0.01) end
+r = box.info.replication[2].relay
+r.rows > 0
+r.bytes > 0
+r.rows_per_flush >= 1
+r.bytes_per_flush > 0
+box.space._schema:delete({'relay'})
+test_run:cmd('switch replica')
+
 box.space._schema:insert({'dup'})
 test_run:cmd('switch default')
 box.space._schema:insert({'dup'})
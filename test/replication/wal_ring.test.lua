@@ -0,0 +1,51 @@
+env = require('test_run')
+test_run = env.new()
+engine = test_run:get_cfg('engine')
+
+box.schema.user.grant('guest', 'replication')
+s = box.schema.space.create('test', {engine = engine})
+_ = s:create_index('primary')
+
+test_run:cmd("create server replica with rpl_master=default, script='replication/replica.lua'")
+test_run:cmd("start server replica")
+
+-- rows read from the ring are accounted once a relay reads them
+ring_rows = function() return box.stat.wal().RING_ROWS.total end
+fiber = require('fiber')
+
+-- the replica is up to date, rows come from the WAL ring
+rows = ring_rows()
+for i = 1, 100 do s:insert{i, string.rep('x', 100)} end
+test_run:cmd("switch replica")
+fiber = require('fiber')
+while box.space.test == nil or box.space.test:count() < 100 do fiber.sleep(0.01) end
+box.space.test:count()
+test_run:cmd("switch default")
+while ring_rows() - rows < 100 do fiber.sleep(0.01) end
+ring_rows() - rows >= 100
+
+-- the replica lags behind the ring, rows come from the WAL files
+test_run:cmd("stop server replica")
+pad = string.rep('x', 1000)
+for i = 101, 20100 do s:insert{i, pad} end
+test_run:cmd("start server replica")
+test_run:cmd("switch replica")
+fiber = require('fiber')
+while box.space.test:count() < 20100 do fiber.sleep(0.01) end
+box.space.test:count()
+test_run:cmd("switch default")
+
+-- back to the ring once caught up
+rows = ring_rows()
+for i = 20101, 20200 do s:insert{i, pad} end
+test_run:cmd("switch replica")
+while box.space.test:count() < 20200 do fiber.sleep(0.01) end
+box.space.test:get{20200}[1]
+test_run:cmd("switch default")
+while ring_rows() - rows < 100 do fiber.sleep(0.01) end
+ring_rows() - rows >= 100
+
+test_run:cmd("stop server replica")
+test_run:cmd("cleanup server replica")
+s:drop()
+box.schema.user.revoke('guest', 'replication')
@@ -0,0 +1,152 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <bitset/iterator.h>
+#include <cpu_feature.h>
+#include "unit.h"
+
+/*
+ * Check that SIMD page kernels evaluate expressions the same
+ * way as the portable ones. Run with --bench argument to measure
+ * the speed of both.
+ */
+
+enum {
+	BITSETS_SIZE = 8,
+	POS_MAX = 1 << 20,
+	BENCH_LOOPS = 20
+};
+
+static struct bitset *bitsets[BITSETS_SIZE];
+
+static void
+bitsets_fill(void)
+{
+	for (size_t b = 0; b < BITSETS_SIZE; b++) {
+		bitsets[b] = malloc(sizeof(struct bitset));
+		fail_if(bitsets[b] == NULL);
+		bitset_create(bitsets[b], realloc);
+		/* From one bit out of 2 to one bit out of 256 */
+		size_t step = 2 << b;
+		for (size_t pos = rand() % step; pos < POS_MAX;
+		     pos += 1 + rand() % step) {
+			fail_unless(bitset_set(bitsets[b], pos) >= 0);
+		}
+	}
+}
+
+static void
+bitsets_destroy(void)
+{
+	for (size_t b = 0; b < BITSETS_SIZE; b++) {
+		bitset_destroy(bitsets[b]);
+		free(bitsets[b]);
+	}
+}
+
+/** (b0 & b1) | (b2 & ~b3) | (~b4 & b5 & b6) | b7 */
+static void
+expr_fill(struct bitset_expr *expr)
+{
+	bitset_expr_create(expr, realloc);
+	fail_unless(bitset_expr_add_conj(expr) == 0);
+	fail_unless(bitset_expr_add_param(expr, 0, false) == 0);
+	fail_unless(bitset_expr_add_param(expr, 1, false) == 0);
+	fail_unless(bitset_expr_add_conj(expr) == 0);
+	fail_unless(bitset_expr_add_param(expr, 2, false) == 0);
+	fail_unless(bitset_expr_add_param(expr, 3, true) == 0);
+	fail_unless(bitset_expr_add_conj(expr) == 0);
+	fail_unless(bitset_expr_add_param(expr, 4, true) == 0);
+	fail_unless(bitset_expr_add_param(expr, 5, false) == 0);
+	fail_unless(bitset_expr_add_param(expr, 6, false) == 0);
+	fail_unless(bitset_expr_add_conj(expr) == 0);
+	fail_unless(bitset_expr_add_param(expr, 7, false) == 0);
+}
+
+/** Iterate over the result, return the number of bits and their sum. */
+static size_t
+expr_eval(struct bitset_iterator *it, size_t *sum)
+{
+	size_t count = 0;
+	*sum = 0;
+	bitset_iterator_rewind(it);
+	size_t pos;
+	while ((pos = bitset_iterator_next(it)) != SIZE_MAX) {
+		count++;
+		*sum += pos;
+	}
+	return count;
+}
+
+static double
+test_clock(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+test_bench(struct bitset_iterator *it, const char *name)
+{
+	size_t sum;
+	double start = test_clock();
+	for (int i = 0; i < BENCH_LOOPS; i++)
+		expr_eval(it, &sum);
+	double next = test_clock() - start;
+	start = test_clock();
+	for (int i = 0; i < BENCH_LOOPS; i++)
+		bitset_iterator_count(it);
+	double count = test_clock() - start;
+	printf("# %s: next %.2f ms, count %.2f ms\n", name,
+	       next * 1e3 / BENCH_LOOPS, count * 1e3 / BENCH_LOOPS);
+}
+
+static void
+test_simd(bool bench)
+{
+	header();
+
+	struct bitset_expr expr;
+	expr_fill(&expr);
+	struct bitset_iterator it;
+	bitset_iterator_create(&it, realloc);
+	fail_unless(bitset_iterator_init(&it, &expr, bitsets,
+					 BITSETS_SIZE) == 0);
+	bitset_expr_destroy(&expr);
+
+	size_t sum, simd_sum;
+	bitset_init(false, false);
+	size_t count = expr_eval(&it, &sum);
+	fail_unless(count > 0);
+	fail_unless(bitset_iterator_count(&it) == count);
+	if (bench)
+		test_bench(&it, "portable");
+
+	bitset_init(avx2_enabled_cpu(), popcnt_enabled_cpu());
+	fail_unless(expr_eval(&it, &simd_sum) == count);
+	fail_unless(simd_sum == sum);
+	fail_unless(bitset_iterator_count(&it) == count);
+	if (bench)
+		test_bench(&it, "simd");
+
+	bitset_iterator_destroy(&it);
+
+	footer();
+}
+
+int
+main(int argc, char **argv)
+{
+	bool bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+	setbuf(stdout, NULL);
+	srand(time(NULL));
+	bitsets_fill();
+	test_simd(bench);
+	bitsets_destroy();
+	return 0;
+}
@@ -0,0 +1,91 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "unit.h"
+#include "salad/bloom.h"
+
+enum { VALUE_COUNT = 100000 };
+
+/** Knuth's multiplicative hash, good enough for a test. */
+static bloom_hash_t
+test_hash(uint32_t value)
+{
+	return value * 2654435761U;
+}
+
+static void
+no_false_negatives_check()
+{
+	header();
+	struct bloom bloom;
+	fail_if(bloom_create(&bloom, VALUE_COUNT, 0.01) != 0);
+	/* A block must not cross a cache line. */
+	fail_unless((uintptr_t)bloom.table % sizeof(struct bloom_block) == 0);
+	for (uint32_t i = 0; i < VALUE_COUNT; i++)
+		bloom_add(&bloom, test_hash(i));
+	for (uint32_t i = 0; i < VALUE_COUNT; i++)
+		fail_unless(bloom_possible_has(&bloom, test_hash(i)));
+	bloom_destroy(&bloom);
+	footer();
+}
+
+static void
+false_positive_rate_check()
+{
+	header();
+	double rates[] = {0.1, 0.01, 0.001};
+	for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+		struct bloom bloom;
+		fail_if(bloom_create(&bloom, VALUE_COUNT, rates[r]) != 0);
+		for (uint32_t i = 0; i < VALUE_COUNT; i++)
+			bloom_add(&bloom, test_hash(i));
+		uint32_t false_positive_count = 0;
+		for (uint32_t i = VALUE_COUNT; i < 2 * VALUE_COUNT; i++) {
+			if (bloom_possible_has(&bloom, test_hash(i)))
+				false_positive_count++;
+		}
+		double rate = (double)false_positive_count / VALUE_COUNT;
+		fail_if(rate > 2 * rates[r]);
+		bloom_destroy(&bloom);
+	}
+	footer();
+}
+
+static void
+store_load_check()
+{
+	header();
+	struct bloom bloom;
+	fail_if(bloom_create(&bloom, VALUE_COUNT, 0.05) != 0);
+	for (uint32_t i = 0; i < VALUE_COUNT; i += 2)
+		bloom_add(&bloom, test_hash(i));
+
+	char *buf = malloc(bloom_store_size(&bloom));
+	fail_if(buf == NULL);
+	char *end = bloom_store(&bloom, buf);
+	fail_unless(end == buf + bloom_store_size(&bloom));
+
+	struct bloom loaded;
+	fail_if(bloom_load(&loaded, bloom.block_count, bloom.hash_count,
+			   buf) != 0);
+	free(buf);
+	fail_unless((uintptr_t)loaded.table % sizeof(struct bloom_block) == 0);
+	fail_unless(loaded.block_count == bloom.block_count);
+	fail_unless(loaded.hash_count == bloom.hash_count);
+	for (uint32_t i = 0; i < VALUE_COUNT; i++) {
+		fail_unless(bloom_possible_has(&bloom, test_hash(i)) ==
+			    bloom_possible_has(&loaded, test_hash(i)));
+	}
+	bloom_destroy(&loaded);
+	bloom_destroy(&bloom);
+	footer();
+}
+
+int
+main(void)
+{
+	no_false_negatives_check();
+	false_positive_rate_check();
+	store_load_check();
+}
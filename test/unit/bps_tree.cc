@@ -756,6 +756,53 @@ approximate_count()
 	footer();
 }
 
+static void
+replace_elem_test()
+{
+	header();
+
+	const type_t rounds = 1000;
+	test tree;
+	test_create(&tree, 0, extent_alloc, extent_free, &extents_count);
+	for (type_t i = 0; i < rounds; i++)
+		test_insert(&tree, i * 2, 0);
+
+	int replaced = 0;
+	for (type_t i = 0; i < rounds; i++) {
+		/* Fits between the neighbours. */
+		if (test_replace_elem(&tree, i * 2, i * 2 + 1) == 0)
+			replaced++;
+		/* Jumps over the next element. */
+		if (i + 1 < rounds &&
+		    test_replace_elem(&tree, i * 2 + 1, i * 2 + 3) == 0)
+			fail("element is out of order", "true");
+		/* Not in the tree. */
+		if (test_replace_elem(&tree, i * 2, i * 2 + 1) == 0)
+			fail("missing element is replaced", "true");
+		if (test_debug_check(&tree)) {
+			test_print(&tree, TYPE_F);
+			fail("debug check nonzero", "true");
+		}
+	}
+	printf("Replaced: %d\n", replaced);
+
+	type_t prev = -1;
+	test_iterator itr = test_iterator_first(&tree);
+	type_t *elem;
+	while ((elem = test_iterator_get_elem(&tree, &itr)) != NULL) {
+		if (*elem != prev + 2)
+			fail("unexpected element", "true");
+		prev = *elem;
+		test_iterator_next(&tree, &itr);
+	}
+	if (test_size(&tree) != (size_t) rounds)
+		fail("Tree count mismatch", "true");
+
+	test_destroy(&tree);
+
+	footer();
+}
+
 int
 main(void)
 {
@@ -767,6 +814,7 @@ main(void)
 	printing_test();
 	white_box_test();
 	approximate_count();
+	replace_elem_test();
 	if (extents_count != 0)
 		fail("memory leak!", "true");
 }
@@ -260,12 +260,131 @@ neighbor_test()
 	footer();
 }
 
+static double
+test_distance2(const struct rtree_rect *rect, const struct rtree_rect *point)
+{
+	double result = 0;
+	for (int i = 0; i < 2; i++) {
+		double c = point->coords[2 * i];
+		double d = 0;
+		if (c < rect->coords[2 * i])
+			d = rect->coords[2 * i] - c;
+		else if (c > rect->coords[2 * i + 1])
+			d = c - rect->coords[2 * i + 1];
+		result += d * d;
+	}
+	return result;
+}
+
+/* Count records found by the search and sum up their ids */
+static size_t
+test_search(struct rtree *tree, const struct rtree_rect *rect,
+	    enum spatial_search_op op, size_t *sum)
+{
+	struct rtree_iterator iterator;
+	rtree_iterator_init(&iterator);
+	size_t count = 0;
+	*sum = 0;
+	if (rtree_search(tree, rect, op, &iterator)) {
+		record_t rec;
+		while ((rec = rtree_iterator_next(&iterator)) != NULL) {
+			count++;
+			*sum += (size_t)rec;
+		}
+	}
+	rtree_iterator_destroy(&iterator);
+	return count;
+}
+
+static void
+bulk_load_test()
+{
+	header();
+
+	const size_t max_count = 5000;
+	struct rtree_rect *arr = (struct rtree_rect *)
+		malloc(max_count * sizeof(*arr));
+	for (size_t i = 0; i < max_count; i++) {
+		double x = rand() % 1000, y = rand() % 1000;
+		rtree_set2d(&arr[i], x, y, x + rand() % 10, y + rand() % 10);
+	}
+	const size_t counts[] = { 0, 1, 2, 30, 31, 32, 33, 40, 500, 1234,
+				  max_count };
+	for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+		size_t count = counts[c];
+		struct rtree tree, bulk;
+		rtree_init(&tree, 2, extent_size,
+			   extent_alloc, extent_free, &page_count,
+			   RTREE_EUCLID);
+		rtree_init(&bulk, 2, extent_size,
+			   extent_alloc, extent_free, &page_count,
+			   RTREE_EUCLID);
+		rtree_test_build(&tree, arr, count);
+		for (size_t i = 0; i < count; i++) {
+			if (rtree_build_next(&bulk, &arr[i],
+					     (record_t)(i + 1)) != 0)
+				fail("build next", "true");
+		}
+		rtree_build_end(&bulk);
+		if (rtree_number_of_records(&bulk) != count)
+			fail("bulk loaded tree count", "true");
+
+		struct rtree_rect rect;
+		size_t sum, bulk_sum;
+		for (int i = 0; i < 100; i++) {
+			double x = rand() % 1000, y = rand() % 1000;
+			rtree_set2d(&rect, x, y, x + rand() % 100,
+				    y + rand() % 100);
+			if (test_search(&tree, &rect, SOP_OVERLAPS, &sum) !=
+			    test_search(&bulk, &rect, SOP_OVERLAPS, &bulk_sum) ||
+			    sum != bulk_sum)
+				fail("overlaps search result", "true");
+			if (test_search(&tree, &rect, SOP_BELONGS, &sum) !=
+			    test_search(&bulk, &rect, SOP_BELONGS, &bulk_sum) ||
+			    sum != bulk_sum)
+				fail("belongs search result", "true");
+		}
+
+		rtree_set2dp(&rect, rand() % 1000, rand() % 1000);
+		struct rtree_iterator iterator;
+		rtree_iterator_init(&iterator);
+		rtree_search(&bulk, &rect, SOP_NEIGHBOR, &iterator);
+		double last = 0;
+		size_t found = 0;
+		record_t rec;
+		while ((rec = rtree_iterator_next(&iterator)) != NULL) {
+			double d = test_distance2(&arr[(size_t)rec - 1], &rect);
+			if (d < last)
+				fail("neighbor search order", "true");
+			last = d;
+			found++;
+		}
+		if (found != count)
+			fail("neighbor search count", "true");
+		rtree_iterator_destroy(&iterator);
+
+		/* Bulk loaded pages must survive removal like usual ones */
+		for (size_t i = 0; i < count; i++) {
+			if (!rtree_remove(&bulk, &arr[i], (record_t)(i + 1)))
+				fail("delete element from bulk loaded tree",
+				     "false");
+		}
+		if (rtree_number_of_records(&bulk) != 0)
+			fail("bulk loaded tree count after delete", "true");
+		rtree_destroy(&bulk);
+		rtree_destroy(&tree);
+	}
+	free(arr);
+
+	footer();
+}
 
 int
 main(void)
 {
 	simple_check();
 	neighbor_test();
+	bulk_load_test();
 	if (page_count != 0) {
 		fail("memory leak!", "true");
 	}
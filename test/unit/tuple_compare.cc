@@ -0,0 +1,262 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "box/tuple.h"
+#include "box/tuple_compare.h"
+#include "unit.h"
+
+/*
+ * Check that comparators specialized by field types agree with
+ * the generic ones. Run with --bench argument to measure the
+ * speed of both.
+ */
+
+struct tuple_format **tuple_formats;
+
+enum { FIELD_COUNT = 4, TUPLE_COUNT = 1000, BENCH_LOOPS = 10000000 };
+
+struct test_layout {
+	const char *name;
+	uint32_t part_count;
+	struct key_part parts[FIELD_COUNT];
+};
+
+static const struct test_layout layouts[] = {
+	{ "unsigned + string", 2, {
+		{ 1, FIELD_TYPE_UNSIGNED }, { 3, FIELD_TYPE_STRING } } },
+	{ "integer + integer", 2, {
+		{ 0, FIELD_TYPE_INTEGER }, { 2, FIELD_TYPE_INTEGER } } },
+	{ "scalar + number + string", 3, {
+		{ 2, FIELD_TYPE_SCALAR }, { 0, FIELD_TYPE_NUMBER },
+		{ 1, FIELD_TYPE_STRING } } },
+	{ "string + unsigned", 2, {
+		{ 0, FIELD_TYPE_STRING }, { 1, FIELD_TYPE_UNSIGNED } } },
+};
+
+static struct key_def *
+test_key_def_new(const struct test_layout *layout)
+{
+	struct key_def *def = (struct key_def *)
+		calloc(1, sizeof(*def) +
+		       layout->part_count * sizeof(struct key_part));
+	fail_if(def == NULL);
+	def->part_count = layout->part_count;
+	memcpy(def->parts, layout->parts,
+	       layout->part_count * sizeof(struct key_part));
+	def->tuple_compare = tuple_compare_create(def);
+	def->tuple_compare_with_key = tuple_compare_with_key_create(def);
+	return def;
+}
+
+static struct tuple_format *
+test_format_new(const struct key_def *def)
+{
+	struct tuple_format *format = (struct tuple_format *)
+		calloc(1, sizeof(*format) +
+		       FIELD_COUNT * sizeof(struct tuple_field_format));
+	fail_if(format == NULL);
+	format->field_count = FIELD_COUNT;
+	for (uint32_t i = 0; i < def->part_count; i++)
+		format->fields[def->parts[i].fieldno].type = def->parts[i].type;
+	/* Same as tuple_format_new(). */
+	format->fields[0].offset_slot = INT32_MAX;
+	int current_slot = 0;
+	for (uint32_t i = 1; i < format->field_count; i++) {
+		if (format->fields[i].type == FIELD_TYPE_ANY)
+			format->fields[i].offset_slot = INT32_MAX;
+		else
+			format->fields[i].offset_slot = --current_slot;
+	}
+	format->field_map_size = -current_slot * sizeof(uint32_t);
+	tuple_formats = (struct tuple_format **)
+		realloc(tuple_formats, sizeof(*tuple_formats));
+	fail_if(tuple_formats == NULL);
+	tuple_formats[0] = format;
+	return format;
+}
+
+static char *
+test_encode_field(char *data, enum field_type type)
+{
+	static const char *strs[] = { "", "a", "ab", "b", "ba", "bb" };
+	const char *str = strs[rand() % lengthof(strs)];
+	int64_t ival = rand() % 200 - 100;
+	switch (type) {
+	case FIELD_TYPE_STRING:
+		return mp_encode_str(data, str, strlen(str));
+	case FIELD_TYPE_SCALAR:
+		if (rand() % 3 == 0)
+			return test_encode_field(data, FIELD_TYPE_STRING);
+		/* Fall through. */
+	case FIELD_TYPE_NUMBER:
+		if (rand() % 2 == 0)
+			return mp_encode_double(data, ival / 4.0);
+		/* Fall through. */
+	case FIELD_TYPE_INTEGER:
+		if (ival < 0)
+			return mp_encode_int(data, ival);
+		return mp_encode_uint(data, ival);
+	default:
+		return mp_encode_uint(data, rand() % 10);
+	}
+}
+
+static struct tuple *
+test_tuple_new(struct tuple_format *format)
+{
+	char buf[256];
+	char *end = mp_encode_array(buf, format->field_count);
+	for (uint32_t i = 0; i < format->field_count; i++)
+		end = test_encode_field(end, format->fields[i].type);
+	uint32_t bsize = end - buf;
+	struct tuple *tuple = (struct tuple *)
+		malloc(sizeof(*tuple) + format->field_map_size + bsize);
+	fail_if(tuple == NULL);
+	tuple->refs = 1;
+	tuple->format_id = format->id;
+	tuple->bsize = bsize;
+	tuple->data_offset = sizeof(*tuple) + format->field_map_size;
+	char *data = (char *) tuple + tuple->data_offset;
+	memcpy(data, buf, bsize);
+	/* Same as tuple_init_field_map(), without validation. */
+	uint32_t *field_map = (uint32_t *) data;
+	const char *pos = data;
+	mp_decode_array(&pos);
+	for (uint32_t i = 0; i < format->field_count; i++) {
+		if (format->fields[i].offset_slot != INT32_MAX)
+			field_map[format->fields[i].offset_slot] = pos - data;
+		mp_next(&pos);
+	}
+	return tuple;
+}
+
+/** Extract the key of @a def from @a tuple into @a buf. */
+static void
+test_key_extract(const struct tuple *tuple, const struct key_def *def,
+		 char *buf)
+{
+	for (uint32_t i = 0; i < def->part_count; i++) {
+		const char *field = tuple_field_raw(tuple_format(tuple),
+						    tuple_data(tuple),
+						    tuple_field_map(tuple),
+						    def->parts[i].fieldno);
+		const char *end = field;
+		mp_next(&end);
+		memcpy(buf, field, end - field);
+		buf += end - field;
+	}
+}
+
+static int
+sign(int r)
+{
+	return r < 0 ? -1 : r > 0;
+}
+
+static double
+test_clock(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+test_bench(const struct key_def *def, struct tuple **tuples, char **keys)
+{
+	double start;
+	int sum = 0;
+	start = test_clock();
+	for (int i = 0; i < BENCH_LOOPS; i++)
+		sum += tuple_compare_default(tuples[i % TUPLE_COUNT],
+					     tuples[(i * 7) % TUPLE_COUNT],
+					     def);
+	double cmp_default = test_clock() - start;
+	start = test_clock();
+	for (int i = 0; i < BENCH_LOOPS; i++)
+		sum += def->tuple_compare(tuples[i % TUPLE_COUNT],
+					  tuples[(i * 7) % TUPLE_COUNT], def);
+	double cmp = test_clock() - start;
+	start = test_clock();
+	for (int i = 0; i < BENCH_LOOPS; i++)
+		sum += tuple_compare_with_key_default(tuples[i % TUPLE_COUNT],
+						      keys[(i * 7) % TUPLE_COUNT],
+						      def->part_count, def);
+	double key_default = test_clock() - start;
+	start = test_clock();
+	for (int i = 0; i < BENCH_LOOPS; i++)
+		sum += def->tuple_compare_with_key(tuples[i % TUPLE_COUNT],
+						   keys[(i * 7) % TUPLE_COUNT],
+						   def->part_count, def);
+	double key = test_clock() - start;
+	printf("# tuple_compare: default %.1f ns, specialized %.1f ns\n",
+	       cmp_default * 1e9 / BENCH_LOOPS, cmp * 1e9 / BENCH_LOOPS);
+	printf("# tuple_compare_with_key: default %.1f ns, "
+	       "specialized %.1f ns (%d)\n", key_default * 1e9 / BENCH_LOOPS,
+	       key * 1e9 / BENCH_LOOPS, sign(sum));
+}
+
+static void
+test_layout(const struct test_layout *layout, bool bench)
+{
+	struct key_def *def = test_key_def_new(layout);
+	struct tuple_format *format = test_format_new(def);
+	struct tuple *tuples[TUPLE_COUNT];
+	char *keys[TUPLE_COUNT];
+	for (int i = 0; i < TUPLE_COUNT; i++) {
+		tuples[i] = test_tuple_new(format);
+		keys[i] = (char *) malloc(tuples[i]->bsize);
+		fail_if(keys[i] == NULL);
+		test_key_extract(tuples[i], def, keys[i]);
+	}
+
+	ok(def->tuple_compare != tuple_compare_default &&
+	   def->tuple_compare_with_key != tuple_compare_with_key_default,
+	   "%s: specialized comparators", layout->name);
+
+	bool is_equal = true;
+	bool is_equal_with_key = true;
+	for (int i = 0; i < TUPLE_COUNT; i++) {
+		for (int j = 0; j < TUPLE_COUNT; j++) {
+			int r = def->tuple_compare(tuples[i], tuples[j], def);
+			int r_default = tuple_compare_default(tuples[i],
+							      tuples[j], def);
+			if (sign(r) != sign(r_default))
+				is_equal = false;
+			uint32_t part_count = 1 + j % def->part_count;
+			r = def->tuple_compare_with_key(tuples[i], keys[j],
+							part_count, def);
+			r_default = tuple_compare_with_key_default(tuples[i],
+								   keys[j],
+								   part_count,
+								   def);
+			if (sign(r) != sign(r_default))
+				is_equal_with_key = false;
+		}
+	}
+	ok(is_equal, "%s: tuple_compare", layout->name);
+	ok(is_equal_with_key, "%s: tuple_compare_with_key", layout->name);
+
+	if (bench)
+		test_bench(def, tuples, keys);
+
+	for (int i = 0; i < TUPLE_COUNT; i++) {
+		free(tuples[i]);
+		free(keys[i]);
+	}
+	free(format);
+	free(def);
+}
+
+int
+main(int argc, char **argv)
+{
+	bool bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+	srand(time(NULL));
+	plan(3 * lengthof(layouts));
+	for (size_t i = 0; i < lengthof(layouts); i++)
+		test_layout(&layouts[i], bench);
+	free(tuple_formats);
+	return check_plan();
+}
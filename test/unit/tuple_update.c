@@ -0,0 +1,218 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "trivia/util.h"
+#include "memory.h"
+#include "fiber.h"
+#include "box/tuple_update.h"
+#include "unit.h"
+
+/*
+ * Check that the in-place update fast path produces the same
+ * tuples as the rope-based path. Upsert always goes the rope way
+ * and is equivalent to update if no operation fails, so it is
+ * used as the reference. Run with --bench argument to measure
+ * the speed of both.
+ */
+
+enum { FIELD_COUNT = 10, RANDOM_LOOPS = 10000, BENCH_LOOPS = 1000000 };
+
+static void *
+test_alloc(void *ctx, size_t size)
+{
+	return region_alloc((struct region *) ctx, size);
+}
+
+static char *
+test_encode_ops(char *pos, const char *opcode, uint32_t field_no,
+		int64_t arg)
+{
+	pos = mp_encode_array(pos, 3);
+	pos = mp_encode_str(pos, opcode, 1);
+	pos = mp_encode_uint(pos, field_no);
+	if (arg < 0)
+		return mp_encode_int(pos, arg);
+	return mp_encode_uint(pos, arg);
+}
+
+/**
+ * Apply @a ops to @a tuple with update and upsert and check
+ * that both produce the same result.
+ */
+static bool
+test_update_equal(const char *tuple, const char *tuple_end,
+		  const char *ops, const char *ops_end, bool *is_error)
+{
+	struct region *region = &fiber()->gc;
+	uint32_t update_size, upsert_size;
+	const char *update = tuple_update_execute(test_alloc, region,
+						  ops, ops_end, tuple,
+						  tuple_end, &update_size,
+						  0, NULL);
+	*is_error = update == NULL;
+	if (update == NULL)
+		return true;
+	const char *upsert = tuple_upsert_execute(test_alloc, region,
+						  ops, ops_end, tuple,
+						  tuple_end, &upsert_size,
+						  0, true, NULL);
+	return upsert != NULL && update_size == upsert_size &&
+	       memcmp(update, upsert, update_size) == 0;
+}
+
+static char *
+test_tuple_new(char *pos)
+{
+	pos = mp_encode_array(pos, FIELD_COUNT);
+	for (uint32_t i = 0; i < FIELD_COUNT; i++) {
+		if (i % 3 == 2)
+			pos = mp_encode_str(pos, "abc", 3);
+		else
+			pos = mp_encode_uint(pos, 100 + i);
+	}
+	return pos;
+}
+
+static void
+test_basic(void)
+{
+	char tuple[256], ops[256];
+	char *tuple_end = test_tuple_new(tuple);
+	bool is_error;
+	char *pos;
+
+	pos = mp_encode_array(ops, 1);
+	pos = test_encode_ops(pos, "+", 1, 1);
+	ok(test_update_equal(tuple, tuple_end, ops, pos, &is_error) &&
+	   !is_error, "increment of the same size");
+
+	pos = mp_encode_array(ops, 1);
+	pos = test_encode_ops(pos, "+", 1, 1000);
+	ok(test_update_equal(tuple, tuple_end, ops, pos, &is_error) &&
+	   !is_error, "increment changing the size");
+
+	pos = mp_encode_array(ops, 3);
+	pos = test_encode_ops(pos, "-", 0, 1);
+	pos = test_encode_ops(pos, "|", 4, 3);
+	pos = test_encode_ops(pos, "=", 3, 42);
+	ok(test_update_equal(tuple, tuple_end, ops, pos, &is_error) &&
+	   !is_error, "several operations");
+
+	pos = mp_encode_array(ops, 1);
+	pos = mp_encode_array(pos, 3);
+	pos = mp_encode_str(pos, "+", 1);
+	pos = mp_encode_int(pos, -1);
+	pos = mp_encode_uint(pos, 1);
+	ok(test_update_equal(tuple, tuple_end, ops, pos, &is_error) &&
+	   !is_error, "negative field number");
+
+	pos = mp_encode_array(ops, 1);
+	pos = mp_encode_array(pos, 3);
+	pos = mp_encode_str(pos, "=", 1);
+	pos = mp_encode_uint(pos, 2);
+	pos = mp_encode_str(pos, "xyz", 3);
+	ok(test_update_equal(tuple, tuple_end, ops, pos, &is_error) &&
+	   !is_error, "set of the same size");
+
+	pos = mp_encode_array(ops, 2);
+	pos = test_encode_ops(pos, "+", 1, 1);
+	pos = test_encode_ops(pos, "+", 1, 1);
+	test_update_equal(tuple, tuple_end, ops, pos, &is_error);
+	ok(is_error, "double update of the same field");
+
+	pos = mp_encode_array(ops, 1);
+	pos = test_encode_ops(pos, "+", 2, 1);
+	test_update_equal(tuple, tuple_end, ops, pos, &is_error);
+	ok(is_error, "arithmetic on a string");
+
+	pos = mp_encode_array(ops, 1);
+	pos = test_encode_ops(pos, "+", FIELD_COUNT, 1);
+	test_update_equal(tuple, tuple_end, ops, pos, &is_error);
+	ok(is_error, "no such field");
+
+	region_truncate(&fiber()->gc, 0);
+}
+
+static void
+test_random(void)
+{
+	static const char *opcodes[] = { "=", "+", "-", "&", "|", "^", "#" };
+	char tuple[256], ops[256];
+	char *tuple_end = test_tuple_new(tuple);
+	bool is_equal = true;
+	for (int i = 0; i < RANDOM_LOOPS; i++) {
+		uint32_t op_count = 1 + rand() % 4;
+		char *pos = mp_encode_array(ops, op_count);
+		for (uint32_t j = 0; j < op_count; j++) {
+			const char *opcode =
+				opcodes[rand() % lengthof(opcodes)];
+			int64_t arg = rand() % 300 - 50;
+			if (*opcode == '#')
+				arg = 1;
+			else if (*opcode != '+' && *opcode != '-' &&
+				 *opcode != '=')
+				arg = labs(arg);
+			uint32_t field_no = rand() % FIELD_COUNT;
+			pos = test_encode_ops(pos, opcode, field_no, arg);
+		}
+		bool is_error;
+		if (!test_update_equal(tuple, tuple_end, ops, pos,
+				       &is_error))
+			is_equal = false;
+		region_truncate(&fiber()->gc, 0);
+	}
+	ok(is_equal, "random updates");
+}
+
+static double
+test_clock(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+test_bench(void)
+{
+	struct region *region = &fiber()->gc;
+	char tuple[256], ops[256];
+	char *tuple_end = test_tuple_new(tuple);
+	char *pos = mp_encode_array(ops, 1);
+	pos = test_encode_ops(pos, "+", 4, 1);
+	uint32_t size;
+	double start = test_clock();
+	for (int i = 0; i < BENCH_LOOPS; i++) {
+		tuple_update_execute(test_alloc, region, ops, pos, tuple,
+				     tuple_end, &size, 0, NULL);
+		region_truncate(region, 0);
+	}
+	double in_place = test_clock() - start;
+	start = test_clock();
+	for (int i = 0; i < BENCH_LOOPS; i++) {
+		tuple_upsert_execute(test_alloc, region, ops, pos, tuple,
+				     tuple_end, &size, 0, true, NULL);
+		region_truncate(region, 0);
+	}
+	double rope = test_clock() - start;
+	printf("# increment: in place %.1f ns, rope %.1f ns\n",
+	       in_place * 1e9 / BENCH_LOOPS, rope * 1e9 / BENCH_LOOPS);
+}
+
+int
+main(int argc, char **argv)
+{
+	bool bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+	memory_init();
+	fiber_init(fiber_c_invoke);
+	srand(time(NULL));
+	plan(9);
+	test_basic();
+	test_random();
+	if (bench)
+		test_bench();
+	fiber_free();
+	memory_free();
+	return check_plan();
+}
@@ -0,0 +1,56 @@
+#include "box/vy_quota.h"
+#include "unit.h"
+
+static void
+quota_cb(enum vy_quota_event event, void *arg)
+{
+	(void)event;
+	(void)arg;
+}
+
+static void
+quota_create(struct vy_quota *q, size_t used)
+{
+	vy_quota_init(q, 1000, quota_cb, NULL);
+	q->watermark = 500;
+	vy_quota_set_throttle_rate(q, 100);
+	vy_quota_force_use(q, used);
+	/* Reset the token bucket. */
+	vy_quota_delay(q, 0, 0);
+}
+
+int
+main()
+{
+	plan(7);
+
+	struct vy_quota q;
+	quota_create(&q, 400);
+	ok(vy_quota_delay(&q, 100, 0) == 0, "no delay below watermark");
+
+	quota_create(&q, 600);
+	double delay = vy_quota_delay(&q, 10, 0);
+	ok(delay > 0, "delay above watermark");
+
+	quota_create(&q, 900);
+	ok(vy_quota_delay(&q, 10, 0) > delay, "delay grows towards limit");
+
+	quota_create(&q, 600);
+	delay = vy_quota_delay(&q, 100, 0);
+	ok(vy_quota_delay(&q, 0, delay) == 0, "debt is paid off by sleeping");
+
+	quota_create(&q, 600);
+	vy_quota_set_throttle_rate(&q, 0);
+	ok(vy_quota_delay(&q, 100, 0) == 0,
+	   "no delay if throttling is disabled");
+
+	quota_create(&q, 999);
+	ok(vy_quota_delay(&q, 100, 0) <= VY_QUOTA_THROTTLE_WINDOW,
+	   "delay is bounded near the limit");
+	for (int i = 0; i < 10; i++)
+		delay = vy_quota_delay(&q, 100, 0);
+	ok(delay <= VY_QUOTA_THROTTLE_WINDOW,
+	   "debt of concurrent writers does not stack");
+
+	return check_plan();
+}
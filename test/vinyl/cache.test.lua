@@ -0,0 +1,36 @@
+test_run = require('test_run').new()
+
+-- hot range scans are served from the tuple cache
+s = box.schema.space.create('test', {engine = 'vinyl'})
+_ = s:create_index('pk')
+for i = 1, 10 do s:replace({i * 10}) end
+box.snapshot()
+#s:select()
+old_hit = box.info.vinyl().tuple_cache.hit
+#s:select()
+box.info.vinyl().tuple_cache.hit - old_hit >= 9
+box.info.vinyl().tuple_cache.used > 0
+
+-- a missing key inside a cached range is found missing right away
+old_hit = box.info.vinyl().tuple_cache.hit
+s:get({15})
+box.info.vinyl().tuple_cache.hit - old_hit
+
+-- the cache is updated on commit
+s:replace({50, 'x'})
+s:delete({60})
+s:insert({15})
+s:upsert({30, 1}, {{'!', 2, 'y'}})
+s:select()
+s:select()
+s:get({60})
+s:get({50})
+s:select({45}, {iterator = 'LT'})
+s:select({45}, {iterator = 'LT'})
+
+-- transactions see their own changes
+box.begin() s:replace({25}) c = s:select({20}, {iterator = 'GE', limit = 2}) box.rollback()
+c
+s:select({20}, {iterator = 'GE', limit = 2})
+
+s:drop()
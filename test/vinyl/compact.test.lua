@@ -38,5 +38,94 @@ test_run:grep_log('default', 'UPSERT operation failed') ~= nil
 
 space:drop()
 
+-- leveled compaction keeps a single run per level
+space = box.schema.space.create("vinyl", { engine = 'vinyl' })
+_ = space:create_index('primary', { compaction = 'leveled' })
+vyinfo().compaction
+space:replace({1})
+box.snapshot()
+space:replace({2})
+box.snapshot()
+while vyinfo().run_count >= 2 do fiber.sleep(0.1) end
+vyinfo().run_count == 1
+space:select()
+space:drop()
+
+space = box.schema.space.create("vinyl", { engine = 'vinyl' })
+space:create_index('pk', { compaction = 'universal' })
+space:create_index('pk', { run_size_ratio = 1 })
+space:create_index('pk', { level_count = 0 })
+space:drop()
+
+-- partial compaction: the newest runs are merged, older runs of
+-- the range are moved to the new range, also after restart
+digest = require('digest')
+space = box.schema.space.create("vinyl", { engine = 'vinyl' })
+_ = space:create_index('primary', { compact_wm = 2, run_size_ratio = 2, range_size = 64 * 1024 * 1024 })
+test_run:cmd("setopt delimiter ';'")
+function fill(keys, tag)
+    for _, k in ipairs(keys) do
+        space:replace({k, tag, digest.sha1_hex(k..tag)})
+    end
+    box.snapshot()
+end;
+function range(first, last, step)
+    local keys = {}
+    for k = first, last, step do table.insert(keys, k) end
+    return keys
+end;
+function check()
+    local bad = 0
+    for _, t in space:pairs() do
+        local k = t[1]
+        local tag = (k > 1600 or k % 16 == 2) and 'd' or
+                    k % 16 == 1 and 'c' or k % 4 == 1 and 'b' or 'a'
+        if t[2] ~= tag or t[3] ~= digest.sha1_hex(k..tag) then
+            bad = bad + 1
+        end
+    end
+    return bad
+end;
+test_run:cmd("setopt delimiter ''");
+fill(range(1, 1600, 1), 'a')
+fill(range(1, 1600, 4), 'b')
+fill(range(1, 1600, 16), 'c')
+-- each run is in its own level
+vyinfo().run_count == 3
+space:count()
+check()
+-- the two newest runs are in the first level, merge them only
+d = range(2, 1600, 16)
+for k = 1601, 1610 do table.insert(d, k) end
+fill(d, 'd')
+while vyinfo().run_count > 3 do fiber.sleep(0.1) end
+vyinfo().run_count == 3
+space:count()
+check()
+test_run:cmd('restart server default')
+test_run = require('test_run').new()
+digest = require('digest')
+space = box.space.vinyl
+function vyinfo() return box.info.vinyl().db[box.space.vinyl.id..'/0'] end
+vyinfo().run_count == 3
+space:count()
+test_run:cmd("setopt delimiter ';'")
+function check()
+    local bad = 0
+    for _, t in space:pairs() do
+        local k = t[1]
+        local tag = (k > 1600 or k % 16 == 2) and 'd' or
+                    k % 16 == 1 and 'c' or k % 4 == 1 and 'b' or 'a'
+        if t[2] ~= tag or t[3] ~= digest.sha1_hex(k..tag) then
+            bad = bad + 1
+        end
+    end
+    return bad
+end;
+test_run:cmd("setopt delimiter ''");
+check()
+space:drop()
+fiber = require('fiber')
+
 fiber = nil
 test_run = nil
@@ -0,0 +1,17 @@
+#!/usr/bin/env tarantool
+
+box.cfg {
+    listen            = os.getenv("LISTEN"),
+    slab_alloc_arena  = 0.5,
+    slab_alloc_maximal = 4 * 1024 * 1024,
+    rows_per_wal      = 1000000,
+    vinyl = {
+        threads = 2;
+        memory_limit = 0.5;
+        page_size = 1024;
+        compress_threads = 2;
+        compact_bandwidth = 64 * 1024;
+    }
+}
+
+require('console').listen(os.getenv('ADMIN'))
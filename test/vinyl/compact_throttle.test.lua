@@ -0,0 +1,56 @@
+test_run = require('test_run').new()
+
+test_run:cmd('create server compact_throttle with script="vinyl/compact_throttle.lua"')
+test_run:cmd("start server compact_throttle")
+test_run:cmd('switch compact_throttle')
+
+fiber = require('fiber')
+digest = require('digest')
+
+function vyinfo(s) return box.info.vinyl().db[s.id..'/0'] end
+
+-- two spaces with 2 dumped runs of ~128K each wait for compaction
+test_run:cmd("setopt delimiter ';'")
+function fill(s)
+    for i = 1, 128 do s:replace{i, digest.urandom(1024)} end
+end;
+test_run:cmd("setopt delimiter ''");
+s1 = box.schema.space.create('s1', {engine = 'vinyl'})
+_ = s1:create_index('pk')
+s2 = box.schema.space.create('s2', {engine = 'vinyl'})
+_ = s2:create_index('pk')
+fill(s1) fill(s2)
+box.snapshot()
+vyinfo(s1).run_count == 1
+fill(s1) fill(s2)
+t = fiber.time()
+box.snapshot()
+
+-- one of the two workers is kept for dumps: a dump doesn't
+-- wait for compactions, which are throttled
+s3 = box.schema.space.create('s3', {engine = 'vinyl'})
+_ = s3:create_index('pk')
+s3:replace{1}
+box.snapshot()
+fiber.time() - t < 1
+vyinfo(s3).run_count == 1
+vyinfo(s1).run_count + vyinfo(s2).run_count > 2
+
+-- compaction of 256K at 64K per second with a burst of 64K
+-- takes at least 3 seconds
+while vyinfo(s1).run_count > 1 or vyinfo(s2).run_count > 1 do fiber.sleep(0.1) end
+fiber.time() - t >= 3
+
+-- pages compressed in parallel are written in order
+s1:count()
+s2:count()
+s1:select({100}, {iterator = 'GE', limit = 3})[3][1]
+s2:select({100}, {iterator = 'LE', limit = 3})[3][1]
+
+s1:drop()
+s2:drop()
+s3:drop()
+
+test_run:cmd('switch default')
+test_run:cmd("stop server compact_throttle")
+test_run:cmd("cleanup server compact_throttle")
@@ -94,3 +94,34 @@ errinj.set("ERRINJ_VY_READ_PAGE", false);
 s:select()
 s:drop()
 
+
+--
+-- Runs written in the XROW page format, used before pages were
+-- packed, are still read, also merged with packed runs.
+--
+page_format = require('page_format')
+s = box.schema.space.create('test', {engine='vinyl'})
+_ = s:create_index('pk', {compact_wm = 10})
+_ = s:create_index('sk', {parts = {2, 'unsigned'}, unique = false, compact_wm = 10})
+m = box.schema.space.create('oracle')
+_ = m:create_index('pk')
+_ = m:create_index('sk', {parts = {2, 'unsigned'}, unique = false})
+errinj.set("ERRINJ_VY_RUN_WRITE_XROW", true)
+test_run:cmd("setopt delimiter ';'")
+for i = 1, 300 do
+    local t = {2 * i, i % 30, string.rep('x', i % 7)}
+    s:replace(t) m:replace(t)
+end;
+test_run:cmd("setopt delimiter ''");
+box.snapshot()
+for i = 1, 300, 3 do s:delete{2 * i} m:delete{2 * i} end
+box.snapshot()
+errinj.set("ERRINJ_VY_RUN_WRITE_XROW", false)
+page_format.check(s.index.pk, m.index.pk, 601)
+page_format.check(s.index.sk, m.index.sk, 30)
+for i = 1, 300, 5 do s:replace{2 * i + 1, i % 30} m:replace{2 * i + 1, i % 30} end
+box.snapshot()
+page_format.check(s.index.pk, m.index.pk, 601)
+page_format.check(s.index.sk, m.index.sk, 30)
+s:drop()
+m:drop()
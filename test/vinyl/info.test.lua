@@ -17,7 +17,10 @@ for _, v in ipairs({ 'path', 'build', 'tx_latency', 'cursor_latency',
                      'get_latency', 'gc_active', 'run_avg', 'run_count',
                      'page_count', 'memory_used', 'run_max', 'run_histogram',
                      'size', 'size_uncompressed', 'used', 'count',
-                     'rps', 'total', 'bandwidth', 'avg', 'max', 'watermark' }) do
+                     'rps', 'total', 'bandwidth', 'avg', 'max', 'watermark',
+                     'hit', 'miss', 'evict', 'write_amplification',
+                     'read_amplification', 'space_amplification',
+                     'throttle_histogram', 'prefetch' }) do
     test_run:cmd("push filter '"..v..": .*' to '"..v..": <"..v..">'")
 end;
 test_run:cmd("setopt delimiter ''");
@@ -56,5 +59,47 @@ box.info.vinyl().memory.min_lsn == box.info.vclock[1]
 space:drop()
 box.info.vinyl().memory.min_lsn
 
+-- decompressed pages are shared between lookups
+space = box.schema.space.create('test', { engine = 'vinyl' })
+index = space:create_index('primary')
+for i = 1, 100 do space:replace({i}) end
+box.snapshot()
+old_miss = box.info.vinyl().page_cache.miss
+old_hit = box.info.vinyl().page_cache.hit
+space:get({1})
+space:get({2})
+box.info.vinyl().page_cache.miss - old_miss > 0
+box.info.vinyl().page_cache.hit - old_hit > 0
+box.info.vinyl().page_cache.used > 0
+space:drop()
+
+-- sequential scans read pages ahead
+space = box.schema.space.create('test', { engine = 'vinyl' })
+index = space:create_index('primary', { page_size = 64 })
+for i = 1, 1000 do space:replace({i}) end
+box.snapshot()
+old_prefetch = box.info.vinyl().page_cache.prefetch
+#index:select()
+box.info.vinyl().page_cache.prefetch - old_prefetch > 0
+#index:select({}, { iterator = 'LE' })
+space:drop()
+
+-- bloom filters let lookups skip runs without the key
+space = box.schema.space.create('test', { engine = 'vinyl' })
+index = space:create_index('primary')
+index2 = space:create_index('secondary', { parts = {2, 'string'} })
+for i = 1, 100 do space:replace({i, tostring(i)}) end
+box.snapshot()
+function pk_info() return box.info.vinyl().db[space.id..'/0'] end
+function sk_info() return box.info.vinyl().db[space.id..'/1'] end
+old_hit = pk_info().bloom_hit
+for i = 1001, 1010 do space:get({i}) end
+pk_info().bloom_hit - old_hit > 0
+space:get({1})
+old_hit = sk_info().bloom_hit
+for i = 1001, 1010 do space:insert({i, tostring(i)}) end
+sk_info().bloom_hit - old_hit > 0
+space:drop()
+
 test_run:cmd('switch default')
 test_run:cmd("stop server vinyl_info")
@@ -0,0 +1,48 @@
+-- Helpers to check lookups in vinyl runs against a memtx space.
+
+local ITERATORS = {'EQ', 'REQ', 'GE', 'GT', 'LE', 'LT'}
+
+local function equal(a, b)
+    if #a ~= #b then
+        return false
+    end
+    for i = 1, #a do
+        local x, y = a[i]:totable(), b[i]:totable()
+        if #x ~= #y then
+            return false
+        end
+        for j = 1, #x do
+            if x[j] ~= y[j] then
+                return false
+            end
+        end
+    end
+    return true
+end
+
+--
+-- Look up every key from 0 to max_key with every iterator type
+-- and return the lookups whose result differs from the oracle.
+-- The keys cover every position of every page, including the
+-- restart points and the keys between them.
+--
+local function check(index, oracle, max_key)
+    local diff = {}
+    for _, it in ipairs(ITERATORS) do
+        for key = 0, max_key do
+            local opts = {iterator = it, limit = 3}
+            if not equal(index:select({key}, opts),
+                         oracle:select({key}, opts)) then
+                table.insert(diff, {it, key})
+            end
+        end
+    end
+    if not equal(index:select(), oracle:select()) then
+        table.insert(diff, 'ALL')
+    end
+    return diff
+end
+
+return {
+    check = check;
+}
@@ -0,0 +1,73 @@
+test_run = require('test_run').new()
+page_format = require('page_format')
+
+--
+-- Round trip of statements through packed run pages. The primary
+-- key of test1 is a prefix of the tuple (VALUE_PREFIX entries),
+-- the secondary index and DELETEs store keys only (KEY entries),
+-- the primary key of test2 is not a prefix (FULL entries). Pages
+-- are 1K, so each of them spans several restart points.
+--
+s1 = box.schema.space.create('test1', {engine = 'vinyl'})
+_ = s1:create_index('pk', {compact_wm = 10})
+_ = s1:create_index('sk', {parts = {2, 'unsigned'}, unique = false, compact_wm = 10})
+m1 = box.schema.space.create('oracle1')
+_ = m1:create_index('pk')
+_ = m1:create_index('sk', {parts = {2, 'unsigned'}, unique = false})
+s2 = box.schema.space.create('test2', {engine = 'vinyl'})
+_ = s2:create_index('pk', {parts = {2, 'unsigned'}, compact_wm = 10})
+m2 = box.schema.space.create('oracle2')
+_ = m2:create_index('pk', {parts = {2, 'unsigned'}})
+function vyinfo(s) return box.info.vinyl().db[s.id..'/0'] end
+test_run:cmd("setopt delimiter ';'")
+for i = 1, 500 do
+    local t = {2 * i, i % 50, string.rep('x', i % 7)}
+    s1:replace(t) m1:replace(t)
+    t = {string.rep('y', i % 5), 2 * i}
+    s2:replace(t) m2:replace(t)
+end;
+test_run:cmd("setopt delimiter ''");
+box.snapshot()
+vyinfo(s1).page_count > 5
+vyinfo(s2).page_count > 5
+page_format.check(s1.index.pk, m1.index.pk, 1001)
+page_format.check(s1.index.sk, m1.index.sk, 50)
+page_format.check(s2.index.pk, m2.index.pk, 1001)
+
+--
+-- DELETE and UPSERT statements are read from a newer run.
+--
+test_run:cmd("setopt delimiter ';'")
+for i = 1, 500, 3 do
+    s1:delete{2 * i} m1:delete{2 * i}
+    s2:delete{2 * i} m2:delete{2 * i}
+end;
+for i = 1, 500, 4 do
+    local ops = {{'=', 1, 'z'}}
+    s2:upsert({'z', 2 * i}, ops) m2:upsert({'z', 2 * i}, ops)
+    s2:upsert({'z', 2 * i + 1}, ops) m2:upsert({'z', 2 * i + 1}, ops)
+end;
+test_run:cmd("setopt delimiter ''");
+box.snapshot()
+vyinfo(s1).run_count == 2
+vyinfo(s2).run_count == 2
+page_format.check(s1.index.pk, m1.index.pk, 1001)
+page_format.check(s1.index.sk, m1.index.sk, 50)
+page_format.check(s2.index.pk, m2.index.pk, 1001)
+
+--
+-- The same lookups with no pages cached.
+--
+test_run:cmd('restart server default')
+page_format = require('page_format')
+s1 = box.space.test1
+m1 = box.space.oracle1
+s2 = box.space.test2
+m2 = box.space.oracle2
+page_format.check(s1.index.pk, m1.index.pk, 1001)
+page_format.check(s1.index.sk, m1.index.sk, 50)
+page_format.check(s2.index.pk, m2.index.pk, 1001)
+s1:drop()
+m1:drop()
+s2:drop()
+m2:drop()
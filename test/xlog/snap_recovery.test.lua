@@ -0,0 +1,29 @@
+--
+-- Snapshot recovery with snap_threads > 1: rows are decoded
+-- in a reader thread, secondary keys are sorted in parallel.
+--
+test_run = require('test_run').new()
+test_run:cmd("create server snap with script='xlog/snap_threads.lua'")
+test_run:cmd("start server snap")
+test_run:cmd("switch snap")
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+_ = s:create_index('sk', {parts = {2, 'unsigned'}, unique = false})
+_ = s:create_index('name', {parts = {3, 'string'}})
+_ = s:create_index('hash', {type = 'hash', parts = {3, 'string'}})
+box.begin() for i = 1, 30000 do s:insert({i, i % 100, 'name' .. i}) end box.commit()
+box.snapshot()
+test_run:cmd("restart server snap")
+box.cfg.snap_threads
+s = box.space.test
+s:count()
+s.index.sk:count(42)
+s.index.sk:min()
+s.index.sk:max()
+s.index.name:select('name1', {limit = 3})
+s.index.name:max()
+s.index.hash:get('name12345')
+s:drop()
+test_run:cmd("switch default")
+test_run:cmd("stop server snap")
+test_run:cmd("cleanup server snap")
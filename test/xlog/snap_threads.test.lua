@@ -0,0 +1,28 @@
+env = require('test_run').new()
+
+-- a snapshot written by several threads is recovered in full
+box.cfg{snap_threads = 4}
+s1 = box.schema.space.create('snap1')
+_ = s1:create_index('pk')
+s2 = box.schema.space.create('snap2')
+_ = s2:create_index('pk', {type = 'hash'})
+box.begin() for i = 1, 50000 do s1:insert({i, string.rep('x', i % 100)}) end box.commit()
+box.begin() for i = 1, 10000 do s2:insert({i}) end box.commit()
+box.snapshot()
+env:cmd('restart server default')
+
+s1 = box.space.snap1
+s2 = box.space.snap2
+s1:count()
+s2:count()
+s1:min()[1]
+s1:max()[1]
+#s1:get(12345)[2]
+s2:get(10000)
+
+ok = pcall(box.cfg, {snap_threads = 0})
+ok
+box.cfg.snap_threads
+
+s1:drop()
+s2:drop()